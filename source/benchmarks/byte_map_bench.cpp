@@ -0,0 +1,112 @@
+// Content substitution map throughput: the byte_map translate paths on
+// a buffer that fits in L2 and one that does not, next to memcpy, then
+// file_read through the mapping with and without a content map, where
+// decoding is part of the copy out of the container.
+//
+// Build (from the repository root):
+//   g++ -std=c++17 -O2 source/benchmarks/byte_map_bench.cpp source/core/fs/*.cpp source/core/storage/*.cpp
+//       source/core/security/*.cpp source/core/config/uconf_parser.cpp source/core/logging/logger.cpp
+//       source/core/logging/log_encoding.cpp source/core/common/*.cpp -I source/include
+//       -o bin/byte_map_bench -pthread
+//
+// Usage: byte_map_bench [file_kb]   (default 4096)
+
+#include "../include/byte_map.hpp"
+#include "../include/file_system.hpp"
+#include "../include/logger.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace ofs;
+
+// GB/s of fn over len bytes, repeated for about 0.2 s.
+template <typename Fn>
+static double gbps(size_t len, Fn fn)
+{
+    size_t rounds = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    double secs = 0;
+    do {
+        fn();
+        ++rounds;
+        secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    } while (secs < 0.2);
+    return rounds * len / secs / 1e9;
+}
+
+int main(int argc, char** argv)
+{
+    size_t file_kb = argc > 1 ? static_cast<size_t>(std::strtoul(argv[1], nullptr, 10)) : 4096;
+
+    uint8_t map[bytemap::TABLE_SIZE];
+    bytemap::make_permutation(1, map);
+    bytemap::Table table;
+    bytemap::prepare(map, table);
+
+    std::printf("%-10s %14s %14s\n", "path", "64 KiB GB/s", "64 MiB GB/s");
+    std::vector<uint8_t> small_src(64 * 1024, 0x5A), small_dst(small_src.size());
+    std::vector<uint8_t> large_src(64 * 1024 * 1024, 0x5A), large_dst(large_src.size());
+    for (size_t i = 0; i < large_src.size(); ++i) {
+        large_src[i] = static_cast<uint8_t>(i * 131 + (i >> 9));
+    }
+    std::memcpy(small_src.data(), large_src.data(), small_src.size());
+
+    double small = gbps(small_src.size(), [&] { std::memcpy(small_dst.data(), small_src.data(), small_src.size()); });
+    double large = gbps(large_src.size(), [&] { std::memcpy(large_dst.data(), large_src.data(), large_src.size()); });
+    std::printf("%-10s %14.2f %14.2f\n", "memcpy", small, large);
+    for (bytemap::Path path : {bytemap::Path::scalar, bytemap::Path::ssse3, bytemap::Path::avx2,
+                                bytemap::Path::avx512vbmi}) {
+        if (!bytemap::supported(path)) {
+            std::printf("%-10s %14s %14s\n", bytemap::path_name(path), "-", "-");
+            continue;
+        }
+        small = gbps(small_src.size(), [&] {
+            bytemap::translate(path, table, small_src.data(), small_dst.data(), small_src.size());
+        });
+        large = gbps(large_src.size(), [&] {
+            bytemap::translate(path, table, large_src.data(), large_dst.data(), large_src.size());
+        });
+        std::printf("%-10s %14.2f %14.2f\n", bytemap::path_name(path), small, large);
+    }
+
+    const std::string path = "byte_map_bench.omni";
+    Logger::get_instance().set_log_file("logs/byte_map_bench.log");
+    Logger::get_instance().set_min_level(LogLevel::warn);
+
+    std::string body(file_kb * 1024, '\0');
+    std::memcpy(body.data(), large_src.data(), std::min(body.size(), large_src.size()));
+    std::printf("\n%-14s %14s\n", "file_read", "GB/s");
+    for (bool encode : {false, true}) {
+        config::Config cfg;
+        cfg.total_size = 64ULL * 1024 * 1024 + 2 * body.size();
+        cfg.total_size -= cfg.total_size % cfg.block_size;
+        cfg.max_files = 64;
+        cfg.max_users = 4;
+        cfg.hash_iterations = 1;
+        cfg.io_sync_policy = "on_shutdown";
+        cfg.history_size = 0;
+        cfg.encode_content = encode;
+        storage::OmniContainer::format(path, cfg);
+
+        fs::FileSystem filesystem;
+        if (filesystem.init(path, cfg) != OFSErrorCodes::SUCCESS ||
+            filesystem.file_create("/data", body.data(), body.size()) != OFSErrorCodes::SUCCESS) {
+            std::cerr << "setup failed\n";
+            return 1;
+        }
+        std::string out;
+        double rate = gbps(body.size(), [&] { filesystem.file_read("/data", out); });
+        std::printf("%-14s %14.2f\n", encode ? "content map" : "stored as is", rate);
+        filesystem.shutdown();
+    }
+
+    std::filesystem::remove(path);
+    return 0;
+}
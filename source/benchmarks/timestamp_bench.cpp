@@ -0,0 +1,90 @@
+// Per-line formatting cost of the logger, before and after the cached clock.
+//
+// Build (from the repository root):
+//   g++ -std=c++17 -O2 source/benchmarks/timestamp_bench.cpp source/core/common/coarse_clock.cpp
+//       source/core/logging/log_encoding.cpp -I source/include -o bin/timestamp_bench -pthread
+
+#include "../include/coarse_clock.hpp"
+#include "../include/log_encoding.hpp"
+
+#include <chrono>
+#include <ctime>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+using namespace ofs;
+
+static constexpr int ITERATIONS = 1000000;
+
+// The original Logger::get_timestamp_utc(): now + gmtime_r + put_time into a fresh ostringstream.
+static std::string legacy_timestamp()
+{
+    auto now = std::chrono::system_clock::now();
+    auto time = std::chrono::system_clock::to_time_t(now);
+    std::tm utc {};
+    gmtime_r(&time, &utc);
+    std::ostringstream oss;
+    oss << std::put_time(&utc, "%Y-%m-%dT%H:%M:%SZ");
+    return oss.str();
+}
+
+// The original line assembly through an ostream.
+static std::string legacy_line(const std::string& msg)
+{
+    std::ostringstream os;
+    os << legacy_timestamp()
+       << " app=\"" << "bench" << "\""
+       << " pid=" << 1234
+       << " level=" << "INFO"
+       << " module=" << "BENCH"
+       << " code=" << 10
+       << " msg=\"" << msg << "\""
+       << " file=\"" << __FILE__ << "\""
+       << " line=" << __LINE__
+       << "\n";
+    return os.str();
+}
+
+template <typename Fn>
+static double ns_per_op(Fn&& fn)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < ITERATIONS; ++i) {
+        fn(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::nano>(end - start).count() / ITERATIONS;
+}
+
+int main()
+{
+    const std::string msg = "file_read completed for /reports/daily.txt";
+    size_t sink = 0;
+
+    double ts_before = ns_per_op([&](int) { sink += legacy_timestamp().size(); });
+    double ts_after = ns_per_op([&](int) { sink += clock::utc_timestamp(clock::unix_nanos()).size(); });
+
+    double line_before = ns_per_op([&](int) { sink += legacy_line(msg).size(); });
+    std::string line;
+    double line_after = ns_per_op([&](int) {
+        line.clear();
+        format_text_log_line(line, clock::unix_nanos(), "bench", 1234, LogLevel::info,
+                             "BENCH", 10, msg, __FILE__, __LINE__);
+        sink += line.size();
+    });
+
+    double secs_before = ns_per_op([&](int) {
+        sink += static_cast<size_t>(std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    });
+    double secs_after = ns_per_op([&](int) { sink += clock::unix_seconds(); });
+
+    std::cout << std::fixed << std::setprecision(1);
+    std::cout << "timestamp only   before " << ts_before << " ns   after " << ts_after << " ns\n";
+    std::cout << "full log line    before " << line_before << " ns   after " << line_after << " ns\n";
+    std::cout << "unix seconds     before " << secs_before << " ns   after " << secs_after << " ns\n";
+    std::cout << "(checksum " << sink << ")\n";
+    return 0;
+}
@@ -0,0 +1,216 @@
+#include "../../include/base64.hpp"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace ofs::base64
+{
+    namespace
+    {
+        constexpr char ALPHABET[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+        constexpr uint8_t INVALID = 0xFF;
+
+        struct DecodeTable
+        {
+            uint8_t v[256];
+
+            constexpr DecodeTable() : v()
+            {
+                for (int i = 0; i < 256; ++i) {
+                    v[i] = INVALID;
+                }
+                for (int i = 0; i < 64; ++i) {
+                    v[static_cast<uint8_t>(ALPHABET[i])] = static_cast<uint8_t>(i);
+                }
+            }
+        };
+
+        constexpr DecodeTable DECODE{};
+    }
+
+    void encode_scalar(const uint8_t* src, size_t len, char* out)
+    {
+        size_t i = 0;
+        for (; i + 3 <= len; i += 3) {
+            uint32_t v = (static_cast<uint32_t>(src[i]) << 16) | (static_cast<uint32_t>(src[i + 1]) << 8) | src[i + 2];
+            *out++ = ALPHABET[v >> 18];
+            *out++ = ALPHABET[(v >> 12) & 63];
+            *out++ = ALPHABET[(v >> 6) & 63];
+            *out++ = ALPHABET[v & 63];
+        }
+        size_t rest = len - i;
+        if (rest == 0) {
+            return;
+        }
+        uint32_t v = static_cast<uint32_t>(src[i]) << 16;
+        if (rest == 2) {
+            v |= static_cast<uint32_t>(src[i + 1]) << 8;
+        }
+        *out++ = ALPHABET[v >> 18];
+        *out++ = ALPHABET[(v >> 12) & 63];
+        *out++ = rest == 2 ? ALPHABET[(v >> 6) & 63] : '=';
+        *out++ = '=';
+    }
+
+    bool decode_scalar(const char* src, size_t len, uint8_t* out, size_t& out_len)
+    {
+        out_len = 0;
+        if (len % 4 != 0) {
+            return false;
+        }
+        const uint8_t* in = reinterpret_cast<const uint8_t*>(src);
+        for (size_t i = 0; i < len; i += 4) {
+            uint8_t a = DECODE.v[in[i]];
+            uint8_t b = DECODE.v[in[i + 1]];
+            uint8_t c = DECODE.v[in[i + 2]];
+            uint8_t d = DECODE.v[in[i + 3]];
+            if ((a | b | c | d) != INVALID && ((a | b | c | d) & 0xC0) == 0) {
+                uint32_t v = (static_cast<uint32_t>(a) << 18) | (static_cast<uint32_t>(b) << 12) |
+                             (static_cast<uint32_t>(c) << 6) | d;
+                out[out_len++] = static_cast<uint8_t>(v >> 16);
+                out[out_len++] = static_cast<uint8_t>(v >> 8);
+                out[out_len++] = static_cast<uint8_t>(v);
+                continue;
+            }
+            // Padding: only in the last group, as "xx==" or "xxx=".
+            if (i + 4 != len || a == INVALID || b == INVALID || in[i + 3] != '=') {
+                return false;
+            }
+            uint32_t v = (static_cast<uint32_t>(a) << 18) | (static_cast<uint32_t>(b) << 12);
+            if (in[i + 2] == '=') {
+                out[out_len++] = static_cast<uint8_t>(v >> 16);
+                return true;
+            }
+            if (c == INVALID) {
+                return false;
+            }
+            v |= static_cast<uint32_t>(c) << 6;
+            out[out_len++] = static_cast<uint8_t>(v >> 16);
+            out[out_len++] = static_cast<uint8_t>(v >> 8);
+            return true;
+        }
+        return true;
+    }
+
+#if defined(__x86_64__)
+    // AVX2 block codecs after Muła and Lemire ("Faster Base64 Encoding and
+    // Decoding using AVX2 Instructions", 2018).
+
+    // 24 input bytes, loaded from src - 4 so that each 128-bit lane holds
+    // its 12 bytes at a fixed place, become 32 six-bit indices.
+    __attribute__((target("avx2"))) static size_t encode_avx2(const uint8_t* src, size_t len, char* out)
+    {
+        if (len < 32) {
+            return 0;
+        }
+        const __m256i shuffle = _mm256_set_epi8(10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1,
+                                                14, 15, 13, 14, 11, 12, 10, 11, 8, 9, 7, 8, 5, 6, 4, 5);
+        const __m256i lut = _mm256_setr_epi8(65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+                                             65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0);
+        // The first load would start 4 bytes before src; mask them out.
+        __m256i in = _mm256_maskload_epi32(reinterpret_cast<const int*>(src - 4),
+                                           _mm256_set_epi32(-1, -1, -1, -1, -1, -1, -1, 0));
+        size_t done = 0;
+        while (true) {
+            __m256i v = _mm256_shuffle_epi8(in, shuffle);
+            __m256i t0 = _mm256_and_si256(v, _mm256_set1_epi32(0x0fc0fc00));
+            __m256i t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+            __m256i t2 = _mm256_and_si256(v, _mm256_set1_epi32(0x003f03f0));
+            __m256i t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+            __m256i idx = _mm256_or_si256(t1, t3);
+
+            __m256i sel = _mm256_subs_epu8(idx, _mm256_set1_epi8(51));
+            sel = _mm256_sub_epi8(sel, _mm256_cmpgt_epi8(idx, _mm256_set1_epi8(25)));
+            __m256i chars = _mm256_add_epi8(idx, _mm256_shuffle_epi8(lut, sel));
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + done / 3 * 4), chars);
+
+            done += 24;
+            if (len - done < 28) {
+                return done;
+            }
+            in = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + done - 4));
+        }
+    }
+
+    // 32 characters become 24 bytes; stops at the first block holding a
+    // byte outside the alphabet (padding included) and leaves it to the
+    // scalar code. Returns the characters consumed.
+    __attribute__((target("avx2"))) static size_t decode_avx2(const char* src, size_t len, uint8_t* out)
+    {
+        const __m256i lut_lo = _mm256_setr_epi8(0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                                0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A,
+                                                0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+                                                0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A);
+        const __m256i lut_hi = _mm256_setr_epi8(0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                                0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10,
+                                                0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+                                                0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+        const __m256i lut_roll = _mm256_setr_epi8(0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0,
+                                                  0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+        const __m256i mask_2f = _mm256_set1_epi8(0x2f);
+        const __m256i pack = _mm256_setr_epi8(2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1,
+                                              2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1);
+        const __m256i lanes = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, -1, -1);
+
+        // 45 keeps the 32-byte store inside decoded_max(len) for valid
+        // input, whose length is a multiple of 4.
+        size_t done = 0;
+        while (len - done >= 45) {
+            __m256i str = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + done));
+            __m256i hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(str, 4), mask_2f);
+            __m256i lo = _mm256_shuffle_epi8(lut_lo, _mm256_and_si256(str, mask_2f));
+            __m256i hi = _mm256_shuffle_epi8(lut_hi, hi_nibbles);
+            if (!_mm256_testz_si256(lo, hi)) {
+                break;
+            }
+            __m256i eq_2f = _mm256_cmpeq_epi8(str, mask_2f);
+            __m256i roll = _mm256_shuffle_epi8(lut_roll, _mm256_add_epi8(eq_2f, hi_nibbles));
+            str = _mm256_add_epi8(str, roll);
+
+            __m256i ab_bc = _mm256_maddubs_epi16(str, _mm256_set1_epi32(0x01400140));
+            __m256i words = _mm256_madd_epi16(ab_bc, _mm256_set1_epi32(0x00011000));
+            words = _mm256_shuffle_epi8(words, pack);
+            words = _mm256_permutevar8x32_epi32(words, lanes);
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(out + done / 4 * 3), words);
+            done += 32;
+        }
+        return done;
+    }
+
+    static bool have_avx2()
+    {
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        return avx2;
+    }
+#endif
+
+    void encode(const uint8_t* src, size_t len, char* out)
+    {
+        size_t done = 0;
+#if defined(__x86_64__)
+        if (have_avx2()) {
+            done = encode_avx2(src, len, out);
+        }
+#endif
+        encode_scalar(src + done, len - done, out + done / 3 * 4);
+    }
+
+    bool decode(const char* src, size_t len, uint8_t* out, size_t& out_len)
+    {
+        if (len % 4 != 0) {
+            out_len = 0;
+            return false;
+        }
+        size_t done = 0;
+#if defined(__x86_64__)
+        if (have_avx2()) {
+            done = decode_avx2(src, len, out);
+        }
+#endif
+        size_t tail = 0;
+        bool ok = decode_scalar(src + done, len - done, out + done / 4 * 3, tail);
+        out_len = done / 4 * 3 + tail;
+        return ok;
+    }
+}
@@ -0,0 +1,237 @@
+#include "../../include/byte_map.hpp"
+
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace ofs::bytemap
+{
+    void prepare(const uint8_t* map, Table& out)
+    {
+        std::memcpy(out.map, map, TABLE_SIZE);
+        // rows[j] answers for high nibbles below 8 - j (see byte_map.hpp),
+        // so it holds map row 7 - j XOR map row 8 - j and rows[0] row 7;
+        // rows[8 + j] does the same for the upper half of the map.
+        for (size_t half = 0; half < 2; ++half) {
+            const uint8_t* src = map + half * 128;
+            uint8_t* dst = out.rows + half * 128;
+            for (size_t i = 0; i < 16; ++i) {
+                dst[i] = src[7 * 16 + i];
+            }
+            for (size_t j = 1; j < 8; ++j) {
+                for (size_t i = 0; i < 16; ++i) {
+                    dst[16 * j + i] = src[16 * (7 - j) + i] ^ src[16 * (8 - j) + i];
+                }
+            }
+        }
+    }
+
+    static void translate_scalar(const uint8_t* map, const uint8_t* src, uint8_t* dst, size_t len)
+    {
+        size_t i = 0;
+        for (; i + 4 <= len; i += 4) {
+            uint8_t a = map[src[i]];
+            uint8_t b = map[src[i + 1]];
+            uint8_t c = map[src[i + 2]];
+            uint8_t d = map[src[i + 3]];
+            dst[i] = a;
+            dst[i + 1] = b;
+            dst[i + 2] = c;
+            dst[i + 3] = d;
+        }
+        for (; i < len; ++i) {
+            dst[i] = map[src[i]];
+        }
+    }
+
+#if defined(__x86_64__)
+    // Each returns the bytes done, a multiple of its vector width.
+
+    __attribute__((target("ssse3"))) static size_t translate_ssse3(const Table& table, const uint8_t* src,
+                                                                   uint8_t* dst, size_t len)
+    {
+        __m128i rows[16];
+        for (int j = 0; j < 16; ++j) {
+            rows[j] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.rows + 16 * j));
+        }
+        const __m128i step = _mm_set1_epi8(0x10);
+        const __m128i high = _mm_set1_epi8(static_cast<char>(0x80));
+
+        size_t done = 0;
+        for (; done + 16 <= len; done += 16) {
+            __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + done));
+            __m128i hi = _mm_xor_si128(lo, high);
+            __m128i out = _mm_xor_si128(_mm_shuffle_epi8(rows[0], lo), _mm_shuffle_epi8(rows[8], hi));
+            for (int j = 1; j < 8; ++j) {
+                lo = _mm_adds_epu8(lo, step);
+                hi = _mm_adds_epu8(hi, step);
+                out = _mm_xor_si128(out, _mm_xor_si128(_mm_shuffle_epi8(rows[j], lo),
+                                                       _mm_shuffle_epi8(rows[8 + j], hi)));
+            }
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(dst + done), out);
+        }
+        return done;
+    }
+
+    __attribute__((target("avx2"))) static size_t translate_avx2(const Table& table, const uint8_t* src,
+                                                                 uint8_t* dst, size_t len)
+    {
+        // vpshufb looks up within each 128-bit lane: both lanes hold the row.
+        __m256i rows[16];
+        for (int j = 0; j < 16; ++j) {
+            rows[j] = _mm256_broadcastsi128_si256(
+                _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.rows + 16 * j)));
+        }
+        const __m256i step = _mm256_set1_epi8(0x10);
+        const __m256i high = _mm256_set1_epi8(static_cast<char>(0x80));
+
+        size_t done = 0;
+        for (; done + 32 <= len; done += 32) {
+            __m256i lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + done));
+            __m256i hi = _mm256_xor_si256(lo, high);
+            __m256i out = _mm256_xor_si256(_mm256_shuffle_epi8(rows[0], lo), _mm256_shuffle_epi8(rows[8], hi));
+            for (int j = 1; j < 8; ++j) {
+                lo = _mm256_adds_epu8(lo, step);
+                hi = _mm256_adds_epu8(hi, step);
+                out = _mm256_xor_si256(out, _mm256_xor_si256(_mm256_shuffle_epi8(rows[j], lo),
+                                                             _mm256_shuffle_epi8(rows[8 + j], hi)));
+            }
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + done), out);
+        }
+        return done;
+    }
+
+    // Finishes the tail with a masked load and store, so it does all of len.
+    __attribute__((target("avx512f,avx512bw,avx512vbmi"))) static size_t translate_avx512vbmi(
+        const Table& table, const uint8_t* src, uint8_t* dst, size_t len)
+    {
+        const __m512i t0 = _mm512_loadu_si512(table.map);
+        const __m512i t1 = _mm512_loadu_si512(table.map + 64);
+        const __m512i t2 = _mm512_loadu_si512(table.map + 128);
+        const __m512i t3 = _mm512_loadu_si512(table.map + 192);
+
+        size_t done = 0;
+        for (; done + 64 <= len; done += 64) {
+            __m512i x = _mm512_loadu_si512(src + done);
+            __m512i lo = _mm512_permutex2var_epi8(t0, x, t1);
+            __m512i hi = _mm512_permutex2var_epi8(t2, x, t3);
+            _mm512_storeu_si512(dst + done, _mm512_mask_blend_epi8(_mm512_movepi8_mask(x), lo, hi));
+        }
+        if (done < len) {
+            __mmask64 live = (1ULL << (len - done)) - 1;
+            __m512i x = _mm512_maskz_loadu_epi8(live, src + done);
+            __m512i lo = _mm512_permutex2var_epi8(t0, x, t1);
+            __m512i hi = _mm512_permutex2var_epi8(t2, x, t3);
+            _mm512_mask_storeu_epi8(dst + done, live, _mm512_mask_blend_epi8(_mm512_movepi8_mask(x), lo, hi));
+        }
+        return len;
+    }
+#endif
+
+    bool supported(Path path)
+    {
+#if defined(__x86_64__)
+        static const bool ssse3 = __builtin_cpu_supports("ssse3");
+        static const bool avx2 = __builtin_cpu_supports("avx2");
+        static const bool avx512vbmi = __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vbmi");
+        switch (path) {
+        case Path::avx512vbmi:
+            return avx512vbmi;
+        case Path::avx2:
+            return avx2;
+        case Path::ssse3:
+            return ssse3;
+        default:
+            return true;
+        }
+#else
+        return path == Path::scalar;
+#endif
+    }
+
+    Path best_path()
+    {
+        static const Path best = supported(Path::avx512vbmi) ? Path::avx512vbmi
+                                 : supported(Path::avx2)     ? Path::avx2
+                                 : supported(Path::ssse3)    ? Path::ssse3
+                                                             : Path::scalar;
+        return best;
+    }
+
+    const char* path_name(Path path)
+    {
+        switch (path) {
+        case Path::avx512vbmi:
+            return "avx512vbmi";
+        case Path::avx2:
+            return "avx2";
+        case Path::ssse3:
+            return "ssse3";
+        default:
+            return "scalar";
+        }
+    }
+
+    void translate(Path path, const Table& table, const uint8_t* src, uint8_t* dst, size_t len)
+    {
+        size_t done = 0;
+#if defined(__x86_64__)
+        if (path == Path::avx512vbmi) {
+            done = translate_avx512vbmi(table, src, dst, len);
+        } else if (path == Path::avx2) {
+            done = translate_avx2(table, src, dst, len);
+        } else if (path == Path::ssse3) {
+            done = translate_ssse3(table, src, dst, len);
+        }
+#else
+        (void)path;
+#endif
+        translate_scalar(table.map, src + done, dst + done, len - done);
+    }
+
+    void translate(const Table& table, const uint8_t* src, uint8_t* dst, size_t len)
+    {
+        translate(best_path(), table, src, dst, len);
+    }
+
+    void make_permutation(uint64_t seed, uint8_t* map)
+    {
+        for (size_t i = 0; i < TABLE_SIZE; ++i) {
+            map[i] = static_cast<uint8_t>(i);
+        }
+        // Fisher-Yates driven by splitmix64.
+        uint64_t x = seed;
+        for (size_t i = TABLE_SIZE - 1; i > 0; --i) {
+            x += 0x9E3779B97F4A7C15ULL;
+            uint64_t z = x;
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            z ^= z >> 31;
+            size_t j = static_cast<size_t>(z % (i + 1));
+            uint8_t t = map[i];
+            map[i] = map[j];
+            map[j] = t;
+        }
+    }
+
+    bool is_permutation(const uint8_t* map)
+    {
+        bool seen[TABLE_SIZE] = {};
+        for (size_t i = 0; i < TABLE_SIZE; ++i) {
+            if (seen[map[i]]) {
+                return false;
+            }
+            seen[map[i]] = true;
+        }
+        return true;
+    }
+
+    void invert(const uint8_t* map, uint8_t* inverse)
+    {
+        for (size_t i = 0; i < TABLE_SIZE; ++i) {
+            inverse[map[i]] = static_cast<uint8_t>(i);
+        }
+    }
+}
@@ -0,0 +1,111 @@
+#include "../../include/coarse_clock.hpp"
+
+#include <chrono>
+#include <cstring>
+#include <ctime>
+
+namespace ofs::clock
+{
+    namespace
+    {
+        // Rendered "YYYY-MM-DDTHH:MM:SS" for the last second seen by this thread.
+        struct SecondCache
+        {
+            int64_t second = INT64_MIN;
+            char prefix[20];
+        };
+
+        thread_local SecondCache tls_cache;
+
+        void put2(char* p, int v)
+        {
+            p[0] = static_cast<char>('0' + v / 10);
+            p[1] = static_cast<char>('0' + v % 10);
+        }
+
+        void render_prefix(SecondCache& cache, int64_t second)
+        {
+            std::time_t t = static_cast<std::time_t>(second);
+            std::tm utc {};
+#if defined(_WIN32)
+            gmtime_s(&utc, &t);
+#else
+            gmtime_r(&t, &utc);
+#endif
+            char* p = cache.prefix;
+            int year = utc.tm_year + 1900;
+            put2(p, year / 100);
+            put2(p + 2, year % 100);
+            p[4] = '-';
+            put2(p + 5, utc.tm_mon + 1);
+            p[7] = '-';
+            put2(p + 8, utc.tm_mday);
+            p[10] = 'T';
+            put2(p + 11, utc.tm_hour);
+            p[13] = ':';
+            put2(p + 14, utc.tm_min);
+            p[16] = ':';
+            put2(p + 17, utc.tm_sec);
+            cache.second = second;
+        }
+    }
+
+    uint64_t unix_seconds()
+    {
+#if defined(CLOCK_REALTIME_COARSE)
+        struct timespec ts;
+        if (clock_gettime(CLOCK_REALTIME_COARSE, &ts) == 0) {
+            return static_cast<uint64_t>(ts.tv_sec);
+        }
+#endif
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::seconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+    }
+
+    int64_t unix_nanos()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    void append_utc_timestamp(std::string& out, int64_t wall_ns, int subsecond_digits)
+    {
+        int64_t second = wall_ns / 1000000000LL;
+        int64_t frac = wall_ns % 1000000000LL;
+        if (frac < 0) {
+            frac += 1000000000LL;
+            --second;
+        }
+
+        SecondCache& cache = tls_cache;
+        if (cache.second != second) {
+            render_prefix(cache, second);
+        }
+        out.append(cache.prefix, sizeof(cache.prefix) - 1);
+
+        if (subsecond_digits > 0) {
+            if (subsecond_digits > 9) {
+                subsecond_digits = 9;
+            }
+            char digits[10];
+            digits[0] = '.';
+            int64_t v = frac;
+            for (int i = 9; i >= 1; --i) {
+                if (i <= subsecond_digits) {
+                    digits[i] = static_cast<char>('0' + v % 10);
+                }
+                v /= 10;
+            }
+            out.append(digits, static_cast<size_t>(subsecond_digits) + 1);
+        }
+        out += 'Z';
+    }
+
+    std::string utc_timestamp(int64_t wall_ns, int subsecond_digits)
+    {
+        std::string out;
+        out.reserve(32);
+        append_utc_timestamp(out, wall_ns, subsecond_digits);
+        return out;
+    }
+}
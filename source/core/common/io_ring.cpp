@@ -0,0 +1,277 @@
+#include "../../include/io_ring.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define MODULE_NAME "IO_RING"
+
+namespace ofs
+{
+    static int sys_setup(uint32_t entries, io_uring_params* p)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_setup, entries, p));
+    }
+
+    static int sys_enter(int fd, uint32_t to_submit, uint32_t min_complete, uint32_t flags)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, nullptr, 0));
+    }
+
+    static int sys_register(int fd, uint32_t opcode, const void* arg, uint32_t nr_args)
+    {
+        return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+    }
+
+    IoRing::IoRing()
+        : ring_fd_(-1),
+          sq_map_(nullptr),
+          sq_map_len_(0),
+          cq_map_(nullptr),
+          cq_map_len_(0),
+          sqes_(nullptr),
+          sqes_len_(0),
+          sq_head_(nullptr),
+          sq_tail_(nullptr),
+          sq_array_(nullptr),
+          sq_mask_(0),
+          sq_entries_(0),
+          cq_head_(nullptr),
+          cq_tail_(nullptr),
+          cq_mask_(0),
+          cqes_(nullptr),
+          local_tail_(0),
+          pending_(0),
+          timeout_{0, 0}
+    {
+    }
+
+    IoRing::~IoRing()
+    {
+        close();
+    }
+
+    bool IoRing::init(uint32_t entries)
+    {
+        close();
+
+        io_uring_params p;
+        std::memset(&p, 0, sizeof(p));
+        int fd = sys_setup(entries, &p);
+        if (fd < 0) {
+            LOG_WARN(MODULE_NAME, 101, "io_uring_setup failed: {}", std::strerror(errno));
+            return false;
+        }
+        ring_fd_ = fd;
+
+        sq_map_len_ = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+        cq_map_len_ = p.cq_off.cqes + p.cq_entries * sizeof(io_uring_cqe);
+        bool single = (p.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (single && cq_map_len_ > sq_map_len_) {
+            sq_map_len_ = cq_map_len_;
+        }
+        sq_map_ = ::mmap(nullptr, sq_map_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                         IORING_OFF_SQ_RING);
+        if (sq_map_ == MAP_FAILED) {
+            sq_map_ = nullptr;
+            LOG_WARN(MODULE_NAME, 102, "cannot map the submission ring: {}", std::strerror(errno));
+            close();
+            return false;
+        }
+        if (single) {
+            cq_map_ = sq_map_;
+        } else {
+            cq_map_ = ::mmap(nullptr, cq_map_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                             IORING_OFF_CQ_RING);
+            if (cq_map_ == MAP_FAILED) {
+                cq_map_ = nullptr;
+                LOG_WARN(MODULE_NAME, 102, "cannot map the completion ring: {}", std::strerror(errno));
+                close();
+                return false;
+            }
+        }
+        sqes_len_ = p.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = ::mmap(nullptr, sqes_len_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                            IORING_OFF_SQES);
+        if (sqes == MAP_FAILED) {
+            LOG_WARN(MODULE_NAME, 102, "cannot map the submission entries: {}", std::strerror(errno));
+            close();
+            return false;
+        }
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+        uint8_t* sq = static_cast<uint8_t*>(sq_map_);
+        sq_head_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.head);
+        sq_tail_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.tail);
+        sq_array_ = reinterpret_cast<uint32_t*>(sq + p.sq_off.array);
+        sq_mask_ = *reinterpret_cast<uint32_t*>(sq + p.sq_off.ring_mask);
+        sq_entries_ = p.sq_entries;
+        uint8_t* cq = static_cast<uint8_t*>(cq_map_);
+        cq_head_ = reinterpret_cast<uint32_t*>(cq + p.cq_off.head);
+        cq_tail_ = reinterpret_cast<uint32_t*>(cq + p.cq_off.tail);
+        cq_mask_ = *reinterpret_cast<uint32_t*>(cq + p.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + p.cq_off.cqes);
+
+        local_tail_ = *sq_tail_;
+        pending_ = 0;
+        return true;
+    }
+
+    void IoRing::close()
+    {
+        if (sqes_ != nullptr) {
+            ::munmap(sqes_, sqes_len_);
+        }
+        if (cq_map_ != nullptr && cq_map_ != sq_map_) {
+            ::munmap(cq_map_, cq_map_len_);
+        }
+        if (sq_map_ != nullptr) {
+            ::munmap(sq_map_, sq_map_len_);
+        }
+        if (ring_fd_ >= 0) {
+            ::close(ring_fd_);
+        }
+        ring_fd_ = -1;
+        sq_map_ = nullptr;
+        cq_map_ = nullptr;
+        sqes_ = nullptr;
+        pending_ = 0;
+    }
+
+    bool IoRing::register_files(const int* fds, uint32_t count)
+    {
+        if (sys_register(ring_fd_, IORING_REGISTER_FILES, fds, count) != 0) {
+            LOG_WARN(MODULE_NAME, 103, "cannot register {} files: {}", count, std::strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    bool IoRing::update_file(uint32_t index, int fd)
+    {
+        io_uring_files_update up;
+        std::memset(&up, 0, sizeof(up));
+        up.offset = index;
+        up.fds = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(&fd));
+        return sys_register(ring_fd_, IORING_REGISTER_FILES_UPDATE, &up, 1) == 1;
+    }
+
+    bool IoRing::register_buffers(const iovec* iov, uint32_t count)
+    {
+        if (sys_register(ring_fd_, IORING_REGISTER_BUFFERS, iov, count) != 0) {
+            LOG_WARN(MODULE_NAME, 104, "cannot register {} buffers: {}", count, std::strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    io_uring_sqe* IoRing::next_sqe()
+    {
+        uint32_t head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (local_tail_ - head >= sq_entries_) {
+            submit(0);
+        }
+        uint32_t idx = local_tail_ & sq_mask_;
+        io_uring_sqe* sqe = &sqes_[idx];
+        std::memset(sqe, 0, sizeof(*sqe));
+        sq_array_[idx] = idx;
+        ++local_tail_;
+        ++pending_;
+        return sqe;
+    }
+
+    void IoRing::prep_rw(uint8_t opcode, int fd, bool fixed, const void* buf, uint32_t len, uint64_t offset,
+                         uint64_t user_data)
+    {
+        io_uring_sqe* sqe = next_sqe();
+        sqe->opcode = opcode;
+        sqe->fd = fd;
+        sqe->flags = fixed ? IOSQE_FIXED_FILE : 0;
+        sqe->addr = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(buf));
+        sqe->len = len;
+        sqe->off = offset;
+        sqe->user_data = user_data;
+    }
+
+    void IoRing::prep_read(int fd, bool fixed, void* buf, uint32_t len, uint64_t offset, uint64_t user_data)
+    {
+        prep_rw(IORING_OP_READ, fd, fixed, buf, len, offset, user_data);
+    }
+
+    void IoRing::prep_write(int fd, bool fixed, const void* buf, uint32_t len, uint64_t offset, uint64_t user_data)
+    {
+        prep_rw(IORING_OP_WRITE, fd, fixed, buf, len, offset, user_data);
+    }
+
+    void IoRing::prep_read_fixed(int fd, bool fixed, void* buf, uint32_t len, uint16_t buf_index,
+                                 uint64_t offset, uint64_t user_data)
+    {
+        prep_rw(IORING_OP_READ_FIXED, fd, fixed, buf, len, offset, user_data);
+        sqes_[(local_tail_ - 1) & sq_mask_].buf_index = buf_index;
+    }
+
+    void IoRing::prep_send(int fd, bool fixed, const void* buf, uint32_t len, int flags, uint64_t user_data)
+    {
+        prep_rw(IORING_OP_SEND, fd, fixed, buf, len, 0, user_data);
+        sqes_[(local_tail_ - 1) & sq_mask_].msg_flags = static_cast<uint32_t>(flags);
+    }
+
+    void IoRing::prep_accept(int fd, int flags, uint64_t user_data)
+    {
+        prep_rw(IORING_OP_ACCEPT, fd, false, nullptr, 0, 0, user_data);
+        sqes_[(local_tail_ - 1) & sq_mask_].accept_flags = static_cast<uint32_t>(flags);
+    }
+
+    void IoRing::prep_timeout(uint32_t ms, uint64_t user_data)
+    {
+        timeout_[0] = ms / 1000;
+        timeout_[1] = static_cast<int64_t>(ms % 1000) * 1000000;
+        prep_rw(IORING_OP_TIMEOUT, -1, false, timeout_, 1, 0, user_data);
+    }
+
+    int IoRing::submit(uint32_t wait_nr)
+    {
+        __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+        uint32_t flags = wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0;
+        while (true) {
+            int n = sys_enter(ring_fd_, pending_, wait_nr, flags);
+            if (n >= 0) {
+                pending_ -= static_cast<uint32_t>(n);
+                return n;
+            }
+            if (errno != EINTR) {
+                return -errno;
+            }
+        }
+    }
+
+    // Without SQPOLL the kernel only reads the SQ ring inside
+    // io_uring_enter, so the tail can be wound back over what it left.
+    uint32_t IoRing::withdraw()
+    {
+        uint32_t left = local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        local_tail_ -= left;
+        __atomic_store_n(sq_tail_, local_tail_, __ATOMIC_RELEASE);
+        pending_ = 0;
+        return left;
+    }
+
+    bool IoRing::pop(Completion& out)
+    {
+        uint32_t head = *cq_head_;
+        if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+            return false;
+        }
+        const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+        out.user_data = cqe.user_data;
+        out.res = cqe.res;
+        __atomic_store_n(cq_head_, head + 1, __ATOMIC_RELEASE);
+        return true;
+    }
+}
@@ -0,0 +1,218 @@
+#include "../../include/lz_codec.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+namespace ofs::lz
+{
+    namespace
+    {
+        constexpr char FRAME_MAGIC[8] = {'O', 'F', 'S', 'L', 'Z', '0', '1', '\n'};
+        constexpr size_t MIN_MATCH = 4;
+        constexpr size_t MAX_OFFSET = 0xFFFF;
+        constexpr int HASH_BITS = 14;
+
+        uint32_t read32(const uint8_t* p)
+        {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
+
+        uint32_t hash32(uint32_t v)
+        {
+            return (v * 2654435761u) >> (32 - HASH_BITS);
+        }
+
+        void put_u32(std::string& out, uint32_t v)
+        {
+            char b[4] = {static_cast<char>(v), static_cast<char>(v >> 8),
+                         static_cast<char>(v >> 16), static_cast<char>(v >> 24)};
+            out.append(b, 4);
+        }
+
+        uint32_t get_u32(const uint8_t* p)
+        {
+            return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8) |
+                   (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+        }
+
+        void put_length(std::string& out, size_t len)
+        {
+            while (len >= 255) {
+                out += static_cast<char>(255);
+                len -= 255;
+            }
+            out += static_cast<char>(len);
+        }
+
+        void emit_sequence(std::string& out, const uint8_t* lit, size_t lit_len,
+                           size_t offset, size_t match_len)
+        {
+            size_t ml = match_len ? match_len - MIN_MATCH : 0;
+            uint8_t token = static_cast<uint8_t>((lit_len < 15 ? lit_len : 15) << 4);
+            token |= static_cast<uint8_t>(ml < 15 ? ml : 15);
+            out += static_cast<char>(token);
+            if (lit_len >= 15) {
+                put_length(out, lit_len - 15);
+            }
+            out.append(reinterpret_cast<const char*>(lit), lit_len);
+            if (match_len == 0) {
+                return;
+            }
+            out += static_cast<char>(offset & 0xFF);
+            out += static_cast<char>(offset >> 8);
+            if (ml >= 15) {
+                put_length(out, ml - 15);
+            }
+        }
+
+        void compress_chunk(const uint8_t* src, size_t n, std::string& out, std::vector<uint32_t>& table)
+        {
+            std::fill(table.begin(), table.end(), UINT32_MAX);
+            size_t anchor = 0;
+            size_t i = 0;
+
+            while (n >= MIN_MATCH && i + MIN_MATCH <= n) {
+                uint32_t seq = read32(src + i);
+                uint32_t h = hash32(seq);
+                uint32_t cand = table[h];
+                table[h] = static_cast<uint32_t>(i);
+
+                if (cand == UINT32_MAX || i - cand > MAX_OFFSET || read32(src + cand) != seq) {
+                    ++i;
+                    continue;
+                }
+
+                size_t len = MIN_MATCH;
+                while (i + len < n && src[cand + len] == src[i + len]) {
+                    ++len;
+                }
+
+                emit_sequence(out, src + anchor, i - anchor, i - cand, len);
+                i += len;
+                anchor = i;
+            }
+
+            emit_sequence(out, src + anchor, n - anchor, 0, 0);
+        }
+
+        bool read_length(const uint8_t*& p, const uint8_t* end, size_t& len)
+        {
+            for (;;) {
+                if (p >= end) {
+                    return false;
+                }
+                uint8_t b = *p++;
+                len += b;
+                if (b != 255) {
+                    return true;
+                }
+            }
+        }
+
+        bool decompress_chunk(const uint8_t* p, const uint8_t* end, std::string& out, size_t raw_len)
+        {
+            size_t start = out.size();
+            while (p < end) {
+                uint8_t token = *p++;
+                size_t lit_len = token >> 4;
+                if (lit_len == 15 && !read_length(p, end, lit_len)) {
+                    return false;
+                }
+                if (lit_len > static_cast<size_t>(end - p)) {
+                    return false;
+                }
+                out.append(reinterpret_cast<const char*>(p), lit_len);
+                p += lit_len;
+                if (p == end) {
+                    break;
+                }
+
+                if (end - p < 2) {
+                    return false;
+                }
+                size_t offset = static_cast<size_t>(p[0]) | (static_cast<size_t>(p[1]) << 8);
+                p += 2;
+                size_t match_len = token & 0x0F;
+                if (match_len == 15 && !read_length(p, end, match_len)) {
+                    return false;
+                }
+                match_len += MIN_MATCH;
+
+                size_t produced = out.size() - start;
+                if (offset == 0 || offset > produced || produced + match_len > raw_len) {
+                    return false;
+                }
+                size_t from = out.size() - offset;
+                for (size_t k = 0; k < match_len; ++k) {
+                    out += out[from + k];
+                }
+            }
+            return out.size() - start == raw_len;
+        }
+    }
+
+    bool is_frame(std::string_view data)
+    {
+        return data.size() >= sizeof(FRAME_MAGIC) &&
+               std::memcmp(data.data(), FRAME_MAGIC, sizeof(FRAME_MAGIC)) == 0;
+    }
+
+    void compress(std::string_view src, std::string& out)
+    {
+        std::vector<uint32_t> table(size_t(1) << HASH_BITS);
+        const uint8_t* data = reinterpret_cast<const uint8_t*>(src.data());
+        std::string packed;
+
+        out.append(FRAME_MAGIC, sizeof(FRAME_MAGIC));
+        for (size_t pos = 0; pos < src.size(); pos += CHUNK_SIZE) {
+            size_t n = src.size() - pos < CHUNK_SIZE ? src.size() - pos : CHUNK_SIZE;
+            packed.clear();
+            compress_chunk(data + pos, n, packed, table);
+            put_u32(out, static_cast<uint32_t>(n));
+            put_u32(out, static_cast<uint32_t>(packed.size()));
+            out += packed;
+        }
+        put_u32(out, 0);
+    }
+
+    bool decompress(std::string_view frame, std::string& out, std::string& err)
+    {
+        if (!is_frame(frame)) {
+            err = "not an OFSLZ frame";
+            return false;
+        }
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(frame.data()) + sizeof(FRAME_MAGIC);
+        const uint8_t* end = reinterpret_cast<const uint8_t*>(frame.data()) + frame.size();
+
+        for (;;) {
+            if (end - p < 4) {
+                err = "truncated frame";
+                return false;
+            }
+            uint32_t raw_len = get_u32(p);
+            p += 4;
+            if (raw_len == 0) {
+                return true;
+            }
+            if (end - p < 4) {
+                err = "truncated frame";
+                return false;
+            }
+            uint32_t packed_len = get_u32(p);
+            p += 4;
+            if (raw_len > CHUNK_SIZE || packed_len > static_cast<size_t>(end - p)) {
+                err = "corrupt chunk header";
+                return false;
+            }
+            if (!decompress_chunk(p, p + packed_len, out, raw_len)) {
+                err = "corrupt chunk data";
+                return false;
+            }
+            p += packed_len;
+        }
+    }
+}
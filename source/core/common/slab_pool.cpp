@@ -0,0 +1,89 @@
+#include "../../include/slab_pool.hpp"
+
+#include <algorithm>
+
+namespace ofs
+{
+    // A string of capacity c owns c + 1 bytes with the terminator; class k
+    // holds strings that own at least 2^k.
+
+    SlabPool::SlabPool() : hits_(0), misses_(0), idle_bytes_(0)
+    {
+        for (unsigned i = 0; i < CLASSES; ++i) {
+            classes_[i].keep = std::max(MIN_KEEP, KEEP_BYTES >> (MIN_SHIFT + i));
+            classes_[i].free.reserve(classes_[i].keep);
+        }
+    }
+
+    SlabPool& SlabPool::get_instance()
+    {
+        static SlabPool pool;
+        return pool;
+    }
+
+    std::string SlabPool::acquire(size_t size)
+    {
+        unsigned shift = size == 0 ? MIN_SHIFT : std::max<unsigned>(MIN_SHIFT, 64 - __builtin_clzll(size));
+        std::string s;
+        if (shift > MAX_SHIFT) {
+            misses_.fetch_add(1, std::memory_order_relaxed);
+            s.reserve(size);
+            return s;
+        }
+        Class& c = classes_[shift - MIN_SHIFT];
+        bool found = false;
+        {
+            std::lock_guard<std::mutex> lock(c.mtx);
+            if (!c.free.empty()) {
+                s = std::move(c.free.back());
+                c.free.pop_back();
+                found = true;
+            }
+        }
+        if (found) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            idle_bytes_.fetch_sub(s.capacity() + 1, std::memory_order_relaxed);
+            return s;
+        }
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        s.reserve((static_cast<size_t>(1) << shift) - 1);
+        return s;
+    }
+
+    void SlabPool::reserve(std::string& s, size_t size)
+    {
+        if (s.capacity() >= size) {
+            return;
+        }
+        std::string bigger = acquire(size);
+        bigger.append(s);
+        release(std::move(s));
+        s = std::move(bigger);
+    }
+
+    void SlabPool::release(std::string&& s)
+    {
+        size_t bytes = s.capacity() + 1;
+        unsigned shift = 63 - __builtin_clzll(bytes);
+        if (shift < MIN_SHIFT || shift > MAX_SHIFT) {
+            std::string().swap(s);
+            return;
+        }
+        s.clear();
+        Class& c = classes_[shift - MIN_SHIFT];
+        {
+            std::lock_guard<std::mutex> lock(c.mtx);
+            if (c.free.size() < c.keep) {
+                c.free.push_back(std::move(s));
+                idle_bytes_.fetch_add(bytes, std::memory_order_relaxed);
+                return;
+            }
+        }
+        std::string().swap(s);
+    }
+
+    SlabPool::Stats SlabPool::stats() const
+    {
+        return Stats{hits_.load(), misses_.load(), idle_bytes_.load()};
+    }
+}
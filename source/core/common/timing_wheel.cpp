@@ -0,0 +1,154 @@
+#include "../../include/timing_wheel.hpp"
+
+namespace ofs
+{
+    TimingWheel::TimingWheel() : current_(0), pending_(0)
+    {
+    }
+
+    void TimingWheel::reset(uint32_t capacity, uint64_t now)
+    {
+        current_ = now;
+        pending_ = 0;
+        heads_.assign(static_cast<size_t>(LEVELS) * BUCKETS, NONE);
+        next_.assign(capacity, NONE);
+        prev_.assign(capacity, NONE);
+        bucket_.assign(capacity, NONE);
+        deadline_.assign(capacity, 0);
+    }
+
+    // Puts id in the bucket for deadline_[id], which is at or after current_.
+    void TimingWheel::link(uint32_t id)
+    {
+        uint64_t due = deadline_[id] < current_ ? current_ : deadline_[id];
+        uint64_t delta = due - current_;
+        if (delta >= SPAN) {
+            due = current_ + SPAN - 1;
+            delta = SPAN - 1;
+        }
+
+        uint32_t level = 0;
+        while (level + 1 < LEVELS && delta >= (1ULL << (BUCKET_BITS * (level + 1)))) {
+            ++level;
+        }
+        uint32_t b = level * BUCKETS + static_cast<uint32_t>((due >> (BUCKET_BITS * level)) & (BUCKETS - 1));
+
+        next_[id] = heads_[b];
+        prev_[id] = NONE;
+        if (heads_[b] != NONE) {
+            prev_[heads_[b]] = id;
+        }
+        heads_[b] = id;
+        bucket_[id] = b;
+    }
+
+    void TimingWheel::unlink(uint32_t id)
+    {
+        uint32_t b = bucket_[id];
+        if (prev_[id] != NONE) {
+            next_[prev_[id]] = next_[id];
+        } else {
+            heads_[b] = next_[id];
+        }
+        if (next_[id] != NONE) {
+            prev_[next_[id]] = prev_[id];
+        }
+        bucket_[id] = NONE;
+    }
+
+    // Detaches a whole bucket; returns its first id (chained through next_).
+    uint32_t TimingWheel::take(uint32_t b)
+    {
+        uint32_t head = heads_[b];
+        heads_[b] = NONE;
+        return head;
+    }
+
+    void TimingWheel::schedule(uint32_t id, uint64_t deadline)
+    {
+        if (bucket_[id] != NONE) {
+            unlink(id);
+        } else {
+            ++pending_;
+        }
+        // The current tick has already been processed.
+        deadline_[id] = deadline > current_ ? deadline : current_ + 1;
+        link(id);
+    }
+
+    void TimingWheel::cancel(uint32_t id)
+    {
+        if (bucket_[id] != NONE) {
+            unlink(id);
+            --pending_;
+        }
+    }
+
+    bool TimingWheel::armed(uint32_t id) const
+    {
+        return bucket_[id] != NONE;
+    }
+
+    size_t TimingWheel::advance(uint64_t now, std::vector<uint32_t>& expired)
+    {
+        size_t before = expired.size();
+        if (now <= current_) {
+            return 0;
+        }
+
+        // After a long gap (suspend, clock step) re-place everything at once
+        // instead of walking every missed tick.
+        if (now - current_ > SPAN) {
+            std::vector<uint32_t> armed_ids;
+            for (uint32_t id = 0; id < bucket_.size(); ++id) {
+                if (bucket_[id] != NONE) {
+                    unlink(id);
+                    armed_ids.push_back(id);
+                }
+            }
+            current_ = now;
+            for (uint32_t id : armed_ids) {
+                if (deadline_[id] <= now) {
+                    expired.push_back(id);
+                    --pending_;
+                } else {
+                    link(id);
+                }
+            }
+            return expired.size() - before;
+        }
+
+        while (current_ < now) {
+            ++current_;
+
+            // Cascade from the top: a bucket of level l comes due when the
+            // lower bits of the tick wrap to zero.
+            for (uint32_t level = LEVELS - 1; level > 0; --level) {
+                uint64_t low_mask = (1ULL << (BUCKET_BITS * level)) - 1;
+                if ((current_ & low_mask) != 0) {
+                    continue;
+                }
+                uint32_t b = level * BUCKETS + static_cast<uint32_t>((current_ >> (BUCKET_BITS * level)) & (BUCKETS - 1));
+                for (uint32_t id = take(b); id != NONE;) {
+                    uint32_t next = next_[id];
+                    link(id);
+                    id = next;
+                }
+            }
+
+            uint32_t b = static_cast<uint32_t>(current_ & (BUCKETS - 1));
+            for (uint32_t id = take(b); id != NONE;) {
+                uint32_t next = next_[id];
+                if (deadline_[id] <= current_) {
+                    bucket_[id] = NONE;
+                    --pending_;
+                    expired.push_back(id);
+                } else {
+                    link(id);
+                }
+                id = next;
+            }
+        }
+        return expired.size() - before;
+    }
+}
@@ -1,5 +1,6 @@
 #include "../../include/uconf_parser.hpp"
 #include "../../include/logger.hpp" // Include logger for function implementations
+#include "../../include/log_macros.hpp"
 #include <fstream>
 #include <sstream>
 #include <algorithm>
@@ -135,21 +136,55 @@ namespace ofs::config
             os << "header_size = " << cfg.header_size << "             # Header size\n";
             os << "block_size = " << cfg.block_size << "             # Block size\n";
             os << "max_files = " << cfg.max_files << "              # Maximum number of files\n";
-            os << "max_filename_length = " << cfg.max_filename_length << "     # Maximum filename length\n\n";
+            os << "max_filename_length = " << cfg.max_filename_length << "     # Maximum filename length\n";
+            os << "block_mapping = " << cfg.block_mapping << "        # File block mapping (chain, extent)\n";
+            os << "journal_size = " << cfg.journal_size << "        # Metadata journal in bytes (0 = no journal)\n";
+            os << "history_size = " << cfg.history_size << "        # File history change log in bytes (0 = no history)\n";
+            os << "history_chunks = " << cfg.history_chunks << "        # File history chunk table slots\n";
+            os << "history_full_every = " << cfg.history_full_every << "        # Versions per full snapshot, the rest are deltas\n\n";
 
             os << "[security]\n";
             os << "max_users = " << cfg.max_users << "                # Maximum number of users\n";
             os << "admin_username = \"" << cfg.admin_username << "\"      # Default admin username\n";
             os << "admin_password = \"" << cfg.admin_password << "\"      # Default admin password\n";
-            os << "require_auth = " << (cfg.require_auth ? "true" : "false") << "           # Require authentication\n\n";
+            os << "require_auth = " << (cfg.require_auth ? "true" : "false") << "           # Require authentication\n";
+            os << "hash_iterations = " << cfg.hash_iterations << "       # PBKDF2 iterations for new password records\n";
+            os << "hash_threads = " << cfg.hash_threads << "              # Password hashing threads (0 = one per core)\n";
+            os << "verify_cache_ttl = " << cfg.verify_cache_ttl << "        # Remember verified logins (seconds, 0 = off)\n";
+            os << "max_sessions = " << cfg.max_sessions << "           # Maximum simultaneous sessions\n";
+            os << "session_timeout = " << cfg.session_timeout << "        # End idle sessions (seconds, 0 = never)\n";
+            os << "encode_content = " << (cfg.encode_content ? "true" : "false") << "         # Store file content through a byte substitution map\n\n";
 
             os << "[server]\n";
             os << "port = " << cfg.port << "                   # Server port\n";
             os << "max_connections = " << cfg.max_connections << "          # Maximum simultaneous connections\n";
             os << "queue_timeout = " << cfg.queue_timeout << "            # Maximum queue wait time (seconds)\n";
+            os << "execution = " << cfg.execution << "              # Request execution (fifo, concurrent)\n";
+            os << "workers = " << cfg.workers << "                   # Concurrent executor threads (0 = one per core)\n";
+            os << "stream_window = " << cfg.stream_window << "       # File bytes per chunk of a streamed read\n\n";
+
+            os << "[io]\n";
+            os << "sync_policy = " << cfg.io_sync_policy << "        # When mapped container pages are msync'ed (immediate, periodic, on_shutdown)\n";
+            os << "sync_interval_ms = " << cfg.io_sync_interval_ms << "       # Flush interval for the periodic policy\n";
+            os << "backend = " << cfg.io_backend << "               # File content and socket I/O (mmap, pread, io_uring)\n";
+            os << "queue_depth = " << cfg.io_queue_depth << "             # io_uring submission queue entries\n";
+            os << "durability = " << cfg.io_durability << "            # When journaled changes are on disk (fsync, group, async)\n";
+            os << "group_commit_ms = " << cfg.io_group_commit_ms << "           # Journal flush interval for group and async\n";
+            os << "cache_size = " << cfg.io_cache_size << "         # Block cache for file content (bytes, 0 = none)\n";
+            os << "read_ahead = " << cfg.io_read_ahead << "               # Blocks read ahead of a sequential reader, at most (0 = off)\n\n";
+
+            os << "[logging]\n";
+            os << "max_size = " << cfg.log_max_size << "            # Rotate the log at this size (bytes)\n";
+            os << "max_age = " << cfg.log_max_age << "                  # Rotate logs older than this (seconds, 0 = never)\n";
+            os << "max_archives = " << cfg.log_max_archives << "            # Rotated logs to keep (0 = unlimited)\n";
+            os << "compress = " << (cfg.log_compress ? "true" : "false") << "            # Compress rotated logs in the background\n";
+            os << "async = " << (cfg.log_async ? "true" : "false") << "              # Write the log from a background thread\n";
+            os << "queue_size = " << cfg.log_queue_size << "             # Records queued for the writer thread\n";
+            os << "overflow = " << cfg.log_overflow << "              # Full queue (block, drop_and_count, drop_debug_only)\n";
+            os << "format = " << cfg.log_format << "                 # Log file encoding (text, binary)\n";
 
             os.close();
-            ofs::Logger::get_instance().log(ofs::LogLevel::info, MODULE_FULL, 200, "wrote uconf file: " + path, __FILE__, __LINE__);
+            LOG_INFO(MODULE_FULL, 200, "wrote uconf file: {}", path);
             return true;
         }
         catch (const std::exception& e)
@@ -173,7 +208,7 @@ namespace ofs::config
                 return false;
             }
             out_cfg = def;
-            ofs::Logger::get_instance().log(ofs::LogLevel::info, MODULE_FULL, 210, "created default uconf: " + path, __FILE__, __LINE__);
+            LOG_INFO(MODULE_FULL, 210, "created default uconf: {}", path);
             return true;
         }
 
@@ -215,7 +250,7 @@ namespace ofs::config
             size_t eq = t.find ( '=' );
             if (eq == std::string::npos)
             {
-                ofs::Logger::get_instance().log(ofs::LogLevel::warn, MODULE_FULL, 301, "ignored malformed line " + std::to_string(line_no), __FILE__, __LINE__);
+                LOG_WARN(MODULE_FULL, 301, "ignored malformed line {}", line_no);
                 continue; // ignore malformed line
             }
             std::string key = trim ( t.substr ( 0, eq ) );
@@ -299,6 +334,62 @@ namespace ofs::config
                         }
                         cfg.max_filename_length = tmp;
                     }
+                    else if (k == "block_mapping")
+                    {
+                        std::string v = sval;
+                        std::transform ( v.begin(), v.end(), v.begin(), ::tolower );
+                        if (v != "chain" && v != "extent")
+                        {
+                            err = "bad block_mapping at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 417, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.block_mapping = v;
+                    }
+                    else if (k == "journal_size")
+                    {
+                        uint64_t tmp;
+                        if ( !parse_u64_dec ( sval, tmp ) )
+                        {
+                            err = "bad journal_size at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 427, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.journal_size = tmp;
+                    }
+                    else if (k == "history_size")
+                    {
+                        uint64_t tmp;
+                        if ( !parse_u64_dec ( sval, tmp ) )
+                        {
+                            err = "bad history_size at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 430, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.history_size = tmp;
+                    }
+                    else if (k == "history_chunks")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) )
+                        {
+                            err = "bad history_chunks at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 431, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.history_chunks = tmp;
+                    }
+                    else if (k == "history_full_every")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) || tmp == 0 || tmp > 64 )
+                        {
+                            err = "bad history_full_every at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 432, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.history_full_every = tmp;
+                    }
                 }
                 else if (current_section == "security")
                 {
@@ -332,6 +423,72 @@ namespace ofs::config
                         }
                         cfg.require_auth = b;
                     }
+                    else if (k == "hash_iterations")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) || tmp == 0 )
+                        {
+                            err = "bad hash_iterations at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 418, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.hash_iterations = tmp;
+                    }
+                    else if (k == "hash_threads")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) )
+                        {
+                            err = "bad hash_threads at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 419, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.hash_threads = tmp;
+                    }
+                    else if (k == "verify_cache_ttl")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) )
+                        {
+                            err = "bad verify_cache_ttl at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 420, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.verify_cache_ttl = tmp;
+                    }
+                    else if (k == "max_sessions")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) || tmp == 0 )
+                        {
+                            err = "bad max_sessions at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 421, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.max_sessions = tmp;
+                    }
+                    else if (k == "session_timeout")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) )
+                        {
+                            err = "bad session_timeout at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 422, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.session_timeout = tmp;
+                    }
+                    else if (k == "encode_content")
+                    {
+                        bool b;
+                        if ( !parse_bool ( sval, b ) )
+                        {
+                            err = "bad encode_content at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 433, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.encode_content = b;
+                    }
                 }
                 else if (current_section == "server")
                 {
@@ -368,10 +525,231 @@ namespace ofs::config
                         }
                         cfg.queue_timeout = tmp;
                     }
+                    else if (k == "execution")
+                    {
+                        std::string v = sval;
+                        std::transform ( v.begin(), v.end(), v.begin(), ::tolower );
+                        if (v != "fifo" && v != "concurrent")
+                        {
+                            err = "bad execution at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 425, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.execution = v;
+                    }
+                    else if (k == "workers")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) || tmp > 1024 )
+                        {
+                            err = "bad workers at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 426, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.workers = tmp;
+                    }
+                    else if (k == "stream_window")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) || tmp < 4096 || tmp > 64u * 1024 * 1024 )
+                        {
+                            err = "bad stream_window at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 436, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.stream_window = tmp;
+                    }
+                }
+                else if (current_section == "io")
+                {
+                    if (k == "sync_policy")
+                    {
+                        std::string v = sval;
+                        std::transform ( v.begin(), v.end(), v.begin(), ::tolower );
+                        if (v != "immediate" && v != "periodic" && v != "on_shutdown")
+                        {
+                            err = "bad sync_policy at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 415, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.io_sync_policy = v;
+                    }
+                    else if (k == "sync_interval_ms")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) || tmp == 0 )
+                        {
+                            err = "bad sync_interval_ms at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 416, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.io_sync_interval_ms = tmp;
+                    }
+                    else if (k == "backend")
+                    {
+                        std::string v = sval;
+                        std::transform ( v.begin(), v.end(), v.begin(), ::tolower );
+                        if (v != "mmap" && v != "pread" && v != "io_uring")
+                        {
+                            err = "bad backend at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 423, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.io_backend = v;
+                    }
+                    else if (k == "queue_depth")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) || tmp == 0 || tmp > 32768 )
+                        {
+                            err = "bad queue_depth at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 424, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.io_queue_depth = tmp;
+                    }
+                    else if (k == "durability")
+                    {
+                        std::string v = sval;
+                        std::transform ( v.begin(), v.end(), v.begin(), ::tolower );
+                        if (v != "fsync" && v != "group" && v != "async")
+                        {
+                            err = "bad durability at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 428, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.io_durability = v;
+                    }
+                    else if (k == "group_commit_ms")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) || tmp == 0 || tmp > 10000 )
+                        {
+                            err = "bad group_commit_ms at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 429, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.io_group_commit_ms = tmp;
+                    }
+                    else if (k == "cache_size")
+                    {
+                        uint64_t tmp;
+                        if ( !parse_u64_dec ( sval, tmp ) )
+                        {
+                            err = "bad cache_size at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 434, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.io_cache_size = tmp;
+                    }
+                    else if (k == "read_ahead")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) || tmp > 65536 )
+                        {
+                            err = "bad read_ahead at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 435, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.io_read_ahead = tmp;
+                    }
+                }
+                else if (current_section == "logging")
+                {
+                    if (k == "max_size")
+                    {
+                        uint64_t tmp;
+                        if ( !parse_u64_dec ( sval, tmp ) || tmp == 0 )
+                        {
+                            err = "bad max_size at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 411, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.log_max_size = tmp;
+                    }
+                    else if (k == "max_age")
+                    {
+                        uint64_t tmp;
+                        if ( !parse_u64_dec ( sval, tmp ) )
+                        {
+                            err = "bad max_age at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 412, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.log_max_age = tmp;
+                    }
+                    else if (k == "max_archives")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) )
+                        {
+                            err = "bad max_archives at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 413, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.log_max_archives = tmp;
+                    }
+                    else if (k == "compress")
+                    {
+                        bool b;
+                        if ( !parse_bool ( sval, b ) )
+                        {
+                            err = "bad compress at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 414, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.log_compress = b;
+                    }
+                    else if (k == "async")
+                    {
+                        bool b;
+                        if ( !parse_bool ( sval, b ) )
+                        {
+                            err = "bad async at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 437, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.log_async = b;
+                    }
+                    else if (k == "queue_size")
+                    {
+                        uint32_t tmp;
+                        if ( !parse_u32_dec ( sval, tmp ) || tmp < 64 || tmp > 1u << 20 )
+                        {
+                            err = "bad queue_size at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 438, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.log_queue_size = tmp;
+                    }
+                    else if (k == "overflow")
+                    {
+                        std::string v = sval;
+                        std::transform ( v.begin(), v.end(), v.begin(), ::tolower );
+                        if (v != "block" && v != "drop_and_count" && v != "drop_debug_only")
+                        {
+                            err = "bad overflow at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 439, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.log_overflow = v;
+                    }
+                    else if (k == "format")
+                    {
+                        std::string v = sval;
+                        std::transform ( v.begin(), v.end(), v.begin(), ::tolower );
+                        if (v != "text" && v != "binary")
+                        {
+                            err = "bad format at line " + std::to_string ( line_no );
+                            ofs::Logger::get_instance().log(ofs::LogLevel::error, MODULE_FULL, 440, err, __FILE__, line_no);
+                            return false;
+                        }
+                        cfg.log_format = v;
+                    }
                 }
                 else
                 {
-                    ofs::Logger::get_instance().log(ofs::LogLevel::warn, MODULE_FULL, 302, "ignored unknown section: " + current_section, __FILE__, __LINE__);
+                    LOG_WARN(MODULE_FULL, 302, "ignored unknown section: {}", current_section);
                 }
             }
             catch (const std::exception& ex)
@@ -383,7 +761,31 @@ namespace ofs::config
         }
 
         out_cfg = cfg;
-        ofs::Logger::get_instance().log(ofs::LogLevel::info, MODULE_FULL, 211, "loaded uconf file: " + path, __FILE__, __LINE__);
+        LOG_INFO(MODULE_FULL, 211, "loaded uconf file: {}", path);
         return true;
     }
+
+    void apply_logging_config(const Config& cfg)
+    {
+        ofs::LogRotationPolicy policy;
+        policy.max_size_bytes = cfg.log_max_size;
+        policy.max_age_seconds = cfg.log_max_age;
+        policy.max_archives = cfg.log_max_archives;
+        policy.compress = cfg.log_compress;
+        ofs::Logger& logger = ofs::Logger::get_instance();
+        logger.set_rotation_policy(policy);
+        logger.set_log_format(cfg.log_format == "binary" ? ofs::LogFormat::binary : ofs::LogFormat::text);
+
+        if (!cfg.log_async) {
+            logger.disable_async();
+            return;
+        }
+        ofs::LogOverflowPolicy overflow = ofs::LogOverflowPolicy::block;
+        if (cfg.log_overflow == "drop_and_count") {
+            overflow = ofs::LogOverflowPolicy::drop_and_count;
+        } else if (cfg.log_overflow == "drop_debug_only") {
+            overflow = ofs::LogOverflowPolicy::drop_debug_only;
+        }
+        logger.enable_async(cfg.log_queue_size, overflow);
+    }
 }
\ No newline at end of file
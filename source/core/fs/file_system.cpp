@@ -0,0 +1,924 @@
+#include "../../include/file_system.hpp"
+#include "../../include/block_cache.hpp"
+#include "../../include/uconf_parser.hpp"
+#include "../../include/coarse_clock.hpp"
+#include "../../include/slab_pool.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+#define MODULE_NAME "FILE_SYSTEM"
+
+namespace ofs::fs
+{
+    using storage::MetadataEntry;
+
+    // Pattern written over a file by file_truncate.
+    static constexpr char TRUNCATE_FILL[] = "siruamr";
+
+    // Sizes out for a read of size bytes; a buffer too small for them is
+    // traded for one from the slab pool.
+    static char* read_buffer(std::string& out, size_t size)
+    {
+        out.clear();
+        SlabPool::get_instance().reserve(out, size);
+        out.resize(size);
+        return out.data();
+    }
+
+    FileSystem::FileSystem()
+        : counts_(nullptr), free_stack_(nullptr), next_handle_(1)
+    {
+    }
+
+    FileSystem::~FileSystem()
+    {
+        shutdown();
+    }
+
+    OFSErrorCodes FileSystem::format(const std::string& omni_path, const std::string& config_path)
+    {
+        config::Config cfg;
+        std::string err;
+        if (!config::load_uconf_or_create_default(config_path, cfg, err)) {
+            LOG_ERROR(MODULE_NAME, 301, "cannot load config {}: {}", config_path, err);
+            return OFSErrorCodes::ERROR_INVALID_CONFIG;
+        }
+        return storage::OmniContainer::format(omni_path, cfg);
+    }
+
+    OFSErrorCodes FileSystem::init(const std::string& omni_path, const std::string& config_path)
+    {
+        config::Config cfg;
+        std::string err;
+        if (!config::load_uconf_or_create_default(config_path, cfg, err)) {
+            LOG_ERROR(MODULE_NAME, 301, "cannot load config {}: {}", config_path, err);
+            return OFSErrorCodes::ERROR_INVALID_CONFIG;
+        }
+        return init(omni_path, cfg);
+    }
+
+    OFSErrorCodes FileSystem::init(const std::string& omni_path, const config::Config& cfg)
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+
+        if (container_.is_open()) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        cfg_ = cfg;
+        OFSErrorCodes rc = container_.open(omni_path,
+                                           storage::sync_policy_from_string(cfg.io_sync_policy),
+                                           cfg.io_sync_interval_ms);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+        container_.set_io_backend(storage::io_backend_from_string(cfg.io_backend), cfg.io_queue_depth);
+        container_.set_cache(static_cast<size_t>(cfg.io_cache_size), cfg.io_sync_interval_ms, cfg.io_read_ahead);
+
+        // Records a crash left behind go in place before anything reads the
+        // metadata.
+        rc = journal_.attach(container_, storage::durability_from_string(cfg.io_durability), cfg.io_group_commit_ms);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            container_.close();
+            return rc;
+        }
+
+        // The dentry table can only be trusted after a clean shutdown, the
+        // snapshot only if it was sealed by the last mount.
+        storage::OmniLayoutInfo& layout = container_.mutable_layout();
+        bool clean = layout.dentry_clean == 1;
+        bool have_snapshot = snapshot_.attach(container_);
+        bool warm = clean && have_snapshot && snapshot_.valid(layout.mount_generation);
+        if (!warm && clean && layout.mount_generation != 0) {
+            LOG_WARN(MODULE_NAME, 102, "{}: no usable index snapshot, rebuilding in-memory indexes", omni_path);
+        }
+
+        uint64_t alloc_len = 0;
+        uint8_t* alloc_section = snapshot_.section(storage::SnapshotSection::allocator, alloc_len);
+        rc = allocator_.attach(container_, warm ? alloc_section : nullptr, static_cast<size_t>(alloc_len));
+        if (rc != OFSErrorCodes::SUCCESS) {
+            snapshot_.detach();
+            journal_.detach();
+            container_.close();
+            return rc;
+        }
+        mapper_ = storage::BlockMapper::create(container_, allocator_);
+        vault_.attach(container_, allocator_, cfg.history_full_every);
+
+        uint64_t dir_len = 0;
+        uint8_t* dir_section = snapshot_.section(storage::SnapshotSection::directory, dir_len);
+        size_t link_words = 3 * (static_cast<size_t>(container_.max_files()) + 1);
+        uint32_t* links = dir_len >= link_words * sizeof(uint32_t) ? reinterpret_cast<uint32_t*>(dir_section) : nullptr;
+        index_.attach(container_, !clean, links, warm && links != nullptr);
+
+        uint64_t entries_len = 0;
+        uint8_t* entries_section = snapshot_.section(storage::SnapshotSection::entries, entries_len);
+        size_t entries_bytes = sizeof(storage::EntriesSnapshot) + container_.max_files() * sizeof(uint32_t);
+        if (entries_len < entries_bytes) {
+            local_entries_.assign(entries_bytes, 0);
+            entries_section = local_entries_.data();
+        }
+        counts_ = reinterpret_cast<storage::EntriesSnapshot*>(entries_section);
+        free_stack_ = reinterpret_cast<uint32_t*>(entries_section + sizeof(storage::EntriesSnapshot));
+        if (!warm || entries_section == local_entries_.data() || counts_->free_count > container_.max_files()) {
+            rebuild_entries();
+        }
+
+        uint64_t users_len = 0;
+        uint8_t* users_section = snapshot_.section(storage::SnapshotSection::users, users_len);
+        users_.attach(container_, users_section, static_cast<size_t>(users_len), warm);
+        hasher_.start(cfg.hash_iterations, cfg.hash_threads, cfg.verify_cache_ttl);
+        users_.set_hasher(&hasher_);
+
+        // From here on the mapped indexes change in place: clear the flag and
+        // move to a new generation on disk before anything else is modified.
+        ++layout.mount_generation;
+        layout.dentry_clean = 0;
+        container_.mark_dirty(&layout, sizeof(layout));
+        container_.sync();
+
+        if (users_.count() == 0) {
+            rc = users_.user_create(cfg.admin_username, cfg.admin_password, UserRole::ADMIN);
+            if (rc != OFSErrorCodes::SUCCESS) {
+                LOG_WARN(MODULE_NAME, 103, "cannot create admin user '{}'", cfg.admin_username);
+            }
+        }
+
+        LOG_INFO(MODULE_NAME, 10, "mounted {} (generation {}): {} files, {} directories, {} free slots{}",
+                 omni_path, layout.mount_generation, counts_->total_files, counts_->total_directories,
+                 counts_->free_count,
+                 warm ? "" : (clean ? " (indexes rebuilt)" : " (indexes rebuilt after unclean shutdown)"));
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    void FileSystem::rebuild_entries()
+    {
+        counts_->free_count = 0;
+        counts_->total_files = 0;
+        counts_->total_directories = 0;
+        for (uint32_t i = container_.max_files(); i >= 1; --i) {
+            const MetadataEntry* e = container_.entry(i);
+            if (!e->in_use()) {
+                free_stack_[counts_->free_count++] = i;
+            } else if (i != storage::ROOT_ENTRY_INDEX) {
+                if (e->is_directory()) {
+                    ++counts_->total_directories;
+                } else {
+                    ++counts_->total_files;
+                }
+            }
+        }
+    }
+
+    void FileSystem::save_snapshot()
+    {
+        if (!snapshot_.present()) {
+            return;
+        }
+        uint64_t alloc_len = 0;
+        uint8_t* alloc_section = snapshot_.section(storage::SnapshotSection::allocator, alloc_len);
+        if (alloc_section != nullptr) {
+            allocator_.save_snapshot(alloc_section, static_cast<size_t>(alloc_len));
+        }
+        snapshot_.mark_all_dirty();
+    }
+
+    void FileSystem::shutdown()
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+
+        if (!container_.is_open()) {
+            return;
+        }
+
+        // Queued logins finish (and record last_login) before the user table
+        // is written out.
+        hasher_.stop();
+        users_.set_hasher(nullptr);
+
+        // Everything else reaches the disk before the snapshot is sealed and
+        // the table is marked clean; a crash in between only costs a rebuild.
+        save_snapshot();
+        container_.sync();
+        storage::OmniLayoutInfo& layout = container_.mutable_layout();
+        snapshot_.seal(layout.mount_generation);
+        layout.dentry_clean = 1;
+        container_.mark_dirty(&layout.dentry_clean, sizeof(layout.dentry_clean));
+
+        snapshot_.detach();
+        users_.detach();
+        index_.detach();
+        mapper_.reset();
+        vault_.detach();
+        allocator_.detach();
+        journal_.detach();
+        container_.close();
+        counts_ = nullptr;
+        free_stack_ = nullptr;
+        local_entries_.clear();
+        {
+            std::lock_guard<std::mutex> open_lock(open_mtx_);
+            open_files_.clear();
+            open_sessions_.clear();
+        }
+        LOG_INFO(MODULE_NAME, 11, "unmounted");
+    }
+
+    bool FileSystem::valid_path(const std::string& path) const
+    {
+        if (path.empty() || path[0] != '/') {
+            return false;
+        }
+        if (path == "/") {
+            return true;
+        }
+
+        size_t max_len = std::min<size_t>(cfg_.max_filename_length, sizeof(MetadataEntry::name) - 1);
+        size_t pos = 1;
+        while (pos <= path.size()) {
+            size_t slash = path.find('/', pos);
+            if (slash == std::string::npos) {
+                slash = path.size();
+            }
+            size_t len = slash - pos;
+            if (len == 0 || len > max_len) {
+                return false;
+            }
+            std::string_view comp(path.data() + pos, len);
+            if (comp == "." || comp == ".." || comp.find('\0') != std::string_view::npos) {
+                return false;
+            }
+            pos = slash + 1;
+        }
+        return true;
+    }
+
+    void FileSystem::split_path(const std::string& path, std::string& parent, std::string& name)
+    {
+        size_t slash = path.rfind('/');
+        parent = slash == 0 ? "/" : path.substr(0, slash);
+        name = path.substr(slash + 1);
+    }
+
+    MetadataEntry* FileSystem::lookup(const std::string& path, uint32_t& index)
+    {
+        index = valid_path(path) ? index_.resolve(path) : 0;
+        return index != 0 ? container_.entry(index) : nullptr;
+    }
+
+    void FileSystem::touch(MetadataEntry& e)
+    {
+        e.modified_time = clock::unix_seconds();
+        container_.mark_dirty(&e, sizeof(e));
+    }
+
+    OFSErrorCodes FileSystem::new_entry(const std::string& path, EntryType type, uint32_t owner,
+                                        uint32_t permissions, uint32_t& index)
+    {
+        if (!valid_path(path) || path == "/") {
+            return OFSErrorCodes::ERROR_INVALID_PATH;
+        }
+
+        std::string parent_path, name;
+        split_path(path, parent_path, name);
+        uint32_t parent = index_.resolve(parent_path);
+        if (parent == 0 || !container_.entry(parent)->is_directory()) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        if (index_.lookup(parent, name) != 0) {
+            return OFSErrorCodes::ERROR_FILE_EXISTS;
+        }
+        if (counts_->free_count == 0) {
+            LOG_WARN(MODULE_NAME, 101, "no free metadata slot for {}", path);
+            return OFSErrorCodes::ERROR_NO_SPACE;
+        }
+
+        index = free_stack_[--counts_->free_count];
+
+        MetadataEntry& e = container_.metadata_table()[index - 1];
+        std::memset(&e, 0, sizeof(e));
+        e.type = static_cast<uint8_t>(type);
+        e.parent_index = parent;
+        std::memcpy(e.name, name.data(), name.size());
+        e.owner_id = owner;
+        e.permissions = permissions;
+        e.created_time = clock::unix_seconds();
+        e.modified_time = e.created_time;
+        e.validity = storage::ENTRY_IN_USE;
+        container_.mark_dirty(&e, sizeof(e));
+
+        index_.insert(index);
+        index_.forget(path);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    void FileSystem::free_entry(uint32_t index)
+    {
+        index_.erase(index);
+        MetadataEntry& e = container_.metadata_table()[index - 1];
+        std::memset(&e, 0, sizeof(e));
+        e.validity = storage::ENTRY_FREE;
+        container_.mark_dirty(&e, sizeof(e));
+        free_stack_[counts_->free_count++] = index;
+
+        std::lock_guard<std::mutex> open_lock(open_mtx_);
+        for (auto& [handle, f] : open_files_) {
+            if (f.index == index) {
+                f.index = 0;
+            }
+        }
+    }
+
+    // Grows or shrinks the blocks of e for size bytes. When the content area
+    // is full, the oldest file history makes room for live data.
+    OFSErrorCodes FileSystem::resize(MetadataEntry& e, uint64_t size)
+    {
+        uint64_t blocks = mapper_->blocks_for_size(size);
+        uint64_t have = mapper_->block_count(e);
+        OFSErrorCodes rc = mapper_->resize(e, blocks);
+        if (rc == OFSErrorCodes::ERROR_NO_SPACE && vault_.reclaim(blocks - have) != 0) {
+            rc = mapper_->resize(e, blocks);
+        }
+        return rc;
+    }
+
+    // Records the current content of e as a full version; nothing is
+    // recorded when the content cannot be read.
+    OFSErrorCodes FileSystem::record_version(uint32_t index, MetadataEntry& e)
+    {
+        if (!vault_.active()) {
+            return OFSErrorCodes::SUCCESS;
+        }
+        std::string content(static_cast<size_t>(e.total_size), '\0');
+        OFSErrorCodes rc = mapper_->read(e, 0, content.data(), content.size());
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+        vault_.record_full(index, e.version, content.data(), content.size(), e.modified_time);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    FileEntry FileSystem::to_file_entry(uint32_t index, const MetadataEntry& e)
+    {
+        std::string owner;
+        if (e.owner_id < container_.max_users()) {
+            const UserInfo& u = container_.user_table()[e.owner_id];
+            if (u.is_active) {
+                owner.assign(u.username, strnlen(u.username, sizeof(u.username)));
+            }
+        }
+
+        FileEntry fe(std::string(entry_name(e)), static_cast<EntryType>(e.type),
+                     e.is_directory() ? 0 : e.total_size, e.permissions, owner, index);
+        fe.created_time = e.created_time;
+        fe.modified_time = e.modified_time;
+        return fe;
+    }
+
+    // ------------------------------------------------------------------------
+    // Files
+    // ------------------------------------------------------------------------
+
+    OFSErrorCodes FileSystem::file_create(const std::string& path, const char* data, size_t size, uint32_t owner)
+    {
+        storage::LockedTransaction<std::shared_mutex> lock(&journal_, mtx_);
+
+        uint32_t index;
+        OFSErrorCodes rc = new_entry(path, EntryType::FILE, owner, 0644, index);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+
+        MetadataEntry& e = *container_.entry(index);
+        rc = resize(e, size);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            free_entry(index);
+            return rc;
+        }
+        rc = mapper_->write(e, 0, data, size);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            mapper_->release(e);
+            free_entry(index);
+            return rc;
+        }
+        e.total_size = size;
+        e.version = 1;
+        container_.mark_dirty(&e, sizeof(e));
+        ++counts_->total_files;
+        vault_.record_full(index, e.version, data, size, e.modified_time);
+
+        LOG_INFO(MODULE_NAME, 20, "file_create {} ({} bytes)", path, size);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::file_read(const std::string& path, std::string& out)
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        if (e->is_directory()) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        size_t size = static_cast<size_t>(e->total_size);
+        return mapper_->read(*e, 0, read_buffer(out, size), size);
+    }
+
+    OFSErrorCodes FileSystem::file_read_range(const std::string& path, uint64_t offset, size_t len, std::string& out)
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        if (e->is_directory() || offset > e->total_size) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        size_t size = static_cast<size_t>(std::min<uint64_t>(len, e->total_size - offset));
+        return mapper_->read(*e, offset, read_buffer(out, size), size);
+    }
+
+    OFSErrorCodes FileSystem::file_open(const std::string& path, std::string_view session, uint64_t& handle,
+                                        uint64_t& size, uint64_t offset)
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        if (e->is_directory() || offset > e->total_size) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        std::lock_guard<std::mutex> open_lock(open_mtx_);
+        if (open_files_.size() >= MAX_OPEN_FILES) {
+            LOG_WARN(MODULE_NAME, 104, "{} files open, refusing to open {}", open_files_.size(), path);
+            return OFSErrorCodes::ERROR_NO_SPACE;
+        }
+        std::string owner(session);
+        size_t& held = open_sessions_[owner];
+        if (!owner.empty() && held >= MAX_OPEN_PER_SESSION) {
+            LOG_WARN(MODULE_NAME, 105, "session has {} files open, refusing to open {}", held, path);
+            return OFSErrorCodes::ERROR_NO_SPACE;
+        }
+        ++held;
+        handle = next_handle_++;
+        open_files_.emplace(handle, OpenFile{index, offset, std::move(owner), e->version, path});
+        size = e->total_size;
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::file_read_next(uint64_t handle, std::string_view session, size_t max, std::string& out,
+                                             uint64_t* offset)
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+
+        // The range is claimed under open_mtx_, so readers sharing a
+        // handle each get their own bytes; the copy happens outside it.
+        MetadataEntry* e;
+        uint64_t at, len;
+        {
+            std::lock_guard<std::mutex> open_lock(open_mtx_);
+            auto it = open_files_.find(handle);
+            if (it == open_files_.end() || it->second.session != session || it->second.index == 0) {
+                return OFSErrorCodes::ERROR_NOT_FOUND;
+            }
+            OpenFile& f = it->second;
+            e = container_.entry(f.index);
+            if (e->version != f.version) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            at = f.offset;
+            len = std::min<uint64_t>(max, e->total_size - at);
+            f.offset = at + len;
+        }
+        if (offset != nullptr) {
+            *offset = at;
+        }
+        return mapper_->read(*e, at, read_buffer(out, static_cast<size_t>(len)), static_cast<size_t>(len));
+    }
+
+    void FileSystem::free_buffer(std::string&& buffer)
+    {
+        SlabPool::get_instance().release(std::move(buffer));
+    }
+
+    OFSErrorCodes FileSystem::file_close(uint64_t handle, std::string_view session)
+    {
+        std::lock_guard<std::mutex> open_lock(open_mtx_);
+        auto it = open_files_.find(handle);
+        if (it == open_files_.end() || it->second.session != session) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        auto held = open_sessions_.find(it->second.session);
+        if (--held->second == 0) {
+            open_sessions_.erase(held);
+        }
+        open_files_.erase(it);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    bool FileSystem::handle_path(uint64_t handle, std::string_view session, std::string& path)
+    {
+        std::lock_guard<std::mutex> open_lock(open_mtx_);
+        auto it = open_files_.find(handle);
+        if (it == open_files_.end() || it->second.session != session) {
+            return false;
+        }
+        path = it->second.path;
+        return true;
+    }
+
+    size_t FileSystem::close_handles(const std::function<bool(std::string_view session)>& ended)
+    {
+        std::lock_guard<std::mutex> open_lock(open_mtx_);
+        size_t closed = 0;
+        for (auto held = open_sessions_.begin(); held != open_sessions_.end();) {
+            if (!ended(held->first)) {
+                ++held;
+                continue;
+            }
+            for (auto it = open_files_.begin(); it != open_files_.end();) {
+                if (it->second.session == held->first) {
+                    it = open_files_.erase(it);
+                    ++closed;
+                } else {
+                    ++it;
+                }
+            }
+            held = open_sessions_.erase(held);
+        }
+        return closed;
+    }
+
+    OFSErrorCodes FileSystem::file_edit(const std::string& path, const char* data, size_t size, uint64_t index)
+    {
+        storage::LockedTransaction<std::shared_mutex> lock(&journal_, mtx_);
+
+        uint32_t entry;
+        MetadataEntry* e = lookup(path, entry);
+        if (e == nullptr) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        if (e->is_directory() || index > e->total_size) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        uint64_t end = index + size;
+        uint64_t old_size = e->total_size;
+        if (end > old_size) {
+            OFSErrorCodes rc = resize(*e, end);
+            if (rc != OFSErrorCodes::SUCCESS) {
+                return rc;
+            }
+        }
+        OFSErrorCodes rc = mapper_->write(*e, index, data, size);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            if (end > old_size) {
+                mapper_->resize(*e, mapper_->blocks_for_size(old_size));
+            }
+            return rc;
+        }
+        e->total_size = std::max(old_size, end);
+        ++e->version;
+        touch(*e);
+        if (!vault_.record_delta(entry, e->version, index, data, size, e->total_size, e->modified_time)) {
+            rc = record_version(entry, *e);
+            if (rc != OFSErrorCodes::SUCCESS) {
+                return rc;
+            }
+        }
+
+        LOG_INFO(MODULE_NAME, 21, "file_edit {} ({} bytes at {})", path, size, index);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::file_delete(const std::string& path)
+    {
+        storage::LockedTransaction<std::shared_mutex> lock(&journal_, mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        if (e->is_directory()) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        mapper_->release(*e);
+        vault_.forget(index);
+        free_entry(index);
+        index_.forget(path);
+        --counts_->total_files;
+
+        LOG_INFO(MODULE_NAME, 22, "file_delete {}", path);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::file_truncate(const std::string& path)
+    {
+        storage::LockedTransaction<std::shared_mutex> lock(&journal_, mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        if (e->is_directory()) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        // The old content is replaced by the fill pattern over its full length.
+        const size_t pattern_len = sizeof(TRUNCATE_FILL) - 1;
+        std::string chunk;
+        for (size_t i = 0; i < 65536; ++i) {
+            chunk += TRUNCATE_FILL[i % pattern_len];
+        }
+        for (uint64_t pos = 0; pos < e->total_size;) {
+            size_t n = static_cast<size_t>(std::min<uint64_t>(chunk.size() - pos % pattern_len, e->total_size - pos));
+            OFSErrorCodes rc = mapper_->write(*e, pos, chunk.data() + pos % pattern_len, n);
+            if (rc != OFSErrorCodes::SUCCESS) {
+                return rc;
+            }
+            pos += n;
+        }
+        ++e->version;
+        touch(*e);
+        OFSErrorCodes rc = record_version(index, *e);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+
+        LOG_INFO(MODULE_NAME, 23, "file_truncate {}", path);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::file_exists(const std::string& path)
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        return (e != nullptr && !e->is_directory()) ? OFSErrorCodes::SUCCESS : OFSErrorCodes::ERROR_NOT_FOUND;
+    }
+
+    OFSErrorCodes FileSystem::file_rename(const std::string& old_path, const std::string& new_path)
+    {
+        storage::LockedTransaction<std::shared_mutex> lock(&journal_, mtx_);
+
+        if (!valid_path(old_path) || !valid_path(new_path) || old_path == "/" || new_path == "/") {
+            return OFSErrorCodes::ERROR_INVALID_PATH;
+        }
+
+        uint32_t index;
+        MetadataEntry* e = lookup(old_path, index);
+        if (e == nullptr) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+
+        std::string parent_path, name;
+        split_path(new_path, parent_path, name);
+        uint32_t parent = index_.resolve(parent_path);
+        if (parent == 0 || !container_.entry(parent)->is_directory()) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        if (index_.lookup(parent, name) != 0) {
+            return OFSErrorCodes::ERROR_FILE_EXISTS;
+        }
+
+        // A directory cannot move below itself.
+        if (e->is_directory()) {
+            for (uint32_t p = parent; p != 0; p = container_.entry(p)->parent_index) {
+                if (p == index) {
+                    return OFSErrorCodes::ERROR_INVALID_OPERATION;
+                }
+            }
+        }
+
+        index_.erase(index);
+        e->parent_index = parent;
+        std::memset(e->name, 0, sizeof(e->name));
+        std::memcpy(e->name, name.data(), name.size());
+        index_.insert(index);
+        touch(*e);
+
+        // Every cached path below a renamed directory is stale.
+        if (e->is_directory()) {
+            index_.forget_all();
+        } else {
+            index_.forget(old_path);
+            index_.forget(new_path);
+        }
+
+        // Handles on the file, or on any file below the directory, follow.
+        {
+            std::lock_guard<std::mutex> open_lock(open_mtx_);
+            for (auto& [handle, f] : open_files_) {
+                if (f.path.compare(0, old_path.size(), old_path) == 0 &&
+                    (f.path.size() == old_path.size() || f.path[old_path.size()] == '/')) {
+                    f.path.replace(0, old_path.size(), new_path);
+                }
+            }
+        }
+
+        LOG_INFO(MODULE_NAME, 24, "rename {} -> {}", old_path, new_path);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::file_versions(const std::string& path, std::vector<storage::FileVersion>& versions)
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr || e->is_directory()) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        vault_.versions(index, versions);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::file_read_version(const std::string& path, uint32_t version, std::string& out)
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr || e->is_directory()) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        return vault_.read(index, version, out);
+    }
+
+    OFSErrorCodes FileSystem::file_restore(const std::string& path, uint32_t version)
+    {
+        storage::LockedTransaction<std::shared_mutex> lock(&journal_, mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr || e->is_directory()) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        std::string content;
+        OFSErrorCodes rc = vault_.read(index, version, content);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+
+        rc = resize(*e, content.size());
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+        rc = mapper_->write(*e, 0, content.data(), content.size());
+        if (rc != OFSErrorCodes::SUCCESS) {
+            mapper_->resize(*e, mapper_->blocks_for_size(e->total_size));
+            return rc;
+        }
+        e->total_size = content.size();
+        ++e->version;
+        touch(*e);
+        vault_.record_full(index, e->version, content.data(), content.size(), e->modified_time);
+
+        LOG_INFO(MODULE_NAME, 27, "file_restore {} to version {}", path, version);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    // ------------------------------------------------------------------------
+    // Directories
+    // ------------------------------------------------------------------------
+
+    OFSErrorCodes FileSystem::dir_create(const std::string& path, uint32_t owner)
+    {
+        storage::LockedTransaction<std::shared_mutex> lock(&journal_, mtx_);
+
+        uint32_t index;
+        OFSErrorCodes rc = new_entry(path, EntryType::DIRECTORY, owner, 0755, index);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+        ++counts_->total_directories;
+
+        LOG_INFO(MODULE_NAME, 25, "dir_create {}", path);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::dir_list(const std::string& path, std::vector<FileEntry>& entries)
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr || !e->is_directory()) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+
+        entries.clear();
+        for (uint32_t child = index_.first_child(index); child != 0; child = index_.next_sibling(child)) {
+            entries.push_back(to_file_entry(child, *container_.entry(child)));
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::dir_delete(const std::string& path)
+    {
+        storage::LockedTransaction<std::shared_mutex> lock(&journal_, mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr || !e->is_directory()) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        if (index == storage::ROOT_ENTRY_INDEX) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+        if (index_.first_child(index) != 0) {
+            return OFSErrorCodes::ERROR_DIRECTORY_NOT_EMPTY;
+        }
+
+        free_entry(index);
+        index_.forget(path);
+        --counts_->total_directories;
+
+        LOG_INFO(MODULE_NAME, 26, "dir_delete {}", path);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::dir_exists(const std::string& path)
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        return (e != nullptr && e->is_directory()) ? OFSErrorCodes::SUCCESS : OFSErrorCodes::ERROR_NOT_FOUND;
+    }
+
+    // ------------------------------------------------------------------------
+    // Information
+    // ------------------------------------------------------------------------
+
+    OFSErrorCodes FileSystem::get_metadata(const std::string& path, FileMetadata& meta)
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+
+        meta = FileMetadata(path, to_file_entry(index, *e));
+        meta.blocks_used = e->is_directory() ? 0 : mapper_->block_count(*e);
+        meta.actual_size = meta.blocks_used * container_.block_size();
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::set_permissions(const std::string& path, uint32_t permissions)
+    {
+        storage::LockedTransaction<std::shared_mutex> lock(&journal_, mtx_);
+
+        uint32_t index;
+        MetadataEntry* e = lookup(path, index);
+        if (e == nullptr) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        e->permissions = permissions & 07777;
+        touch(*e);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes FileSystem::get_stats(FSStats& stats)
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+
+        if (!container_.is_open()) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        stats = FSStats(0, 0, 0);
+        allocator_.fill_stats(stats);
+        stats.total_files = counts_->total_files;
+        stats.total_directories = counts_->total_directories;
+
+        stats.total_users = users_.count();
+        if (const storage::BlockCache* cache = container_.cache()) {
+            storage::BlockCache::Stats cs = cache->stats();
+            stats.cache_hits = cs.hits;
+            stats.cache_misses = cs.misses;
+            stats.cache_evictions = cs.evictions;
+            stats.cache_read_ahead = cs.read_ahead;
+            stats.cache_read_ahead_hits = cs.read_ahead_hits;
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+}
@@ -0,0 +1,316 @@
+#include "../../include/path_index.hpp"
+#include "../../include/omni_container.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <cstring>
+
+#define MODULE_NAME "PATH_INDEX"
+
+namespace ofs::fs
+{
+    using storage::MetadataEntry;
+
+    PathIndex::PathIndex(size_t cache_capacity)
+        : container_(nullptr),
+          entries_(nullptr),
+          max_files_(0),
+          slots_(nullptr),
+          mask_(0),
+          slots_mapped_(false),
+          first_child_(nullptr),
+          next_sibling_(nullptr),
+          prev_sibling_(nullptr),
+          cache_capacity_(cache_capacity),
+          hits_(0),
+          misses_(0)
+    {
+    }
+
+    uint64_t PathIndex::hash_key(uint32_t parent, std::string_view name)
+    {
+        // FNV-1a over the parent index and the name bytes.
+        uint64_t h = 1469598103934665603ULL;
+        for (int i = 0; i < 4; ++i) {
+            h ^= (parent >> (i * 8)) & 0xFF;
+            h *= 1099511628211ULL;
+        }
+        for (char c : name) {
+            h ^= static_cast<uint8_t>(c);
+            h *= 1099511628211ULL;
+        }
+        return h;
+    }
+
+    size_t PathIndex::home_of(uint32_t entry) const
+    {
+        const MetadataEntry& e = meta(entry);
+        return static_cast<size_t>(hash_key(e.parent_index, entry_name(e))) & mask_;
+    }
+
+    void PathIndex::set_slot(size_t slot, uint32_t value)
+    {
+        slots_[slot] = value;
+        if (slots_mapped_) {
+            container_->mark_dirty(&slots_[slot], sizeof(uint32_t));
+        }
+    }
+
+    void PathIndex::attach(storage::OmniContainer& container, bool rebuild, uint32_t* links, bool links_valid)
+    {
+        container_ = &container;
+        entries_ = container.metadata_table();
+        max_files_ = container.max_files();
+
+        storage::View<uint32_t> table = container.dentry_table();
+        if (!table.empty()) {
+            slots_ = table.data;
+            mask_ = table.size - 1;
+            slots_mapped_ = true;
+        } else {
+            size_t slots = 16;
+            while (slots < static_cast<size_t>(max_files_) * 2) {
+                slots <<= 1;
+            }
+            local_slots_.assign(slots, 0);
+            slots_ = local_slots_.data();
+            mask_ = slots - 1;
+            slots_mapped_ = false;
+            rebuild = true;
+        }
+
+        if (rebuild) {
+            std::memset(slots_, 0, (mask_ + 1) * sizeof(uint32_t));
+            if (slots_mapped_) {
+                container.mark_dirty(slots_, (mask_ + 1) * sizeof(uint32_t));
+            }
+        }
+
+        size_t words = static_cast<size_t>(max_files_) + 1;
+        if (links == nullptr) {
+            local_links_.assign(3 * words, 0);
+            links = local_links_.data();
+            links_valid = false;
+        }
+        first_child_ = links;
+        next_sibling_ = links + words;
+        prev_sibling_ = links + 2 * words;
+
+        forget_all();
+        if (!rebuild && links_valid) {
+            LOG_INFO(MODULE_NAME, 10, "using mapped index ({} dentry slots)", mask_ + 1);
+            return;
+        }
+
+        if (!links_valid) {
+            std::memset(links, 0, 3 * words * sizeof(uint32_t));
+        }
+        uint32_t live = 0;
+        for (uint32_t i = 1; i <= max_files_; ++i) {
+            const MetadataEntry& e = meta(i);
+            if (!e.in_use() || i == storage::ROOT_ENTRY_INDEX) {
+                continue;
+            }
+            uint32_t parent = e.parent_index;
+            if (parent == 0 || parent > max_files_ || !meta(parent).in_use() || !meta(parent).is_directory()) {
+                LOG_WARN(MODULE_NAME, 101, "entry {} ('{}') has an invalid parent {}", i, entry_name(e), parent);
+                continue;
+            }
+            if (!links_valid) {
+                link_child(i);
+            }
+            if (rebuild) {
+                hash_insert(i);
+            }
+            ++live;
+        }
+
+        LOG_INFO(MODULE_NAME, 11, "indexed {} entries ({} dentry slots, {}{})", live, mask_ + 1,
+                 rebuild ? "table rebuilt" : "table loaded from container",
+                 links_valid ? "" : ", child lists rebuilt");
+    }
+
+    void PathIndex::detach()
+    {
+        container_ = nullptr;
+        entries_ = nullptr;
+        max_files_ = 0;
+        slots_ = nullptr;
+        mask_ = 0;
+        local_slots_.clear();
+        first_child_ = nullptr;
+        next_sibling_ = nullptr;
+        prev_sibling_ = nullptr;
+        local_links_.clear();
+        forget_all();
+    }
+
+    uint32_t PathIndex::lookup(uint32_t parent, std::string_view name) const
+    {
+        size_t slot = static_cast<size_t>(hash_key(parent, name)) & mask_;
+        for (;;) {
+            uint32_t e = slots_[slot];
+            if (e == 0) {
+                return 0;
+            }
+            const MetadataEntry& m = meta(e);
+            if (m.parent_index == parent && entry_name(m) == name) {
+                return e;
+            }
+            slot = (slot + 1) & mask_;
+        }
+    }
+
+    void PathIndex::hash_insert(uint32_t entry)
+    {
+        size_t slot = home_of(entry);
+        while (slots_[slot] != 0) {
+            slot = (slot + 1) & mask_;
+        }
+        set_slot(slot, entry);
+    }
+
+    // Backward-shift deletion keeps probe chains intact without tombstones.
+    void PathIndex::hash_erase(uint32_t entry)
+    {
+        size_t i = home_of(entry);
+        while (slots_[i] != entry) {
+            if (slots_[i] == 0) {
+                return;
+            }
+            i = (i + 1) & mask_;
+        }
+
+        size_t j = i;
+        for (;;) {
+            j = (j + 1) & mask_;
+            if (slots_[j] == 0) {
+                break;
+            }
+            size_t h = home_of(slots_[j]);
+            if (((j - h) & mask_) >= ((j - i) & mask_)) {
+                set_slot(i, slots_[j]);
+                i = j;
+            }
+        }
+        set_slot(i, 0);
+    }
+
+    // New children go to the head of the parent's list.
+    void PathIndex::link_child(uint32_t entry)
+    {
+        uint32_t parent = meta(entry).parent_index;
+        uint32_t head = first_child_[parent];
+        next_sibling_[entry] = head;
+        prev_sibling_[entry] = 0;
+        if (head != 0) {
+            prev_sibling_[head] = entry;
+        }
+        first_child_[parent] = entry;
+    }
+
+    void PathIndex::unlink_child(uint32_t entry)
+    {
+        uint32_t prev = prev_sibling_[entry];
+        uint32_t next = next_sibling_[entry];
+        if (prev != 0) {
+            next_sibling_[prev] = next;
+        } else if (first_child_[meta(entry).parent_index] == entry) {
+            first_child_[meta(entry).parent_index] = next;
+        }
+        if (next != 0) {
+            prev_sibling_[next] = prev;
+        }
+        next_sibling_[entry] = 0;
+        prev_sibling_[entry] = 0;
+    }
+
+    void PathIndex::insert(uint32_t entry)
+    {
+        hash_insert(entry);
+        link_child(entry);
+    }
+
+    void PathIndex::erase(uint32_t entry)
+    {
+        hash_erase(entry);
+        unlink_child(entry);
+    }
+
+    uint32_t PathIndex::resolve(const std::string& path)
+    {
+        if (path == "/") {
+            return storage::ROOT_ENTRY_INDEX;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(cache_mtx_);
+            auto it = cache_.find(path);
+            if (it != cache_.end()) {
+                lru_.splice(lru_.begin(), lru_, it->second);
+                ++hits_;
+                return it->second->second;
+            }
+            ++misses_;
+        }
+
+        uint32_t cur = storage::ROOT_ENTRY_INDEX;
+        size_t pos = 1;
+        while (cur != 0 && pos <= path.size()) {
+            size_t slash = path.find('/', pos);
+            if (slash == std::string::npos) {
+                slash = path.size();
+            }
+            cur = lookup(cur, std::string_view(path).substr(pos, slash - pos));
+            pos = slash + 1;
+        }
+
+        remember(path, cur);
+        return cur;
+    }
+
+    void PathIndex::remember(const std::string& path, uint32_t entry)
+    {
+        if (cache_capacity_ == 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(cache_mtx_);
+        if (cache_.find(path) != cache_.end()) {
+            return;
+        }
+        lru_.emplace_front(path, entry);
+        cache_.emplace(path, lru_.begin());
+        if (lru_.size() > cache_capacity_) {
+            cache_.erase(lru_.back().first);
+            lru_.pop_back();
+        }
+    }
+
+    void PathIndex::forget(const std::string& path)
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx_);
+        auto it = cache_.find(path);
+        if (it != cache_.end()) {
+            lru_.erase(it->second);
+            cache_.erase(it);
+        }
+    }
+
+    void PathIndex::forget_all()
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx_);
+        lru_.clear();
+        cache_.clear();
+    }
+
+    uint64_t PathIndex::cache_hits() const
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx_);
+        return hits_;
+    }
+
+    uint64_t PathIndex::cache_misses() const
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx_);
+        return misses_;
+    }
+}
@@ -0,0 +1,291 @@
+#include "../../include/log_encoding.hpp"
+#include "../../include/coarse_clock.hpp"
+
+#include <charconv>
+#include <cstring>
+
+namespace ofs
+{
+
+static constexpr char BINARY_LOG_MAGIC[8] = {'O', 'F', 'S', 'B', 'L', 'O', 'G', '1'};
+static constexpr uint8_t TAG_STRING = 0x01;
+static constexpr uint8_t TAG_EVENT = 0x02;
+
+// ---------------------------------------------------------------------------
+// Text
+// ---------------------------------------------------------------------------
+
+const char* log_level_name(LogLevel level)
+{
+    switch (level)
+    {
+        case LogLevel::debug: return "DEBUG";
+        case LogLevel::info:  return "INFO";
+        case LogLevel::warn:  return "WARN";
+        case LogLevel::error: return "ERROR";
+        case LogLevel::fatal: return "FATAL";
+    }
+    return "UNKNOWN";
+}
+
+static void append_int(std::string& out, int64_t v)
+{
+    char buf[24];
+    auto res = std::to_chars(buf, buf + sizeof(buf), v);
+    out.append(buf, res.ptr);
+}
+
+void format_text_log_line(std::string& out,
+                          int64_t wall_ns,
+                          std::string_view app,
+                          int pid,
+                          LogLevel level,
+                          std::string_view module,
+                          int code,
+                          std::string_view msg,
+                          std::string_view src_file,
+                          int line)
+{
+    clock::append_utc_timestamp(out, wall_ns);
+    out += " app=\"";
+    out.append(app.data(), app.size());
+    out += "\" pid=";
+    append_int(out, pid);
+    out += " level=";
+    out += log_level_name(level);
+    out += " module=";
+    out.append(module.data(), module.size());
+    out += " code=";
+    append_int(out, code);
+    out += " msg=\"";
+    out.append(msg.data(), msg.size());
+    out += "\" file=\"";
+    out.append(src_file.data(), src_file.size());
+    out += "\" line=";
+    append_int(out, line);
+    out += '\n';
+}
+
+// ---------------------------------------------------------------------------
+// Binary encoder
+// ---------------------------------------------------------------------------
+
+static void put_varint(std::string& out, uint64_t v)
+{
+    while (v >= 0x80) {
+        out += static_cast<char>((v & 0x7F) | 0x80);
+        v >>= 7;
+    }
+    out += static_cast<char>(v);
+}
+
+static uint64_t zigzag(int64_t v)
+{
+    return (static_cast<uint64_t>(v) << 1) ^ static_cast<uint64_t>(v >> 63);
+}
+
+static int64_t unzigzag(uint64_t v)
+{
+    return static_cast<int64_t>(v >> 1) ^ -static_cast<int64_t>(v & 1);
+}
+
+static void put_bytes(std::string& out, std::string_view s)
+{
+    put_varint(out, s.size());
+    out.append(s.data(), s.size());
+}
+
+BinaryLogEncoder::BinaryLogEncoder()
+    : base_steady_ns_(0), segment_open_(false)
+{
+}
+
+void BinaryLogEncoder::reset()
+{
+    interned_.clear();
+    storage_.clear();
+    segment_open_ = false;
+}
+
+void BinaryLogEncoder::begin_segment(std::string& out,
+                                     int64_t wall_ns,
+                                     int64_t steady_ns,
+                                     std::string_view app,
+                                     int pid)
+{
+    interned_.clear();
+    storage_.clear();
+    base_steady_ns_ = steady_ns;
+    segment_open_ = true;
+
+    out.append(BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC));
+    put_varint(out, static_cast<uint64_t>(wall_ns));
+    put_varint(out, static_cast<uint64_t>(pid));
+    put_bytes(out, app);
+}
+
+uint64_t BinaryLogEncoder::intern(std::string& out, std::string_view s)
+{
+    auto it = interned_.find(s);
+    if (it != interned_.end()) {
+        return it->second;
+    }
+    uint64_t id = interned_.size();
+    storage_.emplace_back(s);
+    interned_.emplace(std::string_view(storage_.back()), id);
+
+    out += static_cast<char>(TAG_STRING);
+    put_varint(out, id);
+    put_bytes(out, s);
+    return id;
+}
+
+void BinaryLogEncoder::append_record(std::string& out,
+                                     int64_t steady_ns,
+                                     LogLevel level,
+                                     std::string_view module,
+                                     int code,
+                                     std::string_view msg,
+                                     std::string_view src_file,
+                                     int line)
+{
+    uint64_t module_id = intern(out, module);
+    uint64_t file_id = intern(out, src_file);
+    int64_t delta = steady_ns - base_steady_ns_;
+
+    out += static_cast<char>(TAG_EVENT);
+    put_varint(out, static_cast<uint64_t>(delta < 0 ? 0 : delta));
+    out += static_cast<char>(level);
+    put_varint(out, zigzag(code));
+    put_varint(out, module_id);
+    put_varint(out, file_id);
+    put_varint(out, static_cast<uint64_t>(line < 0 ? 0 : line));
+    put_bytes(out, msg);
+}
+
+// ---------------------------------------------------------------------------
+// Binary decoder
+// ---------------------------------------------------------------------------
+
+namespace
+{
+    struct Reader
+    {
+        std::string_view data;
+        size_t pos = 0;
+
+        bool at_end() const { return pos >= data.size(); }
+
+        bool varint(uint64_t& v)
+        {
+            v = 0;
+            for (int shift = 0; shift < 64; shift += 7) {
+                if (pos >= data.size()) {
+                    return false;
+                }
+                uint8_t b = static_cast<uint8_t>(data[pos++]);
+                v |= static_cast<uint64_t>(b & 0x7F) << shift;
+                if ((b & 0x80) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        bool bytes(std::string_view& s)
+        {
+            uint64_t len;
+            if (!varint(len) || len > data.size() - pos) {
+                return false;
+            }
+            s = data.substr(pos, static_cast<size_t>(len));
+            pos += static_cast<size_t>(len);
+            return true;
+        }
+
+        bool magic()
+        {
+            if (data.size() - pos < sizeof(BINARY_LOG_MAGIC) ||
+                std::memcmp(data.data() + pos, BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC)) != 0) {
+                return false;
+            }
+            pos += sizeof(BINARY_LOG_MAGIC);
+            return true;
+        }
+    };
+}
+
+bool is_binary_log(std::string_view data)
+{
+    return data.size() >= sizeof(BINARY_LOG_MAGIC) &&
+           std::memcmp(data.data(), BINARY_LOG_MAGIC, sizeof(BINARY_LOG_MAGIC)) == 0;
+}
+
+bool decode_binary_log(std::string_view data,
+                       const std::function<void(const DecodedLogRecord&)>& on_record,
+                       std::string& err)
+{
+    Reader r{data};
+    std::vector<std::string_view> strings;
+    DecodedLogRecord rec {};
+    uint64_t base_wall_ns = 0;
+    bool in_segment = false;
+
+    while (!r.at_end()) {
+        if (r.magic()) {
+            uint64_t pid;
+            if (!r.varint(base_wall_ns) || !r.varint(pid) || !r.bytes(rec.app)) {
+                err = "truncated segment header at byte " + std::to_string(r.pos);
+                return false;
+            }
+            rec.pid = static_cast<int>(pid);
+            strings.clear();
+            in_segment = true;
+            continue;
+        }
+
+        if (!in_segment) {
+            err = "missing segment header at byte " + std::to_string(r.pos);
+            return false;
+        }
+
+        size_t record_start = r.pos;
+        uint8_t tag = static_cast<uint8_t>(data[r.pos++]);
+        if (tag == TAG_STRING) {
+            uint64_t id;
+            std::string_view s;
+            if (!r.varint(id) || !r.bytes(s) || id != strings.size()) {
+                err = "bad string definition at byte " + std::to_string(record_start);
+                return false;
+            }
+            strings.push_back(s);
+        } else if (tag == TAG_EVENT) {
+            uint64_t delta, code, module_id, file_id, line;
+            if (!r.varint(delta) || r.at_end()) {
+                err = "truncated event at byte " + std::to_string(record_start);
+                return false;
+            }
+            uint8_t level = static_cast<uint8_t>(data[r.pos++]);
+            if (!r.varint(code) || !r.varint(module_id) || !r.varint(file_id) ||
+                !r.varint(line) || !r.bytes(rec.msg) ||
+                module_id >= strings.size() || file_id >= strings.size() ||
+                level > static_cast<uint8_t>(LogLevel::fatal)) {
+                err = "bad event at byte " + std::to_string(record_start);
+                return false;
+            }
+            rec.wall_ns = static_cast<int64_t>(base_wall_ns + delta);
+            rec.level = static_cast<LogLevel>(level);
+            rec.code = static_cast<int>(unzigzag(code));
+            rec.line = static_cast<int>(line);
+            rec.module = strings[module_id];
+            rec.src_file = strings[file_id];
+            on_record(rec);
+        } else {
+            err = "unknown record tag " + std::to_string(tag) + " at byte " + std::to_string(record_start);
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace ofs
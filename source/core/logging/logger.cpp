@@ -1,9 +1,15 @@
 #include "../../include/logger.hpp" 
+#include "../../include/log_encoding.hpp"
+#include "../../include/coarse_clock.hpp"
+#include "../../include/lz_codec.hpp"
 #include <iostream>
-#include <iomanip>
-#include <sstream>
 #include <filesystem>
 #include <stdexcept>
+#include <cstring>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <vector>
 #include <sys/stat.h>
 
 #if defined(_WIN32)
@@ -12,11 +18,28 @@
 #else
     #include <unistd.h>
     #include <limits.h>
+    #include <fcntl.h>
+    #include <cerrno>
 #endif
 
 using namespace ofs;
 
 Logger::Logger() 
+    : file_opened_at_(0),
+      rotation_checked_at_(0),
+      format_(LogFormat::text),
+      encoder_(new BinaryLogEncoder()),
+      async_enabled_(false),
+      writer_stop_(false),
+      writer_idle_(false),
+      active_producers_(0),
+      dropped_records_(0),
+      min_level_(static_cast<int>(LogLevel::debug)),
+      overflow_policy_(LogOverflowPolicy::block),
+      async_capacity_(0),
+      bytes_written_(0),
+      fd_(-1),
+      archiver_stop_(false)
 {
     log_file_path_ = "./logs/ofs.log";
     
@@ -24,7 +47,7 @@ Logger::Logger()
     
     std::filesystem::create_directories(std::filesystem::path(log_file_path_).parent_path());
     
-    file_stream_.open(log_file_path_, std::ios::app);
+    open_stream();
     if (!file_stream_.is_open())
     {
         std::cerr << "fatal: logger failed to open log file: " << log_file_path_ << std::endl;
@@ -33,9 +56,11 @@ Logger::Logger()
 
 Logger::~Logger() 
 {
+    disable_async();
     if (file_stream_.is_open()) {
         file_stream_.close();
     }
+    stop_archiver();
 }
 
 Logger& Logger::get_instance() 
@@ -75,60 +100,58 @@ void Logger::initialize_app_identifier()
 void Logger::set_app_name(const std::string& name)
 {
     std::lock_guard<std::mutex> lock(mtx_);
+    bool was_async = async_enabled_.load(std::memory_order_acquire);
+    if (was_async) {
+        stop_async_locked();
+    }
     app_identifier_ = name;
+    if (was_async) {
+        start_async_locked();
+    }
 }
 
 void Logger::set_log_file(const std::string& path) 
 {
     std::lock_guard<std::mutex> lock(mtx_);
+
+    // The writer thread owns the file while async; restart it on the new path.
+    bool was_async = async_enabled_.load(std::memory_order_acquire);
+    if (was_async) {
+        stop_async_locked();
+    }
+
     if (file_stream_.is_open()) {
         file_stream_.close();
     }
     log_file_path_ = path;
     std::filesystem::create_directories(std::filesystem::path(path).parent_path());
-    file_stream_.open(log_file_path_, std::ios::app);
+    open_stream();
     if (!file_stream_.is_open()) {
         std::cerr << "CRITICAL: Failed to open new log file at " << log_file_path_ << std::endl;
     }
+
+    if (was_async) {
+        start_async_locked();
+    }
 }
 
 std::string Logger::level_to_string(LogLevel level) 
 {
-    switch (level) 
-    {
-        case LogLevel::debug: return "DEBUG";
-        case LogLevel::info:  return "INFO";
-        case LogLevel::warn:  return "WARN";
-        case LogLevel::error: return "ERROR";
-        case LogLevel::fatal: return "FATAL";
-    }
-    return "UNKNOWN";
+    return log_level_name(level);
 }
 
 std::string Logger::get_timestamp_utc() 
 {
-    auto now = std::chrono::system_clock::now();
-    auto time = std::chrono::system_clock::to_time_t(now);
-    std::tm utc {};
-
-#if defined(_WIN32)
-    gmtime_s(&utc, &time);
-#else
-    if (gmtime_r(&time, &utc) == nullptr) {}
-#endif
-    
-    std::ostringstream oss;
-    oss << std::put_time(&utc, "%Y-%m-%dT%H:%M:%SZ");
-    return oss.str();
+    return clock::utc_timestamp(clock::unix_nanos());
 }
 
+// One stat: the file is gone, or much shorter than what we wrote to it.
 bool Logger::file_was_rotated() 
 {
+#if defined(_WIN32)
     if (!std::filesystem::exists(log_file_path_)) {
         return true;
     }
-    
-#if defined(_WIN32)
     try {
         size_t current_size = std::filesystem::file_size(log_file_path_);
         auto current_pos = file_stream_.tellp();
@@ -143,15 +166,8 @@ bool Logger::file_was_rotated()
     if (stat(log_file_path_.c_str(), &current_stat) != 0) {
         return true;
     }
-    
-    try {
-        size_t disk_size = std::filesystem::file_size(log_file_path_);
-        auto stream_pos = file_stream_.tellp();
-        
-        if (stream_pos > 0 && disk_size < (std::streampos)stream_pos / 2) {
-            return true;
-        }
-    } catch (...) {
+    auto stream_pos = file_stream_.tellp();
+    if (stream_pos > 0 && current_stat.st_size < static_cast<off_t>(stream_pos) / 2) {
         return true;
     }
 #endif
@@ -159,25 +175,37 @@ bool Logger::file_was_rotated()
     return false;
 }
 
+std::string Logger::archive_path()
+{
+    // Several rotations can land in the same second; never overwrite an archive.
+    std::string base = log_file_path_ + "." + get_timestamp_utc();
+    std::string candidate = base + ".log";
+    for (int seq = 1; std::filesystem::exists(candidate) || std::filesystem::exists(candidate + ".lz"); ++seq) {
+        candidate = base + "." + std::to_string(seq) + ".log";
+    }
+    return candidate;
+}
+
+bool Logger::rotation_due() const
+{
+    if (bytes_written_ >= rotation_.max_size_bytes) {
+        return true;
+    }
+    return rotation_.max_age_seconds != 0 &&
+           clock::unix_seconds() - file_opened_at_ >= rotation_.max_age_seconds;
+}
+
 void Logger::rotate_if_needed() 
 {
     if (!file_stream_.is_open()) {
         return; 
     }
 
-    if (!std::filesystem::exists(log_file_path_)) return;
-    size_t current_size = 0;
-    try {
-        current_size = std::filesystem::file_size(log_file_path_);
-    } catch (const std::filesystem::filesystem_error& e) {
-        std::cerr << "LOG ERROR: Failed to check file size for rotation: " << e.what() << std::endl;
-        return;
-    }
-
-    if (current_size < MAX_FILE_SIZE_BYTES) return;
+    // Size is tracked as we write; no stat() per line.
+    if (!rotation_due()) return;
 
     try {
-        std::string new_path = log_file_path_ + "." + get_timestamp_utc() + ".log";
+        std::string new_path = archive_path();
         
         file_stream_.close(); 
         
@@ -186,9 +214,11 @@ void Logger::rotate_if_needed()
         
         if (ec) {
             std::cerr << "LOG WARN: Rename failed (code: " << ec.value() << ", msg: " << ec.message() << "). File possibly locked by another process." << std::endl;
+        } else {
+            queue_archive(new_path);
         }
 
-        file_stream_.open(log_file_path_, std::ios::app);
+        open_stream();
     } catch (const std::exception& e) {
         std::cerr << "LOG ERROR: Catastrophic rotation failure: " << e.what() << std::endl;
     }
@@ -201,16 +231,41 @@ void Logger::write_internal(LogLevel level,
                             const std::string& src_file,
                             int line) 
 {
-    std::lock_guard<std::mutex> lock(mtx_); 
+    if (level != LogLevel::fatal && enqueue_async(level, module, code, msg, src_file, line)) {
+        return;
+    }
+
+    // Fatal records bypass the ring: drain whatever is queued, then write
+    // the fatal line synchronously so it is on disk before std::exit.
+    if (level == LogLevel::fatal) {
+        disable_async();
+    }
+
+    std::unique_lock<std::mutex> lock(mtx_); 
+
+    // enable_async() may have won the race for the mutex.
+    if (level != LogLevel::fatal && async_enabled_.load(std::memory_order_acquire)) {
+        lock.unlock();
+        if (enqueue_async(level, module, code, msg, src_file, line)) {
+            return;
+        }
+        lock.lock();
+    }
     
     std::string level_str = level_to_string(level);
     
-    if (file_stream_.is_open() && file_was_rotated()) {
-        file_stream_.close();
+    // Only another process moves the file away, so it is looked for at
+    // most once a second rather than on every line.
+    uint64_t now = clock::unix_seconds();
+    if (file_stream_.is_open() && now != rotation_checked_at_) {
+        rotation_checked_at_ = now;
+        if (file_was_rotated()) {
+            file_stream_.close();
+        }
     }
     
     if (!file_stream_.is_open()) {
-        file_stream_.open(log_file_path_, std::ios::app);
+        open_stream();
     }
 
     if (!file_stream_.is_open()) {
@@ -222,6 +277,7 @@ void Logger::write_internal(LogLevel level,
         }
         
         if (level == LogLevel::fatal) {
+            lock.unlock();
             std::exit(code);
         }
         return;
@@ -229,20 +285,16 @@ void Logger::write_internal(LogLevel level,
     
     rotate_if_needed(); 
 
-    std::string timestamp = get_timestamp_utc();
-
     if (file_stream_.is_open()) {
-        file_stream_ << timestamp
-                   << " app=\"" << app_identifier_ << "\""
-                   << " pid=" << process_id_
-                   << " level=" << level_str
-                   << " module=" << module
-                   << " code=" << code
-                   << " msg=\"" << msg << "\""
-                   << " file=\"" << src_file << "\""
-                   << " line=" << line
-                   << "\n";
+        int64_t wall_ns = clock::unix_nanos();
+        int64_t steady_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+        std::string entry;
+        append_entry(entry, wall_ns, steady_ns, level, module.c_str(), code,
+                     msg.c_str(), src_file.c_str(), line);
+        file_stream_.write(entry.data(), static_cast<std::streamsize>(entry.size()));
         file_stream_.flush();
+        bytes_written_ += entry.size();
     }
 
     std::string console_prefix = "[" + app_identifier_ + ":" + std::to_string(process_id_) + "][" + level_str + "] ";
@@ -257,6 +309,469 @@ void Logger::write_internal(LogLevel level,
         if (file_stream_.is_open()) {
             file_stream_.close();
         }
+        // exit() runs ~Logger on this thread, which takes the mutex again.
+        lock.unlock();
         std::exit(code);
     }
-}
\ No newline at end of file
+}
+
+void Logger::open_stream()
+{
+    file_stream_.open(log_file_path_, std::ios::app | std::ios::binary);
+    encoder_->reset();
+
+    std::error_code ec;
+    auto size = std::filesystem::file_size(log_file_path_, ec);
+    bytes_written_ = ec ? 0 : static_cast<size_t>(size);
+    file_opened_at_ = clock::unix_seconds();
+    rotation_checked_at_ = file_opened_at_;
+}
+
+void Logger::set_rotation_policy(const LogRotationPolicy& policy)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    bool was_async = async_enabled_.load(std::memory_order_acquire);
+    if (was_async) {
+        stop_async_locked();
+    }
+    rotation_ = policy;
+    if (rotation_.max_size_bytes == 0) {
+        rotation_.max_size_bytes = 1;
+    }
+    if (was_async) {
+        start_async_locked();
+    }
+}
+
+void Logger::set_log_format(LogFormat format)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    bool was_async = async_enabled_.load(std::memory_order_acquire);
+    if (was_async) {
+        stop_async_locked();
+    }
+    format_ = format;
+    encoder_->reset();
+    if (was_async) {
+        start_async_locked();
+    }
+}
+
+void Logger::append_entry(std::string& out,
+                          int64_t wall_ns,
+                          int64_t steady_ns,
+                          LogLevel level,
+                          const char* module,
+                          int code,
+                          const char* msg,
+                          const char* src_file,
+                          int line)
+{
+    if (format_ == LogFormat::binary) {
+        if (!encoder_->segment_open()) {
+            encoder_->begin_segment(out, wall_ns, steady_ns, app_identifier_, process_id_);
+        }
+        encoder_->append_record(out, steady_ns, level, module, code, msg, src_file, line);
+        return;
+    }
+
+    format_text_log_line(out, wall_ns, app_identifier_, process_id_,
+                         level, module, code, msg, src_file, line);
+}
+
+// ---------------------------------------------------------------------------
+// Async backend
+// ---------------------------------------------------------------------------
+
+static void copy_field(char* dst, size_t cap, const std::string& src, bool mark_truncated)
+{
+    size_t n = src.size();
+    if (n < cap) {
+        std::memcpy(dst, src.data(), n);
+        dst[n] = '\0';
+        return;
+    }
+    n = cap - 1;
+    std::memcpy(dst, src.data(), n);
+    dst[n] = '\0';
+    if (mark_truncated && n >= 3) {
+        std::memcpy(dst + n - 3, "...", 3);
+    }
+}
+
+void Logger::enable_async(size_t capacity, LogOverflowPolicy policy)
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (async_enabled_.load(std::memory_order_acquire)) {
+        return;
+    }
+    async_capacity_ = capacity == 0 ? 1 : capacity;
+    overflow_policy_ = policy;
+    if (!start_async_locked()) {
+        std::cerr << "LOG WARN: async logging unavailable, staying synchronous." << std::endl;
+    }
+}
+
+void Logger::disable_async()
+{
+    std::lock_guard<std::mutex> lock(mtx_);
+    stop_async_locked();
+}
+
+bool Logger::start_async_locked()
+{
+    if (file_stream_.is_open()) {
+        file_stream_.close();
+    }
+
+    ring_.reset(new MpscRingBuffer<LogRecord>(async_capacity_));
+    if (!open_async_file()) {
+        ring_.reset();
+        open_stream();
+        return false;
+    }
+
+    writer_stop_.store(false, std::memory_order_release);
+    writer_thread_ = std::thread(&Logger::writer_loop, this);
+    async_enabled_.store(true, std::memory_order_seq_cst);
+    return true;
+}
+
+void Logger::stop_async_locked()
+{
+    if (!async_enabled_.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    // Close the door first, then wait for producers that already got in.
+    async_enabled_.store(false, std::memory_order_seq_cst);
+    while (active_producers_.load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+    }
+
+    writer_stop_.store(true, std::memory_order_release);
+    {
+        std::lock_guard<std::mutex> wl(wake_mtx_);
+        wake_cv_.notify_one();
+    }
+    if (writer_thread_.joinable()) {
+        writer_thread_.join();
+    }
+
+    close_async_file();
+    ring_.reset();
+}
+
+bool Logger::enqueue_async(LogLevel level,
+                           const std::string& module,
+                           int code,
+                           const std::string& msg,
+                           const std::string& src_file,
+                           int line)
+{
+    active_producers_.fetch_add(1, std::memory_order_seq_cst);
+    if (!async_enabled_.load(std::memory_order_seq_cst)) {
+        active_producers_.fetch_sub(1, std::memory_order_release);
+        return false;
+    }
+
+    LogRecord rec;
+    rec.timestamp_ns = clock::unix_nanos();
+    rec.steady_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    rec.level = level;
+    rec.code = code;
+    rec.line = line;
+    copy_field(rec.module, sizeof(rec.module), module, false);
+    copy_field(rec.src_file, sizeof(rec.src_file), src_file, false);
+    copy_field(rec.msg, sizeof(rec.msg), msg, true);
+
+    bool may_drop = overflow_policy_ == LogOverflowPolicy::drop_and_count ||
+                    (overflow_policy_ == LogOverflowPolicy::drop_debug_only && level == LogLevel::debug);
+
+    bool pushed = ring_->try_push(rec);
+    while (!pushed) {
+        if (may_drop) {
+            dropped_records_.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+        wake_cv_.notify_one();
+        std::this_thread::yield();
+        pushed = ring_->try_push(rec);
+    }
+
+    if (pushed && writer_idle_.load(std::memory_order_relaxed)) {
+        wake_cv_.notify_one();
+    }
+
+    active_producers_.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void Logger::writer_loop()
+{
+    std::string file_batch;
+    std::string out_batch;
+    std::string err_batch;
+    file_batch.reserve(ASYNC_BATCH_RECORDS * 256);
+
+    std::string console_prefix = "[" + app_identifier_ + ":" + std::to_string(process_id_) + "][";
+
+    LogRecord rec;
+    for (;;) {
+        size_t n = 0;
+        while (n < ASYNC_BATCH_RECORDS && ring_->try_pop(rec)) {
+            std::string level_str = level_to_string(rec.level);
+
+            append_entry(file_batch, rec.timestamp_ns, rec.steady_ns, rec.level,
+                         rec.module, rec.code, rec.msg, rec.src_file, rec.line);
+
+            std::string& console = (rec.level == LogLevel::error || rec.level == LogLevel::fatal)
+                                   ? err_batch : out_batch;
+            console += console_prefix;
+            console += level_str;
+            console += "] ";
+            console += rec.msg;
+            console += '\n';
+            ++n;
+        }
+
+        if (n > 0) {
+            write_batch(file_batch, out_batch, err_batch);
+            file_batch.clear();
+            out_batch.clear();
+            err_batch.clear();
+            continue;
+        }
+
+        // Every producer has left before writer_stop_ is raised, so an empty
+        // ring at this point really is the end of the stream.
+        if (writer_stop_.load(std::memory_order_acquire)) {
+            if (ring_->size_approx() == 0) {
+                break;
+            }
+            continue;
+        }
+
+        std::unique_lock<std::mutex> wl(wake_mtx_);
+        writer_idle_.store(true, std::memory_order_relaxed);
+        // A producer can miss the idle flag; the timeout bounds that latency.
+        wake_cv_.wait_for(wl, std::chrono::milliseconds(10));
+        writer_idle_.store(false, std::memory_order_relaxed);
+    }
+}
+
+#if !defined(_WIN32)
+static void write_all(int fd, const char* data, size_t len)
+{
+    while (len > 0) {
+        ssize_t n = ::write(fd, data, len);
+        if (n < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        data += n;
+        len -= static_cast<size_t>(n);
+    }
+}
+#endif
+
+void Logger::write_batch(const std::string& file_batch,
+                         const std::string& out_batch,
+                         const std::string& err_batch)
+{
+#if defined(_WIN32)
+    if (file_stream_.is_open()) {
+        file_stream_.write(file_batch.data(), static_cast<std::streamsize>(file_batch.size()));
+        file_stream_.flush();
+    }
+    std::cout << out_batch << std::flush;
+    std::cerr << err_batch << std::flush;
+#else
+    if (fd_ >= 0) {
+        write_all(fd_, file_batch.data(), file_batch.size());
+    }
+    write_all(STDOUT_FILENO, out_batch.data(), out_batch.size());
+    write_all(STDERR_FILENO, err_batch.data(), err_batch.size());
+#endif
+
+    // Size is tracked locally; no stat() on the hot path.
+    bytes_written_ += file_batch.size();
+    if (rotation_due()) {
+        rotate_async_file();
+    }
+}
+
+bool Logger::open_async_file()
+{
+    std::error_code ec;
+    std::filesystem::create_directories(std::filesystem::path(log_file_path_).parent_path(), ec);
+
+#if defined(_WIN32)
+    file_stream_.open(log_file_path_, std::ios::app | std::ios::binary);
+    if (!file_stream_.is_open()) {
+        return false;
+    }
+    encoder_->reset();
+#else
+    fd_ = ::open(log_file_path_.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        return false;
+    }
+    encoder_->reset();
+#endif
+
+    auto size = std::filesystem::file_size(log_file_path_, ec);
+    bytes_written_ = ec ? 0 : static_cast<size_t>(size);
+    file_opened_at_ = clock::unix_seconds();
+    return true;
+}
+
+void Logger::close_async_file()
+{
+#if defined(_WIN32)
+    if (file_stream_.is_open()) {
+        file_stream_.close();
+    }
+#else
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+#endif
+}
+
+void Logger::rotate_async_file()
+{
+    close_async_file();
+
+    std::string new_path = archive_path();
+    std::error_code ec;
+    std::filesystem::rename(log_file_path_, new_path, ec);
+    if (ec) {
+        std::cerr << "LOG WARN: Rename failed (code: " << ec.value() << ", msg: " << ec.message() << ")." << std::endl;
+    } else {
+        queue_archive(new_path);
+    }
+
+    if (!open_async_file()) {
+        std::cerr << "LOG ERROR: Failed to reopen log file after rotation: " << log_file_path_ << std::endl;
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Archiver
+// ---------------------------------------------------------------------------
+
+void Logger::queue_archive(const std::string& archived)
+{
+    std::lock_guard<std::mutex> lock(archive_mtx_);
+    archive_queue_.push_back(ArchiveJob{archived, log_file_path_, rotation_});
+    if (!archiver_thread_.joinable()) {
+        archiver_stop_ = false;
+        archiver_thread_ = std::thread(&Logger::archiver_loop, this);
+    }
+    archive_cv_.notify_one();
+}
+
+void Logger::stop_archiver()
+{
+    {
+        std::lock_guard<std::mutex> lock(archive_mtx_);
+        archiver_stop_ = true;
+        archive_cv_.notify_one();
+    }
+    if (archiver_thread_.joinable()) {
+        archiver_thread_.join();
+    }
+}
+
+void Logger::archiver_loop()
+{
+    for (;;) {
+        ArchiveJob job;
+        {
+            std::unique_lock<std::mutex> lock(archive_mtx_);
+            archive_cv_.wait(lock, [this] { return archiver_stop_ || !archive_queue_.empty(); });
+            // Pending jobs are still finished on shutdown.
+            if (archive_queue_.empty()) {
+                return;
+            }
+            job = std::move(archive_queue_.front());
+            archive_queue_.pop_front();
+        }
+        process_archive(job);
+    }
+}
+
+void Logger::process_archive(const ArchiveJob& job)
+{
+    namespace fs = std::filesystem;
+    std::error_code ec;
+
+    if (job.policy.compress) {
+        std::ifstream is(job.archive_path, std::ios::binary);
+        if (is) {
+            std::string raw((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+            is.close();
+            // Keep the rotation time so retention still orders archives correctly.
+            auto rotated_at = fs::last_write_time(job.archive_path, ec);
+
+            std::string packed;
+            lz::compress(raw, packed);
+
+            std::string tmp_path = job.archive_path + ".lz.tmp";
+            std::ofstream os(tmp_path, std::ios::binary | std::ios::trunc);
+            os.write(packed.data(), static_cast<std::streamsize>(packed.size()));
+            os.close();
+            if (os) {
+                fs::last_write_time(tmp_path, rotated_at, ec);
+                fs::rename(tmp_path, job.archive_path + ".lz", ec);
+                if (!ec) {
+                    fs::remove(job.archive_path, ec);
+                }
+            } else {
+                fs::remove(tmp_path, ec);
+                std::cerr << "LOG WARN: Failed to compress archive " << job.archive_path << std::endl;
+            }
+        }
+    }
+
+    if (job.policy.max_archives == 0) {
+        return;
+    }
+
+    // Archives are "<active>.<timestamp>[.<seq>].log[.lz]" next to the active file.
+    fs::path active(job.active_path);
+    fs::path dir = active.parent_path().empty() ? fs::path(".") : active.parent_path();
+    std::string prefix = active.filename().string() + ".";
+
+    std::vector<std::pair<fs::file_time_type, fs::path>> archives;
+    for (const auto& entry : fs::directory_iterator(dir, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+        bool is_archive = (name.size() > 4 && name.compare(name.size() - 4, 4, ".log") == 0) ||
+                          (name.size() > 7 && name.compare(name.size() - 7, 7, ".log.lz") == 0);
+        if (!is_archive) {
+            continue;
+        }
+        std::error_code tec;
+        auto mtime = entry.last_write_time(tec);
+        if (!tec) {
+            archives.emplace_back(mtime, entry.path());
+        }
+    }
+
+    if (archives.size() <= job.policy.max_archives) {
+        return;
+    }
+    std::sort(archives.begin(), archives.end());
+    size_t excess = archives.size() - job.policy.max_archives;
+    for (size_t i = 0; i < excess; ++i) {
+        fs::remove(archives[i].second, ec);
+    }
+}
@@ -0,0 +1,580 @@
+#include "../../include/password_hasher.hpp"
+#include "../../include/coarse_clock.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <random>
+
+#include <sys/random.h>
+
+#define MODULE_NAME "PASSWORD_HASHER"
+
+namespace ofs::security
+{
+    static constexpr uint32_t K[64] = {
+        0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+        0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+        0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+        0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+        0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+        0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+        0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+        0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2};
+
+    static constexpr uint32_t H0[8] = {
+        0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19};
+
+    // Offsets in UserInfo::reserved.
+    static constexpr size_t RECORD_SALT = 0;
+    static constexpr size_t RECORD_ITERATIONS = 16;
+    static constexpr size_t RECORD_SCHEME = 20;
+
+    // Lane types for the multi-buffer core. The same code runs on a plain
+    // uint32_t (one buffer), 4 x 32-bit SSE2 and 8 x 32-bit AVX2 vectors.
+    typedef uint32_t v4u __attribute__((vector_size(16)));
+    typedef uint32_t v8u __attribute__((vector_size(32)));
+
+#define OFS_INLINE inline __attribute__((always_inline))
+
+    // A macro rather than a function: V is never passed or returned by
+    // value, so the AVX2 instantiation does not depend on the vector ABI.
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+    template <typename V>
+    static OFS_INLINE uint32_t& lane(V& v, size_t j)
+    {
+        return reinterpret_cast<uint32_t*>(&v)[j];
+    }
+
+    // One SHA-256 compression per lane. w holds the 16 message words of each
+    // lane's block, already in host order.
+    template <typename V>
+    static OFS_INLINE void compress_words(V state[8], const V block[16])
+    {
+        V w[64];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = block[i];
+        }
+        for (int i = 16; i < 64; ++i) {
+            V s0 = ROTR(w[i - 15], 7) ^ ROTR(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            V s1 = ROTR(w[i - 2], 17) ^ ROTR(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+
+        V a = state[0], b = state[1], c = state[2], d = state[3];
+        V e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            V t1 = h + (ROTR(e, 6) ^ ROTR(e, 11) ^ ROTR(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            V t2 = (ROTR(a, 2) ^ ROTR(a, 13) ^ ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g;
+            g = f;
+            f = e;
+            e = d + t1;
+            d = c;
+            c = b;
+            b = a;
+            a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+
+    static inline uint32_t load_be32(const uint8_t* p)
+    {
+        return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16) |
+               (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+    }
+
+    static inline void store_be32(uint8_t* p, uint32_t v)
+    {
+        p[0] = static_cast<uint8_t>(v >> 24);
+        p[1] = static_cast<uint8_t>(v >> 16);
+        p[2] = static_cast<uint8_t>(v >> 8);
+        p[3] = static_cast<uint8_t>(v);
+    }
+
+    static void compress_block(uint32_t state[8], const uint8_t block[64])
+    {
+        uint32_t w[16];
+        for (int i = 0; i < 16; ++i) {
+            w[i] = load_be32(block + i * 4);
+        }
+        compress_words<uint32_t>(state, w);
+    }
+
+    // Hashes data into state, which has already absorbed prefix_len bytes in
+    // whole blocks, then pads and writes the digest.
+    static void sha256_finish(uint32_t state[8], const uint8_t* data, size_t len, uint64_t prefix_len,
+                              uint8_t out[SHA256_DIGEST_SIZE])
+    {
+        size_t full = len / 64;
+        for (size_t i = 0; i < full; ++i) {
+            compress_block(state, data + i * 64);
+        }
+
+        // Final one or two blocks: the tail, 0x80, zero padding and the bit length.
+        uint8_t tail[128] = {};
+        size_t rest = len - full * 64;
+        std::memcpy(tail, data + full * 64, rest);
+        tail[rest] = 0x80;
+        size_t tail_len = rest + 1 + 8 <= 64 ? 64 : 128;
+        uint64_t bits = (prefix_len + static_cast<uint64_t>(len)) * 8;
+        for (int i = 0; i < 8; ++i) {
+            tail[tail_len - 1 - i] = static_cast<uint8_t>(bits >> (i * 8));
+        }
+        compress_block(state, tail);
+        if (tail_len == 128) {
+            compress_block(state, tail + 64);
+        }
+
+        for (int i = 0; i < 8; ++i) {
+            store_be32(out + i * 4, state[i]);
+        }
+    }
+
+    void sha256(const uint8_t* data, size_t len, uint8_t out[SHA256_DIGEST_SIZE])
+    {
+        uint32_t state[8];
+        std::memcpy(state, H0, sizeof(state));
+        sha256_finish(state, data, len, 0, out);
+    }
+
+    static void to_hex(const uint8_t* digest, char* out)
+    {
+        static constexpr char HEX[] = "0123456789abcdef";
+        for (size_t i = 0; i < SHA256_DIGEST_SIZE; ++i) {
+            out[i * 2] = HEX[digest[i] >> 4];
+            out[i * 2 + 1] = HEX[digest[i] & 0x0F];
+        }
+    }
+
+    std::string sha256_hex(std::string_view data)
+    {
+        uint8_t digest[SHA256_DIGEST_SIZE];
+        sha256(reinterpret_cast<const uint8_t*>(data.data()), data.size(), digest);
+        std::string out(PASSWORD_HASH_HEX_SIZE, '\0');
+        to_hex(digest, &out[0]);
+        return out;
+    }
+
+    // HMAC-SHA256 key schedule: the states after absorbing key ^ ipad and
+    // key ^ opad, reused for every iteration.
+    static void hmac_states(std::string_view key, uint32_t inner[8], uint32_t outer[8])
+    {
+        uint8_t k[64] = {};
+        if (key.size() > 64) {
+            sha256(reinterpret_cast<const uint8_t*>(key.data()), key.size(), k);
+        } else {
+            std::memcpy(k, key.data(), key.size());
+        }
+
+        uint8_t pad[64];
+        std::memcpy(inner, H0, sizeof(H0));
+        for (int i = 0; i < 64; ++i) {
+            pad[i] = k[i] ^ 0x36;
+        }
+        compress_block(inner, pad);
+        std::memcpy(outer, H0, sizeof(H0));
+        for (int i = 0; i < 64; ++i) {
+            pad[i] = k[i] ^ 0x5c;
+        }
+        compress_block(outer, pad);
+    }
+
+    // PBKDF2 over the lanes of V; every job in jobs[0..n) has the same
+    // iteration count. Lanes past n repeat the last job and are discarded.
+    template <typename V>
+    static OFS_INLINE void pbkdf2_lanes(Pbkdf2Job* jobs, size_t n)
+    {
+        constexpr size_t L = sizeof(V) / sizeof(uint32_t);
+        V inner[8], outer[8], u[8], t[8];
+
+        for (size_t j = 0; j < L; ++j) {
+            Pbkdf2Job& job = jobs[j < n ? j : n - 1];
+            uint32_t is[8], os[8];
+            hmac_states(job.password, is, os);
+
+            // U1 = HMAC(password, salt || INT(1)).
+            std::vector<uint8_t> msg(job.salt, job.salt + job.salt_len);
+            msg.insert(msg.end(), {0, 0, 0, 1});
+            uint8_t digest[SHA256_DIGEST_SIZE];
+            uint32_t s[8];
+            std::memcpy(s, is, sizeof(s));
+            sha256_finish(s, msg.data(), msg.size(), 64, digest);
+            std::memcpy(s, os, sizeof(s));
+            sha256_finish(s, digest, sizeof(digest), 64, digest);
+
+            for (int i = 0; i < 8; ++i) {
+                lane(inner[i], j) = is[i];
+                lane(outer[i], j) = os[i];
+                lane(u[i], j) = load_be32(digest + i * 4);
+                lane(t[i], j) = lane(u[i], j);
+            }
+        }
+
+        // Each further U is HMAC(password, U_prev): a 32-byte message after
+        // a 64-byte key block, so both hashes are one padded block.
+        V block[16];
+        for (int i = 8; i < 16; ++i) {
+            block[i] = V{} + (i == 8 ? 0x80000000u : i == 15 ? 768u : 0u);
+        }
+        uint32_t iterations = jobs[0].iterations;
+        for (uint32_t it = 1; it < iterations; ++it) {
+            V s[8];
+            for (int i = 0; i < 8; ++i) {
+                block[i] = u[i];
+                s[i] = inner[i];
+            }
+            compress_words<V>(s, block);
+            for (int i = 0; i < 8; ++i) {
+                block[i] = s[i];
+                u[i] = outer[i];
+            }
+            compress_words<V>(u, block);
+            for (int i = 0; i < 8; ++i) {
+                t[i] ^= u[i];
+            }
+        }
+
+        for (size_t j = 0; j < n && j < L; ++j) {
+            for (int i = 0; i < 8; ++i) {
+                store_be32(jobs[j].out + i * 4, lane(t[i], j));
+            }
+        }
+    }
+
+    static void pbkdf2_x1(Pbkdf2Job* jobs, size_t n)
+    {
+        pbkdf2_lanes<uint32_t>(jobs, n);
+    }
+
+    static void pbkdf2_x4(Pbkdf2Job* jobs, size_t n)
+    {
+        pbkdf2_lanes<v4u>(jobs, n);
+    }
+
+    __attribute__((target("avx2"))) static void pbkdf2_x8(Pbkdf2Job* jobs, size_t n)
+    {
+        pbkdf2_lanes<v8u>(jobs, n);
+    }
+
+    size_t sha256_lanes()
+    {
+        static const size_t lanes = __builtin_cpu_supports("avx2") ? 8 : 4;
+        return lanes;
+    }
+
+    void pbkdf2_sha256(Pbkdf2Job& job)
+    {
+        pbkdf2_sha256_batch(&job, 1);
+    }
+
+    void pbkdf2_sha256_batch(Pbkdf2Job* jobs, size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            jobs[i].iterations = std::max<uint32_t>(jobs[i].iterations, 1);
+        }
+
+        // Group equal iteration counts so lanes finish together.
+        std::vector<Pbkdf2Job*> order(count);
+        for (size_t i = 0; i < count; ++i) {
+            order[i] = &jobs[i];
+        }
+        std::stable_sort(order.begin(), order.end(),
+                         [](const Pbkdf2Job* a, const Pbkdf2Job* b) { return a->iterations < b->iterations; });
+
+        size_t width = sha256_lanes();
+        std::vector<Pbkdf2Job> group;
+        size_t i = 0;
+        while (i < count) {
+            size_t end = i + 1;
+            while (end < count && end - i < width && order[end]->iterations == order[i]->iterations) {
+                ++end;
+            }
+            group.clear();
+            for (size_t k = i; k < end; ++k) {
+                group.push_back(*order[k]);
+            }
+
+            size_t n = group.size();
+            if (n == 1) {
+                pbkdf2_x1(group.data(), n);
+            } else if (n <= 4) {
+                pbkdf2_x4(group.data(), n);
+            } else {
+                pbkdf2_x8(group.data(), n);
+            }
+            for (size_t k = 0; k < n; ++k) {
+                std::memcpy(order[i + k]->out, group[k].out, SHA256_DIGEST_SIZE);
+            }
+            i = end;
+        }
+    }
+
+    void random_bytes(uint8_t* out, size_t len)
+    {
+        size_t got = 0;
+        while (got < len) {
+            ssize_t n = ::getrandom(out + got, len - got, 0);
+            if (n <= 0) {
+                break;
+            }
+            got += static_cast<size_t>(n);
+        }
+        if (got < len) {
+            std::random_device rd;
+            for (; got < len; ++got) {
+                out[got] = static_cast<uint8_t>(rd());
+            }
+        }
+    }
+
+    static HashScheme record_scheme(const UserInfo& u)
+    {
+        return static_cast<HashScheme>(u.reserved[RECORD_SCHEME]);
+    }
+
+    static uint32_t record_iterations(const UserInfo& u)
+    {
+        uint32_t v;
+        std::memcpy(&v, u.reserved + RECORD_ITERATIONS, sizeof(v));
+        return v;
+    }
+
+    void make_password_record(std::string_view password, uint32_t iterations, UserInfo& u)
+    {
+        iterations = std::max<uint32_t>(iterations, 1);
+        random_bytes(u.reserved + RECORD_SALT, PASSWORD_SALT_SIZE);
+        std::memcpy(u.reserved + RECORD_ITERATIONS, &iterations, sizeof(iterations));
+        u.reserved[RECORD_SCHEME] = static_cast<uint8_t>(HashScheme::pbkdf2_sha256);
+
+        Pbkdf2Job job{password, u.reserved + RECORD_SALT, PASSWORD_SALT_SIZE, iterations, {}};
+        pbkdf2_sha256(job);
+        to_hex(job.out, u.password_hash);
+    }
+
+    static bool same_hash(const uint8_t* digest, const char stored[PASSWORD_HASH_HEX_SIZE])
+    {
+        char computed[PASSWORD_HASH_HEX_SIZE];
+        to_hex(digest, computed);
+        uint8_t diff = 0;
+        for (size_t i = 0; i < PASSWORD_HASH_HEX_SIZE; ++i) {
+            diff |= static_cast<uint8_t>(computed[i] ^ stored[i]);
+        }
+        return diff == 0;
+    }
+
+    bool verify_password(std::string_view password, const UserInfo& u)
+    {
+        uint8_t digest[SHA256_DIGEST_SIZE];
+        switch (record_scheme(u)) {
+        case HashScheme::sha256:
+            sha256(reinterpret_cast<const uint8_t*>(password.data()), password.size(), digest);
+            return same_hash(digest, u.password_hash);
+        case HashScheme::pbkdf2_sha256: {
+            Pbkdf2Job job{password, u.reserved + RECORD_SALT, PASSWORD_SALT_SIZE, record_iterations(u), {}};
+            pbkdf2_sha256(job);
+            return same_hash(job.out, u.password_hash);
+        }
+        }
+        return false;
+    }
+
+    bool needs_rehash(const UserInfo& u, uint32_t iterations)
+    {
+        return record_scheme(u) != HashScheme::pbkdf2_sha256 || record_iterations(u) != std::max<uint32_t>(iterations, 1);
+    }
+
+    PasswordHasher::PasswordHasher()
+        : iterations_(DEFAULT_HASH_ITERATIONS), cache_ttl_(0), stopping_(false), cache_hits_(0)
+    {
+        random_bytes(cache_key_, sizeof(cache_key_));
+    }
+
+    PasswordHasher::~PasswordHasher()
+    {
+        stop();
+    }
+
+    void PasswordHasher::start(uint32_t iterations, uint32_t threads, uint32_t cache_ttl)
+    {
+        stop();
+
+        iterations_ = std::max<uint32_t>(iterations, 1);
+        cache_ttl_ = cache_ttl;
+        if (threads == 0) {
+            threads = std::max(1u, std::thread::hardware_concurrency());
+        }
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            stopping_ = false;
+        }
+        for (uint32_t i = 0; i < threads; ++i) {
+            workers_.emplace_back(&PasswordHasher::worker_loop, this);
+        }
+        LOG_INFO(MODULE_NAME, 10, "hashing pool: {} threads, {} lanes, {} iterations, cache ttl {}s",
+                 threads, sha256_lanes(), iterations_, cache_ttl_);
+    }
+
+    void PasswordHasher::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            stopping_ = true;
+        }
+        queue_cv_.notify_all();
+        for (std::thread& t : workers_) {
+            t.join();
+        }
+        workers_.clear();
+
+        std::lock_guard<std::mutex> lock(cache_mtx_);
+        cache_.clear();
+    }
+
+    void PasswordHasher::hash(std::string_view password, UserInfo& u) const
+    {
+        make_password_record(password, iterations_, u);
+    }
+
+    void PasswordHasher::cache_tag(const std::string& password, const UserInfo& record,
+                                   uint8_t out[SHA256_DIGEST_SIZE]) const
+    {
+        std::string msg(reinterpret_cast<const char*>(cache_key_), sizeof(cache_key_));
+        msg.append(reinterpret_cast<const char*>(record.reserved + RECORD_SALT), PASSWORD_SALT_SIZE);
+        msg.append(password);
+        sha256(reinterpret_cast<const uint8_t*>(msg.data()), msg.size(), out);
+    }
+
+    bool PasswordHasher::cache_lookup(const std::string& username, const std::string& password, const UserInfo& record)
+    {
+        if (cache_ttl_ == 0) {
+            return false;
+        }
+        uint8_t tag[SHA256_DIGEST_SIZE];
+        cache_tag(password, record, tag);
+
+        std::lock_guard<std::mutex> lock(cache_mtx_);
+        auto it = cache_.find(username);
+        if (it == cache_.end()) {
+            return false;
+        }
+        const CacheEntry& e = it->second;
+        if (e.expires <= clock::unix_seconds() ||
+            std::memcmp(e.record, record.password_hash, PASSWORD_HASH_HEX_SIZE) != 0) {
+            cache_.erase(it);
+            return false;
+        }
+        if (std::memcmp(e.tag, tag, sizeof(tag)) != 0) {
+            return false;
+        }
+        ++cache_hits_;
+        return true;
+    }
+
+    void PasswordHasher::cache_store(const std::string& username, const std::string& password, const UserInfo& record)
+    {
+        if (cache_ttl_ == 0) {
+            return;
+        }
+        CacheEntry e;
+        cache_tag(password, record, e.tag);
+        std::memcpy(e.record, record.password_hash, PASSWORD_HASH_HEX_SIZE);
+        e.expires = clock::unix_seconds() + cache_ttl_;
+
+        std::lock_guard<std::mutex> lock(cache_mtx_);
+        cache_[username] = e;
+    }
+
+    void PasswordHasher::forget(const std::string& username)
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx_);
+        cache_.erase(username);
+    }
+
+    uint64_t PasswordHasher::cache_hits() const
+    {
+        std::lock_guard<std::mutex> lock(cache_mtx_);
+        return cache_hits_;
+    }
+
+    void PasswordHasher::verify_async(const std::string& username, const std::string& password,
+                                      const UserInfo& record, Callback done)
+    {
+        if (cache_lookup(username, password, record)) {
+            done(true);
+            return;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            if (!workers_.empty() && !stopping_) {
+                queue_.push_back(Request{username, password, record, std::move(done)});
+                queue_cv_.notify_one();
+                return;
+            }
+        }
+
+        bool ok = verify_password(password, record);
+        if (ok) {
+            cache_store(username, password, record);
+        }
+        done(ok);
+    }
+
+    bool PasswordHasher::verify(const std::string& username, const std::string& password, const UserInfo& record)
+    {
+        std::promise<bool> result;
+        std::future<bool> f = result.get_future();
+        verify_async(username, password, record, [&result](bool ok) { result.set_value(ok); });
+        return f.get();
+    }
+
+    void PasswordHasher::worker_loop()
+    {
+        std::vector<Request> batch;
+        std::vector<Pbkdf2Job> jobs;
+        std::vector<size_t> job_of;
+        for (;;) {
+            batch.clear();
+            {
+                std::unique_lock<std::mutex> lock(queue_mtx_);
+                queue_cv_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+                if (queue_.empty()) {
+                    return;
+                }
+                size_t take = std::min(queue_.size(), sha256_lanes());
+                for (size_t i = 0; i < take; ++i) {
+                    batch.push_back(std::move(queue_.front()));
+                    queue_.pop_front();
+                }
+            }
+
+            // PBKDF2 records are hashed together; legacy ones one by one.
+            jobs.clear();
+            job_of.assign(batch.size(), SIZE_MAX);
+            for (size_t i = 0; i < batch.size(); ++i) {
+                const UserInfo& r = batch[i].record;
+                if (record_scheme(r) == HashScheme::pbkdf2_sha256) {
+                    job_of[i] = jobs.size();
+                    jobs.push_back(Pbkdf2Job{batch[i].password, r.reserved + RECORD_SALT, PASSWORD_SALT_SIZE,
+                                             record_iterations(r), {}});
+                }
+            }
+            pbkdf2_sha256_batch(jobs.data(), jobs.size());
+
+            for (size_t i = 0; i < batch.size(); ++i) {
+                Request& req = batch[i];
+                bool ok = job_of[i] != SIZE_MAX ? same_hash(jobs[job_of[i]].out, req.record.password_hash)
+                                                : verify_password(req.password, req.record);
+                if (ok) {
+                    cache_store(req.username, req.password, req.record);
+                }
+                req.done(ok);
+            }
+        }
+    }
+}
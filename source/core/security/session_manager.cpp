@@ -0,0 +1,239 @@
+#include "../../include/session_manager.hpp"
+#include "../../include/password_hasher.hpp"
+#include "../../include/coarse_clock.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <cstring>
+
+#define MODULE_NAME "SESSION_MANAGER"
+
+namespace ofs::security
+{
+    SessionManager::SessionManager() : capacity_(0), idle_timeout_(0)
+    {
+    }
+
+    void SessionManager::init(uint32_t capacity, uint32_t idle_timeout)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        capacity_ = capacity;
+        idle_timeout_ = idle_timeout;
+        slots_.reset(new SessionSlot[capacity]);
+        for (uint32_t i = 0; i < capacity; ++i) {
+            slots_[i].secret.store(0, std::memory_order_relaxed);
+            slots_[i].generation.store(0, std::memory_order_relaxed);
+            slots_[i].operations.store(0, std::memory_order_relaxed);
+            slots_[i].last_activity.store(0, std::memory_order_relaxed);
+            slots_[i].role.store(0, std::memory_order_relaxed);
+        }
+        infos_.assign(capacity, SessionInfo{});
+        free_.clear();
+        for (uint32_t i = capacity; i-- > 0;) {
+            free_.push_back(i);
+        }
+        wheel_.reset(capacity, clock::unix_seconds());
+        LOG_INFO(MODULE_NAME, 10, "session slab: {} slots, idle timeout {}s", capacity, idle_timeout);
+    }
+
+    bool SessionManager::parse_token(std::string_view session_id, SessionToken& out)
+    {
+        if (session_id.size() != SESSION_TOKEN_HEX_SIZE) {
+            return false;
+        }
+        uint64_t words[2] = {0, 0};
+        for (size_t i = 0; i < SESSION_TOKEN_HEX_SIZE; ++i) {
+            char c = session_id[i];
+            uint64_t digit;
+            if (c >= '0' && c <= '9') {
+                digit = static_cast<uint64_t>(c - '0');
+            } else if (c >= 'a' && c <= 'f') {
+                digit = static_cast<uint64_t>(c - 'a' + 10);
+            } else {
+                return false;
+            }
+            words[i / 16] = (words[i / 16] << 4) | digit;
+        }
+        out.secret = words[0];
+        out.handle = words[1];
+        return true;
+    }
+
+    void SessionManager::format_token(const SessionToken& token, char out[SESSION_TOKEN_HEX_SIZE])
+    {
+        static constexpr char HEX[] = "0123456789abcdef";
+        for (int i = 0; i < 16; ++i) {
+            out[i] = HEX[(token.secret >> (60 - i * 4)) & 0x0F];
+            out[16 + i] = HEX[(token.handle >> (60 - i * 4)) & 0x0F];
+        }
+    }
+
+    bool SessionManager::matches(const SessionToken& token, uint32_t& slot) const
+    {
+        slot = static_cast<uint32_t>(token.handle);
+        if (slot >= capacity_ || token.secret == 0) {
+            return false;
+        }
+        const SessionSlot& s = slots_[slot];
+        return s.secret.load(std::memory_order_acquire) == token.secret &&
+               s.generation.load(std::memory_order_relaxed) == static_cast<uint32_t>(token.handle >> 32);
+    }
+
+    OFSErrorCodes SessionManager::create(const UserInfo& user, SessionInfo& out)
+    {
+        uint64_t now = clock::unix_seconds();
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (free_.empty()) {
+            LOG_WARN(MODULE_NAME, 101, "session slab full ({} sessions), login of '{}' refused", capacity_,
+                     user.username);
+            return OFSErrorCodes::ERROR_NO_SPACE;
+        }
+
+        uint32_t slot = free_.back();
+        free_.pop_back();
+        SessionSlot& s = slots_[slot];
+
+        SessionToken token;
+        do {
+            random_bytes(reinterpret_cast<uint8_t*>(&token.secret), sizeof(token.secret));
+        } while (token.secret == 0);
+        token.handle = (static_cast<uint64_t>(s.generation.load(std::memory_order_relaxed)) << 32) | slot;
+
+        char id[SESSION_TOKEN_HEX_SIZE + 1] = {};
+        format_token(token, id);
+        SessionInfo& info = infos_[slot];
+        info = SessionInfo(id, user, now);
+        // Sessions are handed to clients; the password record stays behind.
+        std::memset(info.user.password_hash, 0, sizeof(info.user.password_hash));
+        std::memset(info.user.reserved, 0, sizeof(info.user.reserved));
+
+        s.role.store(static_cast<uint8_t>(user.role), std::memory_order_relaxed);
+        s.operations.store(0, std::memory_order_relaxed);
+        s.last_activity.store(now, std::memory_order_relaxed);
+        s.secret.store(token.secret, std::memory_order_release);
+        if (idle_timeout_ != 0) {
+            wheel_.schedule(slot, now + idle_timeout_);
+        }
+
+        out = info;
+        LOG_DEBUG(MODULE_NAME, 20, "session for '{}' in slot {}", user.username, slot);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes SessionManager::validate(const SessionToken& token, UserRole* role)
+    {
+        uint32_t slot;
+        if (!matches(token, slot)) {
+            return OFSErrorCodes::ERROR_INVALID_SESSION;
+        }
+        SessionSlot& s = slots_[slot];
+
+        // The wheel may not have reaped an idle session yet.
+        uint64_t now = clock::unix_seconds();
+        uint64_t last = s.last_activity.load(std::memory_order_relaxed);
+        if (idle_timeout_ != 0 && last + idle_timeout_ <= now) {
+            return OFSErrorCodes::ERROR_INVALID_SESSION;
+        }
+
+        if (role != nullptr) {
+            *role = static_cast<UserRole>(s.role.load(std::memory_order_relaxed));
+            // A slot reused since the first check has a new secret.
+            if (s.secret.load(std::memory_order_acquire) != token.secret) {
+                return OFSErrorCodes::ERROR_INVALID_SESSION;
+            }
+        }
+
+        if (last != now) {
+            s.last_activity.store(now, std::memory_order_relaxed);
+        }
+        s.operations.fetch_add(1, std::memory_order_relaxed);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes SessionManager::validate(std::string_view session_id, UserRole* role)
+    {
+        SessionToken token;
+        if (!parse_token(session_id, token)) {
+            return OFSErrorCodes::ERROR_INVALID_SESSION;
+        }
+        return validate(token, role);
+    }
+
+    OFSErrorCodes SessionManager::info(std::string_view session_id, SessionInfo& out) const
+    {
+        SessionToken token;
+        uint32_t slot;
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!parse_token(session_id, token) || !matches(token, slot)) {
+            return OFSErrorCodes::ERROR_INVALID_SESSION;
+        }
+        out = infos_[slot];
+        out.last_activity = slots_[slot].last_activity.load(std::memory_order_relaxed);
+        out.operations_count = slots_[slot].operations.load(std::memory_order_relaxed);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    void SessionManager::release(uint32_t slot)
+    {
+        SessionSlot& s = slots_[slot];
+        s.secret.store(0, std::memory_order_release);
+        s.generation.fetch_add(1, std::memory_order_relaxed);
+        wheel_.cancel(slot);
+        infos_[slot] = SessionInfo{};
+        free_.push_back(slot);
+    }
+
+    OFSErrorCodes SessionManager::destroy(std::string_view session_id)
+    {
+        SessionToken token;
+        uint32_t slot;
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (!parse_token(session_id, token) || !matches(token, slot)) {
+            return OFSErrorCodes::ERROR_INVALID_SESSION;
+        }
+        release(slot);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    uint32_t SessionManager::destroy_user(std::string_view username)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        uint32_t ended = 0;
+        for (uint32_t slot = 0; slot < capacity_; ++slot) {
+            if (slots_[slot].secret.load(std::memory_order_relaxed) != 0 &&
+                username == std::string_view(infos_[slot].user.username,
+                                             strnlen(infos_[slot].user.username, sizeof(UserInfo::username)))) {
+                release(slot);
+                ++ended;
+            }
+        }
+        return ended;
+    }
+
+    size_t SessionManager::expire(uint64_t now)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        due_.clear();
+        wheel_.advance(now, due_);
+
+        size_t expired = 0;
+        for (uint32_t slot : due_) {
+            uint64_t last = slots_[slot].last_activity.load(std::memory_order_relaxed);
+            if (last + idle_timeout_ > now) {
+                wheel_.schedule(slot, last + idle_timeout_);
+                continue;
+            }
+            release(slot);
+            ++expired;
+        }
+        if (expired != 0) {
+            LOG_INFO(MODULE_NAME, 11, "expired {} idle sessions ({} active)", expired, capacity_ - free_.size());
+        }
+        return expired;
+    }
+
+    uint32_t SessionManager::active() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return capacity_ - static_cast<uint32_t>(free_.size());
+    }
+}
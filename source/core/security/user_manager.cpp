@@ -0,0 +1,476 @@
+#include "../../include/user_manager.hpp"
+#include "../../include/password_hasher.hpp"
+#include "../../include/omni_container.hpp"
+#include "../../include/journal.hpp"
+#include "../../include/coarse_clock.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <cstring>
+#include <mutex>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#define MODULE_NAME "USER_MANAGER"
+
+namespace ofs::security
+{
+    static constexpr uint8_t CTRL_EMPTY = 0x80;
+    static constexpr uint8_t CTRL_DELETED = 0xFE;
+
+    static size_t index_capacity(uint32_t max_users)
+    {
+        size_t capacity = UserManager::GROUP_SIZE;
+        while (capacity < static_cast<size_t>(max_users) * 2) {
+            capacity <<= 1;
+        }
+        return capacity;
+    }
+
+    // Bit i set where group byte i equals value.
+    static inline uint32_t match_byte(const uint8_t* group, uint8_t value)
+    {
+#if defined(__SSE2__)
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(g, _mm_set1_epi8(static_cast<char>(value)))));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < UserManager::GROUP_SIZE; ++i) {
+            mask |= static_cast<uint32_t>(group[i] == value) << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Bit i set where group byte i is empty or deleted (high bit set).
+    static inline uint32_t match_free(const uint8_t* group)
+    {
+#if defined(__SSE2__)
+        __m128i g = _mm_loadu_si128(reinterpret_cast<const __m128i*>(group));
+        return static_cast<uint32_t>(_mm_movemask_epi8(g));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < UserManager::GROUP_SIZE; ++i) {
+            mask |= static_cast<uint32_t>(group[i] >> 7) << i;
+        }
+        return mask;
+#endif
+    }
+
+    UserManager::UserManager()
+        : container_(nullptr),
+          hasher_(nullptr),
+          table_(nullptr),
+          max_users_(0),
+          header_(nullptr),
+          ctrl_(nullptr),
+          hot_(nullptr),
+          free_stack_(nullptr),
+          mask_(0)
+    {
+    }
+
+    uint64_t UserManager::snapshot_bytes(uint32_t max_users)
+    {
+        uint64_t capacity = index_capacity(max_users);
+        return sizeof(UserIndexHeader) + (capacity + GROUP_SIZE) + capacity * sizeof(UserHot) +
+               static_cast<uint64_t>(max_users) * sizeof(uint32_t);
+    }
+
+    uint64_t UserManager::hash_name(std::string_view name)
+    {
+        // FNV-1a with a final avalanche so the 7 tag bits are well mixed.
+        uint64_t h = 1469598103934665603ULL;
+        for (char c : name) {
+            h ^= static_cast<uint8_t>(c);
+            h *= 1099511628211ULL;
+        }
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    std::string_view UserManager::record_name(const UserInfo& u)
+    {
+        size_t len = 0;
+        while (len < sizeof(u.username) && u.username[len] != '\0') {
+            ++len;
+        }
+        return std::string_view(u.username, len);
+    }
+
+    bool UserManager::valid_username(std::string_view username)
+    {
+        if (username.empty() || username.size() >= sizeof(UserInfo::username)) {
+            return false;
+        }
+        for (char c : username) {
+            if (c <= ' ' || c == 0x7F) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void UserManager::attach(storage::OmniContainer& container, uint8_t* storage, size_t storage_len, bool valid)
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+
+        container_ = &container;
+        table_ = container.user_table();
+        max_users_ = container.max_users();
+
+        size_t capacity = index_capacity(max_users_);
+        size_t bytes = static_cast<size_t>(snapshot_bytes(max_users_));
+        if (storage == nullptr || storage_len < bytes) {
+            local_storage_.assign(bytes, 0);
+            storage = local_storage_.data();
+            valid = false;
+        }
+        header_ = reinterpret_cast<UserIndexHeader*>(storage);
+        ctrl_ = storage + sizeof(UserIndexHeader);
+        hot_ = reinterpret_cast<UserHot*>(ctrl_ + capacity + GROUP_SIZE);
+        free_stack_ = reinterpret_cast<uint32_t*>(hot_ + capacity);
+        mask_ = capacity - 1;
+
+        if (valid && header_->capacity == capacity && header_->count <= max_users_ &&
+            header_->free_count <= max_users_) {
+            LOG_INFO(MODULE_NAME, 10, "using mapped user index: {} users, {} positions", header_->count, capacity);
+            return;
+        }
+
+        header_->capacity = static_cast<uint32_t>(capacity);
+        rebuild();
+        LOG_INFO(MODULE_NAME, 11, "indexed {} users ({} positions)", header_->count, capacity);
+    }
+
+    void UserManager::detach()
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+        container_ = nullptr;
+        table_ = nullptr;
+        max_users_ = 0;
+        header_ = nullptr;
+        ctrl_ = nullptr;
+        hot_ = nullptr;
+        free_stack_ = nullptr;
+        mask_ = 0;
+        local_storage_.clear();
+    }
+
+    void UserManager::set_hasher(PasswordHasher* hasher)
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx_);
+        hasher_ = hasher;
+    }
+
+    void UserManager::set_ctrl(size_t pos, uint8_t value)
+    {
+        ctrl_[pos] = value;
+        if (pos < GROUP_SIZE) {
+            ctrl_[mask_ + 1 + pos] = value;
+        }
+    }
+
+    // Index position of name, or SIZE_MAX. Groups are visited with
+    // triangular steps, which covers every group of a power-of-two table.
+    size_t UserManager::locate(std::string_view name, uint64_t hash) const
+    {
+        uint8_t tag = static_cast<uint8_t>(hash & 0x7F);
+        size_t pos = static_cast<size_t>(hash >> 7) & mask_;
+        for (size_t step = 0; step <= mask_; step += GROUP_SIZE) {
+            const uint8_t* group = ctrl_ + pos;
+            for (uint32_t m = match_byte(group, tag); m != 0; m &= m - 1) {
+                size_t i = (pos + static_cast<size_t>(__builtin_ctz(m))) & mask_;
+                if (hot_[i].hash == hash && record_name(table_[hot_[i].slot]) == name) {
+                    return i;
+                }
+            }
+            if (match_byte(group, CTRL_EMPTY) != 0) {
+                return SIZE_MAX;
+            }
+            pos = (pos + step + GROUP_SIZE) & mask_;
+        }
+        return SIZE_MAX;
+    }
+
+    void UserManager::place(uint64_t hash, uint32_t slot, uint8_t role)
+    {
+        size_t pos = static_cast<size_t>(hash >> 7) & mask_;
+        for (size_t step = 0;; step += GROUP_SIZE) {
+            uint32_t m = match_free(ctrl_ + pos);
+            if (m != 0) {
+                size_t i = (pos + static_cast<size_t>(__builtin_ctz(m))) & mask_;
+                if (ctrl_[i] == CTRL_DELETED) {
+                    --header_->tombstones;
+                }
+                set_ctrl(i, static_cast<uint8_t>(hash & 0x7F));
+                hot_[i] = UserHot{hash, slot, role, 1, 0};
+                ++header_->count;
+                return;
+            }
+            pos = (pos + step + GROUP_SIZE) & mask_;
+        }
+    }
+
+    void UserManager::rebuild()
+    {
+        std::memset(ctrl_, CTRL_EMPTY, mask_ + 1 + GROUP_SIZE);
+        header_->count = 0;
+        header_->tombstones = 0;
+        header_->free_count = 0;
+
+        for (uint32_t slot = max_users_; slot-- > 0;) {
+            const UserInfo& u = table_[slot];
+            std::string_view name = record_name(u);
+            if (!u.is_active || !valid_username(name)) {
+                free_stack_[header_->free_count++] = slot;
+                continue;
+            }
+            uint64_t hash = hash_name(name);
+            if (locate(name, hash) != SIZE_MAX) {
+                LOG_WARN(MODULE_NAME, 101, "duplicate user '{}' in slot {} ignored", name, slot);
+                continue;
+            }
+            place(hash, slot, static_cast<uint8_t>(u.role));
+        }
+    }
+
+    // Drops tombstones by reinserting the live positions.
+    void UserManager::rehash()
+    {
+        std::vector<UserHot> live;
+        live.reserve(header_->count);
+        for (size_t i = 0; i <= mask_; ++i) {
+            if ((ctrl_[i] & 0x80) == 0) {
+                live.push_back(hot_[i]);
+            }
+        }
+        std::memset(ctrl_, CTRL_EMPTY, mask_ + 1 + GROUP_SIZE);
+        header_->count = 0;
+        header_->tombstones = 0;
+        for (const UserHot& h : live) {
+            place(h.hash, h.slot, h.role);
+        }
+    }
+
+    OFSErrorCodes UserManager::user_create(const std::string& username, const std::string& password, UserRole role)
+    {
+        if (!valid_username(username)) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+        // The record is hashed before taking the lock; PBKDF2 is slow on purpose.
+        UserInfo record{};
+        if (hasher_ != nullptr) {
+            hasher_->hash(password, record);
+        } else {
+            make_password_record(password, DEFAULT_HASH_ITERATIONS, record);
+        }
+
+        storage::LockedTransaction<std::shared_mutex> lock(container_ != nullptr ? container_->journal() : nullptr, mtx_);
+        if (header_ == nullptr) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        uint64_t hash = hash_name(username);
+        if (locate(username, hash) != SIZE_MAX) {
+            return OFSErrorCodes::ERROR_FILE_EXISTS;
+        }
+        if (header_->free_count == 0) {
+            LOG_WARN(MODULE_NAME, 102, "user table full ({} users), cannot create '{}'", max_users_, username);
+            return OFSErrorCodes::ERROR_NO_SPACE;
+        }
+        if (header_->count + header_->tombstones + 1 > (mask_ + 1) * 7 / 8) {
+            rehash();
+        }
+
+        uint32_t slot = free_stack_[--header_->free_count];
+        UserInfo& u = table_[slot];
+        u = record;
+        std::memcpy(u.username, username.data(), username.size());
+        u.role = role;
+        u.created_time = clock::unix_seconds();
+        u.last_login = 0;
+        u.is_active = 1;
+        container_->mark_dirty(&u, sizeof(u));
+
+        place(hash, slot, static_cast<uint8_t>(role));
+        if (hasher_ != nullptr) {
+            hasher_->forget(username);
+        }
+        LOG_INFO(MODULE_NAME, 20, "created user '{}' in slot {}", username, slot);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes UserManager::user_delete(const std::string& username)
+    {
+        storage::LockedTransaction<std::shared_mutex> lock(container_ != nullptr ? container_->journal() : nullptr, mtx_);
+        if (header_ == nullptr) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        size_t pos = locate(username, hash_name(username));
+        if (pos == SIZE_MAX) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+
+        uint32_t slot = hot_[pos].slot;
+        UserInfo& u = table_[slot];
+        u.is_active = 0;
+        container_->mark_dirty(&u.is_active, sizeof(u.is_active));
+
+        set_ctrl(pos, CTRL_DELETED);
+        hot_[pos].active = 0;
+        --header_->count;
+        ++header_->tombstones;
+        free_stack_[header_->free_count++] = slot;
+        if (hasher_ != nullptr) {
+            hasher_->forget(username);
+        }
+
+        LOG_INFO(MODULE_NAME, 21, "deleted user '{}' (slot {})", username, slot);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes UserManager::lookup(const std::string& username, uint32_t& slot, UserInfo& out) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        if (header_ == nullptr) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+        size_t pos = locate(username, hash_name(username));
+        if (pos == SIZE_MAX) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        slot = hot_[pos].slot;
+        out = table_[slot];
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    // Records a verified login. Legacy or outdated password records are
+    // rehashed with the current parameters while the password is at hand.
+    OFSErrorCodes UserManager::finish_login(const std::string& username, const std::string& password, uint32_t slot,
+                                            bool ok, UserInfo& out)
+    {
+        if (!ok) {
+            LOG_WARN(MODULE_NAME, 103, "failed login for '{}'", username);
+            return OFSErrorCodes::ERROR_PERMISSION_DENIED;
+        }
+
+        uint32_t iterations = hasher_ != nullptr ? hasher_->iterations() : DEFAULT_HASH_ITERATIONS;
+        UserInfo upgraded = out;
+        bool upgrade = needs_rehash(out, iterations);
+        if (upgrade) {
+            make_password_record(password, iterations, upgraded);
+        }
+
+        // last_login is bookkeeping: the login does not wait for it to be
+        // durable.
+        storage::DeferredCommits deferred;
+        storage::LockedTransaction<std::shared_mutex> lock(container_ != nullptr ? container_->journal() : nullptr, mtx_);
+        if (header_ == nullptr) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+        UserInfo& u = table_[slot];
+        if (!u.is_active || record_name(u) != username) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        // The password was checked against out, outside the lock: a user
+        // deleted and recreated, or given a new password, meanwhile has a
+        // record it was not checked against.
+        if (std::memcmp(u.password_hash, out.password_hash, sizeof(u.password_hash)) != 0 ||
+            std::memcmp(u.reserved, out.reserved, sizeof(u.reserved)) != 0) {
+            LOG_WARN(MODULE_NAME, 103, "failed login for '{}': password record changed", username);
+            return OFSErrorCodes::ERROR_PERMISSION_DENIED;
+        }
+        if (upgrade) {
+            std::memcpy(u.password_hash, upgraded.password_hash, sizeof(u.password_hash));
+            std::memcpy(u.reserved, upgraded.reserved, sizeof(u.reserved));
+            LOG_INFO(MODULE_NAME, 22, "rehashed password record of '{}' ({} iterations)", username, iterations);
+        }
+        u.last_login = clock::unix_seconds();
+        container_->mark_dirty(&u, sizeof(u));
+        out = u;
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes UserManager::user_login(const std::string& username, const std::string& password, UserInfo& out)
+    {
+        uint32_t slot;
+        OFSErrorCodes result = lookup(username, slot, out);
+        if (result != OFSErrorCodes::SUCCESS) {
+            return result;
+        }
+
+        // Hash outside the lock; only the last_login update is exclusive.
+        bool ok = hasher_ != nullptr ? hasher_->verify(username, password, out) : verify_password(password, out);
+        return finish_login(username, password, slot, ok, out);
+    }
+
+    void UserManager::user_login_async(const std::string& username, const std::string& password, LoginCallback done)
+    {
+        uint32_t slot;
+        UserInfo record;
+        OFSErrorCodes result = lookup(username, slot, record);
+        if (result != OFSErrorCodes::SUCCESS || hasher_ == nullptr) {
+            if (result == OFSErrorCodes::SUCCESS) {
+                result = finish_login(username, password, slot, verify_password(password, record), record);
+            }
+            done(result, record);
+            return;
+        }
+
+        hasher_->verify_async(username, password, record,
+                              [this, username, password, slot, record, done = std::move(done)](bool ok) mutable {
+                                  OFSErrorCodes r = finish_login(username, password, slot, ok, record);
+                                  done(r, record);
+                              });
+    }
+
+    OFSErrorCodes UserManager::user_list(std::vector<UserInfo>& out) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        out.clear();
+        if (header_ == nullptr) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+        out.reserve(header_->count);
+        for (size_t i = 0; i <= mask_; ++i) {
+            if ((ctrl_[i] & 0x80) == 0) {
+                out.push_back(table_[hot_[i].slot]);
+            }
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes UserManager::find(const std::string& username, uint32_t& slot, UserRole* role) const
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        if (header_ == nullptr) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+        size_t pos = locate(username, hash_name(username));
+        if (pos == SIZE_MAX) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        slot = hot_[pos].slot;
+        if (role != nullptr) {
+            *role = static_cast<UserRole>(hot_[pos].role);
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    uint32_t UserManager::count() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        return header_ != nullptr ? header_->count : 0;
+    }
+
+    uint32_t UserManager::capacity() const
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx_);
+        return header_ != nullptr ? header_->capacity : 0;
+    }
+}
@@ -0,0 +1,520 @@
+#include "../../include/block_allocator.hpp"
+#include "../../include/omni_container.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#define MODULE_NAME "BLOCK_ALLOCATOR"
+
+namespace ofs::storage
+{
+    static inline int ctz64(uint64_t v)
+    {
+        return __builtin_ctzll(v);
+    }
+
+    static inline int popcount64(uint64_t v)
+    {
+        return __builtin_popcountll(v);
+    }
+
+    BlockAllocator::BlockAllocator()
+        : container_(nullptr),
+          map_(nullptr),
+          map_words_(0),
+          total_blocks_(0),
+          block_size_(0),
+          free_blocks_(0),
+          free_extents_(0)
+    {
+    }
+
+    // Header of the allocator snapshot section; the summary levels follow,
+    // lowest level first.
+    struct AllocatorSnapshot
+    {
+        uint64_t total_blocks;
+        uint64_t free_blocks;
+        uint64_t free_extents;
+        uint64_t levels;
+    };
+
+    // Word count of each summary level for a map of map_words words.
+    static std::vector<size_t> summary_shape(size_t map_words)
+    {
+        std::vector<size_t> words;
+        size_t bits = map_words;
+        do {
+            words.push_back((bits + 63) / 64);
+            bits = words.back();
+        } while (words.back() > 1);
+        return words;
+    }
+
+    uint64_t BlockAllocator::snapshot_bytes(uint64_t total_blocks)
+    {
+        uint64_t bytes = sizeof(AllocatorSnapshot);
+        for (size_t w : summary_shape(static_cast<size_t>((total_blocks + 63) / 64))) {
+            bytes += w * sizeof(uint64_t);
+        }
+        return bytes;
+    }
+
+    OFSErrorCodes BlockAllocator::attach(OmniContainer& container, const uint8_t* snapshot, size_t snapshot_len)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+
+        if (!container.is_open()) {
+            LOG_ERROR(MODULE_NAME, 301, "attach called on a closed container");
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        ByteView map = container.free_map();
+        container_ = &container;
+        map_ = reinterpret_cast<uint64_t*>(map.data);
+        total_blocks_ = container.total_blocks();
+        block_size_ = container.block_size();
+        map_words_ = static_cast<size_t>((total_blocks_ + 63) / 64);
+
+        // Bits past the last block are kept "used" so scans never return them.
+        uint64_t tail = total_blocks_ % 64;
+        if (tail != 0) {
+            uint64_t pad = ~0ULL << tail;
+            if ((map_[map_words_ - 1] & pad) != pad) {
+                map_[map_words_ - 1] |= pad;
+                container_->mark_dirty(&map_[map_words_ - 1], sizeof(uint64_t));
+            }
+        }
+
+        bool loaded = snapshot != nullptr && load_snapshot(snapshot, snapshot_len);
+        if (!loaded) {
+            build_summaries();
+        }
+
+        LOG_INFO(MODULE_NAME, 10, "attached: {} blocks, {} free in {} extents, {} summary levels ({})",
+                 total_blocks_, free_blocks_, free_extents_, summary_.size(),
+                 loaded ? "from snapshot" : "rebuilt");
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    void BlockAllocator::build_summaries()
+    {
+        free_blocks_ = 0;
+        free_extents_ = 0;
+        uint64_t prev_top = 0;
+        for (size_t w = 0; w < map_words_; ++w) {
+            uint64_t f = ~map_[w];
+            free_blocks_ += popcount64(f);
+            free_extents_ += popcount64(f & ~((f << 1) | prev_top));
+            prev_top = f >> 63;
+        }
+
+        summary_.clear();
+        summary_bits_.clear();
+        uint64_t bits = map_words_;
+        std::vector<uint64_t> level((bits + 63) / 64, 0);
+        for (size_t w = 0; w < map_words_; ++w) {
+            if (map_[w] != ~0ULL) {
+                level[w >> 6] |= 1ULL << (w & 63);
+            }
+        }
+        summary_.push_back(std::move(level));
+        summary_bits_.push_back(bits);
+
+        while (summary_.back().size() > 1) {
+            const std::vector<uint64_t>& below = summary_.back();
+            bits = below.size();
+            std::vector<uint64_t> next((bits + 63) / 64, 0);
+            for (size_t w = 0; w < below.size(); ++w) {
+                if (below[w] != 0) {
+                    next[w >> 6] |= 1ULL << (w & 63);
+                }
+            }
+            summary_.push_back(std::move(next));
+            summary_bits_.push_back(bits);
+        }
+    }
+
+    bool BlockAllocator::load_snapshot(const uint8_t* src, size_t len)
+    {
+        AllocatorSnapshot h;
+        if (len < snapshot_bytes(total_blocks_)) {
+            return false;
+        }
+        std::memcpy(&h, src, sizeof(h));
+        std::vector<size_t> shape = summary_shape(map_words_);
+        if (h.total_blocks != total_blocks_ || h.levels != shape.size() || h.free_blocks > total_blocks_) {
+            LOG_WARN(MODULE_NAME, 102, "allocator snapshot does not match the free map, rebuilding");
+            return false;
+        }
+
+        free_blocks_ = h.free_blocks;
+        free_extents_ = h.free_extents;
+        summary_.clear();
+        summary_bits_.clear();
+        const uint8_t* p = src + sizeof(h);
+        size_t bits = map_words_;
+        for (size_t words : shape) {
+            std::vector<uint64_t> level(words);
+            std::memcpy(level.data(), p, words * sizeof(uint64_t));
+            p += words * sizeof(uint64_t);
+            summary_.push_back(std::move(level));
+            summary_bits_.push_back(bits);
+            bits = words;
+        }
+        return true;
+    }
+
+    bool BlockAllocator::save_snapshot(uint8_t* dst, size_t len) const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+
+        if (map_ == nullptr || len < snapshot_bytes(total_blocks_)) {
+            return false;
+        }
+        AllocatorSnapshot h;
+        h.total_blocks = total_blocks_;
+        h.free_blocks = free_blocks_;
+        h.free_extents = free_extents_;
+        h.levels = summary_.size();
+        std::memcpy(dst, &h, sizeof(h));
+        uint8_t* p = dst + sizeof(h);
+        for (const std::vector<uint64_t>& level : summary_) {
+            std::memcpy(p, level.data(), level.size() * sizeof(uint64_t));
+            p += level.size() * sizeof(uint64_t);
+        }
+        return true;
+    }
+
+    void BlockAllocator::detach()
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        container_ = nullptr;
+        map_ = nullptr;
+        map_words_ = 0;
+        total_blocks_ = 0;
+        free_blocks_ = 0;
+        free_extents_ = 0;
+        summary_.clear();
+        summary_bits_.clear();
+    }
+
+    bool BlockAllocator::bit_free(uint64_t bit) const
+    {
+        return (map_[bit >> 6] & (1ULL << (bit & 63))) == 0;
+    }
+
+    // Next set bit at or after from in summary_[level], or npos.
+    uint64_t BlockAllocator::next_summary_bit(size_t level, uint64_t from) const
+    {
+        if (from >= summary_bits_[level]) {
+            return npos;
+        }
+        const std::vector<uint64_t>& s = summary_[level];
+        uint64_t w = from >> 6;
+        uint64_t bits = s[w] & (~0ULL << (from & 63));
+        if (bits != 0) {
+            return (w << 6) + ctz64(bits);
+        }
+        if (level + 1 == summary_.size()) {
+            return npos;
+        }
+        uint64_t next_word = next_summary_bit(level + 1, w + 1);
+        if (next_word == npos) {
+            return npos;
+        }
+        return (next_word << 6) + ctz64(s[next_word]);
+    }
+
+    // Next free block bit at or after from, or npos.
+    uint64_t BlockAllocator::next_free(uint64_t from) const
+    {
+        if (from >= total_blocks_) {
+            return npos;
+        }
+        uint64_t w = from >> 6;
+        uint64_t bits = ~map_[w] & (~0ULL << (from & 63));
+        if (bits == 0) {
+            w = next_summary_bit(0, w + 1);
+            if (w == npos) {
+                return npos;
+            }
+            bits = ~map_[w];
+        }
+        uint64_t bit = (w << 6) + ctz64(bits);
+        return bit < total_blocks_ ? bit : npos;
+    }
+
+    // Next used block bit at or after from, or total_blocks_.
+    uint64_t BlockAllocator::next_used(uint64_t from) const
+    {
+        uint64_t w = from >> 6;
+        uint64_t bits = map_[w] & (~0ULL << (from & 63));
+        while (bits == 0) {
+            if (++w == map_words_) {
+                return total_blocks_;
+            }
+            bits = map_[w];
+        }
+        return std::min<uint64_t>((w << 6) + ctz64(bits), total_blocks_);
+    }
+
+    void BlockAllocator::refresh_summary(size_t word)
+    {
+        uint64_t idx = word;
+        bool any = map_[word] != ~0ULL;
+        for (size_t level = 0; level < summary_.size(); ++level) {
+            uint64_t& sw = summary_[level][idx >> 6];
+            bool was = sw != 0;
+            uint64_t bit = 1ULL << (idx & 63);
+            if (any) {
+                sw |= bit;
+            } else {
+                sw &= ~bit;
+            }
+            bool now = sw != 0;
+            if (was == now) {
+                break;
+            }
+            any = now;
+            idx >>= 6;
+        }
+    }
+
+    void BlockAllocator::set_range(uint64_t first_bit, uint64_t count, bool used)
+    {
+        uint64_t last_bit = first_bit + count - 1;
+        size_t first_word = static_cast<size_t>(first_bit >> 6);
+        size_t last_word = static_cast<size_t>(last_bit >> 6);
+
+        for (size_t w = first_word; w <= last_word; ++w) {
+            uint64_t lo = (w == first_word) ? (first_bit & 63) : 0;
+            uint64_t hi = (w == last_word) ? (last_bit & 63) : 63;
+            uint64_t mask = (hi == 63 ? ~0ULL : ((1ULL << (hi + 1)) - 1)) & (~0ULL << lo);
+            if (used) {
+                map_[w] |= mask;
+            } else {
+                map_[w] &= ~mask;
+            }
+            refresh_summary(w);
+        }
+        container_->mark_dirty(&map_[first_word], (last_word - first_word + 1) * sizeof(uint64_t));
+    }
+
+    // Marks [first_bit, first_bit + count) used. The range must lie inside
+    // one free run, which keeps the extent count exact.
+    void BlockAllocator::take(uint64_t first_bit, uint64_t count, std::vector<Extent>& out)
+    {
+        uint64_t end = first_bit + count;
+        bool left_free = first_bit > 0 && bit_free(first_bit - 1);
+        bool right_free = end < total_blocks_ && bit_free(end);
+
+        set_range(first_bit, count, true);
+        free_blocks_ -= count;
+        free_extents_ = free_extents_ + left_free + right_free - 1;
+
+        out.push_back(Extent{static_cast<uint32_t>(first_bit + 1), static_cast<uint32_t>(count)});
+    }
+
+    // First fit from hint, wrapping around once.
+    bool BlockAllocator::find_run(uint64_t count, uint64_t hint, uint64_t& first_bit) const
+    {
+        auto scan = [&](uint64_t from, uint64_t limit) {
+            uint64_t pos = next_free(from);
+            while (pos != npos && pos < limit) {
+                uint64_t end = next_used(pos);
+                if (end - pos >= count) {
+                    first_bit = pos;
+                    return true;
+                }
+                pos = next_free(end);
+            }
+            return false;
+        };
+        return scan(hint, total_blocks_) || (hint > 0 && scan(0, hint));
+    }
+
+    OFSErrorCodes BlockAllocator::allocate(uint32_t count, std::vector<Extent>& out, uint32_t hint)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+
+        if (map_ == nullptr) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+        if (count == 0) {
+            return OFSErrorCodes::SUCCESS;
+        }
+        if (count > free_blocks_) {
+            LOG_WARN(MODULE_NAME, 101, "cannot allocate {} blocks, only {} free", count, free_blocks_);
+            return OFSErrorCodes::ERROR_NO_SPACE;
+        }
+
+        uint64_t hint_bit = (hint > 0 && hint <= total_blocks_) ? hint - 1 : 0;
+        uint64_t first_bit;
+        if (find_run(count, hint_bit, first_bit)) {
+            take(first_bit, count, out);
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        // No single run is big enough: use the largest runs first so the
+        // file ends up in as few extents as possible.
+        std::vector<Extent> runs;
+        for (uint64_t pos = next_free(0); pos != npos;) {
+            uint64_t end = next_used(pos);
+            runs.push_back(Extent{static_cast<uint32_t>(pos), static_cast<uint32_t>(end - pos)});
+            pos = next_free(end);
+        }
+        std::stable_sort(runs.begin(), runs.end(), [](const Extent& a, const Extent& b) {
+            return a.count > b.count;
+        });
+
+        std::vector<Extent> chosen;
+        uint64_t remaining = count;
+        for (const Extent& r : runs) {
+            if (remaining == 0) {
+                break;
+            }
+            uint32_t n = static_cast<uint32_t>(std::min<uint64_t>(r.count, remaining));
+            chosen.push_back(Extent{r.start, n});
+            remaining -= n;
+        }
+        std::sort(chosen.begin(), chosen.end(), [](const Extent& a, const Extent& b) {
+            return a.start < b.start;
+        });
+        for (const Extent& c : chosen) {
+            take(c.start, c.count, out);
+        }
+
+        LOG_DEBUG(MODULE_NAME, 11, "allocation of {} blocks split into {} extents", count, chosen.size());
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes BlockAllocator::allocate_contiguous(uint32_t count, Extent& out, uint32_t hint)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+
+        if (map_ == nullptr || count == 0) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        uint64_t hint_bit = (hint > 0 && hint <= total_blocks_) ? hint - 1 : 0;
+        uint64_t first_bit;
+        if (count > free_blocks_ || !find_run(count, hint_bit, first_bit)) {
+            return OFSErrorCodes::ERROR_NO_SPACE;
+        }
+
+        std::vector<Extent> taken;
+        take(first_bit, count, taken);
+        out = taken.front();
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes BlockAllocator::release_locked(const Extent& extent)
+    {
+        if (extent.count == 0) {
+            return OFSErrorCodes::SUCCESS;
+        }
+        if (extent.start == 0 || static_cast<uint64_t>(extent.start) + extent.count - 1 > total_blocks_) {
+            LOG_ERROR(MODULE_NAME, 302, "release of blocks {}+{} is out of range", extent.start, extent.count);
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        uint64_t first_bit = extent.start - 1;
+        uint64_t end = first_bit + extent.count;
+        uint64_t already_free = next_free(first_bit);
+        if (already_free != npos && already_free < end) {
+            LOG_ERROR(MODULE_NAME, 303, "block {} released twice", already_free + 1);
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        bool left_free = first_bit > 0 && bit_free(first_bit - 1);
+        bool right_free = end < total_blocks_ && bit_free(end);
+
+        set_range(first_bit, extent.count, false);
+        free_blocks_ += extent.count;
+        free_extents_ = free_extents_ + 1 - left_free - right_free;
+        container_->discard_cached(extent.start, extent.count);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes BlockAllocator::release(const Extent& extent)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (map_ == nullptr) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+        return release_locked(extent);
+    }
+
+    OFSErrorCodes BlockAllocator::release(const std::vector<Extent>& extents)
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (map_ == nullptr) {
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+        OFSErrorCodes rc = OFSErrorCodes::SUCCESS;
+        for (const Extent& e : extents) {
+            OFSErrorCodes r = release_locked(e);
+            if (r != OFSErrorCodes::SUCCESS) {
+                rc = r;
+            }
+        }
+        return rc;
+    }
+
+    bool BlockAllocator::is_free(uint32_t block) const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (map_ == nullptr || block == 0 || block > total_blocks_) {
+            return false;
+        }
+        return bit_free(block - 1);
+    }
+
+    uint64_t BlockAllocator::free_blocks() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return free_blocks_;
+    }
+
+    uint64_t BlockAllocator::free_extents() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        return free_extents_;
+    }
+
+    uint64_t BlockAllocator::largest_free_extent() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (map_ == nullptr) {
+            return 0;
+        }
+        uint64_t largest = 0;
+        for (uint64_t pos = next_free(0); pos != npos;) {
+            uint64_t end = next_used(pos);
+            largest = std::max(largest, end - pos);
+            pos = next_free(end);
+        }
+        return largest;
+    }
+
+    double BlockAllocator::fragmentation() const
+    {
+        std::lock_guard<std::mutex> lock(mtx_);
+        if (free_blocks_ <= 1 || free_extents_ <= 1) {
+            return 0.0;
+        }
+        return 100.0 * static_cast<double>(free_extents_ - 1) / static_cast<double>(free_blocks_ - 1);
+    }
+
+    void BlockAllocator::fill_stats(FSStats& stats) const
+    {
+        double frag = fragmentation();
+        std::lock_guard<std::mutex> lock(mtx_);
+        stats.total_size = container_ != nullptr ? container_->header()->total_size : 0;
+        stats.free_space = free_blocks_ * block_size_;
+        stats.used_space = stats.total_size - stats.free_space;
+        stats.fragmentation = frag;
+    }
+}
@@ -0,0 +1,728 @@
+#include "../../include/block_cache.hpp"
+#include "../../include/omni_container.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#define MODULE_NAME "BLOCK_CACHE"
+
+namespace ofs::storage
+{
+    // Shards are halved until each has at least this many frames.
+    static constexpr uint64_t MIN_SHARD_FRAMES = 32;
+    static constexpr size_t MAX_SHARDS = 16;
+
+    // Read-ahead: streams tracked at once, the window a stream starts at,
+    // and requests the worker may fall behind by.
+    static constexpr size_t STREAMS = 8;
+    static constexpr uint32_t FIRST_WINDOW = 4;
+    static constexpr size_t MAX_QUEUED = 64;
+
+    BlockCache::BlockCache(uint64_t content_offset, uint32_t block_size, size_t capacity, Transfer reader,
+                           Transfer writer, uint32_t flush_ms, uint32_t read_ahead, uint32_t last_block)
+        : content_offset_(content_offset), block_size_(block_size), reader_(std::move(reader)),
+          writer_(std::move(writer)), shard_mask_(0), frames_(capacity / block_size),
+          bypass_blocks_(std::max<uint64_t>(1, capacity / block_size / 4)), hits_(0), misses_(0), evictions_(0),
+          write_backs_(0), flushes_(0), dirty_(0), read_ahead_(0), read_ahead_hits_(0), bypassed_(0),
+          flush_ms_(flush_ms == 0 ? 1 : flush_ms), flusher_stop_(false), flush_wanted_(false),
+          max_window_(read_ahead), last_block_(last_block), stream_clock_(0), ahead_stop_(false)
+    {
+        size_t shards = MAX_SHARDS;
+        while (shards > 1 && frames_ / shards < MIN_SHARD_FRAMES) {
+            shards /= 2;
+        }
+        shard_mask_ = static_cast<uint32_t>(shards - 1);
+        slab_.reset(new uint8_t[frames_ * block_size_]);
+
+        uint64_t first = 0;
+        for (size_t i = 0; i < shards; ++i) {
+            uint32_t count = static_cast<uint32_t>(frames_ / shards + (i < frames_ % shards ? 1 : 0));
+            std::unique_ptr<Shard> s(new Shard());
+            s->data = slab_.get() + first * block_size_;
+            s->frames.assign(count, Frame{0, NIL, NIL, none, 0, 0, 0, 0, false});
+            for (uint32_t f = count; f > 0; --f) {
+                s->free.push_back(f - 1);
+            }
+            s->where.reserve(count);
+            s->in_limit = std::max<uint32_t>(1, count / 4);
+            s->ghost_limit = std::max<uint32_t>(1, count / 2);
+            s->dirty = 0;
+            s->changes = 0;
+            shards_.push_back(std::move(s));
+            first += count;
+        }
+
+        flusher_ = std::thread(&BlockCache::flusher_loop, this);
+        if (max_window_ != 0 && last_block_ != 0) {
+            streams_.resize(STREAMS);
+            ahead_worker_ = std::thread(&BlockCache::ahead_loop, this);
+        }
+    }
+
+    BlockCache::~BlockCache()
+    {
+        if (ahead_worker_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(ahead_mtx_);
+                ahead_stop_ = true;
+            }
+            ahead_cv_.notify_one();
+            ahead_worker_.join();
+        }
+        {
+            std::lock_guard<std::mutex> lock(flusher_mtx_);
+            flusher_stop_ = true;
+        }
+        flusher_cv_.notify_one();
+        flusher_.join();
+        flush();
+    }
+
+    size_t BlockCache::shard_index(uint32_t block) const
+    {
+        return ((block * 0x9E3779B1u) >> 16) & shard_mask_;
+    }
+
+    BlockCache::Shard& BlockCache::shard_of(uint32_t block) const
+    {
+        return *shards_[shard_index(block)];
+    }
+
+    // ------------------------------------------------------------------------
+    // Queues
+    // ------------------------------------------------------------------------
+
+    void BlockCache::link_front(Shard& s, List& list, uint32_t f)
+    {
+        Frame& fr = s.frames[f];
+        fr.prev = NIL;
+        fr.next = list.head;
+        if (list.head != NIL) {
+            s.frames[list.head].prev = f;
+        } else {
+            list.tail = f;
+        }
+        list.head = f;
+        ++list.size;
+        fr.queue = &list == &s.in ? a1in : am;
+    }
+
+    void BlockCache::unlink(Shard& s, List& list, uint32_t f)
+    {
+        Frame& fr = s.frames[f];
+        if (fr.prev != NIL) {
+            s.frames[fr.prev].next = fr.next;
+        } else {
+            list.head = fr.next;
+        }
+        if (fr.next != NIL) {
+            s.frames[fr.next].prev = fr.prev;
+        } else {
+            list.tail = fr.prev;
+        }
+        fr.prev = NIL;
+        fr.next = NIL;
+        fr.queue = none;
+        --list.size;
+    }
+
+    // A frame for block, taken from the free list or by evicting: the A1in
+    // tail while A1in is over its limit (its number goes to the ghost
+    // list), the Am tail otherwise. Blocks on the ghost list go to Am.
+    uint32_t BlockCache::take_frame(Shard& s, uint32_t block)
+    {
+        uint32_t f;
+        if (!s.free.empty()) {
+            f = s.free.back();
+            s.free.pop_back();
+        } else {
+            bool from_in = s.in.size > s.in_limit || s.main.size == 0;
+            f = from_in ? s.in.tail : s.main.tail;
+            Frame& victim = s.frames[f];
+            if (victim.dirty_hi > victim.dirty_lo) {
+                write_back_frame(s, f);
+            }
+            if (from_in) {
+                s.ghost.insert(victim.block);
+                s.ghost_order.push_back(victim.block);
+                while (s.ghost_order.size() > s.ghost_limit) {
+                    s.ghost.erase(s.ghost_order.front());
+                    s.ghost_order.pop_front();
+                }
+            }
+            unlink(s, from_in ? s.in : s.main, f);
+            s.where.erase(victim.block);
+            ++evictions_;
+        }
+
+        Frame& fr = s.frames[f];
+        fr.block = block;
+        fr.valid_lo = fr.valid_hi = 0;
+        fr.dirty_lo = fr.dirty_hi = 0;
+        fr.ahead = false;
+        auto ghost = s.ghost.find(block);
+        if (ghost != s.ghost.end()) {
+            s.ghost.erase(ghost);
+            link_front(s, s.main, f);
+        } else {
+            link_front(s, s.in, f);
+        }
+        s.where.emplace(block, f);
+        return f;
+    }
+
+    void BlockCache::drop_frame(Shard& s, uint32_t f)
+    {
+        Frame& fr = s.frames[f];
+        if (fr.dirty_hi > fr.dirty_lo) {
+            --s.dirty;
+            --dirty_;
+        }
+        unlink(s, fr.queue == a1in ? s.in : s.main, f);
+        s.where.erase(fr.block);
+        fr = Frame{0, NIL, NIL, none, 0, 0, 0, 0, false};
+        s.free.push_back(f);
+        ++s.changes;
+    }
+
+    // ------------------------------------------------------------------------
+    // Frames
+    // ------------------------------------------------------------------------
+
+    void BlockCache::write_back_frame(Shard& s, uint32_t f)
+    {
+        Frame& fr = s.frames[f];
+        IoSegment seg{block_start(fr.block) + fr.dirty_lo, frame_data(s, f) + fr.dirty_lo, fr.dirty_hi - fr.dirty_lo};
+        if (writer_(&seg, 1) != OFSErrorCodes::SUCCESS) {
+            LOG_ERROR(MODULE_NAME, 301, "write-back of block {} failed, {} bytes lost", fr.block, seg.len);
+        }
+        fr.dirty_lo = fr.dirty_hi = 0;
+        --s.dirty;
+        --dirty_;
+        ++s.changes;
+        ++write_backs_;
+        ++flushes_;
+    }
+
+    // Completes the frame's valid range from the container; its own bytes
+    // are newer and stay.
+    OFSErrorCodes BlockCache::fill(Shard& s, uint32_t f)
+    {
+        Frame& fr = s.frames[f];
+        if (fr.valid_lo == 0 && fr.valid_hi == block_size_) {
+            return OFSErrorCodes::SUCCESS;
+        }
+        static thread_local std::vector<uint8_t> buf;
+        buf.resize(block_size_);
+        IoSegment seg{block_start(fr.block), buf.data(), block_size_};
+        OFSErrorCodes rc = reader_(&seg, 1);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+        uint8_t* data = frame_data(s, f);
+        std::memcpy(data, buf.data(), fr.valid_lo);
+        std::memcpy(data + fr.valid_hi, buf.data() + fr.valid_hi, block_size_ - fr.valid_hi);
+        fr.valid_lo = 0;
+        fr.valid_hi = block_size_;
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    void BlockCache::mark_dirty(Shard& s, Frame& fr, uint32_t lo, uint32_t hi)
+    {
+        if (fr.dirty_hi > fr.dirty_lo) {
+            fr.dirty_lo = std::min(fr.dirty_lo, lo);
+            fr.dirty_hi = std::max(fr.dirty_hi, hi);
+            return;
+        }
+        fr.dirty_lo = lo;
+        fr.dirty_hi = hi;
+        ++s.dirty;
+        ++dirty_;
+    }
+
+    // ------------------------------------------------------------------------
+    // Transfers
+    // ------------------------------------------------------------------------
+
+    // Copies [lo, lo + len) of block to dst when the block is cached.
+    bool BlockCache::read_piece(uint32_t block, uint32_t lo, uint32_t len, uint8_t* dst)
+    {
+        Shard& s = shard_of(block);
+        std::lock_guard<std::mutex> lock(s.mtx);
+        auto it = s.where.find(block);
+        if (it == s.where.end()) {
+            return false;
+        }
+        uint32_t f = it->second;
+        Frame& fr = s.frames[f];
+        if (lo < fr.valid_lo || lo + len > fr.valid_hi) {
+            if (fill(s, f) != OFSErrorCodes::SUCCESS) {
+                return false;
+            }
+            ++misses_;
+        } else {
+            ++hits_;
+        }
+        if (fr.ahead) {
+            fr.ahead = false;
+            ++read_ahead_hits_;
+        }
+        std::memcpy(dst, frame_data(s, f) + lo, len);
+        if (fr.queue == am) {
+            unlink(s, s.main, f);
+            link_front(s, s.main, f);
+        }
+        return true;
+    }
+
+    // Caches bytes just read from the container. A frame another thread
+    // filled meanwhile wins: its bytes go back to the caller.
+    void BlockCache::install(uint32_t block, uint32_t lo, uint32_t len, uint8_t* src)
+    {
+        Shard& s = shard_of(block);
+        std::lock_guard<std::mutex> lock(s.mtx);
+        uint32_t hi = lo + len;
+        auto it = s.where.find(block);
+        if (it == s.where.end()) {
+            uint32_t f = take_frame(s, block);
+            std::memcpy(frame_data(s, f) + lo, src, len);
+            s.frames[f].valid_lo = lo;
+            s.frames[f].valid_hi = hi;
+            return;
+        }
+
+        Frame& fr = s.frames[it->second];
+        uint8_t* data = frame_data(s, it->second);
+        uint32_t a = std::max(lo, fr.valid_lo);
+        uint32_t b = std::min(hi, fr.valid_hi);
+        if (a < b) {
+            std::memcpy(src + (a - lo), data + a, b - a);
+        }
+        if (lo <= fr.valid_hi && hi >= fr.valid_lo) {
+            if (lo < fr.valid_lo) {
+                std::memcpy(data + lo, src, fr.valid_lo - lo);
+                fr.valid_lo = lo;
+            }
+            if (hi > fr.valid_hi) {
+                std::memcpy(data + fr.valid_hi, src + (fr.valid_hi - lo), hi - fr.valid_hi);
+                fr.valid_hi = hi;
+            }
+        }
+    }
+
+    void BlockCache::write_piece(uint32_t block, uint32_t lo, uint32_t len, const uint8_t* src)
+    {
+        Shard& s = shard_of(block);
+        std::lock_guard<std::mutex> lock(s.mtx);
+        uint32_t hi = lo + len;
+        uint32_t f;
+        auto it = s.where.find(block);
+        if (it == s.where.end()) {
+            f = take_frame(s, block);
+            s.frames[f].valid_lo = lo;
+            s.frames[f].valid_hi = hi;
+        } else {
+            f = it->second;
+            Frame& fr = s.frames[f];
+            // The valid range stays one piece: bridge a gap from the
+            // container, or start over from this write if that fails.
+            if ((lo > fr.valid_hi || hi < fr.valid_lo) && fill(s, f) != OFSErrorCodes::SUCCESS) {
+                if (fr.dirty_hi > fr.dirty_lo) {
+                    write_back_frame(s, f);
+                }
+                fr.valid_lo = lo;
+                fr.valid_hi = hi;
+            }
+            fr.valid_lo = std::min(fr.valid_lo, lo);
+            fr.valid_hi = std::max(fr.valid_hi, hi);
+        }
+        std::memcpy(frame_data(s, f) + lo, src, len);
+        mark_dirty(s, s.frames[f], lo, hi);
+    }
+
+    OFSErrorCodes BlockCache::read(const IoSegment* segs, size_t count)
+    {
+        uint64_t lo, hi;
+        if (blocks_spanned(segs, count, lo, hi) > bypass_blocks_) {
+            return read_around(segs, count, lo, hi);
+        }
+        if (!streams_.empty() && hi > lo) {
+            note_stream(block_of(segs[0].offset), block_of(segs[count - 1].offset + segs[count - 1].len - 1));
+        }
+
+        static thread_local std::vector<IoSegment> missing;
+        missing.clear();
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t off = segs[i].offset;
+            uint8_t* p = segs[i].data;
+            size_t left = segs[i].len;
+            while (left > 0) {
+                uint32_t block = block_of(off);
+                uint32_t lo = static_cast<uint32_t>((off - content_offset_) % block_size_);
+                uint32_t n = static_cast<uint32_t>(std::min<size_t>(left, block_size_ - lo));
+                if (!read_piece(block, lo, n, p)) {
+                    ++misses_;
+                    IoSegment* last = missing.empty() ? nullptr : &missing.back();
+                    if (last != nullptr && last->offset + last->len == off && last->data + last->len == p) {
+                        last->len += n;
+                    } else {
+                        missing.push_back(IoSegment{off, p, n});
+                    }
+                }
+                off += n;
+                p += n;
+                left -= n;
+            }
+        }
+        if (missing.empty()) {
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        // Everything missing in one batch, then into frames.
+        OFSErrorCodes rc = reader_(missing.data(), missing.size());
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+        for (const IoSegment& m : missing) {
+            uint64_t off = m.offset;
+            uint8_t* p = m.data;
+            size_t left = m.len;
+            while (left > 0) {
+                uint32_t block = block_of(off);
+                uint32_t lo = static_cast<uint32_t>((off - content_offset_) % block_size_);
+                uint32_t n = static_cast<uint32_t>(std::min<size_t>(left, block_size_ - lo));
+                install(block, lo, n, p);
+                off += n;
+                p += n;
+                left -= n;
+            }
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes BlockCache::write(const IoSegment* segs, size_t count)
+    {
+        uint64_t lo, hi;
+        if (blocks_spanned(segs, count, lo, hi) > bypass_blocks_) {
+            return write_around(segs, count, lo, hi);
+        }
+
+        for (size_t i = 0; i < count; ++i) {
+            uint64_t off = segs[i].offset;
+            const uint8_t* p = segs[i].data;
+            size_t left = segs[i].len;
+            while (left > 0) {
+                uint32_t block = block_of(off);
+                uint32_t lo = static_cast<uint32_t>((off - content_offset_) % block_size_);
+                uint32_t n = static_cast<uint32_t>(std::min<size_t>(left, block_size_ - lo));
+                write_piece(block, lo, n, p);
+                off += n;
+                p += n;
+                left -= n;
+            }
+        }
+        if (dirty_.load(std::memory_order_relaxed) > frames_ / 2) {
+            {
+                std::lock_guard<std::mutex> lock(flusher_mtx_);
+                flush_wanted_ = true;
+            }
+            flusher_cv_.notify_one();
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    // ------------------------------------------------------------------------
+    // Large transfers
+    // ------------------------------------------------------------------------
+
+    // Blocks the segments touch, and the byte range [lo, hi) around them.
+    uint64_t BlockCache::blocks_spanned(const IoSegment* segs, size_t count, uint64_t& lo, uint64_t& hi) const
+    {
+        uint64_t blocks = 0;
+        lo = UINT64_MAX;
+        hi = 0;
+        for (size_t i = 0; i < count; ++i) {
+            if (segs[i].len == 0) {
+                continue;
+            }
+            uint64_t end = segs[i].offset + segs[i].len;
+            blocks += block_of(end - 1) - block_of(segs[i].offset) + 1;
+            lo = std::min(lo, segs[i].offset);
+            hi = std::max(hi, end);
+        }
+        return blocks;
+    }
+
+    OFSErrorCodes BlockCache::read_around(const IoSegment* segs, size_t count, uint64_t lo, uint64_t hi)
+    {
+        if (dirty_.load() != 0) {
+            OFSErrorCodes rc = flush(lo, hi - lo);
+            if (rc != OFSErrorCodes::SUCCESS) {
+                return rc;
+            }
+        }
+        ++bypassed_;
+        return reader_(segs, count);
+    }
+
+    // Dirty bytes sharing a block with the write go out first, then the
+    // write in one writer call, and the frames it covered are dropped.
+    OFSErrorCodes BlockCache::write_around(const IoSegment* segs, size_t count, uint64_t lo, uint64_t hi)
+    {
+        if (dirty_.load() != 0) {
+            OFSErrorCodes rc = flush(lo, hi - lo);
+            if (rc != OFSErrorCodes::SUCCESS) {
+                return rc;
+            }
+        }
+        static thread_local std::vector<IoSegment> sorted;
+        sorted.assign(segs, segs + count);
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const IoSegment& a, const IoSegment& b) { return a.offset < b.offset; });
+        OFSErrorCodes rc = writer_(sorted.data(), sorted.size());
+        for (const IoSegment& seg : sorted) {
+            if (seg.len > 0) {
+                uint32_t first = block_of(seg.offset);
+                discard(first, block_of(seg.offset + seg.len - 1) - first + 1);
+            }
+        }
+        ++bypassed_;
+        return rc;
+    }
+
+    // ------------------------------------------------------------------------
+    // Read-ahead
+    // ------------------------------------------------------------------------
+
+    // A read of blocks [first, last] continues a stream when it starts in
+    // the block the stream's last read ended in or the one after.
+    void BlockCache::note_stream(uint32_t first, uint32_t last)
+    {
+        std::lock_guard<std::mutex> lock(ahead_mtx_);
+        ++stream_clock_;
+        Stream* oldest = &streams_[0];
+        Stream* st = nullptr;
+        for (Stream& candidate : streams_) {
+            if (candidate.used != 0 && first <= candidate.next && first + 1 >= candidate.next) {
+                st = &candidate;
+                break;
+            }
+            if (candidate.used < oldest->used) {
+                oldest = &candidate;
+            }
+        }
+        if (st == nullptr) {
+            *oldest = Stream{last + 1, 0, last + 1, stream_clock_};
+            return;
+        }
+
+        st->window = std::min(st->window == 0 ? FIRST_WINDOW : st->window * 2, max_window_);
+        st->next = std::max(st->next, last + 1);
+        st->used = stream_clock_;
+        // Topped up once the reader is within half a window of its end.
+        if (st->ahead > st->next + st->window / 2) {
+            return;
+        }
+        uint32_t from = std::max(st->ahead, st->next);
+        uint32_t to = static_cast<uint32_t>(
+            std::min<uint64_t>(static_cast<uint64_t>(st->next) + st->window, static_cast<uint64_t>(last_block_) + 1));
+        if (from >= to) {
+            return;
+        }
+        if (ahead_queue_.size() == MAX_QUEUED) {
+            ahead_queue_.pop_front();
+        }
+        ahead_queue_.push_back(Range{from, to - from});
+        st->ahead = to;
+        ahead_cv_.notify_one();
+    }
+
+    // Reads the blocks of range that are not cached, neighbours in one
+    // segment. A shard that wrote back, dropped or discarded a block
+    // meanwhile may hold newer bytes than were read, or the container may:
+    // its blocks are left out.
+    void BlockCache::read_ahead(Range range)
+    {
+        std::vector<uint32_t> blocks;
+        for (uint32_t b = range.first; b < range.first + range.count; ++b) {
+            Shard& s = shard_of(b);
+            std::lock_guard<std::mutex> lock(s.mtx);
+            if (s.where.find(b) == s.where.end()) {
+                blocks.push_back(b);
+            }
+        }
+        if (blocks.empty()) {
+            return;
+        }
+
+        std::vector<uint64_t> changes(shards_.size());
+        for (size_t i = 0; i < shards_.size(); ++i) {
+            std::lock_guard<std::mutex> lock(shards_[i]->mtx);
+            changes[i] = shards_[i]->changes;
+        }
+
+        std::vector<uint8_t> buf(blocks.size() * block_size_);
+        std::vector<IoSegment> segs;
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            if (i > 0 && blocks[i] == blocks[i - 1] + 1) {
+                segs.back().len += block_size_;
+            } else {
+                segs.push_back(IoSegment{block_start(blocks[i]), buf.data() + i * block_size_, block_size_});
+            }
+        }
+        if (reader_(segs.data(), segs.size()) != OFSErrorCodes::SUCCESS) {
+            return;
+        }
+
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            size_t index = shard_index(blocks[i]);
+            Shard& s = *shards_[index];
+            std::lock_guard<std::mutex> lock(s.mtx);
+            if (s.changes != changes[index] || s.where.find(blocks[i]) != s.where.end()) {
+                continue;
+            }
+            uint32_t f = take_frame(s, blocks[i]);
+            std::memcpy(frame_data(s, f), buf.data() + i * block_size_, block_size_);
+            Frame& fr = s.frames[f];
+            fr.valid_lo = 0;
+            fr.valid_hi = block_size_;
+            fr.ahead = true;
+            ++read_ahead_;
+        }
+    }
+
+    void BlockCache::ahead_loop()
+    {
+        std::unique_lock<std::mutex> lock(ahead_mtx_);
+        while (true) {
+            ahead_cv_.wait(lock, [this] { return ahead_stop_ || !ahead_queue_.empty(); });
+            if (ahead_stop_) {
+                break;
+            }
+            Range range = ahead_queue_.front();
+            ahead_queue_.pop_front();
+            lock.unlock();
+            read_ahead(range);
+            lock.lock();
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // Write-back
+    // ------------------------------------------------------------------------
+
+    OFSErrorCodes BlockCache::flush(uint64_t offset, uint64_t len)
+    {
+        if (dirty_.load() == 0) {
+            return OFSErrorCodes::SUCCESS;
+        }
+        uint64_t end = len > UINT64_MAX - offset ? UINT64_MAX : offset + len;
+        if (end <= content_offset_) {
+            return OFSErrorCodes::SUCCESS;
+        }
+        uint64_t first = offset <= content_offset_ ? 1 : (offset - content_offset_) / block_size_ + 1;
+        uint64_t last = (end - 1 - content_offset_) / block_size_ + 1;
+
+        // Every shard stays locked until the bytes are written, so nothing
+        // can evict a block and read it back from the container before.
+        std::vector<std::unique_lock<std::mutex>> locks;
+        locks.reserve(shards_.size());
+        for (auto& s : shards_) {
+            locks.emplace_back(s->mtx);
+        }
+
+        std::vector<IoSegment> segs;
+        auto take = [&](Shard& s, uint32_t f) {
+            Frame& fr = s.frames[f];
+            segs.push_back(IoSegment{block_start(fr.block) + fr.dirty_lo, frame_data(s, f) + fr.dirty_lo,
+                                     fr.dirty_hi - fr.dirty_lo});
+            fr.dirty_lo = fr.dirty_hi = 0;
+            --s.dirty;
+            --dirty_;
+            ++s.changes;
+        };
+        if (last - first + 1 < frames_) {
+            for (uint64_t b = first; b <= last; ++b) {
+                Shard& s = shard_of(static_cast<uint32_t>(b));
+                auto it = s.where.find(static_cast<uint32_t>(b));
+                if (it != s.where.end() && s.frames[it->second].dirty_hi > s.frames[it->second].dirty_lo) {
+                    take(s, it->second);
+                }
+            }
+        } else {
+            for (auto& s : shards_) {
+                for (uint32_t f = 0; s->dirty > 0 && f < s->frames.size(); ++f) {
+                    const Frame& fr = s->frames[f];
+                    if (fr.dirty_hi > fr.dirty_lo && fr.block >= first && fr.block <= last) {
+                        take(*s, f);
+                    }
+                }
+            }
+        }
+        if (segs.empty()) {
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        std::sort(segs.begin(), segs.end(),
+                  [](const IoSegment& a, const IoSegment& b) { return a.offset < b.offset; });
+        OFSErrorCodes rc = writer_(segs.data(), segs.size());
+        if (rc != OFSErrorCodes::SUCCESS) {
+            LOG_ERROR(MODULE_NAME, 302, "write-back of {} blocks failed", segs.size());
+        }
+        write_backs_ += segs.size();
+        ++flushes_;
+        return rc;
+    }
+
+    // The blocks' shards count a change whether or not a frame held them:
+    // a read-ahead may already have read the bytes the caller replaced.
+    void BlockCache::discard(uint32_t first, uint32_t count)
+    {
+        if (count < frames_) {
+            for (uint64_t b = first; b < static_cast<uint64_t>(first) + count; ++b) {
+                Shard& s = shard_of(static_cast<uint32_t>(b));
+                std::lock_guard<std::mutex> lock(s.mtx);
+                ++s.changes;
+                auto it = s.where.find(static_cast<uint32_t>(b));
+                if (it != s.where.end()) {
+                    drop_frame(s, it->second);
+                }
+            }
+            return;
+        }
+        for (auto& s : shards_) {
+            std::lock_guard<std::mutex> lock(s->mtx);
+            ++s->changes;
+            for (uint32_t f = 0; f < s->frames.size(); ++f) {
+                uint32_t block = s->frames[f].block;
+                if (block != 0 && block >= first && block - first < count) {
+                    drop_frame(*s, f);
+                }
+            }
+        }
+    }
+
+    BlockCache::Stats BlockCache::stats() const
+    {
+        return Stats{hits_.load(), misses_.load(), evictions_.load(), write_backs_.load(), flushes_.load(),
+                     dirty_.load(), frames_, read_ahead_.load(), read_ahead_hits_.load(), bypassed_.load()};
+    }
+
+    void BlockCache::flusher_loop()
+    {
+        std::unique_lock<std::mutex> lock(flusher_mtx_);
+        while (!flusher_stop_) {
+            flusher_cv_.wait_for(lock, std::chrono::milliseconds(flush_ms_),
+                                 [this] { return flusher_stop_ || flush_wanted_; });
+            if (flusher_stop_) {
+                break;
+            }
+            flush_wanted_ = false;
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+}
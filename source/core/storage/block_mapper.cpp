@@ -0,0 +1,529 @@
+#include "../../include/block_mapper.hpp"
+#include "../../include/omni_container.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#define MODULE_NAME "BLOCK_MAPPER"
+
+namespace ofs::storage
+{
+    // Chain walk read-ahead, in blocks.
+    static constexpr uint32_t WALK_RUN = 4;
+    static constexpr uint32_t WALK_FIRST_WINDOW = 16;
+    static constexpr uint32_t WALK_MAX_WINDOW = 256;
+
+    // ------------------------------------------------------------------------
+    // BlockMapper
+    // ------------------------------------------------------------------------
+
+    BlockMapper::BlockMapper(OmniContainer& container, BlockAllocator& allocator)
+        : container_(container), allocator_(allocator)
+    {
+    }
+
+    std::unique_ptr<BlockMapper> BlockMapper::create(OmniContainer& container, BlockAllocator& allocator)
+    {
+        if (container.block_mapping() == BlockMapping::chain) {
+            return std::make_unique<ChainMapper>(container, allocator);
+        }
+        return std::make_unique<ExtentMapper>(container, allocator);
+    }
+
+    uint32_t BlockMapper::payload_size() const
+    {
+        return container_.block_size() - payload_offset();
+    }
+
+    uint64_t BlockMapper::blocks_for_size(uint64_t bytes) const
+    {
+        uint64_t payload = payload_size();
+        return (bytes + payload - 1) / payload;
+    }
+
+    OFSErrorCodes BlockMapper::read(const MetadataEntry& entry, uint64_t offset, void* dst, size_t len)
+    {
+        if (len == 0) {
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        uint64_t payload = payload_size();
+        uint64_t first = offset / payload;
+        uint64_t last = (offset + len - 1) / payload;
+        // Per-thread scratch: a transfer maps its range on every call.
+        static thread_local std::vector<Extent> runs;
+        static thread_local std::vector<IoSegment> segs;
+        runs.clear();
+        segs.clear();
+        OFSErrorCodes rc = map_range(entry, first, last - first + 1, runs);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+
+        to_segments(runs, first, offset, len, static_cast<uint8_t*>(dst), segs);
+        return container_.read_segments(segs.data(), segs.size());
+    }
+
+    OFSErrorCodes BlockMapper::write(const MetadataEntry& entry, uint64_t offset, const void* src, size_t len)
+    {
+        if (len == 0) {
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        uint64_t payload = payload_size();
+        uint64_t first = offset / payload;
+        uint64_t last = (offset + len - 1) / payload;
+        static thread_local std::vector<Extent> runs;
+        static thread_local std::vector<IoSegment> segs;
+        runs.clear();
+        segs.clear();
+        OFSErrorCodes rc = map_range(entry, first, last - first + 1, runs);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+
+        to_segments(runs, first, offset, len, static_cast<uint8_t*>(const_cast<void*>(src)), segs);
+        return container_.write_segments(segs.data(), segs.size());
+    }
+
+    // One segment per run: the part of [offset, offset + len) it holds.
+    void BlockMapper::to_segments(const std::vector<Extent>& runs, uint64_t first, uint64_t offset, size_t len,
+                                  uint8_t* buf, std::vector<IoSegment>& segs) const
+    {
+        uint64_t payload = payload_size();
+        uint64_t logical = first;
+        uint64_t pos = offset;
+        uint64_t end = offset + len;
+        segs.reserve(runs.size());
+        for (const Extent& run : runs) {
+            uint64_t run_end = (logical + run.count) * payload;
+            uint64_t n = std::min(run_end, end) - pos;
+            segs.push_back(IoSegment{container_.block_offset(run.start) + payload_offset() + (pos - logical * payload),
+                                     buf, static_cast<size_t>(n)});
+            buf += n;
+            pos += n;
+            logical += run.count;
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // ChainMapper
+    // ------------------------------------------------------------------------
+
+    uint32_t ChainMapper::next_of(uint32_t block)
+    {
+        uint32_t next;
+        std::memcpy(&next, container_.block(block).data, sizeof(next));
+        return next;
+    }
+
+    void ChainMapper::set_next(uint32_t block, uint32_t next)
+    {
+        uint8_t* p = container_.block(block).data;
+        std::memcpy(p, &next, sizeof(next));
+        container_.mark_dirty(p, sizeof(next));
+    }
+
+    OFSErrorCodes ChainMapper::collect(const MetadataEntry& entry, std::vector<uint32_t>& chain)
+    {
+        uint64_t total = container_.total_blocks();
+        for (uint32_t b = entry.start_block; b != 0; b = next_of(b)) {
+            if (b > total || chain.size() >= total) {
+                LOG_ERROR(MODULE_NAME, 301, "broken block chain for '{}' at block {}", entry.name, b);
+                return OFSErrorCodes::ERROR_IO_ERROR;
+            }
+            chain.push_back(b);
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    uint64_t ChainMapper::block_count(const MetadataEntry& entry)
+    {
+        std::vector<uint32_t> chain;
+        collect(entry, chain);
+        return chain.size();
+    }
+
+    OFSErrorCodes ChainMapper::map_range(const MetadataEntry& entry, uint64_t first, uint64_t count,
+                                         std::vector<Extent>& runs)
+    {
+        // Every step of the walk reads a next pointer through the mapping.
+        // Once the chain has run through WALK_RUN consecutive blocks, the
+        // kernel is asked for the blocks ahead, a window at a time.
+        uint32_t run = 0;
+        uint32_t advised = 0;
+        uint32_t window = WALK_FIRST_WINDOW;
+        auto step = [&](uint32_t from) {
+            uint32_t to = next_of(from);
+            run = to == from + 1 ? run + 1 : 0;
+            if (run >= WALK_RUN && to >= advised) {
+                container_.will_need(to, window);
+                advised = to + window;
+                window = std::min(window * 2, WALK_MAX_WINDOW);
+            }
+            return to;
+        };
+
+        uint64_t total = container_.total_blocks();
+        uint32_t b = entry.start_block;
+        for (uint64_t i = 0; i < first && b != 0 && b <= total; ++i) {
+            b = step(b);
+        }
+        for (uint64_t i = 0; i < count; ++i) {
+            if (b == 0 || b > total) {
+                LOG_ERROR(MODULE_NAME, 302, "block {} of '{}' is not mapped", first + i, entry.name);
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            runs.push_back(Extent{b, 1});
+            b = step(b);
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes ChainMapper::resize(MetadataEntry& entry, uint64_t blocks)
+    {
+        std::vector<uint32_t> chain;
+        OFSErrorCodes rc = collect(entry, chain);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+
+        uint64_t cur = chain.size();
+        if (blocks == cur) {
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        if (blocks > cur) {
+            if (blocks > UINT32_MAX) {
+                return OFSErrorCodes::ERROR_NO_SPACE;
+            }
+            std::vector<Extent> added;
+            uint32_t hint = chain.empty() ? 0 : chain.back() + 1;
+            rc = allocator_.allocate(static_cast<uint32_t>(blocks - cur), added, hint);
+            if (rc != OFSErrorCodes::SUCCESS) {
+                return rc;
+            }
+
+            uint32_t prev = chain.empty() ? 0 : chain.back();
+            for (const Extent& e : added) {
+                for (uint32_t b = e.start; b < e.end(); ++b) {
+                    if (prev == 0) {
+                        entry.start_block = b;
+                    } else {
+                        set_next(prev, b);
+                    }
+                    prev = b;
+                }
+            }
+            set_next(prev, 0);
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        if (blocks == 0) {
+            entry.start_block = 0;
+        } else {
+            set_next(chain[blocks - 1], 0);
+        }
+
+        // Give the tail back, merging neighbours into extents.
+        std::vector<Extent> freed;
+        for (uint64_t i = blocks; i < cur; ++i) {
+            if (!freed.empty() && freed.back().end() == chain[i]) {
+                ++freed.back().count;
+            } else {
+                freed.push_back(Extent{chain[i], 1});
+            }
+        }
+        return allocator_.release(freed);
+    }
+
+    // ------------------------------------------------------------------------
+    // ExtentMapper
+    // ------------------------------------------------------------------------
+
+    ExtentNodeHeader* ExtentMapper::node(uint32_t block)
+    {
+        ByteView view = container_.block(block);
+        if (view.empty()) {
+            return nullptr;
+        }
+        ExtentNodeHeader* header = reinterpret_cast<ExtentNodeHeader*>(view.data);
+        return header->magic == EXTENT_NODE_MAGIC ? header : nullptr;
+    }
+
+    uint32_t ExtentMapper::leaf_capacity() const
+    {
+        return static_cast<uint32_t>((container_.block_size() - sizeof(ExtentNodeHeader)) / sizeof(ExtentRecord));
+    }
+
+    uint32_t ExtentMapper::index_capacity() const
+    {
+        return static_cast<uint32_t>((container_.block_size() - sizeof(ExtentNodeHeader)) / sizeof(ExtentIndex));
+    }
+
+    static ExtentRecord* records_of(ExtentNodeHeader* node)
+    {
+        return reinterpret_cast<ExtentRecord*>(node + 1);
+    }
+
+    static ExtentIndex* indices_of(ExtentNodeHeader* node)
+    {
+        return reinterpret_cast<ExtentIndex*>(node + 1);
+    }
+
+    OFSErrorCodes ExtentMapper::load(const MetadataEntry& entry, std::vector<ExtentRecord>& extents,
+                                     std::vector<uint32_t>& nodes)
+    {
+        if (entry.start_block == 0) {
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        ExtentNodeHeader* root = node(entry.start_block);
+        if (root == nullptr || root->depth > 1) {
+            LOG_ERROR(MODULE_NAME, 310, "bad extent root for '{}' at block {}", entry.name, entry.start_block);
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        nodes.push_back(entry.start_block);
+
+        if (root->depth == 0) {
+            extents.assign(records_of(root), records_of(root) + root->count);
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        ExtentIndex* idx = indices_of(root);
+        for (uint16_t i = 0; i < root->count; ++i) {
+            ExtentNodeHeader* leaf = node(idx[i].child);
+            if (leaf == nullptr || leaf->depth != 0) {
+                LOG_ERROR(MODULE_NAME, 311, "bad extent leaf for '{}' at block {}", entry.name, idx[i].child);
+                return OFSErrorCodes::ERROR_IO_ERROR;
+            }
+            nodes.push_back(idx[i].child);
+            extents.insert(extents.end(), records_of(leaf), records_of(leaf) + leaf->count);
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    void ExtentMapper::write_leaf(uint32_t block, const ExtentRecord* records, uint32_t count, uint32_t mapped_blocks)
+    {
+        ExtentNodeHeader* header = reinterpret_cast<ExtentNodeHeader*>(container_.block(block).data);
+        header->magic = EXTENT_NODE_MAGIC;
+        header->depth = 0;
+        header->count = static_cast<uint16_t>(count);
+        header->mapped_blocks = mapped_blocks;
+        header->reserved = 0;
+        std::memcpy(records_of(header), records, count * sizeof(ExtentRecord));
+        container_.mark_dirty(header, sizeof(ExtentNodeHeader) + count * sizeof(ExtentRecord));
+    }
+
+    OFSErrorCodes ExtentMapper::store(MetadataEntry& entry, const std::vector<ExtentRecord>& extents,
+                                      std::vector<uint32_t>& nodes, uint64_t mapped_blocks)
+    {
+        size_t n = extents.size();
+        if (n == 0) {
+            std::vector<Extent> freed;
+            for (uint32_t b : nodes) {
+                freed.push_back(Extent{b, 1});
+            }
+            nodes.clear();
+            entry.start_block = 0;
+            return allocator_.release(freed);
+        }
+
+        uint32_t leaf_cap = leaf_capacity();
+        size_t leaves = n <= leaf_cap ? 0 : (n + leaf_cap - 1) / leaf_cap;
+        if (leaves > index_capacity()) {
+            LOG_WARN(MODULE_NAME, 101, "'{}' needs {} extents, more than the tree can hold", entry.name, n);
+            return OFSErrorCodes::ERROR_NO_SPACE;
+        }
+        size_t needed = 1 + leaves;
+
+        if (nodes.size() < needed) {
+            std::vector<Extent> extra;
+            uint32_t hint = nodes.empty() ? 0 : nodes.back() + 1;
+            OFSErrorCodes rc = allocator_.allocate(static_cast<uint32_t>(needed - nodes.size()), extra, hint);
+            if (rc != OFSErrorCodes::SUCCESS) {
+                return rc;
+            }
+            for (const Extent& e : extra) {
+                for (uint32_t b = e.start; b < e.end(); ++b) {
+                    nodes.push_back(b);
+                }
+            }
+        } else if (nodes.size() > needed) {
+            std::vector<Extent> surplus;
+            for (size_t i = needed; i < nodes.size(); ++i) {
+                surplus.push_back(Extent{nodes[i], 1});
+            }
+            nodes.resize(needed);
+            allocator_.release(surplus);
+        }
+
+        if (leaves == 0) {
+            write_leaf(nodes[0], extents.data(), static_cast<uint32_t>(n), static_cast<uint32_t>(mapped_blocks));
+        } else {
+            ExtentNodeHeader* root = reinterpret_cast<ExtentNodeHeader*>(container_.block(nodes[0]).data);
+            root->magic = EXTENT_NODE_MAGIC;
+            root->depth = 1;
+            root->count = static_cast<uint16_t>(leaves);
+            root->mapped_blocks = static_cast<uint32_t>(mapped_blocks);
+            root->reserved = 0;
+
+            ExtentIndex* idx = indices_of(root);
+            for (size_t l = 0; l < leaves; ++l) {
+                size_t begin = l * leaf_cap;
+                uint32_t count = static_cast<uint32_t>(std::min<size_t>(leaf_cap, n - begin));
+                write_leaf(nodes[1 + l], &extents[begin], count, 0);
+                idx[l].logical = extents[begin].logical;
+                idx[l].child = nodes[1 + l];
+            }
+            container_.mark_dirty(root, sizeof(ExtentNodeHeader) + leaves * sizeof(ExtentIndex));
+        }
+
+        entry.start_block = nodes[0];
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    uint64_t ExtentMapper::block_count(const MetadataEntry& entry)
+    {
+        if (entry.start_block == 0) {
+            return 0;
+        }
+        ExtentNodeHeader* root = node(entry.start_block);
+        return root != nullptr ? root->mapped_blocks : 0;
+    }
+
+    OFSErrorCodes ExtentMapper::map_range(const MetadataEntry& entry, uint64_t first, uint64_t count,
+                                          std::vector<Extent>& runs)
+    {
+        if (count == 0) {
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        ExtentNodeHeader* root = entry.start_block != 0 ? node(entry.start_block) : nullptr;
+        if (root == nullptr || first + count > root->mapped_blocks) {
+            LOG_ERROR(MODULE_NAME, 302, "blocks {}+{} of '{}' are not mapped", first, count, entry.name);
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        auto by_logical = [](uint64_t value, const auto& rec) { return value < rec.logical; };
+
+        ExtentIndex* idx = nullptr;
+        size_t leaf_pos = 0;
+        ExtentNodeHeader* leaf = root;
+        if (root->depth == 1) {
+            idx = indices_of(root);
+            leaf_pos = std::upper_bound(idx, idx + root->count, first, by_logical) - idx;
+            leaf_pos = leaf_pos == 0 ? 0 : leaf_pos - 1;
+            leaf = node(idx[leaf_pos].child);
+        }
+
+        uint64_t pos = first;
+        uint64_t end = first + count;
+        size_t i = 0;
+        if (leaf != nullptr) {
+            ExtentRecord* recs = records_of(leaf);
+            i = std::upper_bound(recs, recs + leaf->count, first, by_logical) - recs;
+            i = i == 0 ? 0 : i - 1;
+        }
+
+        while (pos < end) {
+            if (leaf != nullptr && i >= leaf->count && idx != nullptr && ++leaf_pos < root->count) {
+                leaf = node(idx[leaf_pos].child);
+                i = 0;
+            }
+            if (leaf == nullptr || i >= leaf->count) {
+                LOG_ERROR(MODULE_NAME, 312, "extent tree of '{}' ends before block {}", entry.name, pos);
+                return OFSErrorCodes::ERROR_IO_ERROR;
+            }
+
+            const ExtentRecord& r = records_of(leaf)[i];
+            if (pos < r.logical || pos >= static_cast<uint64_t>(r.logical) + r.count) {
+                LOG_ERROR(MODULE_NAME, 313, "extent tree of '{}' has a hole at block {}", entry.name, pos);
+                return OFSErrorCodes::ERROR_IO_ERROR;
+            }
+            uint64_t skip = pos - r.logical;
+            uint64_t take = std::min<uint64_t>(r.count - skip, end - pos);
+            runs.push_back(Extent{static_cast<uint32_t>(r.physical + skip), static_cast<uint32_t>(take)});
+            pos += take;
+            ++i;
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes ExtentMapper::resize(MetadataEntry& entry, uint64_t blocks)
+    {
+        if (blocks > UINT32_MAX) {
+            return OFSErrorCodes::ERROR_NO_SPACE;
+        }
+
+        std::vector<ExtentRecord> extents;
+        std::vector<uint32_t> nodes;
+        OFSErrorCodes rc = load(entry, extents, nodes);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+
+        uint64_t cur = extents.empty() ? 0 : static_cast<uint64_t>(extents.back().logical) + extents.back().count;
+        if (blocks == cur) {
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        if (blocks > cur) {
+            // The root goes in front of the data so later growth can extend
+            // the last extent in place.
+            bool new_root = nodes.empty();
+            if (new_root) {
+                Extent root;
+                rc = allocator_.allocate_contiguous(1, root);
+                if (rc != OFSErrorCodes::SUCCESS) {
+                    return rc;
+                }
+                nodes.push_back(root.start);
+            }
+
+            std::vector<Extent> added;
+            uint32_t hint = extents.empty() ? nodes[0] + 1 : extents.back().physical + extents.back().count;
+            rc = allocator_.allocate(static_cast<uint32_t>(blocks - cur), added, hint);
+            if (rc == OFSErrorCodes::SUCCESS) {
+                uint32_t logical = static_cast<uint32_t>(cur);
+                for (const Extent& a : added) {
+                    if (!extents.empty() && extents.back().physical + extents.back().count == a.start) {
+                        extents.back().count += a.count;
+                    } else {
+                        extents.push_back(ExtentRecord{logical, a.start, a.count, 0});
+                    }
+                    logical += a.count;
+                }
+                rc = store(entry, extents, nodes, blocks);
+                if (rc != OFSErrorCodes::SUCCESS) {
+                    allocator_.release(added);
+                }
+            }
+            if (rc != OFSErrorCodes::SUCCESS && new_root) {
+                allocator_.release(Extent{nodes[0], 1});
+            }
+            return rc;
+        }
+
+        std::vector<Extent> freed;
+        while (!extents.empty() && extents.back().logical >= blocks) {
+            freed.push_back(Extent{extents.back().physical, extents.back().count});
+            extents.pop_back();
+        }
+        if (!extents.empty()) {
+            ExtentRecord& last = extents.back();
+            uint32_t keep = static_cast<uint32_t>(blocks - last.logical);
+            if (keep < last.count) {
+                freed.push_back(Extent{last.physical + keep, last.count - keep});
+                last.count = keep;
+            }
+        }
+
+        rc = store(entry, extents, nodes, blocks);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+        return allocator_.release(freed);
+    }
+}
@@ -0,0 +1,686 @@
+#include "../../include/delta_vault.hpp"
+#include "../../include/omni_container.hpp"
+#include "../../include/block_allocator.hpp"
+#include "../../include/snapshot.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstring>
+
+#define MODULE_NAME "DELTA_VAULT"
+
+namespace ofs::storage
+{
+    namespace
+    {
+        // Chunk runs are allocated this many bytes at a time.
+        constexpr uint64_t RUN_BYTES = 4 * CDC_MAX_CHUNK;
+
+        constexpr std::array<uint64_t, 256> make_gear()
+        {
+            std::array<uint64_t, 256> table{};
+            uint64_t x = 0x0F5C0FFEE0DDF00DULL;
+            for (size_t i = 0; i < table.size(); ++i) {
+                // splitmix64
+                x += 0x9E3779B97F4A7C15ULL;
+                uint64_t z = x;
+                z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+                table[i] = z ^ (z >> 31);
+            }
+            return table;
+        }
+
+        constexpr std::array<uint64_t, 256> GEAR = make_gear();
+
+        // The Gear hash shifts left, so the top bits depend on the most
+        // bytes. Before the average size the mask has two bits more than
+        // log2(CDC_AVG_CHUNK), after it two bits fewer.
+        constexpr uint64_t top_bits(int n)
+        {
+            return ((1ULL << n) - 1) << (64 - n);
+        }
+        constexpr uint64_t MASK_SMALL = top_bits(15);
+        constexpr uint64_t MASK_LARGE = top_bits(11);
+
+        uint64_t pad8(uint64_t v)
+        {
+            return (v + 7) & ~uint64_t(7);
+        }
+    }
+
+    size_t cdc_cut(const uint8_t* data, size_t len)
+    {
+        if (len <= CDC_MIN_CHUNK) {
+            return len;
+        }
+        size_t n = std::min(len, CDC_MAX_CHUNK);
+        size_t normal = std::min(n, CDC_AVG_CHUNK);
+        uint64_t fp = 0;
+        size_t i = CDC_MIN_CHUNK;
+        for (; i < normal; ++i) {
+            fp = (fp << 1) + GEAR[data[i]];
+            if ((fp & MASK_SMALL) == 0) {
+                return i + 1;
+            }
+        }
+        for (; i < n; ++i) {
+            fp = (fp << 1) + GEAR[data[i]];
+            if ((fp & MASK_LARGE) == 0) {
+                return i + 1;
+            }
+        }
+        return n;
+    }
+
+    DeltaVault::DeltaVault()
+        : container_(nullptr),
+          allocator_(nullptr),
+          full_every_(8),
+          chunks_(nullptr),
+          chunk_slots_(0),
+          log_(nullptr),
+          ring_(nullptr),
+          ring_size_(0),
+          block_size_(0),
+          content_offset_(0),
+          chunk_bytes_(0),
+          version_bytes_(0),
+          versions_(0),
+          deltas_(0),
+          dedup_hits_(0),
+          dropped_(0)
+    {
+    }
+
+    void DeltaVault::attach(OmniContainer& container, BlockAllocator& allocator, uint32_t full_every)
+    {
+        detach();
+        const OmniLayoutInfo& layout = container.layout();
+        if (layout.history_chunk_slots == 0) {
+            return;
+        }
+
+        container_ = &container;
+        allocator_ = &allocator;
+        full_every_ = std::max<uint32_t>(full_every, 1);
+        chunks_ = reinterpret_cast<ChunkRecord*>(container.base() + container.header()->file_state_storage_offset);
+        chunk_slots_ = static_cast<uint32_t>(std::min<uint64_t>(layout.history_chunk_slots, UINT32_MAX));
+        log_ = reinterpret_cast<ChangeLogHeader*>(container.base() + container.header()->change_log_offset);
+        ring_ = reinterpret_cast<uint8_t*>(log_) + CHANGE_LOG_RECORDS_OFFSET;
+        ring_size_ = (layout.change_log_size - CHANGE_LOG_RECORDS_OFFSET) & ~uint64_t(7);
+        block_size_ = container.block_size();
+        content_offset_ = layout.content_offset;
+
+        uint64_t content_end = content_offset_ + layout.total_blocks * block_size_;
+        for (uint32_t i = chunk_slots_; i >= 1; --i) {
+            ChunkRecord& c = chunk(i);
+            if (c.length != 0 && (c.length > CDC_MAX_CHUNK || c.offset < content_offset_ ||
+                                  c.offset + c.length > content_end || c.refs == 0)) {
+                LOG_WARN(MODULE_NAME, 101, "{}: chunk {} is damaged and was dropped", container.path(), i);
+                std::memset(&c, 0, sizeof(c));
+                container.mark_dirty(&c, sizeof(c));
+            }
+            if (c.length == 0) {
+                free_chunks_.push_back(i);
+                continue;
+            }
+            by_hash_.emplace(c.hash, i);
+            count_blocks(c.offset, c.length, true);
+            chunk_bytes_ += c.length;
+        }
+
+        if (!rebuild_log()) {
+            // Without the log nothing refers to the chunks any more.
+            LOG_WARN(MODULE_NAME, 102, "{}: change log is damaged, file history starts over", container.path());
+            std::memset(log_, 0, sizeof(*log_));
+            std::memcpy(log_->magic, CHANGE_LOG_MAGIC, sizeof(log_->magic));
+            container.mark_dirty(log_, sizeof(*log_));
+            files_.clear();
+            versions_ = deltas_ = version_bytes_ = 0;
+            for (uint32_t i = 1; i <= chunk_slots_; ++i) {
+                if (chunk(i).length != 0) {
+                    chunk(i).refs = 1;
+                    release_chunk(i);
+                }
+            }
+        }
+
+        LOG_INFO(MODULE_NAME, 10, "file history: {} versions of {} files, {} chunks ({} bytes), {} of {} log bytes used",
+                 versions_, files_.size(), by_hash_.size(), chunk_bytes_, log_->head - log_->tail, ring_size_);
+    }
+
+    void DeltaVault::detach()
+    {
+        container_ = nullptr;
+        allocator_ = nullptr;
+        chunks_ = nullptr;
+        log_ = nullptr;
+        ring_ = nullptr;
+        by_hash_.clear();
+        free_chunks_.clear();
+        block_chunks_.clear();
+        files_.clear();
+        chunk_bytes_ = version_bytes_ = versions_ = deltas_ = 0;
+    }
+
+    // Indexes the records from tail to head; false if the log is unusable.
+    bool DeltaVault::rebuild_log()
+    {
+        if (std::memcmp(log_->magic, CHANGE_LOG_MAGIC, sizeof(log_->magic)) != 0 || log_->head < log_->tail ||
+            log_->head - log_->tail > ring_size_ || log_->open_offset > log_->open_end) {
+            return false;
+        }
+
+        uint64_t pos = log_->tail;
+        while (pos != log_->head) {
+            VersionRecord* r = record_at(pos);
+            if (r == nullptr) {
+                pos += ring_size_ - pos % ring_size_;
+                continue;
+            }
+            bool ok = r->magic == VERSION_RECORD_MAGIC && r->length >= sizeof(VersionRecord) && r->length % 8 == 0 &&
+                      pos % ring_size_ + r->length <= ring_size_ && pos + r->length <= log_->head;
+            VersionKind kind = static_cast<VersionKind>(r->kind);
+            if (ok && kind == VersionKind::full) {
+                ok = sizeof(VersionRecord) + static_cast<uint64_t>(r->count) * sizeof(uint32_t) <= r->length;
+                const uint32_t* ids = reinterpret_cast<const uint32_t*>(r + 1);
+                for (uint32_t i = 0; ok && i < r->count; ++i) {
+                    ok = ids[i] >= 1 && ids[i] <= chunk_slots_ && chunk(ids[i]).length != 0;
+                }
+            } else if (ok && kind == VersionKind::delta) {
+                ok = sizeof(VersionRecord) + sizeof(uint64_t) + r->count <= r->length;
+            }
+            if (!ok) {
+                return false;
+            }
+            if (kind == VersionKind::full || kind == VersionKind::delta) {
+                files_[r->entry].push_back(Version{pos, r->version, r->size, r->time, kind == VersionKind::delta});
+                ++versions_;
+                deltas_ += kind == VersionKind::delta ? 1 : 0;
+                version_bytes_ += r->size;
+            }
+            pos += r->length;
+        }
+        return true;
+    }
+
+    // nullptr when pos is too close to the end of the ring for a record;
+    // the next record is then at the start.
+    VersionRecord* DeltaVault::record_at(uint64_t pos) const
+    {
+        uint64_t p = pos % ring_size_;
+        if (ring_size_ - p < sizeof(VersionRecord)) {
+            return nullptr;
+        }
+        return reinterpret_cast<VersionRecord*>(ring_ + p);
+    }
+
+    // ------------------------------------------------------------------------
+    // Chunks
+    // ------------------------------------------------------------------------
+
+    void DeltaVault::count_blocks(uint64_t offset, uint64_t len, bool add)
+    {
+        uint32_t first = static_cast<uint32_t>((offset - content_offset_) / block_size_ + 1);
+        uint32_t last = static_cast<uint32_t>((offset + len - 1 - content_offset_) / block_size_ + 1);
+        for (uint32_t b = first; b <= last; ++b) {
+            if (add) {
+                ++block_chunks_[b];
+                continue;
+            }
+            auto it = block_chunks_.find(b);
+            if (it != block_chunks_.end() && --it->second == 0) {
+                block_chunks_.erase(it);
+                release_block(b);
+            }
+        }
+    }
+
+    // A block with no chunks left goes back to the allocator, unless the
+    // open run will still put chunks into it.
+    void DeltaVault::release_block(uint32_t block)
+    {
+        uint64_t start = content_offset_ + static_cast<uint64_t>(block - 1) * block_size_;
+        if (start + block_size_ > log_->open_offset && start < log_->open_end) {
+            return;
+        }
+        allocator_->release(Extent{block, 1});
+    }
+
+    void DeltaVault::release_chunk(uint32_t id)
+    {
+        ChunkRecord& c = chunk(id);
+        if (c.refs > 1) {
+            --c.refs;
+            container_->mark_dirty(&c.refs, sizeof(c.refs));
+            return;
+        }
+        auto range = by_hash_.equal_range(c.hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            if (it->second == id) {
+                by_hash_.erase(it);
+                break;
+            }
+        }
+        uint64_t offset = c.offset;
+        uint64_t len = c.length;
+        std::memset(&c, 0, sizeof(c));
+        container_->mark_dirty(&c, sizeof(c));
+        free_chunks_.push_back(id);
+        chunk_bytes_ -= len;
+        count_blocks(offset, len, false);
+    }
+
+    // Returns the blocks of the open run no chunk uses.
+    void DeltaVault::close_run()
+    {
+        uint64_t offset = log_->open_offset;
+        uint64_t end = log_->open_end;
+        log_->open_offset = log_->open_end = 0;
+        container_->mark_dirty(log_, sizeof(*log_));
+        if (end <= offset) {
+            return;
+        }
+        uint32_t first = static_cast<uint32_t>((offset - content_offset_) / block_size_ + 1);
+        uint32_t last = static_cast<uint32_t>((end - 1 - content_offset_) / block_size_ + 1);
+        for (uint32_t b = first; b <= last; ++b) {
+            if (block_chunks_.find(b) == block_chunks_.end()) {
+                allocator_->release(Extent{b, 1});
+            }
+        }
+    }
+
+    // Closes the open run and starts a new one with room for len bytes.
+    bool DeltaVault::open_run(size_t len)
+    {
+        uint32_t run_blocks = static_cast<uint32_t>((RUN_BYTES + block_size_ - 1) / block_size_);
+        uint32_t need_blocks = static_cast<uint32_t>((len + block_size_ - 1) / block_size_);
+        uint32_t hint = log_->open_end > content_offset_
+                            ? static_cast<uint32_t>((log_->open_end - content_offset_) / block_size_ + 1)
+                            : 0;
+        Extent ext;
+        while (allocator_->allocate_contiguous(run_blocks, ext, hint) != OFSErrorCodes::SUCCESS &&
+               allocator_->allocate_contiguous(need_blocks, ext, hint) != OFSErrorCodes::SUCCESS) {
+            if (!drop_oldest()) {
+                return false;
+            }
+        }
+        close_run();
+        log_->open_offset = content_offset_ + static_cast<uint64_t>(ext.start - 1) * block_size_;
+        log_->open_end = log_->open_offset + static_cast<uint64_t>(ext.count) * block_size_;
+        container_->mark_dirty(log_, sizeof(*log_));
+        return true;
+    }
+
+    bool DeltaVault::place_chunk(size_t len, uint64_t& offset)
+    {
+        if (log_->open_end - log_->open_offset < len && !open_run(len)) {
+            return false;
+        }
+        offset = log_->open_offset;
+        log_->open_offset += len;
+        container_->mark_dirty(log_, sizeof(*log_));
+        return true;
+    }
+
+    // Returns the id of a chunk holding data with one more reference, or 0
+    // when there is no room for it.
+    uint32_t DeltaVault::store_chunk(const uint8_t* data, size_t len)
+    {
+        uint64_t hash = snapshot_checksum(data, len);
+        auto range = by_hash_.equal_range(hash);
+        for (auto it = range.first; it != range.second; ++it) {
+            // Compared as read back, so the content map applies.
+            ChunkRecord& c = chunk(it->second);
+            if (c.length != len) {
+                continue;
+            }
+            scratch_.resize(len);
+            IoSegment seg{c.offset, scratch_.data(), len};
+            if (container_->read_segments(&seg, 1) == OFSErrorCodes::SUCCESS &&
+                std::memcmp(scratch_.data(), data, len) == 0) {
+                ++c.refs;
+                container_->mark_dirty(&c.refs, sizeof(c.refs));
+                ++dedup_hits_;
+                return it->second;
+            }
+        }
+
+        while (free_chunks_.empty()) {
+            if (!drop_oldest()) {
+                return 0;
+            }
+        }
+        uint64_t offset;
+        if (!place_chunk(len, offset)) {
+            return 0;
+        }
+        // Dropping versions above may have freed a slot with a lower id.
+        uint32_t id = free_chunks_.back();
+        free_chunks_.pop_back();
+
+        IoSegment seg{offset, const_cast<uint8_t*>(data), len};
+        if (container_->write_segments(&seg, 1) != OFSErrorCodes::SUCCESS) {
+            free_chunks_.push_back(id);
+            return 0;
+        }
+        ChunkRecord& c = chunk(id);
+        c.hash = hash;
+        c.offset = offset;
+        c.length = static_cast<uint32_t>(len);
+        c.refs = 1;
+        container_->mark_dirty(&c, sizeof(c));
+        by_hash_.emplace(hash, id);
+        count_blocks(offset, len, true);
+        chunk_bytes_ += len;
+        return id;
+    }
+
+    // ------------------------------------------------------------------------
+    // Change log
+    // ------------------------------------------------------------------------
+
+    // Makes room for a record of length bytes at the head, dropping the
+    // oldest versions as needed.
+    bool DeltaVault::make_room(uint64_t length)
+    {
+        if (length > ring_size_ / 2) {
+            return false;
+        }
+        while (true) {
+            uint64_t p = log_->head % ring_size_;
+            uint64_t skip = ring_size_ - p < length ? ring_size_ - p : 0;
+            if (log_free() >= skip + length) {
+                return true;
+            }
+            if (!drop_oldest()) {
+                return false;
+            }
+        }
+    }
+
+    // Appends a record with payload bytes after the header; the caller
+    // fills the payload and marks the record dirty. make_room() first.
+    VersionRecord* DeltaVault::append(VersionKind kind, uint32_t entry, uint32_t version, uint64_t size,
+                                      uint64_t time, uint32_t count, uint64_t payload, uint64_t& pos)
+    {
+        uint64_t length = pad8(sizeof(VersionRecord) + payload);
+        if (!make_room(length)) {
+            return nullptr;
+        }
+        uint64_t p = log_->head % ring_size_;
+        if (ring_size_ - p < length) {
+            if (ring_size_ - p >= sizeof(VersionRecord)) {
+                VersionRecord* wrap = reinterpret_cast<VersionRecord*>(ring_ + p);
+                std::memset(wrap, 0, sizeof(*wrap));
+                wrap->magic = VERSION_RECORD_MAGIC;
+                wrap->kind = static_cast<uint8_t>(VersionKind::wrap);
+                wrap->length = static_cast<uint32_t>(ring_size_ - p);
+                container_->mark_dirty(wrap, sizeof(*wrap));
+            }
+            log_->head += ring_size_ - p;
+            p = 0;
+        }
+
+        VersionRecord* r = reinterpret_cast<VersionRecord*>(ring_ + p);
+        std::memset(r, 0, length);
+        r->magic = VERSION_RECORD_MAGIC;
+        r->kind = static_cast<uint8_t>(kind);
+        r->entry = entry;
+        r->version = version;
+        r->size = size;
+        r->time = time;
+        r->length = static_cast<uint32_t>(length);
+        r->count = count;
+        pos = log_->head;
+        log_->head += length;
+        container_->mark_dirty(log_, sizeof(*log_));
+        return r;
+    }
+
+    // Removes version i of entry from the index; a full version takes the
+    // deltas built on it along.
+    void DeltaVault::drop_version(uint32_t entry, size_t i)
+    {
+        auto it = files_.find(entry);
+        std::vector<Version>& list = it->second;
+        size_t end = i + 1;
+        if (!list[i].delta) {
+            VersionRecord* r = record_at(list[i].pos);
+            const uint32_t* ids = reinterpret_cast<const uint32_t*>(r + 1);
+            for (uint32_t k = 0; k < r->count; ++k) {
+                release_chunk(ids[k]);
+            }
+            while (end < list.size() && list[end].delta) {
+                ++end;
+            }
+        }
+        for (size_t k = i; k < end; ++k) {
+            VersionRecord* r = record_at(list[k].pos);
+            r->kind = static_cast<uint8_t>(VersionKind::dead);
+            container_->mark_dirty(&r->kind, sizeof(r->kind));
+            --versions_;
+            deltas_ -= list[k].delta ? 1 : 0;
+            version_bytes_ -= list[k].size;
+            ++dropped_;
+        }
+        list.erase(list.begin() + static_cast<std::ptrdiff_t>(i), list.begin() + static_cast<std::ptrdiff_t>(end));
+        if (list.empty()) {
+            files_.erase(it);
+        }
+    }
+
+    // Drops the version at the tail of the log; false when the log is empty.
+    bool DeltaVault::drop_oldest()
+    {
+        while (log_->tail != log_->head) {
+            VersionRecord* r = record_at(log_->tail);
+            if (r == nullptr) {
+                log_->tail += ring_size_ - log_->tail % ring_size_;
+                continue;
+            }
+            uint64_t pos = log_->tail;
+            log_->tail += r->length;
+            container_->mark_dirty(log_, sizeof(*log_));
+            VersionKind kind = static_cast<VersionKind>(r->kind);
+            if (kind != VersionKind::full && kind != VersionKind::delta) {
+                continue;
+            }
+            auto it = files_.find(r->entry);
+            if (it != files_.end() && it->second.front().pos == pos) {
+                drop_version(r->entry, 0);
+            }
+            return true;
+        }
+        container_->mark_dirty(log_, sizeof(*log_));
+        return false;
+    }
+
+    // ------------------------------------------------------------------------
+    // Versions
+    // ------------------------------------------------------------------------
+
+    void DeltaVault::record_full(uint32_t entry, uint32_t version, const char* data, size_t len, uint64_t time)
+    {
+        if (!active()) {
+            return;
+        }
+        const uint8_t* p = reinterpret_cast<const uint8_t*>(data);
+        std::vector<uint32_t> ids;
+        ids.reserve(len / CDC_AVG_CHUNK + 1);
+        uint64_t pos = 0;
+        VersionRecord* r = nullptr;
+        bool stored = true;
+        for (size_t at = 0; at < len && stored;) {
+            size_t n = cdc_cut(p + at, len - at);
+            uint32_t id = store_chunk(p + at, n);
+            stored = id != 0;
+            if (stored) {
+                ids.push_back(id);
+            }
+            at += n;
+        }
+        if (stored) {
+            r = append(VersionKind::full, entry, version, len, time, static_cast<uint32_t>(ids.size()),
+                       ids.size() * sizeof(uint32_t), pos);
+        }
+        if (r == nullptr) {
+            for (uint32_t id : ids) {
+                release_chunk(id);
+            }
+            LOG_WARN(MODULE_NAME, 103, "no room to keep version {} of entry {} ({} bytes)", version, entry, len);
+            return;
+        }
+        std::memcpy(r + 1, ids.data(), ids.size() * sizeof(uint32_t));
+        container_->mark_dirty(r, r->length);
+        files_[entry].push_back(Version{pos, version, len, time, false});
+        ++versions_;
+        version_bytes_ += len;
+    }
+
+    bool DeltaVault::record_delta(uint32_t entry, uint32_t version, uint64_t offset, const char* data, size_t len,
+                                  uint64_t new_size, uint64_t time)
+    {
+        if (!active() || len > std::max<uint64_t>(DELTA_MIN_LIMIT, new_size / 8)) {
+            return false;
+        }
+        auto chained = [this, entry, version] {
+            auto it = files_.find(entry);
+            if (it == files_.end() || it->second.back().version + 1 != version) {
+                return false;
+            }
+            uint32_t since_full = 0;
+            for (auto v = it->second.rbegin(); v != it->second.rend() && v->delta; ++v) {
+                ++since_full;
+            }
+            return since_full + 1 < full_every_;
+        };
+        uint64_t length = pad8(sizeof(VersionRecord) + sizeof(uint64_t) + len);
+        // Making room can drop the versions this delta builds on.
+        if (!chained() || !make_room(length) || !chained()) {
+            return false;
+        }
+
+        uint64_t pos;
+        VersionRecord* r = append(VersionKind::delta, entry, version, new_size, time, static_cast<uint32_t>(len),
+                                  sizeof(uint64_t) + len, pos);
+        uint8_t* payload = reinterpret_cast<uint8_t*>(r + 1);
+        std::memcpy(payload, &offset, sizeof(offset));
+        std::memcpy(payload + sizeof(offset), data, len);
+        container_->mark_dirty(r, r->length);
+        files_[entry].push_back(Version{pos, version, new_size, time, true});
+        ++versions_;
+        ++deltas_;
+        version_bytes_ += new_size;
+        return true;
+    }
+
+    void DeltaVault::forget(uint32_t entry)
+    {
+        if (!active()) {
+            return;
+        }
+        while (files_.find(entry) != files_.end()) {
+            drop_version(entry, 0);
+        }
+    }
+
+    void DeltaVault::versions(uint32_t entry, std::vector<FileVersion>& out) const
+    {
+        out.clear();
+        auto it = files_.find(entry);
+        if (it == files_.end()) {
+            return;
+        }
+        for (const Version& v : it->second) {
+            out.push_back(FileVersion{v.version, v.size, v.time, v.delta});
+        }
+    }
+
+    // Content of a full version: every chunk read in one call.
+    OFSErrorCodes DeltaVault::materialize(const Version& v, std::string& out) const
+    {
+        const VersionRecord* r = record_at(v.pos);
+        const uint32_t* ids = reinterpret_cast<const uint32_t*>(r + 1);
+        out.resize(static_cast<size_t>(r->size));
+        std::vector<IoSegment> segs;
+        segs.reserve(r->count);
+        size_t at = 0;
+        for (uint32_t i = 0; i < r->count; ++i) {
+            const ChunkRecord& c = chunk(ids[i]);
+            segs.push_back(IoSegment{c.offset, reinterpret_cast<uint8_t*>(out.data()) + at, c.length});
+            at += c.length;
+        }
+        return container_->read_segments(segs.data(), segs.size());
+    }
+
+    OFSErrorCodes DeltaVault::read(uint32_t entry, uint32_t version, std::string& out) const
+    {
+        auto it = active() ? files_.find(entry) : files_.end();
+        if (it == files_.end()) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+        const std::vector<Version>& list = it->second;
+        size_t i = 0;
+        while (i < list.size() && list[i].version != version) {
+            ++i;
+        }
+        if (i == list.size()) {
+            return OFSErrorCodes::ERROR_NOT_FOUND;
+        }
+
+        // Back to the full version this one builds on, then forward.
+        size_t base = i;
+        while (list[base].delta) {
+            --base;
+        }
+        OFSErrorCodes rc = materialize(list[base], out);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            out.clear();
+            return rc;
+        }
+        for (size_t k = base + 1; k <= i; ++k) {
+            const VersionRecord* r = record_at(list[k].pos);
+            const uint8_t* payload = reinterpret_cast<const uint8_t*>(r + 1);
+            uint64_t offset;
+            std::memcpy(&offset, payload, sizeof(offset));
+            out.resize(static_cast<size_t>(r->size));
+            std::memcpy(out.data() + offset, payload + sizeof(offset), r->count);
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    uint64_t DeltaVault::reclaim(uint64_t blocks)
+    {
+        if (!active()) {
+            return 0;
+        }
+        uint64_t before = allocator_->free_blocks();
+        while (allocator_->free_blocks() < before + blocks) {
+            if (!drop_oldest()) {
+                close_run();
+                break;
+            }
+        }
+        return allocator_->free_blocks() - before;
+    }
+
+    DeltaVault::Stats DeltaVault::stats() const
+    {
+        Stats s{};
+        if (!active()) {
+            return s;
+        }
+        s.versions = versions_;
+        s.deltas = deltas_;
+        s.chunks = by_hash_.size();
+        s.chunk_bytes = chunk_bytes_;
+        s.version_bytes = version_bytes_;
+        s.log_used = log_->head - log_->tail;
+        s.dedup_hits = dedup_hits_;
+        s.dropped = dropped_;
+        return s;
+    }
+}
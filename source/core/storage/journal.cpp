@@ -0,0 +1,603 @@
+#include "../../include/journal.hpp"
+#include "../../include/omni_container.hpp"
+#include "../../include/snapshot.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+
+#define MODULE_NAME "JOURNAL"
+
+namespace ofs::storage
+{
+    // The transaction this thread is in, if any.
+    struct ThreadTransaction
+    {
+        Journal* journal = nullptr;
+        uint32_t depth = 0;
+        std::vector<Journal::Range> meta;
+        std::vector<Journal::Range> data;
+        bool deferred = false;
+        uint64_t last_seq = 0;
+    };
+
+    static thread_local ThreadTransaction tls_tx;
+
+    // Content ranges this close are synced as one; msync works in pages.
+    static constexpr uint64_t SYNC_GAP = 4096;
+
+    static uint64_t pad8(uint64_t v)
+    {
+        return (v + 7) & ~uint64_t(7);
+    }
+
+    static uint64_t record_checksum(const JournalRecord& rec, const uint8_t* payload, size_t len)
+    {
+        uint64_t fields[3] = {rec.seq, rec.length, rec.ranges};
+        return snapshot_checksum(payload, len) ^
+               (snapshot_checksum(reinterpret_cast<const uint8_t*>(fields), sizeof(fields)) * 0x9E3779B185EBCA87ULL);
+    }
+
+    // Sorts and merges ranges that overlap or touch. Ranges with a gap
+    // between them stay apart: the gap may belong to someone else's change.
+    // Ranges that are only synced may bridge gaps of up to gap bytes.
+    static void merge(std::vector<Journal::Range>& ranges, uint64_t gap = 0)
+    {
+        if (ranges.size() < 2) {
+            return;
+        }
+        std::sort(ranges.begin(), ranges.end(),
+                  [](const Journal::Range& a, const Journal::Range& b) { return a.offset < b.offset; });
+        size_t out = 0;
+        for (size_t i = 1; i < ranges.size(); ++i) {
+            Journal::Range& last = ranges[out];
+            if (ranges[i].offset <= last.offset + last.len + gap) {
+                last.len = std::max(last.len, ranges[i].offset + ranges[i].len - last.offset);
+            } else {
+                ranges[++out] = ranges[i];
+            }
+        }
+        ranges.resize(out + 1);
+    }
+
+    Durability durability_from_string(const std::string& name)
+    {
+        if (name == "fsync") {
+            return Durability::fsync;
+        }
+        if (name == "async") {
+            return Durability::async;
+        }
+        return Durability::group;
+    }
+
+    const char* durability_name(Durability durability)
+    {
+        switch (durability) {
+        case Durability::fsync:
+            return "fsync";
+        case Durability::async:
+            return "async";
+        default:
+            return "group";
+        }
+    }
+
+    Journal::Journal()
+        : container_(nullptr),
+          durability_(Durability::group),
+          group_commit_ms_(5),
+          area_offset_(0),
+          area_size_(0),
+          header_(nullptr),
+          in_progress_(0),
+          stalled_(0),
+          checkpoint_waiting_(false),
+          next_seq_(1),
+          write_pos_(JOURNAL_RECORDS_OFFSET),
+          durable_seq_(0),
+          flushed_pos_(JOURNAL_RECORDS_OFFSET),
+          flusher_stop_(false),
+          records_(0),
+          bytes_(0),
+          flushes_(0),
+          checkpoints_(0),
+          replayed_(0)
+    {
+    }
+
+    Journal::~Journal()
+    {
+        detach();
+    }
+
+    OFSErrorCodes Journal::attach(OmniContainer& container, Durability durability, uint32_t group_commit_ms)
+    {
+        detach();
+        const OmniLayoutInfo& layout = container.layout();
+        if (layout.journal_size == 0) {
+            return OFSErrorCodes::SUCCESS;
+        }
+
+        area_offset_ = layout.journal_offset;
+        area_size_ = layout.journal_size;
+        header_ = reinterpret_cast<JournalHeader*>(container.base() + area_offset_);
+        durability_ = durability;
+        group_commit_ms_ = group_commit_ms == 0 ? 1 : group_commit_ms;
+        container_ = &container;
+
+        uint64_t first = header_->first_seq == 0 ? 1 : header_->first_seq;
+        if (std::memcmp(header_->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC)) != 0) {
+            LOG_WARN(MODULE_NAME, 101, "{}: journal header missing, starting an empty journal", container.path());
+            std::memset(header_, 0, sizeof(*header_));
+            std::memcpy(header_->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+            replayed_ = 0;
+            next_seq_ = first;
+        } else {
+            next_seq_ = first;
+            replayed_ = replay();
+        }
+
+        // Replayed changes go in place before the journal starts over.
+        OFSErrorCodes rc = container.sync_in_place();
+        if (rc != OFSErrorCodes::SUCCESS) {
+            container_ = nullptr;
+            header_ = nullptr;
+            return rc;
+        }
+        durable_seq_ = next_seq_ - 1;
+        reset(next_seq_);
+        container.set_journal(this);
+
+        if (durability_ != Durability::fsync) {
+            flusher_stop_ = false;
+            flusher_ = std::thread(&Journal::flusher_loop, this);
+        }
+        if (replayed_ != 0) {
+            LOG_WARN(MODULE_NAME, 102, "{}: replayed {} journal records", container.path(), replayed_);
+        }
+        LOG_INFO(MODULE_NAME, 10, "{}: {} byte journal, {} durability{}", container.path(), area_size_,
+                 durability_name(durability_),
+                 durability_ == Durability::fsync ? "" : " every " + std::to_string(group_commit_ms_) + " ms");
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    void Journal::detach()
+    {
+        if (container_ == nullptr) {
+            return;
+        }
+        if (flusher_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(flusher_mtx_);
+                flusher_stop_ = true;
+            }
+            flusher_cv_.notify_one();
+            flusher_.join();
+        }
+        checkpoint();
+        container_->set_journal(nullptr);
+        container_ = nullptr;
+        header_ = nullptr;
+    }
+
+    // Applies every intact record from first_seq on; returns how many.
+    uint64_t Journal::replay()
+    {
+        uint8_t* base = container_->base();
+        uint8_t* area = base + area_offset_;
+        uint64_t limit = container_->mapped_size();
+        uint64_t pos = JOURNAL_RECORDS_OFFSET;
+        uint64_t applied = 0;
+
+        while (pos + sizeof(JournalRecord) <= area_size_) {
+            JournalRecord rec;
+            std::memcpy(&rec, area + pos, sizeof(rec));
+            if (rec.magic != JOURNAL_RECORD_MAGIC || rec.seq != next_seq_ || rec.length < sizeof(JournalRecord) ||
+                rec.length % 8 != 0 || rec.length > area_size_ - pos) {
+                break;
+            }
+            const uint8_t* payload = area + pos + sizeof(JournalRecord);
+            size_t payload_len = static_cast<size_t>(rec.length - sizeof(JournalRecord));
+            if (record_checksum(rec, payload, payload_len) != rec.checksum) {
+                break;
+            }
+
+            // Every range must lie in the container outside the journal
+            // before any of them is applied.
+            bool ok = true;
+            uint64_t at = 0;
+            for (uint32_t i = 0; i < rec.ranges && ok; ++i) {
+                JournalRange r;
+                ok = at + sizeof(r) <= payload_len;
+                if (ok) {
+                    std::memcpy(&r, payload + at, sizeof(r));
+                    at += sizeof(r) + pad8(r.length);
+                    ok = at <= payload_len && r.offset + r.length <= limit &&
+                         (r.offset + r.length <= area_offset_ || r.offset >= area_offset_ + area_size_);
+                }
+            }
+            if (!ok) {
+                LOG_WARN(MODULE_NAME, 103, "{}: journal record {} has a bad range, replay stops",
+                         container_->path(), rec.seq);
+                break;
+            }
+            at = 0;
+            for (uint32_t i = 0; i < rec.ranges; ++i) {
+                JournalRange r;
+                std::memcpy(&r, payload + at, sizeof(r));
+                std::memcpy(base + r.offset, payload + at + sizeof(r), r.length);
+                container_->mark_dirty(base + r.offset, r.length);
+                at += sizeof(r) + pad8(r.length);
+            }
+            ++applied;
+            ++next_seq_;
+            pos += rec.length;
+        }
+        return applied;
+    }
+
+    // Starts the records over at the front. Caller holds flush_mtx_ or
+    // is the only user.
+    void Journal::reset(uint64_t first_seq)
+    {
+        std::memcpy(header_->magic, JOURNAL_MAGIC, sizeof(JOURNAL_MAGIC));
+        header_->first_seq = first_seq;
+        ++header_->checkpoints;
+        container_->sync_range(area_offset_, sizeof(JournalHeader));
+        write_pos_ = JOURNAL_RECORDS_OFFSET;
+        flushed_pos_ = JOURNAL_RECORDS_OFFSET;
+    }
+
+    void Journal::enter()
+    {
+        bool half_full;
+        {
+            std::lock_guard<std::mutex> lock(append_mtx_);
+            half_full = write_pos_ - JOURNAL_RECORDS_OFFSET > (area_size_ - JOURNAL_RECORDS_OFFSET) / 2;
+        }
+        if (half_full) {
+            checkpoint();
+        }
+        std::unique_lock<std::mutex> lock(gate_mtx_);
+        gate_cv_.wait(lock, [this] { return !checkpoint_waiting_; });
+        ++in_progress_;
+    }
+
+    void Journal::leave()
+    {
+        std::lock_guard<std::mutex> lock(gate_mtx_);
+        if (--in_progress_ <= stalled_) {
+            gate_cv_.notify_all();
+        }
+    }
+
+    OFSErrorCodes Journal::checkpoint()
+    {
+        if (container_ == nullptr) {
+            return OFSErrorCodes::SUCCESS;
+        }
+        return checkpoint_gated(tls_tx.journal == this && tls_tx.depth > 0);
+    }
+
+    // Waits for the transactions in progress, then checkpoints. One that
+    // is itself in progress (inside) waits for the others only; several
+    // doing so at once do not wait for each other, so the change of one
+    // may be written in place before its record.
+    OFSErrorCodes Journal::checkpoint_gated(bool inside)
+    {
+        {
+            std::unique_lock<std::mutex> lock(gate_mtx_);
+            if (inside) {
+                ++stalled_;
+                gate_cv_.notify_all();
+            }
+            gate_cv_.wait(lock, [this] { return !checkpoint_waiting_; });
+            checkpoint_waiting_ = true;
+            gate_cv_.wait(lock, [this] { return in_progress_ <= stalled_; });
+        }
+        OFSErrorCodes rc = checkpoint_quiet();
+        {
+            std::lock_guard<std::mutex> lock(gate_mtx_);
+            checkpoint_waiting_ = false;
+            if (inside) {
+                --stalled_;
+            }
+        }
+        gate_cv_.notify_all();
+        return rc;
+    }
+
+    // Records durable, container in place, journal emptied.
+    OFSErrorCodes Journal::checkpoint_quiet()
+    {
+        Waiters ready;
+        OFSErrorCodes rc;
+        {
+            std::lock_guard<std::mutex> lock(flush_mtx_);
+            flush_locked(ready);
+            rc = container_->sync_in_place();
+            if (rc == OFSErrorCodes::SUCCESS) {
+                std::lock_guard<std::mutex> append_lock(append_mtx_);
+                reset(next_seq_);
+            }
+        }
+        ++checkpoints_;
+        for (auto& w : ready) {
+            w.second();
+        }
+        return rc;
+    }
+
+    void Journal::note(uint64_t offset, size_t len, bool data)
+    {
+        ThreadTransaction& t = tls_tx;
+        if (t.journal != this || t.depth == 0) {
+            return;
+        }
+        (data ? t.data : t.meta).push_back(Range{offset, len});
+    }
+
+    // Copies the after-images of meta into a new record; returns its
+    // sequence number, or 0 when nothing was recorded. Runs inside the
+    // transaction, before leave().
+    uint64_t Journal::append(std::vector<Range>& meta, std::vector<Range>& data)
+    {
+        if (meta.empty() && data.empty()) {
+            return 0;
+        }
+        merge(meta);
+        uint64_t length = sizeof(JournalRecord);
+        for (const Range& r : meta) {
+            length += sizeof(JournalRange) + pad8(r.len);
+        }
+
+        std::unique_lock<std::mutex> lock(append_mtx_);
+        if (write_pos_ + length > area_size_) {
+            // Only a record larger than half the journal, or several large
+            // ones at once, get here. The checkpoint that makes room also
+            // writes this change in place.
+            lock.unlock();
+            OFSErrorCodes rc = checkpoint_gated(true);
+            lock.lock();
+            if (rc != OFSErrorCodes::SUCCESS) {
+                LOG_ERROR(MODULE_NAME, 301, "{}: checkpoint for a {} byte change failed", container_->path(),
+                          length);
+                return 0;
+            }
+            if (write_pos_ + length > area_size_) {
+                // Larger than the journal: already durable in place. An
+                // empty record stands for it, so that waiting for the
+                // commit still waits for a flush.
+                LOG_WARN(MODULE_NAME, 104, "{}: {} byte change exceeds the journal, written in place",
+                         container_->path(), length);
+                meta.clear();
+                length = sizeof(JournalRecord);
+                if (write_pos_ + length > area_size_) {
+                    return durable_seq_.load();
+                }
+            }
+        }
+
+        const uint8_t* base = container_->base();
+        uint8_t* rec_base = container_->base() + area_offset_ + write_pos_;
+        uint8_t* out = rec_base + sizeof(JournalRecord);
+        for (const Range& r : meta) {
+            JournalRange jr{r.offset, static_cast<uint32_t>(r.len), 0};
+            std::memcpy(out, &jr, sizeof(jr));
+            std::memcpy(out + sizeof(jr), base + r.offset, r.len);
+            std::memset(out + sizeof(jr) + r.len, 0, pad8(r.len) - r.len);
+            out += sizeof(jr) + pad8(r.len);
+        }
+        JournalRecord rec{JOURNAL_RECORD_MAGIC, static_cast<uint32_t>(meta.size()), next_seq_, length, 0};
+        rec.checksum = record_checksum(rec, rec_base + sizeof(JournalRecord), length - sizeof(JournalRecord));
+        std::memcpy(rec_base, &rec, sizeof(rec));
+
+        write_pos_ += length;
+        pending_data_.insert(pending_data_.end(), data.begin(), data.end());
+        ++records_;
+        bytes_ += length;
+        return next_seq_++;
+    }
+
+    // Content first, then the records, each with one msync per range.
+    // flush_mtx_ held.
+    void Journal::flush_locked(Waiters& ready)
+    {
+        uint64_t target, from, to;
+        std::vector<Range> data;
+        {
+            std::lock_guard<std::mutex> lock(append_mtx_);
+            target = next_seq_ - 1;
+            from = flushed_pos_;
+            to = write_pos_;
+            data.swap(pending_data_);
+        }
+        if (target <= durable_seq_.load() && data.empty()) {
+            return;
+        }
+        // Chain blocks split content at every next pointer: the pieces of
+        // one page are synced together.
+        merge(data, SYNC_GAP);
+        for (const Range& r : data) {
+            container_->sync_range(r.offset, r.len);
+        }
+        if (to > from) {
+            container_->sync_range(area_offset_ + from, to - from);
+        }
+        flushed_pos_ = to;
+        durable_seq_ = target;
+        ++flushes_;
+
+        size_t keep = 0;
+        for (auto& w : waiters_) {
+            if (w.first <= target) {
+                ready.push_back(std::move(w));
+            } else {
+                waiters_[keep++] = std::move(w);
+            }
+        }
+        waiters_.resize(keep);
+        durable_cv_.notify_all();
+    }
+
+    void Journal::flush(uint64_t seq)
+    {
+        if (container_ == nullptr || (seq != 0 && durable_seq_.load() >= seq)) {
+            return;
+        }
+        Waiters ready;
+        {
+            std::lock_guard<std::mutex> lock(flush_mtx_);
+            // Someone else's flush may have covered seq meanwhile.
+            if (seq == 0 || durable_seq_.load() < seq) {
+                flush_locked(ready);
+            }
+        }
+        for (auto& w : ready) {
+            w.second();
+        }
+    }
+
+    void Journal::wait(uint64_t seq)
+    {
+        std::unique_lock<std::mutex> lock(flush_mtx_);
+        durable_cv_.wait(lock, [this, seq] { return durable_seq_.load() >= seq; });
+    }
+
+    void Journal::when_durable(uint64_t seq, std::function<void()> done)
+    {
+        if (container_ == nullptr || seq == 0 || durability_ == Durability::async || durable_seq_.load() >= seq) {
+            done();
+            return;
+        }
+        if (durability_ == Durability::fsync) {
+            flush(seq);
+            done();
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(flush_mtx_);
+            if (durable_seq_.load() < seq) {
+                waiters_.emplace_back(seq, std::move(done));
+                return;
+            }
+        }
+        done();
+    }
+
+    void Journal::flusher_loop()
+    {
+        std::unique_lock<std::mutex> lock(flusher_mtx_);
+        while (!flusher_stop_) {
+            flusher_cv_.wait_for(lock, std::chrono::milliseconds(group_commit_ms_));
+            if (flusher_stop_) {
+                break;
+            }
+            lock.unlock();
+            flush();
+            lock.lock();
+        }
+    }
+
+    Journal::Stats Journal::stats() const
+    {
+        Stats s;
+        s.records = records_.load();
+        s.bytes = bytes_.load();
+        s.flushes = flushes_.load();
+        s.checkpoints = checkpoints_.load();
+        s.replayed = replayed_;
+        return s;
+    }
+
+    // ------------------------------------------------------------------------
+    // Transactions
+    // ------------------------------------------------------------------------
+
+    Transaction::Transaction(Journal* journal)
+        : journal_(journal != nullptr && journal->active() ? journal : nullptr),
+          outer_(false),
+          committed_(true),
+          seq_(0)
+    {
+        if (journal_ == nullptr) {
+            return;
+        }
+        ThreadTransaction& t = tls_tx;
+        if (t.depth > 0) {
+            // Joins the enclosing transaction; another journal's changes
+            // are not recorded.
+            if (t.journal != journal_) {
+                journal_ = nullptr;
+                return;
+            }
+            ++t.depth;
+            committed_ = false;
+            return;
+        }
+        journal_->enter();
+        t.journal = journal_;
+        t.depth = 1;
+        t.meta.clear();
+        t.data.clear();
+        outer_ = true;
+        committed_ = false;
+    }
+
+    Transaction::~Transaction()
+    {
+        commit();
+        if (!outer_ || seq_ == 0) {
+            return;
+        }
+        ThreadTransaction& t = tls_tx;
+        if (t.deferred) {
+            t.last_seq = std::max(t.last_seq, seq_);
+            return;
+        }
+        if (journal_->durability() == Durability::fsync) {
+            journal_->flush(seq_);
+        } else if (journal_->durability() == Durability::group) {
+            journal_->wait(seq_);
+        }
+    }
+
+    void Transaction::commit()
+    {
+        if (committed_) {
+            return;
+        }
+        committed_ = true;
+        ThreadTransaction& t = tls_tx;
+        if (!outer_) {
+            --t.depth;
+            return;
+        }
+        t.depth = 0;
+        t.journal = nullptr;
+        seq_ = journal_->append(t.meta, t.data);
+        journal_->leave();
+    }
+
+    DeferredCommits::DeferredCommits() : outer_(!tls_tx.deferred)
+    {
+        if (outer_) {
+            tls_tx.deferred = true;
+            tls_tx.last_seq = 0;
+        }
+    }
+
+    DeferredCommits::~DeferredCommits()
+    {
+        if (outer_) {
+            tls_tx.deferred = false;
+        }
+    }
+
+    uint64_t DeferredCommits::last() const
+    {
+        return tls_tx.last_seq;
+    }
+}
@@ -0,0 +1,997 @@
+#include "../../include/omni_container.hpp"
+#include "../../include/journal.hpp"
+#include "../../include/delta_vault.hpp"
+#include "../../include/snapshot.hpp"
+#include "../../include/byte_map.hpp"
+#include "../../include/block_cache.hpp"
+#include "../../include/log_macros.hpp"
+#include "../../include/coarse_clock.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <ctime>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define MODULE_NAME "OMNI_CONTAINER"
+
+namespace ofs::storage
+{
+    // Encoded bytes one write_back() pwritev carries at most.
+    static constexpr size_t STAGING_BYTES = 1 << 20;
+
+    static uint64_t page_size()
+    {
+        static const uint64_t size = static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+        return size;
+    }
+
+    static bool is_power_of_two(uint64_t v)
+    {
+        return v != 0 && (v & (v - 1)) == 0;
+    }
+
+    SyncPolicy sync_policy_from_string(const std::string& name)
+    {
+        if (name == "immediate") {
+            return SyncPolicy::immediate;
+        }
+        if (name == "on_shutdown") {
+            return SyncPolicy::on_shutdown;
+        }
+        return SyncPolicy::periodic;
+    }
+
+    IoBackend io_backend_from_string(const std::string& name)
+    {
+        if (name == "pread") {
+            return IoBackend::pread;
+        }
+        if (name == "io_uring") {
+            return IoBackend::io_uring;
+        }
+        return IoBackend::mmap;
+    }
+
+    const char* io_backend_name(IoBackend backend)
+    {
+        switch (backend) {
+        case IoBackend::pread:
+            return "pread";
+        case IoBackend::io_uring:
+            return "io_uring";
+        default:
+            return "mmap";
+        }
+    }
+
+    OmniContainer::OmniContainer()
+        : fd_(-1),
+          base_(nullptr),
+          size_(0),
+          private_end_(0),
+          header_(nullptr),
+          layout_(nullptr),
+          policy_(SyncPolicy::periodic),
+          sync_interval_ms_(1000),
+          flusher_stop_(false),
+          io_backend_(IoBackend::mmap),
+          journal_(nullptr),
+          encoded_(false)
+    {
+    }
+
+    OmniContainer::~OmniContainer()
+    {
+        close();
+    }
+
+    // The Delta Vault areas follow the snapshot; the header addresses them
+    // with 32-bit offsets.
+    static void history_offsets(const OmniLayoutInfo& l, uint64_t& chunks, uint64_t& log)
+    {
+        chunks = align_up(l.snapshot_offset + l.snapshot_size, 64);
+        log = align_up(chunks + l.history_chunk_slots * sizeof(ChunkRecord), 64);
+    }
+
+    OFSErrorCodes OmniContainer::compute_layout(const config::Config& cfg, OmniLayoutInfo& out)
+    {
+        std::memset(&out, 0, sizeof(out));
+
+        if (cfg.header_size != 512) {
+            LOG_ERROR(MODULE_NAME, 401, "header_size {} must be 512", cfg.header_size);
+            return OFSErrorCodes::ERROR_INVALID_CONFIG;
+        }
+        if (!is_power_of_two(cfg.block_size) || cfg.block_size < 512) {
+            LOG_ERROR(MODULE_NAME, 402, "block_size {} must be a power of two >= 512", cfg.block_size);
+            return OFSErrorCodes::ERROR_INVALID_CONFIG;
+        }
+        if (cfg.total_size % cfg.block_size != 0) {
+            LOG_ERROR(MODULE_NAME, 403, "total_size {} is not a multiple of block_size {}", cfg.total_size, cfg.block_size);
+            return OFSErrorCodes::ERROR_INVALID_CONFIG;
+        }
+        if (cfg.max_files < 1 || cfg.max_users < 1) {
+            LOG_ERROR(MODULE_NAME, 404, "max_files and max_users must be at least 1");
+            return OFSErrorCodes::ERROR_INVALID_CONFIG;
+        }
+
+        uint64_t user_table_offset = cfg.header_size;
+        uint64_t user_table_end = user_table_offset + static_cast<uint64_t>(cfg.max_users) * sizeof(UserInfo);
+        out.metadata_offset = align_up(user_table_end, 8);
+        uint64_t metadata_end = out.metadata_offset + static_cast<uint64_t>(cfg.max_files) * sizeof(MetadataEntry);
+
+        // Open-addressing table of entry indices, kept at most half full.
+        out.dentry_offset = align_up(metadata_end, 8);
+        out.dentry_slots = 16;
+        while (out.dentry_slots < static_cast<uint64_t>(cfg.max_files) * 2) {
+            out.dentry_slots <<= 1;
+        }
+        // The snapshot's allocator section is sized for the upper bound of
+        // blocks; the exact count is only known once the map is placed.
+        out.snapshot_offset = align_up(out.dentry_offset + out.dentry_slots * sizeof(uint32_t), 64);
+        uint64_t block_bound = cfg.total_size > out.snapshot_offset ? (cfg.total_size - out.snapshot_offset) / cfg.block_size : 0;
+        out.snapshot_size = compute_snapshot_layout(cfg.max_files, cfg.max_users, block_bound).total_size;
+        out.free_map_offset = align_up(out.snapshot_offset + out.snapshot_size, 8);
+        if (cfg.history_size != 0) {
+            out.history_chunk_slots = std::max<uint64_t>(cfg.history_chunks, 64);
+            out.change_log_size = align_up(std::max<uint64_t>(cfg.history_size, CHANGE_LOG_MIN_SIZE), 64);
+            uint64_t chunks, log;
+            history_offsets(out, chunks, log);
+            if (log > UINT32_MAX) {
+                LOG_ERROR(MODULE_NAME, 407, "file history areas must start in the first 4 GiB (change log at {})", log);
+                return OFSErrorCodes::ERROR_INVALID_CONFIG;
+            }
+            out.free_map_offset = align_up(log + out.change_log_size, 8);
+        }
+        if (cfg.encode_content) {
+            out.content_map_offset = align_up(out.free_map_offset, 64);
+            out.free_map_offset = out.content_map_offset + bytemap::TABLE_SIZE;
+        }
+
+        if (out.free_map_offset + cfg.block_size >= cfg.total_size) {
+            LOG_ERROR(MODULE_NAME, 405, "total_size {} leaves no room for content blocks", cfg.total_size);
+            return OFSErrorCodes::ERROR_INVALID_CONFIG;
+        }
+
+        // The map is sized for the upper bound of blocks, then the journal
+        // and the content area follow on their own boundaries.
+        uint64_t max_blocks = (cfg.total_size - out.free_map_offset) / cfg.block_size;
+        uint64_t map_size = align_up((max_blocks + 7) / 8, 8);
+        uint64_t content_start = out.free_map_offset + map_size;
+        if (cfg.journal_size != 0) {
+            out.journal_offset = align_up(content_start, JOURNAL_ALIGN);
+            out.journal_size = align_up(cfg.journal_size, JOURNAL_ALIGN);
+            content_start = out.journal_offset + out.journal_size;
+        }
+        out.content_offset = align_up(content_start, cfg.block_size);
+        if (out.content_offset >= cfg.total_size) {
+            LOG_ERROR(MODULE_NAME, 405, "total_size {} leaves no room for content blocks", cfg.total_size);
+            return OFSErrorCodes::ERROR_INVALID_CONFIG;
+        }
+
+        out.total_blocks = (cfg.total_size - out.content_offset) / cfg.block_size;
+        out.free_map_size = align_up((out.total_blocks + 7) / 8, 8);
+        out.max_files = cfg.max_files;
+        out.block_mapping = static_cast<uint32_t>(cfg.block_mapping == "chain" ? BlockMapping::chain : BlockMapping::extent);
+        out.metadata_entry_size = sizeof(MetadataEntry);
+
+        if (out.total_blocks > UINT32_MAX) {
+            LOG_ERROR(MODULE_NAME, 406, "{} blocks exceed the 32-bit block index", out.total_blocks);
+            return OFSErrorCodes::ERROR_INVALID_CONFIG;
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes OmniContainer::format(const std::string& path, const config::Config& cfg)
+    {
+        OmniLayoutInfo layout;
+        OFSErrorCodes rc = compute_layout(cfg, layout);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0) {
+            LOG_ERROR(MODULE_NAME, 301, "cannot create container {}: {}", path, std::strerror(errno));
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        if (::ftruncate(fd, static_cast<off_t>(cfg.total_size)) != 0) {
+            LOG_ERROR(MODULE_NAME, 302, "cannot size container {} to {} bytes: {}", path, cfg.total_size, std::strerror(errno));
+            ::close(fd);
+            return OFSErrorCodes::ERROR_NO_SPACE;
+        }
+
+        // Only the metadata part is touched; the content area stays sparse.
+        size_t meta_len = static_cast<size_t>(layout.content_offset);
+        void* mem = ::mmap(nullptr, meta_len, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (mem == MAP_FAILED) {
+            LOG_ERROR(MODULE_NAME, 303, "mmap failed while formatting {}: {}", path, std::strerror(errno));
+            ::close(fd);
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        uint8_t* base = static_cast<uint8_t*>(mem);
+
+        OMNIHeader* header = reinterpret_cast<OMNIHeader*>(base);
+        std::memset(base, 0, cfg.header_size);
+        std::memcpy(header->magic, OMNI_MAGIC, sizeof(header->magic));
+        header->format_version = OMNI_FORMAT_VERSION;
+        header->total_size = cfg.total_size;
+        header->header_size = cfg.header_size;
+        header->block_size = cfg.block_size;
+        header->config_timestamp = clock::unix_seconds();
+        header->user_table_offset = cfg.header_size;
+        header->max_users = cfg.max_users;
+
+        std::time_t now = static_cast<std::time_t>(header->config_timestamp);
+        std::tm utc {};
+        gmtime_r(&now, &utc);
+        std::strftime(header->submission_date, sizeof(header->submission_date), "%Y-%m-%d", &utc);
+
+        layout.dentry_clean = 1;
+        *layout_info(header) = layout;
+
+        uint64_t block_bound = (cfg.total_size - layout.snapshot_offset) / cfg.block_size;
+        Snapshot::initialize(base + layout.snapshot_offset,
+                             compute_snapshot_layout(layout.max_files, cfg.max_users, block_bound));
+
+        if (layout.history_chunk_slots != 0) {
+            uint64_t chunks, log;
+            history_offsets(layout, chunks, log);
+            header->file_state_storage_offset = static_cast<uint32_t>(chunks);
+            header->change_log_offset = static_cast<uint32_t>(log);
+            ChangeLogHeader* change_log = reinterpret_cast<ChangeLogHeader*>(base + log);
+            std::memcpy(change_log->magic, CHANGE_LOG_MAGIC, sizeof(change_log->magic));
+        }
+
+        if (layout.content_map_offset != 0) {
+            std::random_device rd;
+            uint64_t seed = (static_cast<uint64_t>(rd()) << 32) ^ rd() ^ header->config_timestamp;
+            bytemap::make_permutation(seed, base + layout.content_map_offset);
+        }
+
+        if (layout.journal_size != 0) {
+            JournalHeader* journal = reinterpret_cast<JournalHeader*>(base + layout.journal_offset);
+            std::memcpy(journal->magic, JOURNAL_MAGIC, sizeof(journal->magic));
+            journal->first_seq = 1;
+        }
+
+        MetadataEntry* entries = reinterpret_cast<MetadataEntry*>(base + layout.metadata_offset);
+        for (uint32_t i = 0; i < layout.max_files; ++i) {
+            entries[i].validity = ENTRY_FREE;
+        }
+
+        MetadataEntry& root = entries[ROOT_ENTRY_INDEX - 1];
+        root.validity = ENTRY_IN_USE;
+        root.type = static_cast<uint8_t>(EntryType::DIRECTORY);
+        root.parent_index = 0;
+        std::strncpy(root.name, "/", sizeof(root.name) - 1);
+        root.owner_id = 0;
+        root.permissions = 0755;
+        root.created_time = header->config_timestamp;
+        root.modified_time = header->config_timestamp;
+
+        int sync_rc = ::msync(base, meta_len, MS_SYNC);
+        ::munmap(base, meta_len);
+        ::close(fd);
+        if (sync_rc != 0) {
+            LOG_ERROR(MODULE_NAME, 304, "msync failed while formatting {}: {}", path, std::strerror(errno));
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+
+        LOG_INFO(MODULE_NAME, 10, "formatted {}: {} blocks of {} bytes, {} metadata slots, {} users",
+                 path, layout.total_blocks, cfg.block_size, layout.max_files, cfg.max_users);
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes OmniContainer::open(const std::string& path, SyncPolicy policy, uint32_t sync_interval_ms)
+    {
+        close();
+
+        fd_ = ::open(path.c_str(), O_RDWR | O_CLOEXEC);
+        if (fd_ < 0) {
+            int err = errno;
+            LOG_ERROR(MODULE_NAME, 305, "cannot open container {}: {}", path, std::strerror(err));
+            return err == ENOENT ? OFSErrorCodes::ERROR_NOT_FOUND : OFSErrorCodes::ERROR_IO_ERROR;
+        }
+
+        struct stat st;
+        if (::fstat(fd_, &st) != 0 || static_cast<uint64_t>(st.st_size) < sizeof(OMNIHeader)) {
+            LOG_ERROR(MODULE_NAME, 306, "container {} is too small to hold a header", path);
+            ::close(fd_);
+            fd_ = -1;
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+
+        size_ = static_cast<size_t>(st.st_size);
+        void* mem = ::mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED, fd_, 0);
+        if (mem == MAP_FAILED) {
+            LOG_ERROR(MODULE_NAME, 303, "mmap of {} failed: {}", path, std::strerror(errno));
+            ::close(fd_);
+            fd_ = -1;
+            size_ = 0;
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+
+        base_ = static_cast<uint8_t*>(mem);
+        header_ = reinterpret_cast<OMNIHeader*>(base_);
+        layout_ = layout_info(header_);
+        path_ = path;
+
+        OFSErrorCodes rc = validate();
+        if (rc != OFSErrorCodes::SUCCESS) {
+            ::munmap(base_, size_);
+            ::close(fd_);
+            fd_ = -1;
+            base_ = nullptr;
+            header_ = nullptr;
+            layout_ = nullptr;
+            size_ = 0;
+            path_.clear();
+            return rc;
+        }
+
+        // The journal orders what reaches the file: metadata below the
+        // content area only gets there through write_out().
+        if (layout_->journal_size != 0) {
+            uint64_t end = std::min<uint64_t>(layout_->content_offset / page_size() * page_size(), size_);
+            if (::mmap(base_, end, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_FIXED, fd_, 0) == MAP_FAILED) {
+                LOG_ERROR(MODULE_NAME, 303, "private mmap of {} failed: {}", path, std::strerror(errno));
+                ::munmap(base_, size_);
+                ::close(fd_);
+                fd_ = -1;
+                base_ = nullptr;
+                header_ = nullptr;
+                layout_ = nullptr;
+                size_ = 0;
+                path_.clear();
+                return OFSErrorCodes::ERROR_IO_ERROR;
+            }
+            private_end_ = end;
+        }
+
+        encoded_ = layout_->content_map_offset != 0;
+        if (encoded_) {
+            uint8_t inverse[bytemap::TABLE_SIZE];
+            bytemap::invert(base_ + layout_->content_map_offset, inverse);
+            bytemap::prepare(base_ + layout_->content_map_offset, encode_);
+            bytemap::prepare(inverse, decode_);
+        }
+
+        policy_ = policy;
+        sync_interval_ms_ = sync_interval_ms == 0 ? 1 : sync_interval_ms;
+        if (policy_ == SyncPolicy::periodic) {
+            flusher_stop_ = false;
+            flusher_ = std::thread(&OmniContainer::flusher_loop, this);
+        }
+
+        LOG_INFO(MODULE_NAME, 11, "mapped {} ({} bytes, {} blocks, content map: {})", path, size_, layout_->total_blocks,
+                 encoded_ ? bytemap::path_name(bytemap::best_path()) : "none");
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    OFSErrorCodes OmniContainer::validate()
+    {
+        if (std::memcmp(header_->magic, OMNI_MAGIC, sizeof(OMNI_MAGIC)) != 0) {
+            LOG_ERROR(MODULE_NAME, 410, "{} is not an OMNI container (bad magic)", path_);
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        if ((header_->format_version >> 16) != (OMNI_FORMAT_VERSION >> 16)) {
+            LOG_ERROR(MODULE_NAME, 411, "{} has unsupported format_version {}", path_, header_->format_version);
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        if (header_->header_size != 512 || header_->total_size != size_) {
+            LOG_ERROR(MODULE_NAME, 412, "{} header sizes do not match the file (total_size {} vs {} bytes)",
+                      path_, header_->total_size, size_);
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        if (!is_power_of_two(header_->block_size) || header_->block_size < 512) {
+            LOG_ERROR(MODULE_NAME, 413, "{} has invalid block_size {}", path_, header_->block_size);
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+
+        const OmniLayoutInfo& l = *layout_;
+        uint64_t user_end = static_cast<uint64_t>(header_->user_table_offset) +
+                            static_cast<uint64_t>(header_->max_users) * sizeof(UserInfo);
+        bool ok = l.metadata_entry_size == sizeof(MetadataEntry) &&
+                  l.max_files >= 1 &&
+                  header_->user_table_offset >= header_->header_size &&
+                  l.metadata_offset >= user_end &&
+                  l.free_map_offset >= l.metadata_offset + static_cast<uint64_t>(l.max_files) * sizeof(MetadataEntry) &&
+                  (l.dentry_slots == 0 ||
+                   ((l.dentry_slots & (l.dentry_slots - 1)) == 0 &&
+                    l.dentry_slots >= static_cast<uint64_t>(l.max_files) * 2 &&
+                    l.dentry_offset >= l.metadata_offset + static_cast<uint64_t>(l.max_files) * sizeof(MetadataEntry) &&
+                    l.dentry_offset + l.dentry_slots * sizeof(uint32_t) <= l.free_map_offset)) &&
+                  (l.snapshot_size == 0 ||
+                   (l.snapshot_offset % 64 == 0 &&
+                    l.snapshot_offset >= l.dentry_offset + l.dentry_slots * sizeof(uint32_t) &&
+                    l.snapshot_offset + l.snapshot_size <= l.free_map_offset)) &&
+                  l.free_map_size * 8 >= l.total_blocks &&
+                  l.content_offset >= l.free_map_offset + l.free_map_size &&
+                  (l.history_chunk_slots == 0 ||
+                   (header_->file_state_storage_offset >= l.snapshot_offset + l.snapshot_size &&
+                    header_->change_log_offset >= header_->file_state_storage_offset + l.history_chunk_slots * sizeof(ChunkRecord) &&
+                    l.change_log_size >= CHANGE_LOG_MIN_SIZE &&
+                    header_->change_log_offset + l.change_log_size <= l.free_map_offset)) &&
+                  (l.content_map_offset == 0 ||
+                   (l.content_map_offset >= l.snapshot_offset + l.snapshot_size &&
+                    l.content_map_offset + bytemap::TABLE_SIZE <= l.free_map_offset)) &&
+                  (l.journal_size == 0 ||
+                   (l.journal_offset % JOURNAL_ALIGN == 0 && l.journal_size % JOURNAL_ALIGN == 0 &&
+                    l.journal_offset >= l.free_map_offset + l.free_map_size &&
+                    l.journal_offset + l.journal_size <= l.content_offset)) &&
+                  l.content_offset % header_->block_size == 0 &&
+                  l.total_blocks >= 1 &&
+                  l.block_mapping <= static_cast<uint32_t>(BlockMapping::extent) &&
+                  l.content_offset + l.total_blocks * header_->block_size <= size_;
+        if (!ok) {
+            LOG_ERROR(MODULE_NAME, 414, "{} has an inconsistent layout", path_);
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+
+        MetadataEntry* root = metadata_table() + (ROOT_ENTRY_INDEX - 1);
+        if (!root->in_use() || !root->is_directory()) {
+            LOG_ERROR(MODULE_NAME, 415, "{} has no root directory entry", path_);
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        if (l.content_map_offset != 0 && !bytemap::is_permutation(base_ + l.content_map_offset)) {
+            LOG_ERROR(MODULE_NAME, 416, "{} has a content map that is not one-to-one", path_);
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    void OmniContainer::close()
+    {
+        if (flusher_.joinable()) {
+            {
+                std::lock_guard<std::mutex> lock(flusher_mtx_);
+                flusher_stop_ = true;
+            }
+            flusher_cv_.notify_one();
+            flusher_.join();
+        }
+
+        if (base_ == nullptr) {
+            return;
+        }
+
+        // The journal points into the mapping: it checkpoints and lets go.
+        if (journal_ != nullptr) {
+            journal_->detach();
+        }
+        ring_.reset();
+        io_backend_ = IoBackend::mmap;
+        sync();
+        cache_.reset();
+        ::munmap(base_, size_);
+        ::close(fd_);
+
+        LOG_INFO(MODULE_NAME, 12, "unmapped {}", path_);
+        encoded_ = false;
+        fd_ = -1;
+        base_ = nullptr;
+        private_end_ = 0;
+        header_ = nullptr;
+        layout_ = nullptr;
+        size_ = 0;
+        path_.clear();
+    }
+
+    void OmniContainer::mark_dirty(const void* ptr, size_t len)
+    {
+        if (base_ == nullptr || len == 0) {
+            return;
+        }
+
+        const uint8_t* p = static_cast<const uint8_t*>(ptr);
+        if (p < base_ || p + len > base_ + size_) {
+            LOG_WARN(MODULE_NAME, 101, "mark_dirty outside the mapping ignored ({} bytes)", len);
+            return;
+        }
+
+        uint64_t offset = static_cast<uint64_t>(p - base_);
+        if (journal_ != nullptr) {
+            journal_->note(offset, len, false);
+        }
+        uint64_t page = page_size();
+        uint64_t start = offset / page * page;
+        uint64_t end = std::min<uint64_t>(align_up(offset + len, page), size_);
+
+        if (policy_ == SyncPolicy::immediate && journal_ == nullptr) {
+            std::map<uint64_t, uint64_t> range{{start, end}};
+            flush_ranges(range);
+            return;
+        }
+        add_dirty(start, end);
+    }
+
+    void OmniContainer::add_dirty(uint64_t start, uint64_t end)
+    {
+        std::lock_guard<std::mutex> lock(dirty_mtx_);
+        auto it = dirty_.upper_bound(start);
+        if (it != dirty_.begin()) {
+            auto prev = std::prev(it);
+            if (prev->second >= start) {
+                start = prev->first;
+                end = std::max(end, prev->second);
+                it = dirty_.erase(prev);
+            }
+        }
+        while (it != dirty_.end() && it->first <= end) {
+            end = std::max(end, it->second);
+            it = dirty_.erase(it);
+        }
+        dirty_.emplace(start, end);
+    }
+
+    // Page-aligned [start, end) to the file: msync for the shared mapping,
+    // pwrite for the private part, which the caller then fdatasyncs when
+    // wrote is set.
+    OFSErrorCodes OmniContainer::write_out(uint64_t start, uint64_t end, bool& wrote)
+    {
+        OFSErrorCodes rc = OFSErrorCodes::SUCCESS;
+        uint64_t split = std::min(std::max(start, private_end_), end);
+        for (uint64_t pos = start; pos < split;) {
+            ssize_t n = ::pwrite(fd_, base_ + pos, split - pos, static_cast<off_t>(pos));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                LOG_ERROR(MODULE_NAME, 310, "pwrite of metadata failed: {}", std::strerror(errno));
+                rc = OFSErrorCodes::ERROR_IO_ERROR;
+                break;
+            }
+            pos += static_cast<uint64_t>(n);
+            wrote = true;
+        }
+        if (end > split && ::msync(base_ + split, end - split, MS_SYNC) != 0) {
+            LOG_ERROR(MODULE_NAME, 310, "msync failed: {}", std::strerror(errno));
+            rc = OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        return rc;
+    }
+
+    OFSErrorCodes OmniContainer::flush_ranges(std::map<uint64_t, uint64_t>& ranges)
+    {
+        OFSErrorCodes rc = OFSErrorCodes::SUCCESS;
+        bool wrote = false;
+        for (const auto& r : ranges) {
+            if (write_out(r.first, r.second, wrote) != OFSErrorCodes::SUCCESS) {
+                rc = OFSErrorCodes::ERROR_IO_ERROR;
+            }
+        }
+        if (wrote && ::fdatasync(fd_) != 0) {
+            LOG_ERROR(MODULE_NAME, 310, "fdatasync failed: {}", std::strerror(errno));
+            rc = OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        return rc;
+    }
+
+    OFSErrorCodes OmniContainer::sync()
+    {
+        if (journal_ != nullptr) {
+            return journal_->checkpoint();
+        }
+        return sync_in_place();
+    }
+
+    OFSErrorCodes OmniContainer::sync_in_place()
+    {
+        if (base_ == nullptr) {
+            return OFSErrorCodes::SUCCESS;
+        }
+        OFSErrorCodes rc = cache_ != nullptr ? cache_->flush() : OFSErrorCodes::SUCCESS;
+        std::map<uint64_t, uint64_t> ranges;
+        {
+            std::lock_guard<std::mutex> lock(dirty_mtx_);
+            ranges.swap(dirty_);
+        }
+        OFSErrorCodes flushed = flush_ranges(ranges);
+        return rc != OFSErrorCodes::SUCCESS ? rc : flushed;
+    }
+
+    OFSErrorCodes OmniContainer::sync_range(uint64_t offset, uint64_t len)
+    {
+        if (base_ == nullptr || len == 0 || offset >= size_) {
+            return OFSErrorCodes::SUCCESS;
+        }
+        if (cache_ != nullptr && cache_->flush(offset, len) != OFSErrorCodes::SUCCESS) {
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        uint64_t page = page_size();
+        std::map<uint64_t, uint64_t> range{{offset / page * page, std::min<uint64_t>(align_up(offset + len, page), size_)}};
+        return flush_ranges(range);
+    }
+
+    void OmniContainer::flusher_loop()
+    {
+        std::unique_lock<std::mutex> lock(flusher_mtx_);
+        while (!flusher_stop_) {
+            flusher_cv_.wait_for(lock, std::chrono::milliseconds(sync_interval_ms_));
+            if (flusher_stop_) {
+                break;
+            }
+            lock.unlock();
+            sync();
+            lock.lock();
+        }
+    }
+
+    // ------------------------------------------------------------------------
+    // Content I/O
+    // ------------------------------------------------------------------------
+
+    IoBackend OmniContainer::set_io_backend(IoBackend backend, uint32_t queue_depth)
+    {
+        std::lock_guard<std::mutex> lock(ring_mtx_);
+        ring_.reset();
+        if (backend == IoBackend::io_uring) {
+            std::unique_ptr<IoRing> ring(new IoRing());
+            if (ring->init(queue_depth == 0 ? 1 : queue_depth) && ring->register_files(&fd_, 1)) {
+                ring_ = std::move(ring);
+            } else {
+                LOG_WARN(MODULE_NAME, 102, "io_uring unavailable for {}, using pread", path_);
+                backend = IoBackend::pread;
+            }
+        }
+        io_backend_ = backend;
+        if (backend != IoBackend::mmap) {
+            LOG_INFO(MODULE_NAME, 13, "{}: {} content I/O", path_, io_backend_name(backend));
+        }
+        return backend;
+    }
+
+    void OmniContainer::set_cache(size_t capacity, uint32_t flush_ms, uint32_t read_ahead)
+    {
+        cache_.reset();
+        if (base_ == nullptr) {
+            return;
+        }
+        capacity = static_cast<size_t>(std::min<uint64_t>(capacity, layout_->total_blocks * block_size()));
+        if (capacity < block_size()) {
+            return;
+        }
+        cache_.reset(new BlockCache(
+            layout_->content_offset, block_size(), capacity,
+            [this](const IoSegment* segs, size_t count) { return read_direct(segs, count); },
+            [this](const IoSegment* segs, size_t count) { return write_back(segs, count); }, flush_ms, read_ahead,
+            static_cast<uint32_t>(layout_->total_blocks)));
+        LOG_INFO(MODULE_NAME, 14, "{}: block cache of {} blocks, read-ahead up to {}", path_, cache_->stats().frames,
+                 read_ahead);
+    }
+
+    void OmniContainer::will_need(uint32_t first_block, uint32_t count)
+    {
+        if (first_block == 0 || first_block > layout_->total_blocks || count == 0) {
+            return;
+        }
+        count = static_cast<uint32_t>(std::min<uint64_t>(count, layout_->total_blocks - first_block + 1));
+        uint64_t page = page_size();
+        uint64_t offset = block_offset(first_block);
+        uint64_t start = offset / page * page;
+        uint64_t end = std::min<uint64_t>(align_up(offset + static_cast<uint64_t>(count) * block_size(), page), size_);
+        ::madvise(base_ + start, end - start, MADV_WILLNEED);
+    }
+
+    void OmniContainer::discard_cached(uint32_t first, uint32_t count)
+    {
+        if (cache_ != nullptr) {
+            cache_->discard(first, count);
+        }
+    }
+
+    OFSErrorCodes OmniContainer::read_segments(const IoSegment* segs, size_t count)
+    {
+        if (cache_ != nullptr) {
+            return cache_->read(segs, count);
+        }
+        return read_direct(segs, count);
+    }
+
+    OFSErrorCodes OmniContainer::write_segments(const IoSegment* segs, size_t count)
+    {
+        if (cache_ == nullptr) {
+            return write_direct(segs, count);
+        }
+        OFSErrorCodes rc = cache_->write(segs, count);
+        if (journal_ != nullptr) {
+            for (size_t i = 0; i < count; ++i) {
+                if (segs[i].len > 0) {
+                    journal_->note(segs[i].offset, segs[i].len, true);
+                }
+            }
+        }
+        return rc;
+    }
+
+    OFSErrorCodes OmniContainer::read_direct(const IoSegment* segs, size_t count)
+    {
+        if (io_backend_ == IoBackend::mmap) {
+            for (size_t i = 0; i < count; ++i) {
+                if (encoded_) {
+                    bytemap::translate(decode_, base_ + segs[i].offset, segs[i].data, segs[i].len);
+                } else {
+                    std::memcpy(segs[i].data, base_ + segs[i].offset, segs[i].len);
+                }
+            }
+            return OFSErrorCodes::SUCCESS;
+        }
+        OFSErrorCodes rc = io_backend_ == IoBackend::io_uring ? transfer_ring(segs, count, false)
+                                                              : transfer_sync(segs, count, false);
+        if (encoded_ && rc == OFSErrorCodes::SUCCESS) {
+            for (size_t i = 0; i < count; ++i) {
+                bytemap::translate(decode_, segs[i].data, segs[i].data, segs[i].len);
+            }
+        }
+        return rc;
+    }
+
+    OFSErrorCodes OmniContainer::write_direct(const IoSegment* segs, size_t count)
+    {
+        OFSErrorCodes rc = OFSErrorCodes::SUCCESS;
+        if (io_backend_ == IoBackend::mmap) {
+            for (size_t i = 0; i < count; ++i) {
+                if (encoded_) {
+                    bytemap::translate(encode_, segs[i].data, base_ + segs[i].offset, segs[i].len);
+                } else {
+                    std::memcpy(base_ + segs[i].offset, segs[i].data, segs[i].len);
+                }
+            }
+        } else if (encoded_) {
+            // The caller's bytes stay as they are: encode a copy.
+            static thread_local std::vector<uint8_t> staging;
+            static thread_local std::vector<IoSegment> staged;
+            size_t total = 0;
+            for (size_t i = 0; i < count; ++i) {
+                total += segs[i].len;
+            }
+            staging.resize(total);
+            staged.assign(segs, segs + count);
+            size_t at = 0;
+            for (IoSegment& seg : staged) {
+                bytemap::translate(encode_, seg.data, staging.data() + at, seg.len);
+                seg.data = staging.data() + at;
+                at += seg.len;
+            }
+            rc = io_backend_ == IoBackend::io_uring ? transfer_ring(staged.data(), count, true)
+                                                    : transfer_sync(staged.data(), count, true);
+        } else {
+            rc = io_backend_ == IoBackend::io_uring ? transfer_ring(segs, count, true)
+                                                    : transfer_sync(segs, count, true);
+        }
+        uint64_t page = page_size();
+        for (size_t i = 0; i < count; ++i) {
+            if (segs[i].len == 0) {
+                continue;
+            }
+            if (journal_ != nullptr) {
+                journal_->note(segs[i].offset, segs[i].len, true);
+            }
+            add_dirty(segs[i].offset / page * page, std::min<uint64_t>(align_up(segs[i].offset + segs[i].len, page), size_));
+        }
+        return rc;
+    }
+
+    // pwritev of every byte in iov, picking up after short writes.
+    static bool pwritev_full(int fd, struct iovec* iov, size_t count, uint64_t offset)
+    {
+        while (count > 0) {
+            ssize_t n = ::pwritev(fd, iov, static_cast<int>(count), static_cast<off_t>(offset));
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                return false;
+            }
+            offset += static_cast<uint64_t>(n);
+            while (count > 0 && static_cast<size_t>(n) >= iov->iov_len) {
+                n -= static_cast<ssize_t>(iov->iov_len);
+                ++iov;
+                --count;
+            }
+            if (count > 0) {
+                iov->iov_base = static_cast<uint8_t*>(iov->iov_base) + n;
+                iov->iov_len -= static_cast<size_t>(n);
+            }
+        }
+        return true;
+    }
+
+    // Block cache write-back and large writes. segs are sorted by offset;
+    // segments that continue one another are one run, written with
+    // pwritev. Encoded runs are staged STAGING_BYTES at a time, one pwritev
+    // per fill.
+    OFSErrorCodes OmniContainer::write_back(const IoSegment* segs, size_t count)
+    {
+        static thread_local std::vector<uint8_t> staging;
+        static thread_local std::vector<struct iovec> iov;
+        bool through_map = io_backend_ == IoBackend::mmap;
+        if (encoded_ && !through_map) {
+            staging.resize(STAGING_BYTES);
+        }
+
+        OFSErrorCodes rc = OFSErrorCodes::SUCCESS;
+        uint64_t page = page_size();
+        for (size_t i = 0; i < count;) {
+            size_t first = i;
+            uint64_t start = segs[i].offset;
+            uint64_t end = start;
+            for (; i < count && segs[i].offset == end; ++i) {
+                end += segs[i].len;
+            }
+            add_dirty(start / page * page, std::min<uint64_t>(align_up(end, page), size_));
+
+            if (through_map) {
+                for (size_t k = first; k < i; ++k) {
+                    if (encoded_) {
+                        bytemap::translate(encode_, segs[k].data, base_ + segs[k].offset, segs[k].len);
+                    } else {
+                        std::memcpy(base_ + segs[k].offset, segs[k].data, segs[k].len);
+                    }
+                }
+                continue;
+            }
+
+            uint64_t at_offset = start;
+            size_t queued = 0;
+            size_t staged = 0;
+            iov.clear();
+            auto put = [&]() {
+                if (!iov.empty() && !pwritev_full(fd_, iov.data(), iov.size(), at_offset)) {
+                    LOG_ERROR(MODULE_NAME, 313, "pwritev of {} bytes at {} failed: {}", queued, at_offset,
+                              std::strerror(errno));
+                    rc = OFSErrorCodes::ERROR_IO_ERROR;
+                }
+                at_offset += queued;
+                queued = 0;
+                staged = 0;
+                iov.clear();
+            };
+            for (size_t k = first; k < i; ++k) {
+                size_t done = 0;
+                while (done < segs[k].len) {
+                    if (iov.size() == IOV_MAX || (encoded_ && staged == STAGING_BYTES)) {
+                        put();
+                    }
+                    size_t n = segs[k].len - done;
+                    uint8_t* bytes = segs[k].data + done;
+                    if (encoded_) {
+                        n = std::min(n, STAGING_BYTES - staged);
+                        bytemap::translate(encode_, bytes, staging.data() + staged, n);
+                        bytes = staging.data() + staged;
+                        staged += n;
+                    }
+                    iov.push_back(iovec{bytes, n});
+                    queued += n;
+                    done += n;
+                }
+            }
+            put();
+        }
+        return rc;
+    }
+
+    OFSErrorCodes OmniContainer::transfer_sync(const IoSegment* segs, size_t count, bool write)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            size_t done = 0;
+            while (done < segs[i].len) {
+                ssize_t n = write ? ::pwrite(fd_, segs[i].data + done, segs[i].len - done,
+                                             static_cast<off_t>(segs[i].offset + done))
+                                  : ::pread(fd_, segs[i].data + done, segs[i].len - done,
+                                            static_cast<off_t>(segs[i].offset + done));
+                if (n < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (n <= 0) {
+                    LOG_ERROR(MODULE_NAME, 311, "{} of {} bytes at {} failed: {}", write ? "pwrite" : "pread",
+                              segs[i].len - done, segs[i].offset + done, n < 0 ? std::strerror(errno) : "end of file");
+                    return OFSErrorCodes::ERROR_IO_ERROR;
+                }
+                done += static_cast<size_t>(n);
+            }
+        }
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    // Queues every segment, submits them together and waits for all of
+    // them; short transfers are resubmitted for the remainder. A ring
+    // that io_uring_enter rejects is drained and dropped, and this and
+    // every later transfer go through pread/pwrite.
+    OFSErrorCodes OmniContainer::transfer_ring(const IoSegment* segs, size_t count, bool write)
+    {
+        std::unique_lock<std::mutex> lock(ring_mtx_);
+        if (ring_ == nullptr) {
+            lock.unlock();
+            return transfer_sync(segs, count, write);
+        }
+        std::vector<size_t> done(count, 0);
+
+        auto queue = [&](size_t i) {
+            uint32_t len = static_cast<uint32_t>(std::min<size_t>(segs[i].len - done[i], 1u << 30));
+            if (write) {
+                ring_->prep_write(0, true, segs[i].data + done[i], len, segs[i].offset + done[i], i);
+            } else {
+                ring_->prep_read(0, true, segs[i].data + done[i], len, segs[i].offset + done[i], i);
+            }
+        };
+
+        OFSErrorCodes rc = OFSErrorCodes::SUCCESS;
+        size_t next = 0;
+        size_t outstanding = 0;
+        while (next < count || outstanding > 0) {
+            while (next < count && outstanding < ring_->entries()) {
+                if (segs[next].len > 0) {
+                    queue(next);
+                    ++outstanding;
+                }
+                ++next;
+            }
+            if (outstanding == 0) {
+                break;
+            }
+            // EAGAIN / EBUSY: the kernel is short of resources; reap and retry.
+            int sub = ring_->submit(1);
+            if (sub < 0 && sub != -EAGAIN && sub != -EBUSY) {
+                LOG_ERROR(MODULE_NAME, 312, "io_uring_enter failed: {}", std::strerror(-sub));
+                drain_ring(outstanding);
+                ring_.reset();
+                LOG_WARN(MODULE_NAME, 103, "io_uring dropped for {}, using pread", path_);
+                lock.unlock();
+                return transfer_sync(segs, count, write);
+            }
+
+            IoRing::Completion cqe;
+            while (ring_->pop(cqe)) {
+                --outstanding;
+                size_t i = static_cast<size_t>(cqe.user_data);
+                if (cqe.res == -EINTR || cqe.res == -EAGAIN) {
+                    queue(i);
+                    ++outstanding;
+                    continue;
+                }
+                if (cqe.res <= 0) {
+                    LOG_ERROR(MODULE_NAME, 311, "{} of {} bytes at {} failed: {}", write ? "write" : "read",
+                              segs[i].len - done[i], segs[i].offset + done[i],
+                              cqe.res < 0 ? std::strerror(-cqe.res) : "end of file");
+                    rc = OFSErrorCodes::ERROR_IO_ERROR;
+                    continue;
+                }
+                done[i] += static_cast<size_t>(cqe.res);
+                if (done[i] < segs[i].len) {
+                    queue(i);
+                    ++outstanding;
+                }
+            }
+        }
+        return rc;
+    }
+
+    // Waits for every operation the kernel took from the ring; the ones
+    // it did not take are withdrawn. Their buffers are the caller's and
+    // must be left alone once transfer_ring returns.
+    void OmniContainer::drain_ring(size_t outstanding)
+    {
+        outstanding -= std::min<size_t>(outstanding, ring_->withdraw());
+        IoRing::Completion cqe;
+        while (outstanding > 0) {
+            while (outstanding > 0 && ring_->pop(cqe)) {
+                --outstanding;
+            }
+            if (outstanding > 0 && ring_->submit(1) < 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+        }
+    }
+}
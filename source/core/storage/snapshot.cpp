@@ -0,0 +1,189 @@
+#include "../../include/snapshot.hpp"
+#include "../../include/omni_container.hpp"
+#include "../../include/block_allocator.hpp"
+#include "../../include/user_manager.hpp"
+#include "../../include/log_macros.hpp"
+
+#include <cstring>
+
+#define MODULE_NAME "SNAPSHOT"
+
+namespace ofs::storage
+{
+    static constexpr uint64_t SECTION_ALIGN = 64;
+
+    static inline uint64_t rotl64(uint64_t v, int r)
+    {
+        return (v << r) | (v >> (64 - r));
+    }
+
+    static inline uint64_t load64(const uint8_t* p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    uint64_t snapshot_checksum(const uint8_t* data, size_t len)
+    {
+        // Four independent multiply-rotate lanes over 32-byte stripes, so the
+        // multiplies overlap; the tail is folded in word by word.
+        const uint64_t k1 = 0x9E3779B185EBCA87ULL;
+        const uint64_t k2 = 0xC2B2AE3D27D4EB4FULL;
+        uint64_t lane[4] = {k1, k2, ~k1, ~k2};
+
+        size_t i = 0;
+        for (; i + 32 <= len; i += 32) {
+            for (int j = 0; j < 4; ++j) {
+                lane[j] = rotl64(lane[j] + load64(data + i + j * 8) * k2, 31) * k1;
+            }
+        }
+
+        uint64_t h = rotl64(lane[0], 1) + rotl64(lane[1], 7) + rotl64(lane[2], 12) + rotl64(lane[3], 18);
+        for (; i + 8 <= len; i += 8) {
+            h = rotl64(h ^ (load64(data + i) * k2), 27) * k1;
+        }
+        for (; i < len; ++i) {
+            h = rotl64(h ^ (data[i] * k1), 11) * k2;
+        }
+
+        h ^= static_cast<uint64_t>(len);
+        h ^= h >> 33;
+        h *= k2;
+        h ^= h >> 29;
+        return h;
+    }
+
+    SnapshotLayout compute_snapshot_layout(uint32_t max_files, uint32_t max_users, uint64_t total_blocks)
+    {
+        SnapshotLayout out;
+        std::memset(&out, 0, sizeof(out));
+
+        uint64_t offset = align_up(sizeof(SnapshotHeader), SECTION_ALIGN);
+        auto add = [&](SnapshotSection id, uint64_t size) {
+            SnapshotSectionInfo& s = out.sections[out.section_count++];
+            s.id = static_cast<uint32_t>(id);
+            s.offset = offset;
+            s.size = size;
+            offset = align_up(offset + size, SECTION_ALIGN);
+        };
+
+        uint64_t slots = static_cast<uint64_t>(max_files) + 1;
+        add(SnapshotSection::allocator, BlockAllocator::snapshot_bytes(total_blocks));
+        add(SnapshotSection::directory, 3 * slots * sizeof(uint32_t));
+        add(SnapshotSection::entries, sizeof(EntriesSnapshot) + static_cast<uint64_t>(max_files) * sizeof(uint32_t));
+        add(SnapshotSection::users, security::UserManager::snapshot_bytes(max_users));
+
+        out.total_size = offset;
+        return out;
+    }
+
+    Snapshot::Snapshot()
+        : container_(nullptr), header_(nullptr), base_(nullptr), size_(0)
+    {
+    }
+
+    void Snapshot::initialize(uint8_t* area, const SnapshotLayout& layout)
+    {
+        SnapshotHeader* h = reinterpret_cast<SnapshotHeader*>(area);
+        std::memset(h, 0, sizeof(*h));
+        std::memcpy(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic));
+        h->version = SNAPSHOT_VERSION;
+        h->section_count = layout.section_count;
+        std::memcpy(h->sections, layout.sections, sizeof(h->sections));
+        // generation 0 never matches a mounted container, so a fresh area is
+        // rebuilt on the first fs_init.
+    }
+
+    bool Snapshot::attach(OmniContainer& container)
+    {
+        detach();
+
+        const OmniLayoutInfo& l = container.layout();
+        if (l.snapshot_size < sizeof(SnapshotHeader)) {
+            return false;
+        }
+
+        SnapshotHeader* h = reinterpret_cast<SnapshotHeader*>(container.base() + l.snapshot_offset);
+        if (std::memcmp(h->magic, SNAPSHOT_MAGIC, sizeof(h->magic)) != 0 ||
+            h->version != SNAPSHOT_VERSION || h->section_count > SNAPSHOT_MAX_SECTIONS) {
+            LOG_WARN(MODULE_NAME, 101, "{}: snapshot area has a bad header, ignoring it", container.path());
+            return false;
+        }
+        uint64_t payload_start = align_up(sizeof(SnapshotHeader), SECTION_ALIGN);
+        for (uint32_t i = 0; i < h->section_count; ++i) {
+            const SnapshotSectionInfo& s = h->sections[i];
+            if (s.offset < payload_start || s.offset > l.snapshot_size || s.size > l.snapshot_size - s.offset) {
+                LOG_WARN(MODULE_NAME, 102, "{}: snapshot section {} is out of bounds, ignoring the area",
+                         container.path(), s.id);
+                return false;
+            }
+        }
+
+        container_ = &container;
+        header_ = h;
+        base_ = reinterpret_cast<uint8_t*>(h);
+        size_ = l.snapshot_size;
+        return true;
+    }
+
+    void Snapshot::detach()
+    {
+        container_ = nullptr;
+        header_ = nullptr;
+        base_ = nullptr;
+        size_ = 0;
+    }
+
+    uint8_t* Snapshot::section(SnapshotSection id, uint64_t& size)
+    {
+        size = 0;
+        if (header_ == nullptr) {
+            return nullptr;
+        }
+        for (uint32_t i = 0; i < header_->section_count; ++i) {
+            if (header_->sections[i].id == static_cast<uint32_t>(id)) {
+                size = header_->sections[i].size;
+                return base_ + header_->sections[i].offset;
+            }
+        }
+        return nullptr;
+    }
+
+    uint64_t Snapshot::payload_checksum() const
+    {
+        uint64_t start = align_up(sizeof(SnapshotHeader), SECTION_ALIGN);
+        return snapshot_checksum(base_ + start, static_cast<size_t>(size_ - start));
+    }
+
+    bool Snapshot::valid(uint64_t generation) const
+    {
+        if (header_ == nullptr || header_->generation == 0 || header_->generation != generation) {
+            return false;
+        }
+        if (header_->checksum != payload_checksum()) {
+            LOG_WARN(MODULE_NAME, 103, "{}: snapshot checksum mismatch at generation {}",
+                     container_->path(), generation);
+            return false;
+        }
+        return true;
+    }
+
+    void Snapshot::seal(uint64_t generation)
+    {
+        if (header_ == nullptr) {
+            return;
+        }
+        header_->checksum = payload_checksum();
+        header_->generation = generation;
+        container_->mark_dirty(header_, sizeof(*header_));
+        LOG_DEBUG(MODULE_NAME, 10, "sealed snapshot at generation {}", generation);
+    }
+
+    void Snapshot::mark_all_dirty()
+    {
+        if (header_ != nullptr) {
+            container_->mark_dirty(base_, static_cast<size_t>(size_));
+        }
+    }
+}
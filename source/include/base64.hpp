@@ -0,0 +1,31 @@
+#ifndef BASE64_HPP
+#define BASE64_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ofs::base64
+{
+    /*
+     * Standard base64 (RFC 4648, '+' and '/', '=' padding) for file payloads
+     * in the socket protocol. Blocks of 24 input bytes (encode) or 32
+     * characters (decode) go through AVX2 when the CPU has it; the rest,
+     * and CPUs without AVX2, use the table-driven scalar code.
+     */
+    constexpr size_t encoded_size(size_t len) { return (len + 2) / 3 * 4; }
+    constexpr size_t decoded_max(size_t len) { return len / 4 * 3; }
+
+    // Writes exactly encoded_size(len) characters to out.
+    void encode(const uint8_t* src, size_t len, char* out);
+
+    // Decodes src into out (decoded_max(len) bytes of room; out may equal
+    // src). Rejects characters outside the alphabet, lengths that are not
+    // a multiple of 4 and misplaced padding.
+    bool decode(const char* src, size_t len, uint8_t* out, size_t& out_len);
+
+    // Scalar paths, exposed so tests can compare them with the SIMD ones.
+    void encode_scalar(const uint8_t* src, size_t len, char* out);
+    bool decode_scalar(const char* src, size_t len, uint8_t* out, size_t& out_len);
+}
+
+#endif // BASE64_HPP
@@ -0,0 +1,119 @@
+#ifndef BLOCK_ALLOCATOR_HPP
+#define BLOCK_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include "odf_types.hpp"
+
+namespace ofs::storage
+{
+    class OmniContainer;
+
+    // A run of contiguous content blocks. start is a 1-based block index.
+    struct Extent
+    {
+        uint32_t start = 0;
+        uint32_t count = 0;
+
+        uint32_t end() const { return start + count; }  // one past the last block
+    };
+
+    /**
+     * Free space allocator over the container's "Map of Usage".
+     *
+     * Level 0 is the on-disk free map itself (one bit per content block,
+     * 1 = used), used in place through the mapping. Above it sit summary
+     * levels kept in memory where each bit means "something below is free",
+     * so finding the next free block touches one word per level instead of
+     * scanning the whole map. The summaries and free counts are derived from
+     * level 0 on attach(), or copied from the index snapshot written by
+     * save_snapshot() at the last clean shutdown.
+     *
+     * allocate() hands out a single contiguous extent when one exists and
+     * only falls back to several extents (largest free runs first) when the
+     * free space is fragmented.
+     */
+    class BlockAllocator
+    {
+    private:
+        OmniContainer* container_;
+        uint64_t* map_;
+        size_t map_words_;
+        uint64_t total_blocks_;
+        uint32_t block_size_;
+
+        // summary_[0] has one bit per map word, summary_[k] one bit per word
+        // of summary_[k - 1]. The last level is a single word.
+        std::vector<std::vector<uint64_t>> summary_;
+        std::vector<uint64_t> summary_bits_;
+
+        uint64_t free_blocks_;
+        uint64_t free_extents_;  // number of maximal free runs
+
+        mutable std::mutex mtx_;
+
+        static constexpr uint64_t npos = ~0ULL;
+
+        bool bit_free(uint64_t bit) const;
+        uint64_t next_free(uint64_t from) const;
+        uint64_t next_used(uint64_t from) const;
+        uint64_t next_summary_bit(size_t level, uint64_t from) const;
+        void refresh_summary(size_t word);
+        void set_range(uint64_t first_bit, uint64_t count, bool used);
+        void take(uint64_t first_bit, uint64_t count, std::vector<Extent>& out);
+        bool find_run(uint64_t count, uint64_t hint, uint64_t& first_bit) const;
+        void build_summaries();
+        bool load_snapshot(const uint8_t* src, size_t len);
+        OFSErrorCodes release_locked(const Extent& extent);
+
+    public:
+        BlockAllocator();
+
+        BlockAllocator(const BlockAllocator&) = delete;
+        BlockAllocator& operator=(const BlockAllocator&) = delete;
+
+        // Binds to an open container's free map. snapshot, when given, is an
+        // allocator section saved for this map; otherwise (or if it does not
+        // fit the container) the summaries are rebuilt from the map.
+        OFSErrorCodes attach(OmniContainer& container, const uint8_t* snapshot = nullptr, size_t snapshot_len = 0);
+        void detach();
+
+        // Bytes needed to save the summaries of a map with total_blocks bits.
+        static uint64_t snapshot_bytes(uint64_t total_blocks);
+
+        // Writes counts and summary levels to dst; false if len is too small.
+        bool save_snapshot(uint8_t* dst, size_t len) const;
+
+        // Allocates count blocks, appending the extents to out. hint is a
+        // block index to start searching from (e.g. the file's last block).
+        // On ERROR_NO_SPACE nothing is allocated.
+        OFSErrorCodes allocate(uint32_t count, std::vector<Extent>& out, uint32_t hint = 0);
+
+        // Allocates exactly one extent of count blocks or fails.
+        OFSErrorCodes allocate_contiguous(uint32_t count, Extent& out, uint32_t hint = 0);
+
+        // Returns blocks to the free map. Freeing a block that is already
+        // free is rejected with ERROR_INVALID_OPERATION.
+        OFSErrorCodes release(const Extent& extent);
+        OFSErrorCodes release(const std::vector<Extent>& extents);
+
+        bool is_free(uint32_t block) const;
+
+        uint64_t total_blocks() const { return total_blocks_; }
+        uint64_t free_blocks() const;
+        uint64_t free_extents() const;
+        uint64_t largest_free_extent() const;
+
+        // 0 when all free space is one run, 100 when every free block is
+        // isolated: (free_extents - 1) / (free_blocks - 1).
+        double fragmentation() const;
+
+        // Fills total_size, used_space, free_space and fragmentation.
+        void fill_stats(FSStats& stats) const;
+    };
+}
+
+#endif // BLOCK_ALLOCATOR_HPP
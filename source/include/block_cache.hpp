@@ -0,0 +1,227 @@
+#ifndef BLOCK_CACHE_HPP
+#define BLOCK_CACHE_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+#include "odf_types.hpp"
+
+namespace ofs::storage
+{
+    struct IoSegment;
+
+    /**
+     * Write-back cache of decoded content blocks in front of an
+     * OmniContainer.
+     *
+     * Memory is one slab of frames, one block each, fixed at construction
+     * and split into shards by block number; each shard has its own lock
+     * and runs 2Q. A block read once goes to the A1in FIFO; when it falls
+     * out, its number is remembered in the A1out ghost list, and a block
+     * that comes back while it is remembered goes to the Am LRU. Am only
+     * loses blocks when A1in is within its quarter of the shard, so one
+     * long scan cycles through A1in and leaves the blocks that are read
+     * again and again where they are.
+     *
+     * A frame holds one contiguous valid byte range of its block and, when
+     * dirty, one contiguous dirty range inside it. Writes only touch the
+     * frame; dirty ranges reach the container through the writer, sorted
+     * by offset so that neighbouring blocks go out as one vectored write:
+     * from flush(), from a background flusher every flush_ms or when half
+     * the frames are dirty, and one at a time when a dirty frame is
+     * evicted.
+     *
+     * A transfer of more blocks than A1in holds would only push itself out
+     * again: it goes straight to the container in one reader or writer
+     * call, after writing back the dirty blocks it overlaps.
+     *
+     * Reads that continue where an earlier one stopped form a stream. Each
+     * further read of a stream doubles its window, from 4 blocks up to
+     * read_ahead, and a worker thread keeps that many blocks past the
+     * reader in A1in, reading the missing ones in one batch.
+     */
+    class BlockCache
+    {
+    public:
+        // Transfers of decoded bytes between caller buffers and the
+        // container. The writer gets segments sorted by offset.
+        using Transfer = std::function<OFSErrorCodes(const IoSegment* segs, size_t count)>;
+
+        struct Stats
+        {
+            uint64_t hits;           // block reads served from a frame
+            uint64_t misses;         // block reads that went to the container
+            uint64_t evictions;
+            uint64_t write_backs;    // dirty blocks written to the container
+            uint64_t flushes;        // writer calls that carried them
+            uint64_t dirty;          // dirty frames now
+            uint64_t frames;
+            uint64_t read_ahead;     // blocks read ahead of a stream
+            uint64_t read_ahead_hits;
+            uint64_t bypassed;       // transfers too large for the frames
+        };
+
+        // content_offset is the container offset of block 1. capacity is
+        // rounded down to whole blocks and must hold at least one.
+        // read_ahead is the largest window in blocks (0 = none); it stops
+        // at last_block.
+        BlockCache(uint64_t content_offset, uint32_t block_size, size_t capacity, Transfer reader, Transfer writer,
+                   uint32_t flush_ms, uint32_t read_ahead = 0, uint32_t last_block = 0);
+        ~BlockCache();
+
+        BlockCache(const BlockCache&) = delete;
+        BlockCache& operator=(const BlockCache&) = delete;
+
+        // Scattered transfers of content bytes, like OmniContainer's.
+        OFSErrorCodes read(const IoSegment* segs, size_t count);
+        OFSErrorCodes write(const IoSegment* segs, size_t count);
+
+        // Writes back the dirty blocks overlapping [offset, offset + len).
+        OFSErrorCodes flush(uint64_t offset = 0, uint64_t len = UINT64_MAX);
+
+        // Forgets blocks [first, first + count) without writing them back;
+        // for blocks that were freed.
+        void discard(uint32_t first, uint32_t count);
+
+        Stats stats() const;
+
+    private:
+        static constexpr uint32_t NIL = UINT32_MAX;
+
+        enum Queue : uint8_t
+        {
+            none,
+            a1in,
+            am
+        };
+
+        struct Frame
+        {
+            uint32_t block;          // 0 = free
+            uint32_t prev;
+            uint32_t next;
+            Queue queue;
+            uint32_t valid_lo;       // valid bytes [valid_lo, valid_hi)
+            uint32_t valid_hi;
+            uint32_t dirty_lo;       // dirty bytes [dirty_lo, dirty_hi), empty when clean
+            uint32_t dirty_hi;
+            bool ahead;              // read ahead and not read since
+        };
+
+        struct List
+        {
+            uint32_t head = NIL;     // most recent
+            uint32_t tail = NIL;
+            uint32_t size = 0;
+        };
+
+        struct Shard
+        {
+            std::mutex mtx;
+            uint8_t* data;
+            std::vector<Frame> frames;
+            std::vector<uint32_t> free;
+            std::unordered_map<uint32_t, uint32_t> where;   // block -> frame
+            List in;
+            List main;
+            std::deque<uint32_t> ghost_order;
+            std::unordered_set<uint32_t> ghost;
+            uint32_t in_limit;
+            uint32_t ghost_limit;
+            uint32_t dirty;
+            uint64_t changes;        // write-backs and discards, for read-ahead
+        };
+
+        struct Stream
+        {
+            uint32_t next = 0;       // block the next read should start at
+            uint32_t window = 0;
+            uint32_t ahead = 0;      // first block not yet requested
+            uint64_t used = 0;
+        };
+
+        struct Range
+        {
+            uint32_t first;
+            uint32_t count;
+        };
+
+        uint64_t content_offset_;
+        uint32_t block_size_;
+        Transfer reader_;
+        Transfer writer_;
+        std::unique_ptr<uint8_t[]> slab_;
+        std::vector<std::unique_ptr<Shard>> shards_;
+        uint32_t shard_mask_;
+        uint64_t frames_;
+        uint64_t bypass_blocks_;
+
+        std::atomic<uint64_t> hits_;
+        std::atomic<uint64_t> misses_;
+        std::atomic<uint64_t> evictions_;
+        std::atomic<uint64_t> write_backs_;
+        std::atomic<uint64_t> flushes_;
+        std::atomic<uint64_t> dirty_;
+        std::atomic<uint64_t> read_ahead_;
+        std::atomic<uint64_t> read_ahead_hits_;
+        std::atomic<uint64_t> bypassed_;
+
+        std::thread flusher_;
+        std::mutex flusher_mtx_;
+        std::condition_variable flusher_cv_;
+        uint32_t flush_ms_;
+        bool flusher_stop_;
+        bool flush_wanted_;
+
+        uint32_t max_window_;
+        uint32_t last_block_;
+        std::vector<Stream> streams_;
+        uint64_t stream_clock_;
+        std::deque<Range> ahead_queue_;
+        std::thread ahead_worker_;
+        std::mutex ahead_mtx_;
+        std::condition_variable ahead_cv_;
+        bool ahead_stop_;
+
+        uint64_t block_start(uint32_t block) const { return content_offset_ + static_cast<uint64_t>(block - 1) * block_size_; }
+        uint32_t block_of(uint64_t offset) const { return static_cast<uint32_t>((offset - content_offset_) / block_size_) + 1; }
+        size_t shard_index(uint32_t block) const;
+        Shard& shard_of(uint32_t block) const;
+        uint8_t* frame_data(Shard& s, uint32_t f) const { return s.data + static_cast<size_t>(f) * block_size_; }
+
+        static void link_front(Shard& s, List& list, uint32_t f);
+        static void unlink(Shard& s, List& list, uint32_t f);
+
+        uint32_t take_frame(Shard& s, uint32_t block);
+        void drop_frame(Shard& s, uint32_t f);
+        void write_back_frame(Shard& s, uint32_t f);
+        OFSErrorCodes fill(Shard& s, uint32_t f);
+        void mark_dirty(Shard& s, Frame& fr, uint32_t lo, uint32_t hi);
+
+        bool read_piece(uint32_t block, uint32_t lo, uint32_t len, uint8_t* dst);
+        void install(uint32_t block, uint32_t lo, uint32_t len, uint8_t* src);
+        void write_piece(uint32_t block, uint32_t lo, uint32_t len, const uint8_t* src);
+
+        uint64_t blocks_spanned(const IoSegment* segs, size_t count, uint64_t& lo, uint64_t& hi) const;
+        OFSErrorCodes read_around(const IoSegment* segs, size_t count, uint64_t lo, uint64_t hi);
+        OFSErrorCodes write_around(const IoSegment* segs, size_t count, uint64_t lo, uint64_t hi);
+
+        void note_stream(uint32_t first, uint32_t last);
+        void read_ahead(Range range);
+
+        void flusher_loop();
+        void ahead_loop();
+    };
+}
+
+#endif // BLOCK_CACHE_HPP
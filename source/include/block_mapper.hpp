@@ -0,0 +1,126 @@
+#ifndef BLOCK_MAPPER_HPP
+#define BLOCK_MAPPER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "odf_types.hpp"
+#include "omni_layout.hpp"
+#include "block_allocator.hpp"
+
+namespace ofs::storage
+{
+    class OmniContainer;
+    struct IoSegment;
+
+    /**
+     * Maps a file's logical blocks to content blocks.
+     *
+     * Two on-disk formats exist and the container records which one it was
+     * formatted with (OmniLayoutInfo::block_mapping):
+     *   - ChainMapper: the linked chain from the design notes. Every block
+     *     starts with a 4-byte next pointer, so finding block N walks N
+     *     blocks.
+     *   - ExtentMapper: start_block is the root of a small extent tree.
+     *     Lookups are a binary search and blocks carry no header, so a
+     *     contiguous extent can be copied in one go.
+     *
+     * Runs returned by map_range() are contiguous in the mapping: for
+     * extents a run covers count whole blocks, for chains every run is a
+     * single block.
+     */
+    class BlockMapper
+    {
+    protected:
+        OmniContainer& container_;
+        BlockAllocator& allocator_;
+
+        void to_segments(const std::vector<Extent>& runs, uint64_t first, uint64_t offset, size_t len,
+                         uint8_t* buf, std::vector<IoSegment>& segs) const;
+
+    public:
+        BlockMapper(OmniContainer& container, BlockAllocator& allocator);
+        virtual ~BlockMapper() = default;
+
+        BlockMapper(const BlockMapper&) = delete;
+        BlockMapper& operator=(const BlockMapper&) = delete;
+
+        // Picks the mapper matching the container's format.
+        static std::unique_ptr<BlockMapper> create(OmniContainer& container, BlockAllocator& allocator);
+
+        virtual BlockMapping kind() const = 0;
+
+        // Byte offset of file content inside a block, and how many bytes of
+        // each block hold content.
+        virtual uint32_t payload_offset() const = 0;
+        uint32_t payload_size() const;
+        uint64_t blocks_for_size(uint64_t bytes) const;
+
+        // Number of content blocks the entry currently owns for data.
+        virtual uint64_t block_count(const MetadataEntry& entry) = 0;
+
+        // Appends the runs covering logical blocks [first, first + count).
+        virtual OFSErrorCodes map_range(const MetadataEntry& entry, uint64_t first, uint64_t count,
+                                        std::vector<Extent>& runs) = 0;
+
+        // Grows or shrinks the entry to exactly blocks data blocks. Updates
+        // entry.start_block; the caller persists the entry itself.
+        virtual OFSErrorCodes resize(MetadataEntry& entry, uint64_t blocks) = 0;
+
+        OFSErrorCodes release(MetadataEntry& entry) { return resize(entry, 0); }
+
+        // Copies file content between the container and a caller buffer
+        // through the container's I/O backend; all runs of one call go out
+        // as one batch. The range must already be mapped (see resize()).
+        OFSErrorCodes read(const MetadataEntry& entry, uint64_t offset, void* dst, size_t len);
+        OFSErrorCodes write(const MetadataEntry& entry, uint64_t offset, const void* src, size_t len);
+    };
+
+    class ChainMapper : public BlockMapper
+    {
+    private:
+        uint32_t next_of(uint32_t block);
+        void set_next(uint32_t block, uint32_t next);
+        OFSErrorCodes collect(const MetadataEntry& entry, std::vector<uint32_t>& chain);
+
+    public:
+        using BlockMapper::BlockMapper;
+
+        BlockMapping kind() const override { return BlockMapping::chain; }
+        uint32_t payload_offset() const override { return CHAIN_POINTER_SIZE; }
+
+        uint64_t block_count(const MetadataEntry& entry) override;
+        OFSErrorCodes map_range(const MetadataEntry& entry, uint64_t first, uint64_t count,
+                                std::vector<Extent>& runs) override;
+        OFSErrorCodes resize(MetadataEntry& entry, uint64_t blocks) override;
+    };
+
+    class ExtentMapper : public BlockMapper
+    {
+    private:
+        ExtentNodeHeader* node(uint32_t block);
+        uint32_t leaf_capacity() const;
+        uint32_t index_capacity() const;
+
+        OFSErrorCodes load(const MetadataEntry& entry, std::vector<ExtentRecord>& extents,
+                           std::vector<uint32_t>& nodes);
+        OFSErrorCodes store(MetadataEntry& entry, const std::vector<ExtentRecord>& extents,
+                            std::vector<uint32_t>& nodes, uint64_t mapped_blocks);
+        void write_leaf(uint32_t block, const ExtentRecord* records, uint32_t count, uint32_t mapped_blocks);
+
+    public:
+        using BlockMapper::BlockMapper;
+
+        BlockMapping kind() const override { return BlockMapping::extent; }
+        uint32_t payload_offset() const override { return 0; }
+
+        uint64_t block_count(const MetadataEntry& entry) override;
+        OFSErrorCodes map_range(const MetadataEntry& entry, uint64_t first, uint64_t count,
+                                std::vector<Extent>& runs) override;
+        OFSErrorCodes resize(MetadataEntry& entry, uint64_t blocks) override;
+    };
+}
+
+#endif // BLOCK_MAPPER_HPP
@@ -0,0 +1,61 @@
+#ifndef BYTE_MAP_HPP
+#define BYTE_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ofs::bytemap
+{
+    /*
+     * Byte substitution for file content: every byte b becomes map[b]. The
+     * map a container stores is a permutation; its inverse decodes.
+     *
+     * pshufb looks up 16 bytes by the low nibble of each index byte and
+     * gives 0 where the index has bit 7 set. adds(b, 16j) keeps the low
+     * nibble of b and sets bit 7 exactly when the high nibble of b is at
+     * least 8 - j, so lookup j only answers for bytes whose high nibble
+     * is below 8 - j. XOR-ing eight such lookups over rows prepared as
+     * differences of neighbouring map rows gives map[b] for b < 128;
+     * eight more on b ^ 0x80 cover the rest. The SSSE3 path does that 16
+     * bytes at a time and the AVX2 path 32; with AVX-512 VBMI two vpermi2b
+     * over the whole map and a blend on bit 7 do 64, with a masked load and
+     * store for the tail. The widest path the CPU has is used; the other
+     * paths leave tails to the scalar loop.
+     */
+    constexpr size_t TABLE_SIZE = 256;
+
+    enum class Path
+    {
+        scalar,
+        ssse3,
+        avx2,
+        avx512vbmi
+    };
+
+    // A map with the rows the pshufb paths look up, built by prepare().
+    struct Table
+    {
+        uint8_t map[TABLE_SIZE];
+        uint8_t rows[TABLE_SIZE];
+    };
+
+    void prepare(const uint8_t* map, Table& out);
+
+    Path best_path();
+    bool supported(Path path);
+    const char* path_name(Path path);
+
+    // dst[i] = table.map[src[i]] for every i < len; dst may equal src.
+    void translate(const Table& table, const uint8_t* src, uint8_t* dst, size_t len);
+
+    // The same through one path, which must be supported(); for tests and
+    // benchmarks.
+    void translate(Path path, const Table& table, const uint8_t* src, uint8_t* dst, size_t len);
+
+    // A permutation of the 256 byte values drawn from seed.
+    void make_permutation(uint64_t seed, uint8_t* map);
+    bool is_permutation(const uint8_t* map);
+    void invert(const uint8_t* map, uint8_t* inverse);
+}
+
+#endif // BYTE_MAP_HPP
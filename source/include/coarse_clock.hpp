@@ -0,0 +1,26 @@
+#ifndef COARSE_CLOCK_HPP
+#define COARSE_CLOCK_HPP
+
+#include <cstdint>
+#include <string>
+
+namespace ofs::clock
+{
+    // Wall-clock seconds since the Unix epoch from the coarse (tick-resolution)
+    // kernel clock. Use this for second-granularity stamps such as
+    // SessionInfo::last_activity and FileEntry::modified_time.
+    uint64_t unix_seconds();
+
+    // Precise wall-clock nanoseconds since the Unix epoch.
+    int64_t unix_nanos();
+
+    // Appends "YYYY-MM-DDTHH:MM:SS[.fff]Z". The second-resolution prefix is
+    // cached per thread and only re-rendered when the second changes, so the
+    // common case is a 19-byte copy plus the optional fraction digits.
+    // subsecond_digits is clamped to 0..9.
+    void append_utc_timestamp(std::string& out, int64_t wall_ns, int subsecond_digits = 0);
+
+    std::string utc_timestamp(int64_t wall_ns, int subsecond_digits = 0);
+}
+
+#endif // COARSE_CLOCK_HPP
@@ -13,15 +13,47 @@ namespace ofs::config
         uint32_t block_size = 4096u;             
         uint32_t max_files = 1000u;
         uint32_t max_filename_length = 10u;      
+        std::string block_mapping = "extent";
+        uint64_t journal_size = 1048576ULL;     // metadata journal area, 0 = none
+        uint64_t history_size = 1048576ULL;     // Delta Vault change log, 0 = no file history
+        uint32_t history_chunks = 16384u;       // Delta Vault chunk table slots
+        uint32_t history_full_every = 8u;       // versions per full snapshot (the rest are deltas)
 
         uint32_t max_users = 50u;
         std::string admin_username = "admin";
         std::string admin_password = "admin123";
         bool require_auth = true;
+        uint32_t hash_iterations = 10000u;      // PBKDF2 iterations for new password records
+        uint32_t hash_threads = 0u;             // 0 = hardware concurrency
+        uint32_t verify_cache_ttl = 300u;       // seconds; 0 disables the cache
+        uint32_t max_sessions = 4096u;
+        uint32_t session_timeout = 1800u;       // idle seconds; 0 = never expire
+        bool encode_content = true;             // content through a byte substitution map
 
         uint16_t port = 8080u;
         uint16_t max_connections = 20u;
         uint16_t queue_timeout = 30u;            
+        std::string execution = "fifo";         // fifo or concurrent
+        uint32_t workers = 0u;                  // concurrent executor threads, 0 = one per core
+        uint32_t stream_window = 1024u * 1024;  // content bytes per chunk of a streamed read
+
+        std::string io_sync_policy = "periodic";
+        uint32_t io_sync_interval_ms = 1000u;
+        std::string io_backend = "mmap";        // mmap, pread or io_uring
+        uint32_t io_queue_depth = 256u;         // io_uring submission slots
+        std::string io_durability = "group";    // fsync, group or async
+        uint32_t io_group_commit_ms = 5u;       // journal flush interval for group and async
+        uint64_t io_cache_size = 16ull * 1024 * 1024;  // block cache bytes (0 = no cache)
+        uint32_t io_read_ahead = 32u;           // largest read-ahead window in blocks (0 = off)
+
+        uint64_t log_max_size = 1048576ULL;      
+        uint64_t log_max_age = 0u;               
+        uint32_t log_max_archives = 10u;
+        bool log_compress = true;
+        bool log_async = false;                 // records through the async ring buffer
+        uint32_t log_queue_size = 4096u;        // async ring buffer records
+        std::string log_overflow = "block";     // block, drop_and_count or drop_debug_only
+        std::string log_format = "text";        // text or binary
 
     };
 }
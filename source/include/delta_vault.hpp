@@ -0,0 +1,223 @@
+#ifndef DELTA_VAULT_HPP
+#define DELTA_VAULT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "odf_types.hpp"
+
+namespace ofs::storage
+{
+    class OmniContainer;
+    class BlockAllocator;
+
+    /*
+     * Delta Vault: the version history of every file.
+     *
+     * File state storage (OMNIHeader::file_state_storage_offset) is a table
+     * of ChunkRecords, one per distinct chunk of content. Chunk bytes are
+     * packed one after another into runs of content blocks taken from the
+     * allocator, so history shares the content area with the files.
+     *
+     * The change log (OMNIHeader::change_log_offset) is a ring of version
+     * records after a ChangeLogHeader:
+     *
+     *   full    [ VersionRecord ][ uint32 chunk id ] * count
+     *   delta   [ VersionRecord ][ uint64 offset ][ count bytes ]
+     *
+     * A full record lists the chunks of the whole content. A delta is one
+     * file_edit against the version before it: count bytes written at
+     * offset, with size the length afterwards. Every history_full_every-th
+     * version is full, so reading any version applies at most
+     * history_full_every - 1 deltas to one full version.
+     *
+     * When the ring, the chunk table or the content area runs out, the
+     * oldest versions are dropped from the tail. Dropping a full version
+     * drops the deltas that build on it.
+     */
+
+    constexpr char CHANGE_LOG_MAGIC[8] = {'O', 'F', 'S', 'V', 'L', 'T', 'L', '1'};
+    constexpr uint32_t VERSION_RECORD_MAGIC = 0x53524556u;  // "VERS"
+    constexpr uint64_t CHANGE_LOG_RECORDS_OFFSET = 64u;
+    constexpr uint64_t CHANGE_LOG_MIN_SIZE = 64u * 1024u;
+
+    // FastCDC parameters: cut points are found with a Gear rolling hash,
+    // never closer than CDC_MIN_CHUNK or further than CDC_MAX_CHUNK apart,
+    // and normalised towards CDC_AVG_CHUNK.
+    constexpr size_t CDC_MIN_CHUNK = 2048u;
+    constexpr size_t CDC_AVG_CHUNK = 8192u;
+    constexpr size_t CDC_MAX_CHUNK = 65536u;
+
+    // Edits up to this size, or an eighth of the file, are stored as deltas.
+    constexpr size_t DELTA_MIN_LIMIT = 4096u;
+
+    struct ChunkRecord {
+        uint64_t hash;              // snapshot_checksum of the bytes
+        uint64_t offset;            // Container byte offset of the bytes
+        uint32_t length;            // 0 = free slot
+        uint32_t refs;              // Full versions that list this chunk
+    };  // Total: 24 bytes
+
+    struct ChangeLogHeader {
+        char magic[8];              // CHANGE_LOG_MAGIC
+        uint64_t head;              // Ring position where the next record goes
+        uint64_t tail;              // Ring position of the oldest record
+        uint64_t open_offset;       // Next free byte of the open chunk run
+        uint64_t open_end;          // End of the open chunk run
+        uint64_t reserved[3];       // Padding
+    };  // Total: 64 bytes
+
+    enum class VersionKind : uint8_t
+    {
+        full = 1,
+        delta = 2,
+        dead = 3,   // dropped, skipped until the tail passes it
+        wrap = 4    // rest of the ring is unused; continue at the start
+    };
+
+    struct VersionRecord {
+        uint32_t magic;             // VERSION_RECORD_MAGIC
+        uint8_t kind;               // VersionKind
+        uint8_t reserved[3];        // Padding
+        uint32_t entry;             // Metadata entry index of the file
+        uint32_t version;           // Version number within the file
+        uint64_t size;              // Content length of this version
+        uint64_t time;              // Unix epoch seconds
+        uint32_t length;            // Whole record in bytes, multiple of 8
+        uint32_t count;             // Chunk ids (full) or bytes (delta)
+    };  // Total: 40 bytes
+
+    static_assert(sizeof(ChunkRecord) == 24 && sizeof(ChangeLogHeader) == 64 && sizeof(VersionRecord) == 40,
+                  "Delta Vault structures must keep their on-disk sizes");
+
+    // Length of the first chunk of data[0, len) (FastCDC, normalised).
+    size_t cdc_cut(const uint8_t* data, size_t len);
+
+    struct FileVersion
+    {
+        uint32_t version;
+        uint64_t size;
+        uint64_t time;
+        bool delta;
+    };
+
+    /**
+     * Version history kept inside the container.
+     *
+     * The chunk table and the change log are used in place through the
+     * mapping and changed with mark_dirty(), so a file operation and the
+     * version it records are one journal transaction. The chunk index by
+     * hash, the per-file version lists and the per-block chunk counts are
+     * rebuilt from them by attach(). Callers serialise access the way
+     * FileSystem does: changes exclusively, reads shared.
+     */
+    class DeltaVault
+    {
+    public:
+        struct Stats
+        {
+            uint64_t versions;
+            uint64_t deltas;
+            uint64_t chunks;
+            uint64_t chunk_bytes;    // stored once, however many versions share them
+            uint64_t version_bytes;  // sum of the sizes of all kept versions
+            uint64_t log_used;
+            uint64_t dedup_hits;
+            uint64_t dropped;
+        };
+
+        DeltaVault();
+
+        DeltaVault(const DeltaVault&) = delete;
+        DeltaVault& operator=(const DeltaVault&) = delete;
+
+        // A container formatted without history leaves the vault inactive.
+        void attach(OmniContainer& container, BlockAllocator& allocator, uint32_t full_every);
+        void detach();
+        bool active() const { return container_ != nullptr; }
+
+        // Records version of entry with the whole content.
+        void record_full(uint32_t entry, uint32_t version, const char* data, size_t len, uint64_t time);
+
+        // Records version as len bytes written at offset, leaving the file
+        // new_size bytes long. Returns false without recording anything
+        // when a full version is due or the edit is not small; the caller
+        // then records a full version.
+        bool record_delta(uint32_t entry, uint32_t version, uint64_t offset, const char* data, size_t len,
+                          uint64_t new_size, uint64_t time);
+
+        // Drops the history of a deleted file.
+        void forget(uint32_t entry);
+
+        // Kept versions, oldest first.
+        void versions(uint32_t entry, std::vector<FileVersion>& out) const;
+
+        // Content of a kept version.
+        OFSErrorCodes read(uint32_t entry, uint32_t version, std::string& out) const;
+
+        // Drops the oldest versions until at least blocks content blocks
+        // were returned to the allocator or no history is left.
+        uint64_t reclaim(uint64_t blocks);
+
+        Stats stats() const;
+
+    private:
+        struct Version
+        {
+            uint64_t pos;           // ring position of the record
+            uint32_t version;
+            uint64_t size;
+            uint64_t time;
+            bool delta;
+        };
+
+        OmniContainer* container_;
+        BlockAllocator* allocator_;
+        uint32_t full_every_;
+        ChunkRecord* chunks_;
+        uint32_t chunk_slots_;
+        ChangeLogHeader* log_;
+        uint8_t* ring_;
+        uint64_t ring_size_;
+        uint64_t block_size_;
+        uint64_t content_offset_;
+
+        std::unordered_multimap<uint64_t, uint32_t> by_hash_;   // hash -> chunk id
+        std::vector<uint32_t> free_chunks_;
+        std::unordered_map<uint32_t, uint32_t> block_chunks_;   // block -> live chunks in it
+        std::unordered_map<uint32_t, std::vector<Version>> files_;
+        std::vector<uint8_t> scratch_;                          // chunk bytes read back for comparison
+
+        uint64_t chunk_bytes_;
+        uint64_t version_bytes_;
+        uint64_t versions_;
+        uint64_t deltas_;
+        uint64_t dedup_hits_;
+        uint64_t dropped_;
+
+        ChunkRecord& chunk(uint32_t id) const { return chunks_[id - 1]; }
+        VersionRecord* record_at(uint64_t pos) const;
+        uint64_t log_free() const { return ring_size_ - (log_->head - log_->tail); }
+
+        uint32_t store_chunk(const uint8_t* data, size_t len);
+        bool place_chunk(size_t len, uint64_t& offset);
+        void release_chunk(uint32_t id);
+        void count_blocks(uint64_t offset, uint64_t len, bool add);
+        void release_block(uint32_t block);
+        void close_run();
+        bool open_run(size_t len);
+
+        bool make_room(uint64_t length);
+        VersionRecord* append(VersionKind kind, uint32_t entry, uint32_t version, uint64_t size, uint64_t time,
+                              uint32_t count, uint64_t payload, uint64_t& pos);
+        bool drop_oldest();
+        void drop_version(uint32_t entry, size_t i);
+        bool rebuild_log();
+        OFSErrorCodes materialize(const Version& v, std::string& out) const;
+    };
+}
+
+#endif // DELTA_VAULT_HPP
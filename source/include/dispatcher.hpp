@@ -0,0 +1,148 @@
+#ifndef DISPATCHER_HPP
+#define DISPATCHER_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "config_types.hpp"
+#include "file_system.hpp"
+#include "path_locks.hpp"
+#include "protocol.hpp"
+#include "scheduler.hpp"
+#include "session_manager.hpp"
+
+namespace ofs::server
+{
+    /**
+     * Executes protocol requests against a mounted file system.
+     *
+     * handle() answers most operations before returning. user_login hands
+     * the password check to the file system's hashing pool and replies
+     * from there, and a change waits for the journal to make it durable,
+     * so reply may run on another thread and after handle() has returned.
+     *
+     * A streamed file_read answers with its first chunk and hands the rest
+     * back with it; the caller asks for each further chunk with resume()
+     * when it has room for one. Chunks carry at most [server]
+     * stream_window bytes of the file.
+     *
+     * Responses are written into buffers from the SlabPool, sized up front
+     * for file content and listings; the caller hands them back with
+     * SlabPool::release() once they are sent. Everything else a request
+     * needs (parameters, the file buffer, directory entries, the user
+     * list) lives in the Arena of the thread that runs it, which keeps its
+     * capacity from one request to the next. get_stats reports how many
+     * requests ran and how often one of them still had to allocate.
+     */
+    class Dispatcher
+    {
+    public:
+        // The rest of a streamed file_read. Closes its file system handle
+        // when the stream ends or is dropped unfinished.
+        struct Stream
+        {
+            fs::FileSystem* fs = nullptr;
+            uint64_t handle = 0;
+            uint64_t left = 0;           // file bytes still to send
+            std::string session;         // owns the handle
+            std::string path;
+            std::string request_id;
+
+            Stream() = default;
+            Stream(const Stream&) = delete;
+            Stream& operator=(const Stream&) = delete;
+            ~Stream();
+        };
+
+        // Receives one complete response line; while rest is set the
+        // response goes on, and resume(rest) produces its next line.
+        using Reply = std::function<void(std::string&& response, std::unique_ptr<Stream> rest)>;
+
+        Dispatcher(fs::FileSystem& filesystem, security::SessionManager& sessions, const config::Config& cfg);
+
+        // The frame is parsed in place and left modified.
+        void handle(std::string& frame, Reply reply);
+
+        // A request parsed by the caller; err is the parse error, or
+        // nullptr when it parsed.
+        void handle(const Request& req, const char* err, Reply reply);
+
+        // Reads and answers the next chunk of a stream.
+        void resume(std::unique_ptr<Stream> stream, Reply reply);
+
+        // Error response for a frame that will not be executed (queue
+        // timeout, overload); echoes its operation and request_id if the
+        // frame parses.
+        static std::string reject(std::string& frame, OFSErrorCodes code, std::string_view message);
+        static std::string reject(const Request& req, OFSErrorCodes code, std::string_view message);
+
+        // The locks that let the request run next to others while giving
+        // the result it would have in arrival order: its paths (for a
+        // handle, the path of its file), the user table and its session.
+        // Requests that fail validation before touching anything need
+        // none.
+        void footprint(const Request& req, LockSet& out);
+
+        // Scheduling class: file contents are bulk, user administration is
+        // maintenance, everything else (and anything malformed, which is
+        // answered at once) is interactive.
+        static Priority priority(const Request& req);
+
+        // Waits for logins still on the hashing pool and changes waiting
+        // for the journal.
+        void drain();
+
+    private:
+        // Request-scoped buffers of the worker thread running a request.
+        // The strings grow through the slab pool; reset() empties
+        // everything once the response is handed on. Nothing in them has
+        // a destructor to run, so that is O(1) and the capacity stays for
+        // the next request; a buffer that one large request grew past
+        // ARENA_KEEP goes back to the pool (or the heap) instead.
+        struct Arena
+        {
+            static constexpr size_t ARENA_KEEP = 256 * 1024;
+
+            std::string path;
+            std::string data;
+            std::string name;
+            std::string other;
+            std::vector<FileEntry> entries;
+            std::vector<UserInfo> users;
+            size_t entries_capacity = 0;
+            size_t users_capacity = 0;
+            size_t response = 0;         // capacity the response was given
+
+            // Gives out room for extra more bytes, through the pool.
+            void make_room(std::string& out, size_t extra);
+            // Returns how many times the vectors, or a response that
+            // outgrew the room made for it, went to the heap.
+            uint32_t reset(const std::string& out);
+        };
+
+        static Arena& arena();
+
+        fs::FileSystem& fs_;
+        security::SessionManager& sessions_;
+        bool require_auth_;
+        size_t window_;
+        std::atomic<uint32_t> pending_logins_;
+        std::atomic<uint32_t> pending_commits_;
+        std::atomic<uint64_t> requests_;
+        std::atomic<uint64_t> allocations_;   // reported by Arena::reset()
+
+        OFSErrorCodes execute(const Request& req, UserRole role, std::string& out, std::unique_ptr<Stream>& rest);
+        OFSErrorCodes next_chunk(Stream& stream, std::string& out);
+        void finish(const std::string& out);
+        void login(const Request& req, Reply reply);
+        uint32_t owner_slot(const Request& req);
+        OFSErrorCodes open_handle(const std::string& path, std::string_view session, uint64_t& handle,
+                                  uint64_t& size, uint64_t offset);
+    };
+}
+
+#endif // DISPATCHER_HPP
@@ -0,0 +1,196 @@
+#ifndef FILE_SYSTEM_HPP
+#define FILE_SYSTEM_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "odf_types.hpp"
+#include "config_types.hpp"
+#include "omni_container.hpp"
+#include "block_allocator.hpp"
+#include "block_mapper.hpp"
+#include "path_index.hpp"
+#include "snapshot.hpp"
+#include "journal.hpp"
+#include "delta_vault.hpp"
+#include "password_hasher.hpp"
+#include "user_manager.hpp"
+
+namespace ofs::fs
+{
+    /**
+     * File and directory operations on one mapped .omni container.
+     *
+     * fs_init is init(): map the container, attach the allocator to the
+     * on-disk free map and the path index to the on-disk dentry table. After
+     * a clean shutdown the index snapshot supplies the allocator summaries,
+     * child lists, free slot stack and counters, so nothing is rebuilt;
+     * after a crash they are reconstructed from the metadata area. The
+     * first mount of a container with no users creates the configured
+     * admin account.
+     * Paths are absolute ("/a/b/c"); every component is at most
+     * max_filename_length characters.
+     *
+     * Operations are serialised with a reader/writer lock: lookups and reads
+     * run concurrently, anything that changes metadata is exclusive and is
+     * one journal Transaction, durable as io.durability asks.
+     *
+     * Every create, edit, truncate and restore of a file records a new
+     * version in the Delta Vault, in the same transaction; a file's history
+     * goes with it on delete.
+     *
+     * Large files can be read a piece at a time: file_read_range reads one
+     * byte range, and a handle from file_open reads on from where its last
+     * read stopped. Read buffers come from the process-wide SlabPool and
+     * go back to it through free_buffer.
+     */
+    class FileSystem
+    {
+    public:
+        // Open handles in all, and per session. file_open fails with
+        // ERROR_NO_SPACE past either; handles opened without a session
+        // are held to the first only.
+        static constexpr size_t MAX_OPEN_FILES = 1024;
+        static constexpr size_t MAX_OPEN_PER_SESSION = 64;
+
+        FileSystem();
+        ~FileSystem();
+
+        FileSystem(const FileSystem&) = delete;
+        FileSystem& operator=(const FileSystem&) = delete;
+
+        // fs_format: creates a new container from a .uconf file.
+        static OFSErrorCodes format(const std::string& omni_path, const std::string& config_path);
+
+        // fs_init / fs_shutdown.
+        OFSErrorCodes init(const std::string& omni_path, const std::string& config_path);
+        OFSErrorCodes init(const std::string& omni_path, const config::Config& cfg);
+        void shutdown();
+        bool is_open() const { return container_.is_open(); }
+
+        // owner is a user table slot.
+        OFSErrorCodes file_create(const std::string& path, const char* data, size_t size, uint32_t owner = 0);
+        OFSErrorCodes file_read(const std::string& path, std::string& out);
+        OFSErrorCodes file_edit(const std::string& path, const char* data, size_t size, uint64_t index);
+        OFSErrorCodes file_delete(const std::string& path);
+        OFSErrorCodes file_truncate(const std::string& path);
+        OFSErrorCodes file_exists(const std::string& path);
+        OFSErrorCodes file_rename(const std::string& old_path, const std::string& new_path);
+
+        // Up to len bytes from offset; fewer at the end of the file, none
+        // when offset is the size.
+        OFSErrorCodes file_read_range(const std::string& path, uint64_t offset, size_t len, std::string& out);
+
+        // file_open positions a handle at offset and reports the size.
+        // file_read_next reads up to max bytes where the handle stands and
+        // moves it past them; offset receives their position, and out is
+        // empty at the end of the file. A handle follows its file through
+        // renames. Reads fail with ERROR_INVALID_OPERATION once the content
+        // has changed since the open, so the pieces read through one handle
+        // always come from one version, and with ERROR_NOT_FOUND once the
+        // file is deleted. A handle belongs to the session that opened it
+        // (empty for none): for any other session it does not exist.
+        OFSErrorCodes file_open(const std::string& path, std::string_view session, uint64_t& handle, uint64_t& size,
+                                uint64_t offset = 0);
+        OFSErrorCodes file_read_next(uint64_t handle, std::string_view session, size_t max, std::string& out,
+                                     uint64_t* offset = nullptr);
+        OFSErrorCodes file_close(uint64_t handle, std::string_view session);
+
+        // The path of the handle's file, as opened or renamed since; false
+        // for a handle the session does not have. Takes only the handle
+        // table's lock, so it never waits for a writer.
+        bool handle_path(uint64_t handle, std::string_view session, std::string& path);
+
+        // Closes the handles of every session for which ended() holds,
+        // such as sessions that logged out or expired; returns how many.
+        size_t close_handles(const std::function<bool(std::string_view session)>& ended);
+
+        // The reads above fill out from the slab pool when it is too small
+        // for the bytes; free_buffer hands such a buffer back to the pool
+        // and leaves it empty.
+        static void free_buffer(std::string&& buffer);
+
+        // File history, oldest version first. file_restore writes an old
+        // version back as the newest one.
+        OFSErrorCodes file_versions(const std::string& path, std::vector<storage::FileVersion>& versions);
+        OFSErrorCodes file_read_version(const std::string& path, uint32_t version, std::string& out);
+        OFSErrorCodes file_restore(const std::string& path, uint32_t version);
+
+        OFSErrorCodes dir_create(const std::string& path, uint32_t owner = 0);
+        OFSErrorCodes dir_list(const std::string& path, std::vector<FileEntry>& entries);
+        OFSErrorCodes dir_delete(const std::string& path);
+        OFSErrorCodes dir_exists(const std::string& path);
+
+        OFSErrorCodes get_metadata(const std::string& path, FileMetadata& meta);
+        OFSErrorCodes set_permissions(const std::string& path, uint32_t permissions);
+        OFSErrorCodes get_stats(FSStats& stats);
+
+        storage::OmniContainer& container() { return container_; }
+        PathIndex& path_index() { return index_; }
+        security::UserManager& users() { return users_; }
+        storage::Journal& journal() { return journal_; }
+        storage::DeltaVault& vault() { return vault_; }
+
+    private:
+        config::Config cfg_;
+        storage::OmniContainer container_;
+        storage::Journal journal_;
+        storage::BlockAllocator allocator_;
+        std::unique_ptr<storage::BlockMapper> mapper_;
+        storage::DeltaVault vault_;
+        PathIndex index_;
+        security::PasswordHasher hasher_;
+        security::UserManager users_;
+        storage::Snapshot snapshot_;
+
+        // Counters and the free metadata slot stack (lowest index on top),
+        // in the snapshot's entries section or local_entries_.
+        storage::EntriesSnapshot* counts_;
+        uint32_t* free_stack_;
+        std::vector<uint8_t> local_entries_;
+
+        mutable std::shared_mutex mtx_;
+
+        // A handle's metadata slot (0 once the file is deleted), position,
+        // owning session, the content version it was opened at and the
+        // file's path.
+        struct OpenFile
+        {
+            uint32_t index;
+            uint64_t offset;
+            std::string session;
+            uint32_t version;
+            std::string path;
+        };
+
+        // Taken inside mtx_ when both are held. open_sessions_ counts the
+        // handles of each session that has any.
+        std::mutex open_mtx_;
+        std::unordered_map<uint64_t, OpenFile> open_files_;
+        std::unordered_map<std::string, size_t> open_sessions_;
+        uint64_t next_handle_;
+
+        bool valid_path(const std::string& path) const;
+        static void split_path(const std::string& path, std::string& parent, std::string& name);
+        storage::MetadataEntry* lookup(const std::string& path, uint32_t& index);
+        OFSErrorCodes new_entry(const std::string& path, EntryType type, uint32_t owner,
+                                uint32_t permissions, uint32_t& index);
+        void free_entry(uint32_t index);
+        OFSErrorCodes resize(storage::MetadataEntry& e, uint64_t size);
+        OFSErrorCodes record_version(uint32_t index, storage::MetadataEntry& e);
+        void touch(storage::MetadataEntry& e);
+        void rebuild_entries();
+        void save_snapshot();
+        FileEntry to_file_entry(uint32_t index, const storage::MetadataEntry& e);
+    };
+}
+
+#endif // FILE_SYSTEM_HPP
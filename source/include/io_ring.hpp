@@ -0,0 +1,108 @@
+#ifndef IO_RING_HPP
+#define IO_RING_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+struct iovec;
+struct io_uring_sqe;
+struct io_uring_cqe;
+
+namespace ofs
+{
+    /**
+     * One io_uring instance driven through the raw system calls.
+     *
+     * The submission ring, the completion ring and the submission entries
+     * are mapped from the kernel at init(). Callers fill entries with the
+     * prep_* helpers, hand them all to the kernel with one submit(), and
+     * reap completions with pop(); user_data comes back unchanged. When the
+     * submission ring is full, the next prep_* submits what is queued.
+     *
+     * Fixed files are addressed by their index in the registered table
+     * (fixed = true); fixed buffers by their index in the registered
+     * buffer list. Not thread-safe: one thread, or a caller-held lock,
+     * drives a ring.
+     */
+    class IoRing
+    {
+    public:
+        struct Completion
+        {
+            uint64_t user_data;
+            int32_t res;       // bytes transferred, or -errno
+        };
+
+        IoRing();
+        ~IoRing();
+
+        IoRing(const IoRing&) = delete;
+        IoRing& operator=(const IoRing&) = delete;
+
+        // Creates a ring with at least entries submission slots. Returns
+        // false when the kernel has no io_uring or refuses it (ENOSYS,
+        // EPERM under a seccomp or sysctl policy); callers fall back to
+        // plain system calls.
+        bool init(uint32_t entries);
+        void close();
+        bool is_open() const { return ring_fd_ >= 0; }
+
+        // Sparse file table; -1 leaves a slot empty until update_file().
+        bool register_files(const int* fds, uint32_t count);
+        bool update_file(uint32_t index, int fd);
+        bool register_buffers(const iovec* iov, uint32_t count);
+
+        void prep_read(int fd, bool fixed, void* buf, uint32_t len, uint64_t offset, uint64_t user_data);
+        void prep_write(int fd, bool fixed, const void* buf, uint32_t len, uint64_t offset, uint64_t user_data);
+        void prep_read_fixed(int fd, bool fixed, void* buf, uint32_t len, uint16_t buf_index,
+                             uint64_t offset, uint64_t user_data);
+        void prep_send(int fd, bool fixed, const void* buf, uint32_t len, int flags, uint64_t user_data);
+        void prep_accept(int fd, int flags, uint64_t user_data);
+        // Completes with -ETIME after ms milliseconds. One timeout may be
+        // prepared per submit().
+        void prep_timeout(uint32_t ms, uint64_t user_data);
+
+        // Submits everything prepared and, with wait_nr > 0, blocks until
+        // that many completions are available. Returns the number of
+        // entries submitted or -errno.
+        int submit(uint32_t wait_nr = 0);
+
+        // Takes back the prepared entries the kernel has not consumed, as
+        // after a failed submit(), and returns how many there were.
+        uint32_t withdraw();
+
+        // Next completion; false when none is ready.
+        bool pop(Completion& out);
+
+        uint32_t entries() const { return sq_entries_; }
+
+    private:
+        int ring_fd_;
+        void* sq_map_;
+        size_t sq_map_len_;
+        void* cq_map_;
+        size_t cq_map_len_;
+        io_uring_sqe* sqes_;
+        size_t sqes_len_;
+
+        uint32_t* sq_head_;
+        uint32_t* sq_tail_;
+        uint32_t* sq_array_;
+        uint32_t sq_mask_;
+        uint32_t sq_entries_;
+        uint32_t* cq_head_;
+        uint32_t* cq_tail_;
+        uint32_t cq_mask_;
+        io_uring_cqe* cqes_;
+
+        uint32_t local_tail_;  // prepared entries end here
+        uint32_t pending_;     // prepared, not yet submitted
+        int64_t timeout_[2];   // __kernel_timespec for prep_timeout
+
+        io_uring_sqe* next_sqe();
+        void prep_rw(uint8_t opcode, int fd, bool fixed, const void* buf, uint32_t len, uint64_t offset,
+                     uint64_t user_data);
+    };
+}
+
+#endif // IO_RING_HPP
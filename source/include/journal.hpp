@@ -0,0 +1,282 @@
+#ifndef JOURNAL_HPP
+#define JOURNAL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "odf_types.hpp"
+
+namespace ofs::storage
+{
+    class OmniContainer;
+
+    /*
+     * Journal area (OmniLayoutInfo::journal_offset, journal_size)
+     *
+     *   [ JournalHeader ]  64 bytes
+     *   [ records       ]  appended from JOURNAL_RECORDS_OFFSET
+     *
+     * A record is the after-image of every metadata byte range one
+     * operation changed:
+     *
+     *   [ JournalRecord ][ JournalRange ][ bytes, padded to 8 ] ...
+     *
+     * Records carry consecutive sequence numbers starting at the header's
+     * first_seq. Replay applies records in order and stops at the first
+     * one whose magic, sequence or checksum is wrong, so it never reads
+     * more than the journal area. A checkpoint writes the container in
+     * place and restarts the records at the front with a new first_seq;
+     * older records left behind have lower sequence numbers and end the
+     * scan.
+     */
+
+    constexpr char JOURNAL_MAGIC[8] = {'O', 'F', 'S', 'J', 'R', 'N', 'L', '1'};
+    constexpr uint32_t JOURNAL_RECORD_MAGIC = 0x4C4E524Au;  // "JRNL"
+    constexpr uint64_t JOURNAL_RECORDS_OFFSET = 64u;
+    // Journal start and size are multiples of this, so that no page of the
+    // journal holds metadata or content (covers 4, 16 and 64 KiB pages).
+    constexpr uint64_t JOURNAL_ALIGN = 64u * 1024u;
+
+    struct JournalHeader {
+        char magic[8];              // JOURNAL_MAGIC
+        uint64_t first_seq;         // Sequence of the first record
+        uint64_t checkpoints;       // Checkpoints since format
+        uint64_t reserved[5];       // Padding
+    };  // Total: 64 bytes
+
+    struct JournalRecord {
+        uint32_t magic;             // JOURNAL_RECORD_MAGIC
+        uint32_t ranges;            // JournalRange entries that follow
+        uint64_t seq;               // Sequence number
+        uint64_t length;            // Whole record in bytes, multiple of 8
+        uint64_t checksum;          // Over seq, length, ranges and the payload
+    };  // Total: 32 bytes
+
+    struct JournalRange {
+        uint64_t offset;            // Container byte offset
+        uint32_t length;            // Bytes that follow (then padding to 8)
+        uint32_t reserved;          // Padding
+    };  // Total: 16 bytes
+
+    static_assert(sizeof(JournalHeader) == 64 && sizeof(JournalRecord) == 32 && sizeof(JournalRange) == 16,
+                  "journal structures must keep their on-disk sizes");
+
+    // When a committed operation is known to be on disk.
+    enum class Durability
+    {
+        fsync,   // every commit flushes the journal before it returns
+        group,   // commits wait for a flush that runs every group_commit_ms
+        async    // commits return at once; flushes run every group_commit_ms
+    };
+
+    Durability durability_from_string(const std::string& name);
+    const char* durability_name(Durability durability);
+
+    /**
+     * Redo journal for the metadata of one container.
+     *
+     * Between Transaction begin and commit, every OmniContainer::mark_dirty()
+     * range is collected; the commit copies their current bytes into one
+     * record. Content written through write_segments() is not journaled;
+     * it is flushed before the records of the operations that wrote it,
+     * so a replayed entry never points at stale data.
+     *
+     * The container's in-place pages are only written out by a checkpoint,
+     * after every record covering them is durable. A checkpoint runs from
+     * OmniContainer::sync() (the sync policy's flusher and shutdown), and
+     * before a transaction starts once the journal is half full; it waits
+     * for transactions in progress, so no half-made change is written in
+     * place. The metadata areas are mapped private, so the kernel cannot
+     * write them back on its own either; extent nodes and chain pointers
+     * live in content blocks, which are shared, and are the exception.
+     *
+     * A flush makes every appended record durable with one msync, however
+     * many operations committed since the last one.
+     */
+    class Journal
+    {
+    public:
+        struct Range
+        {
+            uint64_t offset;
+            uint64_t len;
+        };
+
+        struct Stats
+        {
+            uint64_t records;
+            uint64_t bytes;
+            uint64_t flushes;
+            uint64_t checkpoints;
+            uint64_t replayed;      // records applied by the last attach()
+        };
+
+        Journal();
+        ~Journal();
+
+        Journal(const Journal&) = delete;
+        Journal& operator=(const Journal&) = delete;
+
+        // Replays the records left by a crash, checkpoints, and starts
+        // journaling. A container formatted without a journal area is left
+        // alone (active() stays false).
+        OFSErrorCodes attach(OmniContainer& container, Durability durability, uint32_t group_commit_ms);
+
+        // Checkpoints and stops journaling.
+        void detach();
+
+        bool active() const { return container_ != nullptr; }
+        Durability durability() const { return durability_; }
+
+        // Makes every record durable, writes the container in place and
+        // empties the journal.
+        OFSErrorCodes checkpoint();
+
+        // Flushes records up to seq (0: everything appended).
+        void flush(uint64_t seq = 0);
+
+        // Runs done once record seq is durable: at once under async or when
+        // it already is, after a flush under fsync, from the flusher thread
+        // under group.
+        void when_durable(uint64_t seq, std::function<void()> done);
+
+        // OmniContainer hooks: bytes changed at a container offset. data
+        // ranges are content, flushed ahead of the records.
+        void note(uint64_t offset, size_t len, bool data);
+
+        Stats stats() const;
+
+    private:
+        friend class Transaction;
+
+        using Waiters = std::vector<std::pair<uint64_t, std::function<void()>>>;
+
+        OmniContainer* container_;
+        Durability durability_;
+        uint32_t group_commit_ms_;
+        uint64_t area_offset_;       // container offset of the journal
+        uint64_t area_size_;
+        JournalHeader* header_;
+
+        // Transactions in progress, and a checkpoint waiting for them.
+        // stalled_ of those are themselves waiting to checkpoint, for room
+        // for their record; a checkpoint does not wait for them.
+        std::mutex gate_mtx_;
+        std::condition_variable gate_cv_;
+        uint32_t in_progress_;
+        uint32_t stalled_;
+        bool checkpoint_waiting_;
+
+        // Appending: guarded by append_mtx_.
+        std::mutex append_mtx_;
+        uint64_t next_seq_;
+        uint64_t write_pos_;         // from the start of the area
+        std::vector<Range> pending_data_;
+
+        // Flushing: guarded by flush_mtx_; lock order flush_mtx_, append_mtx_.
+        std::mutex flush_mtx_;
+        std::condition_variable durable_cv_;
+        std::atomic<uint64_t> durable_seq_;
+        uint64_t flushed_pos_;
+        Waiters waiters_;            // when_durable() under group
+
+        std::thread flusher_;
+        std::mutex flusher_mtx_;
+        std::condition_variable flusher_cv_;
+        bool flusher_stop_;
+
+        std::atomic<uint64_t> records_;
+        std::atomic<uint64_t> bytes_;
+        std::atomic<uint64_t> flushes_;
+        std::atomic<uint64_t> checkpoints_;
+        uint64_t replayed_;
+
+        uint64_t replay();
+        void reset(uint64_t first_seq);
+        void enter();
+        void leave();
+        uint64_t append(std::vector<Range>& meta, std::vector<Range>& data);
+        void wait(uint64_t seq);
+        void flush_locked(Waiters& ready);
+        OFSErrorCodes checkpoint_gated(bool inside);
+        OFSErrorCodes checkpoint_quiet();
+        void flusher_loop();
+    };
+
+    /**
+     * One journaled change. Nested transactions on a thread join the
+     * outermost one. commit() records the changes and must run while the
+     * lock that ordered them is still held; the destructor commits if that
+     * has not happened and then waits for durability as the journal's
+     * level asks, unless a DeferredCommits is active on the thread.
+     * Without a journal every step is a no-op.
+     */
+    class Transaction
+    {
+    public:
+        explicit Transaction(Journal* journal);
+        ~Transaction();
+
+        Transaction(const Transaction&) = delete;
+        Transaction& operator=(const Transaction&) = delete;
+
+        void commit();
+
+    private:
+        Journal* journal_;
+        bool outer_;
+        bool committed_;
+        uint64_t seq_;
+    };
+
+    // An exclusive lock with a Transaction inside it: the transaction
+    // starts once the lock is held, commits before it is released and
+    // waits for durability after.
+    template <typename Mutex>
+    class LockedTransaction
+    {
+    public:
+        LockedTransaction(Journal* journal, Mutex& mtx) : lock_(mtx), tx_(journal) {}
+
+        ~LockedTransaction()
+        {
+            tx_.commit();
+            lock_.unlock();
+        }
+
+    private:
+        std::unique_lock<Mutex> lock_;
+        Transaction tx_;
+    };
+
+    /**
+     * While alive, transactions on this thread return without waiting for
+     * durability; last() is the newest record they wrote, for
+     * Journal::when_durable. The server uses this to send a response only
+     * once the change is on disk without holding up the next request.
+     */
+    class DeferredCommits
+    {
+    public:
+        DeferredCommits();
+        ~DeferredCommits();
+
+        DeferredCommits(const DeferredCommits&) = delete;
+        DeferredCommits& operator=(const DeferredCommits&) = delete;
+
+        uint64_t last() const;
+
+    private:
+        bool outer_;
+    };
+}
+
+#endif // JOURNAL_HPP
@@ -0,0 +1,117 @@
+#ifndef LOG_ENCODING_HPP
+#define LOG_ENCODING_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <deque>
+#include <functional>
+
+#include "logger.hpp"
+
+namespace ofs
+{
+
+const char* log_level_name(LogLevel level);
+
+// Renders the standard text line:
+// TIMESTAMP app="APP" pid=PID level=LEVEL module=MODULE code=CODE msg="MSG" file="FILE" line=LINE
+// The timestamp comes from the per-thread cache in coarse_clock.hpp.
+void format_text_log_line(std::string& out,
+                          int64_t wall_ns,
+                          std::string_view app,
+                          int pid,
+                          LogLevel level,
+                          std::string_view module,
+                          int code,
+                          std::string_view msg,
+                          std::string_view src_file,
+                          int line);
+
+/*
+ * Binary log layout
+ *
+ * A file is a sequence of segments. A new segment starts every time the
+ * logger opens the file, so appending to an existing log stays decodable.
+ *
+ *   segment := MAGIC "OFSBLOG1"
+ *              varint base_wall_ns      wall clock when the segment started
+ *              varint pid
+ *              varint app_len, app bytes
+ *              record*
+ *
+ *   record  := 0x01 varint id, varint len, bytes          string definition
+ *            | 0x02 varint delta_ns                      log event
+ *                   u8 level
+ *                   varint zigzag(code)
+ *                   varint module_id
+ *                   varint file_id
+ *                   varint line
+ *                   varint msg_len, msg bytes
+ *
+ * delta_ns is a steady-clock offset from the segment base, so events are
+ * ordered even if the wall clock steps. Module and file names are interned
+ * per segment and only written once.
+ */
+class BinaryLogEncoder
+{
+private:
+    // Keys view into storage_, which never relocates its strings.
+    std::deque<std::string> storage_;
+    std::unordered_map<std::string_view, uint64_t> interned_;
+    int64_t base_steady_ns_;
+    bool segment_open_;
+
+    uint64_t intern(std::string& out, std::string_view s);
+
+public:
+    BinaryLogEncoder();
+
+    // Forget the string table; the next record starts a new segment.
+    void reset();
+
+    bool segment_open() const { return segment_open_; }
+
+    void begin_segment(std::string& out,
+                       int64_t wall_ns,
+                       int64_t steady_ns,
+                       std::string_view app,
+                       int pid);
+
+    void append_record(std::string& out,
+                       int64_t steady_ns,
+                       LogLevel level,
+                       std::string_view module,
+                       int code,
+                       std::string_view msg,
+                       std::string_view src_file,
+                       int line);
+};
+
+struct DecodedLogRecord
+{
+    int64_t wall_ns;
+    LogLevel level;
+    int code;
+    int line;
+    int pid;
+    std::string_view app;
+    std::string_view module;
+    std::string_view src_file;
+    std::string_view msg;
+};
+
+// Decodes a whole binary log image. Returns false (with err set) on a
+// malformed or truncated segment; records before the damage are still
+// delivered to the callback.
+bool decode_binary_log(std::string_view data,
+                       const std::function<void(const DecodedLogRecord&)>& on_record,
+                       std::string& err);
+
+bool is_binary_log(std::string_view data);
+
+} // namespace ofs
+
+#endif // LOG_ENCODING_HPP
@@ -0,0 +1,117 @@
+#ifndef LOG_FORMAT_HPP
+#define LOG_FORMAT_HPP
+
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <charconv>
+#include <cstdio>
+#include <type_traits>
+#include <utility>
+
+namespace ofs
+{
+
+namespace detail
+{
+    inline void append_log_arg(std::string& out, const std::string& v) { out += v; }
+    inline void append_log_arg(std::string& out, std::string_view v) { out.append(v.data(), v.size()); }
+    inline void append_log_arg(std::string& out, const char* v) { out += (v ? v : "(null)"); }
+    inline void append_log_arg(std::string& out, char* v) { out += (v ? v : "(null)"); }
+    inline void append_log_arg(std::string& out, char v) { out += v; }
+    inline void append_log_arg(std::string& out, bool v) { out += (v ? "true" : "false"); }
+
+    template <typename T>
+    void append_log_arg(std::string& out, const T& v)
+    {
+        if constexpr (std::is_integral_v<T> || std::is_enum_v<T>)
+        {
+            using U = std::conditional_t<std::is_enum_v<T>, std::underlying_type<T>, std::common_type<T>>;
+            char buf[24];
+            auto res = std::to_chars(buf, buf + sizeof(buf), static_cast<typename U::type>(v));
+            out.append(buf, res.ptr);
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            char buf[32];
+            int n = std::snprintf(buf, sizeof(buf), "%g", static_cast<double>(v));
+            if (n > 0) {
+                out.append(buf, static_cast<size_t>(n) < sizeof(buf) ? static_cast<size_t>(n) : sizeof(buf) - 1);
+            }
+        }
+        else
+        {
+            std::ostringstream oss;
+            oss << v;
+            out += oss.str();
+        }
+    }
+
+    // Copies fmt up to the next "{}" (honouring "{{" / "}}" escapes) and
+    // returns the position just after the placeholder, or npos at the end.
+    inline size_t copy_until_placeholder(std::string& out, std::string_view fmt, size_t pos)
+    {
+        while (pos < fmt.size()) {
+            char c = fmt[pos];
+            if (c == '{' && pos + 1 < fmt.size()) {
+                if (fmt[pos + 1] == '{') { out += '{'; pos += 2; continue; }
+                if (fmt[pos + 1] == '}') { return pos + 2; }
+            }
+            if (c == '}' && pos + 1 < fmt.size() && fmt[pos + 1] == '}') {
+                out += '}';
+                pos += 2;
+                continue;
+            }
+            out += c;
+            ++pos;
+        }
+        return std::string_view::npos;
+    }
+
+    inline void format_rest(std::string& out, std::string_view fmt, size_t pos)
+    {
+        // Placeholders without a matching argument are kept verbatim.
+        while (pos != std::string_view::npos && pos <= fmt.size()) {
+            pos = copy_until_placeholder(out, fmt, pos);
+            if (pos != std::string_view::npos) {
+                out += "{}";
+            }
+        }
+    }
+
+    template <typename Arg, typename... Rest>
+    void format_rest(std::string& out, std::string_view fmt, size_t pos, const Arg& arg, const Rest&... rest)
+    {
+        if (pos == std::string_view::npos) {
+            return;
+        }
+        pos = copy_until_placeholder(out, fmt, pos);
+        if (pos == std::string_view::npos) {
+            return;
+        }
+        append_log_arg(out, arg);
+        format_rest(out, fmt, pos, rest...);
+    }
+}
+
+// A lone message is passed through untouched (braces in it are not special),
+// so existing LOG_* call sites keep working without any copy.
+template <typename Msg>
+decltype(auto) format_log_message(Msg&& msg)
+{
+    return std::forward<Msg>(msg);
+}
+
+// "{}"-style formatting: format_log_message("loaded {} users", n).
+template <typename Arg, typename... Rest>
+std::string format_log_message(std::string_view fmt, const Arg& arg, const Rest&... rest)
+{
+    std::string out;
+    out.reserve(fmt.size() + 16 * (1 + sizeof...(Rest)));
+    detail::format_rest(out, fmt, 0, arg, rest...);
+    return out;
+}
+
+} // namespace ofs
+
+#endif // LOG_FORMAT_HPP
@@ -1,16 +1,71 @@
 #ifndef LOG_MACROS_HPP
 #define LOG_MACROS_HPP
 
-#include "logger.hpp" 
+#include "logger.hpp"
+#include "log_format.hpp"
 
-// The core macro that calls the actual log function, passing __FILE__ and __LINE__
-#define OFS_LOG(level, module, code, msg) \
-    ofs::Logger::get_instance().log(level, module, code, msg, __FILE__, __LINE__)
+// Numeric levels, matching the order of ofs::LogLevel.
+#define OFS_LOG_LEVEL_DEBUG 0
+#define OFS_LOG_LEVEL_INFO  1
+#define OFS_LOG_LEVEL_WARN  2
+#define OFS_LOG_LEVEL_ERROR 3
+#define OFS_LOG_LEVEL_FATAL 4
 
-#define LOG_FATAL(module, code, msg)  OFS_LOG(ofs::LogLevel::fatal, module, code, msg)
-#define LOG_ERROR(module, code, msg)  OFS_LOG(ofs::LogLevel::error, module, code, msg)
-#define LOG_WARN(module, code, msg)   OFS_LOG(ofs::LogLevel::warn, module, code, msg)
-#define LOG_INFO(module, code, msg)   OFS_LOG(ofs::LogLevel::info, module, code, msg)
-#define LOG_DEBUG(module, code, msg)  OFS_LOG(ofs::LogLevel::debug, module, code, msg)
+// Compile-time floor: calls below this level are removed entirely, e.g.
+// -DOFS_MIN_LOG_LEVEL=OFS_LOG_LEVEL_INFO drops every LOG_DEBUG. FATAL can
+// never be compiled out because it terminates the process.
+#ifndef OFS_MIN_LOG_LEVEL
+#define OFS_MIN_LOG_LEVEL OFS_LOG_LEVEL_DEBUG
+#endif
 
-#endif // LOG_MACROS_HPP
\ No newline at end of file
+// The core macro that calls the actual log function, passing __FILE__ and __LINE__.
+// The runtime level is checked first, so the message (and any format
+// arguments) is only built when the record will actually be written:
+//   LOG_DEBUG(MODULE, 50, "read " + std::to_string(n) + " bytes");
+//   LOG_DEBUG(MODULE, 50, "read {} bytes from {}", n, path);
+#define OFS_LOG(level, module, code, ...)                                               \
+    do {                                                                                \
+        ofs::Logger& ofs_logger_ = ofs::Logger::get_instance();                         \
+        if (ofs_logger_.should_log(level)) {                                            \
+            ofs_logger_.log(level, module, code, ofs::format_log_message(__VA_ARGS__),  \
+                            __FILE__, __LINE__);                                        \
+        }                                                                               \
+    } while (0)
+
+// Compiled-out calls still type-check their arguments but never evaluate them.
+#define OFS_LOG_DISCARD(module, code, ...)                                              \
+    do {                                                                                \
+        if (false) {                                                                    \
+            (void)(module);                                                             \
+            (void)(code);                                                               \
+            (void)ofs::format_log_message(__VA_ARGS__);                                 \
+        }                                                                               \
+    } while (0)
+
+#define LOG_FATAL(module, code, ...)  OFS_LOG(ofs::LogLevel::fatal, module, code, __VA_ARGS__)
+
+#if OFS_MIN_LOG_LEVEL <= OFS_LOG_LEVEL_ERROR
+#define LOG_ERROR(module, code, ...)  OFS_LOG(ofs::LogLevel::error, module, code, __VA_ARGS__)
+#else
+#define LOG_ERROR(module, code, ...)  OFS_LOG_DISCARD(module, code, __VA_ARGS__)
+#endif
+
+#if OFS_MIN_LOG_LEVEL <= OFS_LOG_LEVEL_WARN
+#define LOG_WARN(module, code, ...)   OFS_LOG(ofs::LogLevel::warn, module, code, __VA_ARGS__)
+#else
+#define LOG_WARN(module, code, ...)   OFS_LOG_DISCARD(module, code, __VA_ARGS__)
+#endif
+
+#if OFS_MIN_LOG_LEVEL <= OFS_LOG_LEVEL_INFO
+#define LOG_INFO(module, code, ...)   OFS_LOG(ofs::LogLevel::info, module, code, __VA_ARGS__)
+#else
+#define LOG_INFO(module, code, ...)   OFS_LOG_DISCARD(module, code, __VA_ARGS__)
+#endif
+
+#if OFS_MIN_LOG_LEVEL <= OFS_LOG_LEVEL_DEBUG
+#define LOG_DEBUG(module, code, ...)  OFS_LOG(ofs::LogLevel::debug, module, code, __VA_ARGS__)
+#else
+#define LOG_DEBUG(module, code, ...)  OFS_LOG_DISCARD(module, code, __VA_ARGS__)
+#endif
+
+#endif // LOG_MACROS_HPP
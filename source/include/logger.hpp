@@ -6,36 +6,137 @@
 #include <mutex>
 #include <chrono>
 #include <ctime>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+#include <cstdint>
+#include <deque>
+
+#include "mpsc_ring_buffer.hpp"
 
 namespace ofs
 {
 
 enum class LogLevel
 {
-    debug, 
-    info,  
-    warn,  
-    error, 
-    fatal  
+    debug,
+    info,
+    warn,
+    error,
+    fatal
+};
+
+// What a producer does when the async ring buffer is full.
+enum class LogOverflowPolicy
+{
+    block,           // wait for the writer thread to free a slot
+    drop_and_count,  // discard the record and bump dropped_records()
+    drop_debug_only  // discard debug records, block for everything else
 };
 
+// On-disk encoding of log records (console output is always text).
+enum class LogFormat
+{
+    text,   // key=value lines, see notes/logging_notes.md
+    binary  // compact interned records, decoded with ofs_logcat
+};
+
+// When the active log file is archived and how many archives are kept.
+struct LogRotationPolicy
+{
+    uint64_t max_size_bytes = 1024 * 1024;  // rotate once the file reaches this size
+    uint64_t max_age_seconds = 0;           // rotate files older than this (0 = never)
+    uint32_t max_archives = 10;             // archives kept on disk (0 = unlimited)
+    bool compress = true;                   // compress archives to <name>.lz
+};
+
+class BinaryLogEncoder;
+
 class Logger
 {
 private:
+    // Fixed-size record handed from producers to the async writer thread.
+    // Strings longer than their field are truncated.
+    struct LogRecord
+    {
+        int64_t timestamp_ns;
+        int64_t steady_ns;
+        LogLevel level;
+        int code;
+        int line;
+        char module[32];
+        char src_file[160];
+        char msg[800];
+    };
+
+    static constexpr size_t ASYNC_BATCH_RECORDS = 256;
+
     std::ofstream file_stream_;
     std::mutex mtx_;
     std::string log_file_path_;
-    static constexpr size_t MAX_FILE_SIZE_BYTES = 1024 * 1024;
+    LogRotationPolicy rotation_;
+    uint64_t file_opened_at_;
+    uint64_t rotation_checked_at_;  // last look for an outside rotation
     std::string app_identifier_;
     int process_id_;
+    LogFormat format_;
+    std::unique_ptr<BinaryLogEncoder> encoder_;
+
+    // async backend
+    std::unique_ptr<MpscRingBuffer<LogRecord>> ring_;
+    std::thread writer_thread_;
+    std::atomic<bool> async_enabled_;
+    std::atomic<bool> writer_stop_;
+    std::atomic<bool> writer_idle_;
+    std::atomic<int> active_producers_;
+    std::atomic<uint64_t> dropped_records_;
+    std::atomic<int> min_level_;
+    std::mutex wake_mtx_;
+    std::condition_variable wake_cv_;
+    LogOverflowPolicy overflow_policy_;
+    size_t async_capacity_;
+    size_t bytes_written_;
+    int fd_;
+
+    // Archiver: compresses rotated files and enforces retention off the
+    // logging path.
+    struct ArchiveJob
+    {
+        std::string archive_path;
+        std::string active_path;
+        LogRotationPolicy policy;
+    };
+    std::thread archiver_thread_;
+    std::mutex archive_mtx_;
+    std::condition_variable archive_cv_;
+    std::deque<ArchiveJob> archive_queue_;
+    bool archiver_stop_;
 
     Logger();
     void rotate_if_needed();
+    bool rotation_due() const;
+    std::string archive_path();
+    void queue_archive(const std::string& archived);
+    void archiver_loop();
+    void process_archive(const ArchiveJob& job);
+    void stop_archiver();
     bool file_was_rotated();
     std::string get_timestamp_utc();
     std::string level_to_string(LogLevel level);
     void initialize_app_identifier();
 
+    void open_stream();
+    void append_entry(std::string& out,
+                      int64_t wall_ns,
+                      int64_t steady_ns,
+                      LogLevel level,
+                      const char* module,
+                      int code,
+                      const char* msg,
+                      const char* src_file,
+                      int line);
+
     void write_internal(LogLevel level,
                         const std::string& module,
                         int code,
@@ -43,6 +144,23 @@ private:
                         const std::string& src_file,
                         int line);
 
+    bool enqueue_async(LogLevel level,
+                       const std::string& module,
+                       int code,
+                       const std::string& msg,
+                       const std::string& src_file,
+                       int line);
+
+    void writer_loop();
+    bool open_async_file();
+    void close_async_file();
+    void rotate_async_file();
+    void write_batch(const std::string& file_batch,
+                     const std::string& out_batch,
+                     const std::string& err_batch);
+    bool start_async_locked();
+    void stop_async_locked();
+
 public:
 
     ~Logger();
@@ -52,6 +170,35 @@ public:
     void set_log_file(const std::string& path);
     void set_app_name(const std::string& name);
 
+    // Selects the file encoding. Each file (and each reopen) starts a new
+    // self-describing segment, so formats can change between runs.
+    void set_log_format(LogFormat format);
+    LogFormat log_format() const { return format_; }
+
+    // Rotation thresholds and archive retention (the [logging] uconf section).
+    void set_rotation_policy(const LogRotationPolicy& policy);
+
+    // Switches to the asynchronous backend: log() only copies the record into
+    // a lock-free ring buffer and a background thread batches it to disk.
+    void enable_async(size_t capacity = 4096,
+                      LogOverflowPolicy policy = LogOverflowPolicy::block);
+
+    // Drains everything still queued and returns to synchronous writes.
+    void disable_async();
+
+    // Records below this level are discarded. FATAL is always written.
+    void set_min_level(LogLevel level) { min_level_.store(static_cast<int>(level), std::memory_order_relaxed); }
+    LogLevel min_level() const { return static_cast<LogLevel>(min_level_.load(std::memory_order_relaxed)); }
+
+    bool should_log(LogLevel level) const
+    {
+        return level == LogLevel::fatal ||
+               static_cast<int>(level) >= min_level_.load(std::memory_order_relaxed);
+    }
+
+    bool is_async() const { return async_enabled_.load(std::memory_order_acquire); }
+    uint64_t dropped_records() const { return dropped_records_.load(std::memory_order_relaxed); }
+
     void log(LogLevel level,
              const std::string& module,
              int code,
@@ -59,6 +206,9 @@ public:
              const std::string& src_file,
              int line)
     {
+        if (!should_log(level)) {
+            return;
+        }
         write_internal(level, module, code, msg, src_file, line);
     }
 
@@ -68,4 +218,4 @@ public:
 
 } // namespace ofs
 
-#endif // LOGGER_HPP
\ No newline at end of file
+#endif // LOGGER_HPP
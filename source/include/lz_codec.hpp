@@ -0,0 +1,27 @@
+#ifndef LZ_CODEC_HPP
+#define LZ_CODEC_HPP
+
+#include <string>
+#include <string_view>
+
+namespace ofs::lz
+{
+    /*
+     * Small LZ77 codec used for rotated log archives (no external libraries).
+     *
+     *   frame := "OFSLZ01\n" chunk* end
+     *   chunk := u32 raw_len, u32 packed_len, packed bytes     (little endian)
+     *   end   := u32 0
+     *
+     * A chunk holds at most CHUNK_SIZE input bytes and is a sequence of
+     * LZ4-style (literal run, back-reference) pairs; the last pair of a chunk
+     * has no back-reference.
+     */
+    constexpr size_t CHUNK_SIZE = 1u << 20;
+
+    void compress(std::string_view src, std::string& out);
+    bool decompress(std::string_view frame, std::string& out, std::string& err);
+    bool is_frame(std::string_view data);
+}
+
+#endif // LZ_CODEC_HPP
@@ -0,0 +1,113 @@
+#ifndef MPSC_RING_BUFFER_HPP
+#define MPSC_RING_BUFFER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+
+namespace ofs
+{
+
+// Bounded multi-producer / single-consumer ring buffer.
+//
+// Every cell carries a sequence number (Vyukov's bounded queue): a producer
+// claims a slot with one CAS on the enqueue cursor, copies its payload in and
+// publishes it by bumping the cell sequence. The single consumer never needs
+// a CAS, it only checks the sequence of the cell under its cursor.
+//
+// T must be trivially copyable; capacity is rounded up to a power of two.
+template <typename T>
+class MpscRingBuffer
+{
+private:
+    static constexpr size_t CACHE_LINE = 64;
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> cells_;
+    size_t mask_;
+
+    alignas(CACHE_LINE) std::atomic<size_t> enqueue_pos_;
+    alignas(CACHE_LINE) std::atomic<size_t> dequeue_pos_;
+
+    static size_t round_up_pow2(size_t n)
+    {
+        size_t p = 2;
+        while (p < n) {
+            p <<= 1;
+        }
+        return p;
+    }
+
+public:
+    explicit MpscRingBuffer(size_t capacity)
+        : cells_(new Cell[round_up_pow2(capacity)]),
+          mask_(round_up_pow2(capacity) - 1),
+          enqueue_pos_(0),
+          dequeue_pos_(0)
+    {
+        for (size_t i = 0; i <= mask_; ++i) {
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    MpscRingBuffer(const MpscRingBuffer&) = delete;
+    MpscRingBuffer& operator=(const MpscRingBuffer&) = delete;
+
+    size_t capacity() const { return mask_ + 1; }
+
+    // Producer side. Returns false when the buffer is full.
+    bool try_push(const T& value)
+    {
+        size_t pos = enqueue_pos_.load(std::memory_order_relaxed);
+        for (;;) {
+            Cell& cell = cells_[pos & mask_];
+            size_t seq = cell.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.value = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            } else if (diff < 0) {
+                return false;
+            } else {
+                pos = enqueue_pos_.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer side. Must only be called from one thread at a time.
+    bool try_pop(T& out)
+    {
+        size_t pos = dequeue_pos_.load(std::memory_order_relaxed);
+        Cell& cell = cells_[pos & mask_];
+        size_t seq = cell.sequence.load(std::memory_order_acquire);
+        if (static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos + 1) < 0) {
+            return false;
+        }
+        out = cell.value;
+        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+        dequeue_pos_.store(pos + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Approximate fill level, only meaningful as a hint.
+    size_t size_approx() const
+    {
+        size_t head = enqueue_pos_.load(std::memory_order_relaxed);
+        size_t tail = dequeue_pos_.load(std::memory_order_relaxed);
+        return head >= tail ? head - tail : 0;
+    }
+};
+
+} // namespace ofs
+
+#endif // MPSC_RING_BUFFER_HPP
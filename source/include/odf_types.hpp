@@ -232,7 +232,12 @@ struct FSStats {
     uint32_t total_users;       // Total number of users
     uint32_t active_sessions;   // Currently active sessions
     double fragmentation;       // Fragmentation percentage (0.0 - 100.0)
-    uint8_t reserved[64];       // Reserved
+    uint64_t cache_hits;        // Block reads served by the block cache
+    uint64_t cache_misses;      // Block reads that went to the container
+    uint64_t cache_evictions;   // Blocks the cache evicted to make room
+    uint64_t cache_read_ahead;  // Blocks read ahead of sequential readers
+    uint64_t cache_read_ahead_hits; // Read-ahead blocks that were then read
+    uint8_t reserved[24];       // Reserved
 
     // Default constructor
     FSStats() = default;
@@ -241,7 +246,9 @@ struct FSStats {
     FSStats(uint64_t total, uint64_t used, uint64_t free)
         : total_size(total), used_space(used), free_space(free),
           total_files(0), total_directories(0), total_users(0),
-          active_sessions(0), fragmentation(0.0) {
+          active_sessions(0), fragmentation(0.0),
+          cache_hits(0), cache_misses(0), cache_evictions(0),
+          cache_read_ahead(0), cache_read_ahead_hits(0) {
         std::memset(reserved, 0, sizeof(reserved));
     }
 };
@@ -0,0 +1,278 @@
+#ifndef OMNI_CONTAINER_HPP
+#define OMNI_CONTAINER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+#include <memory>
+
+#include "byte_map.hpp"
+#include "io_ring.hpp"
+#include "odf_types.hpp"
+#include "omni_layout.hpp"
+#include "config_types.hpp"
+
+namespace ofs::storage
+{
+    class Journal;
+    class BlockCache;
+
+    // When dirty ranges of the mapping are pushed to disk with msync.
+    enum class SyncPolicy
+    {
+        immediate,   // every mark_dirty() is flushed before it returns
+        periodic,    // a background thread flushes every sync_interval_ms
+        on_shutdown  // only sync() and close() flush
+    };
+
+    SyncPolicy sync_policy_from_string(const std::string& name);
+
+    // How file content moves between the container and caller buffers.
+    enum class IoBackend
+    {
+        mmap,     // memcpy through the mapping
+        pread,    // pread / pwrite, one call per contiguous run
+        io_uring  // every run of a transfer in one io_uring submission
+    };
+
+    IoBackend io_backend_from_string(const std::string& name);
+    const char* io_backend_name(IoBackend backend);
+
+    // One contiguous piece of a scattered transfer: len bytes at byte
+    // offset of the container file.
+    struct IoSegment
+    {
+        uint64_t offset;
+        uint8_t* data;
+        size_t len;
+    };
+
+    // Non-owning view over a contiguous run of bytes inside the mapping.
+    template <typename T>
+    struct View
+    {
+        T* data = nullptr;
+        size_t size = 0;
+
+        T* begin() const { return data; }
+        T* end() const { return data + size; }
+        bool empty() const { return size == 0; }
+        T& operator[](size_t i) const { return data[i]; }
+    };
+
+    using ByteView = View<uint8_t>;
+    using ConstByteView = View<const uint8_t>;
+
+    /**
+     * Memory-mapped .omni container.
+     *
+     * fs_init does not parse anything: open() maps the file, validates the
+     * header and hands out typed pointers straight into the mapping. Callers
+     * that modify mapped bytes report the range with mark_dirty(); the sync
+     * policy decides when those ranges reach the disk.
+     *
+     * In a container with a journal, everything below the content area is
+     * mapped private: changes to it stay in this process until a sync
+     * writes the dirty ranges out with pwrite, so neither the kernel's
+     * writeback nor a crash can put an uncommitted change in the file.
+     */
+    class OmniContainer
+    {
+    private:
+        int fd_;
+        uint8_t* base_;
+        size_t size_;
+        uint64_t private_end_;  // [0, private_end_) is mapped MAP_PRIVATE
+        std::string path_;
+
+        OMNIHeader* header_;
+        const OmniLayoutInfo* layout_;
+
+        SyncPolicy policy_;
+        uint32_t sync_interval_ms_;
+
+        // Dirty byte ranges, page aligned and merged: start -> end.
+        std::map<uint64_t, uint64_t> dirty_;
+        std::mutex dirty_mtx_;
+
+        std::thread flusher_;
+        std::mutex flusher_mtx_;
+        std::condition_variable flusher_cv_;
+        bool flusher_stop_;
+
+        IoBackend io_backend_;
+        std::unique_ptr<IoRing> ring_;  // io_uring backend; container fd is fixed file 0, null once it failed
+        std::mutex ring_mtx_;
+
+        Journal* journal_;
+
+        // Content substitution map from the container and its inverse.
+        bool encoded_;
+        bytemap::Table encode_;
+        bytemap::Table decode_;
+
+        std::unique_ptr<BlockCache> cache_;
+
+        void add_dirty(uint64_t start, uint64_t end);
+
+        OFSErrorCodes validate();
+        OFSErrorCodes transfer_sync(const IoSegment* segs, size_t count, bool write);
+        OFSErrorCodes transfer_ring(const IoSegment* segs, size_t count, bool write);
+        void drain_ring(size_t outstanding);
+        OFSErrorCodes read_direct(const IoSegment* segs, size_t count);
+        OFSErrorCodes write_direct(const IoSegment* segs, size_t count);
+        OFSErrorCodes write_back(const IoSegment* segs, size_t count);
+        void flusher_loop();
+        OFSErrorCodes flush_ranges(std::map<uint64_t, uint64_t>& ranges);
+        OFSErrorCodes write_out(uint64_t start, uint64_t end, bool& wrote);
+
+    public:
+        OmniContainer();
+        ~OmniContainer();
+
+        OmniContainer(const OmniContainer&) = delete;
+        OmniContainer& operator=(const OmniContainer&) = delete;
+
+        // Creates a new container sized and laid out from cfg. An existing
+        // file at path is replaced.
+        static OFSErrorCodes format(const std::string& path, const config::Config& cfg);
+
+        // Computes the layout fs_format would produce for cfg.
+        static OFSErrorCodes compute_layout(const config::Config& cfg, OmniLayoutInfo& out);
+
+        OFSErrorCodes open(const std::string& path,
+                           SyncPolicy policy = SyncPolicy::periodic,
+                           uint32_t sync_interval_ms = 1000);
+        void close();
+
+        bool is_open() const { return base_ != nullptr; }
+        const std::string& path() const { return path_; }
+        int fd() const { return fd_; }
+
+        // Typed access into the mapping.
+        OMNIHeader* header() { return header_; }
+        const OmniLayoutInfo& layout() const { return *layout_; }
+
+        UserInfo* user_table() { return reinterpret_cast<UserInfo*>(base_ + header_->user_table_offset); }
+        uint32_t max_users() const { return header_->max_users; }
+
+        uint32_t max_files() const { return layout_->max_files; }
+        MetadataEntry* metadata_table() { return reinterpret_cast<MetadataEntry*>(base_ + layout_->metadata_offset); }
+        // index is 1-based; returns nullptr when out of range.
+        MetadataEntry* entry(uint32_t index)
+        {
+            if (index == 0 || index > layout_->max_files) {
+                return nullptr;
+            }
+            return metadata_table() + (index - 1);
+        }
+
+        // Dentry hash table slots; empty for containers formatted without one.
+        View<uint32_t> dentry_table()
+        {
+            return View<uint32_t>{reinterpret_cast<uint32_t*>(base_ + layout_->dentry_offset),
+                                  static_cast<size_t>(layout_->dentry_slots)};
+        }
+
+        // Layout fields that change at run time (e.g. dentry_clean).
+        OmniLayoutInfo& mutable_layout() { return *layout_info(header_); }
+
+        ByteView free_map() { return ByteView{base_ + layout_->free_map_offset, static_cast<size_t>(layout_->free_map_size)}; }
+
+        BlockMapping block_mapping() const { return static_cast<BlockMapping>(layout_->block_mapping); }
+
+        uint64_t total_blocks() const { return layout_->total_blocks; }
+        uint32_t block_size() const { return static_cast<uint32_t>(header_->block_size); }
+
+        // block_index is 1-based; returns an empty view when out of range.
+        ByteView block(uint32_t block_index)
+        {
+            if (block_index == 0 || block_index > layout_->total_blocks) {
+                return ByteView{};
+            }
+            return ByteView{base_ + block_offset(block_index), block_size()};
+        }
+
+        // Contiguous view over count blocks starting at first_block.
+        ByteView blocks(uint32_t first_block, uint32_t count)
+        {
+            if (first_block == 0 || count == 0 ||
+                static_cast<uint64_t>(first_block) + count - 1 > layout_->total_blocks) {
+                return ByteView{};
+            }
+            return ByteView{base_ + block_offset(first_block), static_cast<size_t>(count) * block_size()};
+        }
+
+        uint64_t block_offset(uint32_t block_index) const
+        {
+            return layout_->content_offset + static_cast<uint64_t>(block_index - 1) * header_->block_size;
+        }
+
+        uint8_t* base() { return base_; }
+        size_t mapped_size() const { return size_; }
+
+        // Records that [ptr, ptr + len) inside the mapping was modified.
+        // Inside a journal Transaction the range is also journaled.
+        void mark_dirty(const void* ptr, size_t len);
+
+        // Flushes all dirty ranges now (MS_SYNC); with a journal attached
+        // this is a journal checkpoint.
+        OFSErrorCodes sync();
+
+        // Flushes all dirty ranges now, bypassing the journal.
+        OFSErrorCodes sync_in_place();
+
+        // Flushes [offset, offset + len) now, widened to whole pages.
+        OFSErrorCodes sync_range(uint64_t offset, uint64_t len);
+
+        // Set by Journal::attach() and detach(). While a journal is attached
+        // the immediate sync policy no longer flushes in mark_dirty(); the
+        // journal's durability level takes its place.
+        void set_journal(Journal* journal) { journal_ = journal; }
+        Journal* journal() const { return journal_; }
+
+        // Selects the content I/O backend. io_uring falls back to pread
+        // when the kernel refuses it; returns the backend in effect.
+        IoBackend set_io_backend(IoBackend backend, uint32_t queue_depth = 256);
+        IoBackend io_backend() const { return io_backend_; }
+
+        // Scattered content transfers. Writes are recorded as dirty
+        // whatever the backend: pwrite and the mapping share the page
+        // cache, so msync of the range persists them either way. They are
+        // content, not journaled metadata.
+        //
+        // In a container with a content map, bytes are encoded on the way
+        // in and decoded on the way out. Through the mapping that is part
+        // of the copy; pread decodes the caller's buffer right after the
+        // read, pwrite encodes into a staging buffer first.
+        //
+        // With a block cache both go through it, and writes reach the
+        // container when the cache writes them back; sync() and
+        // sync_range() write back what they cover first.
+        OFSErrorCodes read_segments(const IoSegment* segs, size_t count);
+        OFSErrorCodes write_segments(const IoSegment* segs, size_t count);
+
+        // True when content goes through the map at layout().content_map_offset.
+        bool content_encoded() const { return encoded_; }
+
+        // Puts a block cache of capacity bytes in front of the content
+        // blocks, with its flusher running every flush_ms and sequential
+        // readers read ahead by up to read_ahead blocks; 0 removes it after
+        // writing it back.
+        void set_cache(size_t capacity, uint32_t flush_ms, uint32_t read_ahead = 0);
+        BlockCache* cache() const { return cache_.get(); }
+
+        // Asks the kernel to start reading blocks [first_block, first_block
+        // + count) of the mapping in the background.
+        void will_need(uint32_t first_block, uint32_t count);
+
+        // Blocks [first, first + count) were freed: cached copies go.
+        void discard_cached(uint32_t first, uint32_t count);
+    };
+}
+
+#endif // OMNI_CONTAINER_HPP
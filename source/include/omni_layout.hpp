@@ -0,0 +1,155 @@
+#ifndef OMNI_LAYOUT_HPP
+#define OMNI_LAYOUT_HPP
+
+#include <cstdint>
+#include <cstring>
+
+#include "odf_types.hpp"
+
+namespace ofs::storage
+{
+    /*
+     * Physical layout of a .omni container (see notes/file_system_design.md)
+     *
+     *   [ OMNIHeader                 ]  header_size bytes (512)
+     *   [ User table                 ]  max_users * sizeof(UserInfo)
+     *   [ Metadata index area        ]  max_files * sizeof(MetadataEntry)
+     *   [ Dentry table               ]  dentry_slots * 4, (parent, name) -> entry
+     *   [ Index snapshot             ]  snapshot_size, see snapshot.hpp
+     *   [ File state storage         ]  history_chunk_slots * 24, see delta_vault.hpp
+     *   [ Change log                 ]  change_log_size, see delta_vault.hpp
+     *   [ Content map                ]  256 bytes, see byte_map.hpp
+     *   [ Free space map             ]  one bit per content block, 8-byte words
+     *   [ Journal                    ]  journal_size, 64 KiB aligned, see journal.hpp
+     *   [ padding to block_size      ]
+     *   [ Content block area         ]  total_blocks * block_size
+     *
+     * Block and entry indices start at 1; 0 means "none". Entry 1 is the
+     * root directory. Every offset that is not part of the standard header
+     * lives in OmniLayoutInfo, stored at the start of OMNIHeader::reserved.
+     */
+
+    constexpr char OMNI_MAGIC[8] = {'O', 'M', 'N', 'I', 'F', 'S', '0', '1'};
+    constexpr uint32_t OMNI_FORMAT_VERSION = 0x00010000u;
+    constexpr uint32_t ROOT_ENTRY_INDEX = 1u;
+
+    constexpr uint8_t ENTRY_IN_USE = 0u;
+    constexpr uint8_t ENTRY_FREE = 1u;
+
+    /**
+     * File/Directory metadata slot (72 bytes), one per max_files.
+     */
+    struct MetadataEntry {
+        uint8_t validity;           // ENTRY_IN_USE (0) or ENTRY_FREE (1)
+        uint8_t type;               // EntryType: 0 = file, 1 = directory
+        uint8_t flags;              // Per-entry flags
+        uint8_t reserved0;          // Padding
+        uint32_t parent_index;      // Entry index of the parent (0 for root)
+        char name[12];              // Short name, up to 10 chars + NUL
+        uint32_t start_block;       // First content block (0 = empty)
+        uint64_t total_size;        // Logical size in bytes
+        uint32_t owner_id;          // User table slot of the owner
+        uint32_t permissions;       // UNIX-style permission bits
+        uint64_t created_time;      // Unix epoch seconds
+        uint64_t modified_time;     // Unix epoch seconds
+        uint32_t version;           // Latest content version (0 = none yet)
+        uint8_t reserved[12];       // Reserved for future use
+
+        bool in_use() const { return validity == ENTRY_IN_USE; }
+        bool is_directory() const { return type == static_cast<uint8_t>(EntryType::DIRECTORY); }
+    };  // Total: 72 bytes
+
+    static_assert(sizeof(MetadataEntry) == 72, "MetadataEntry must stay 72 bytes");
+    // The odf_types structs carry natural padding: the header fits inside the
+    // 512-byte header region and user slots are sizeof(UserInfo) apart.
+    static_assert(sizeof(OMNIHeader) <= 512, "OMNIHeader must fit the 512-byte header region");
+
+    /**
+     * Container geometry, stored in OMNIHeader::reserved.
+     * Fields are only ever appended; zero means "not present".
+     */
+    struct OmniLayoutInfo {
+        uint64_t metadata_offset;      // Byte offset of the metadata index area
+        uint64_t free_map_offset;      // Byte offset of the free space map
+        uint64_t free_map_size;        // Size of the free space map in bytes
+        uint64_t content_offset;       // Byte offset of content block 1
+        uint64_t total_blocks;         // Number of content blocks
+        uint32_t max_files;            // Number of metadata slots
+        uint32_t metadata_entry_size;  // sizeof(MetadataEntry) at format time
+        uint32_t block_mapping;        // BlockMapping chosen at format time
+        uint32_t dentry_clean;         // 1 when the dentry table matches the metadata
+        uint64_t dentry_offset;        // Byte offset of the dentry hash table
+        uint64_t dentry_slots;         // Slots in the dentry table (power of two)
+        uint64_t snapshot_offset;      // Byte offset of the index snapshot area
+        uint64_t snapshot_size;        // Size of the snapshot area in bytes
+        uint64_t mount_generation;     // Incremented on every fs_init
+        uint64_t journal_offset;       // Byte offset of the metadata journal
+        uint64_t journal_size;         // Size of the journal in bytes (0 = none)
+        uint64_t history_chunk_slots;  // Chunk records at OMNIHeader::file_state_storage_offset (0 = no history)
+        uint64_t change_log_size;      // Bytes at OMNIHeader::change_log_offset
+        uint64_t content_map_offset;   // 256-byte content substitution map (0 = content stored as is)
+    };
+
+    /**
+     * How a file's content blocks are found from its metadata entry.
+     * Containers formatted before this field existed read as chain.
+     */
+    enum class BlockMapping : uint32_t {
+        chain = 0,   // 4-byte next pointer at the head of every block
+        extent = 1   // start_block is the root of an extent tree
+    };
+
+    // Chain mapping: the first 4 bytes of every block hold the next block.
+    constexpr uint32_t CHAIN_POINTER_SIZE = 4u;
+
+    /**
+     * Extent mapping: start_block points at the root node of a tree of at
+     * most two levels. A depth 0 node holds ExtentRecords; a depth 1 root
+     * holds ExtentIndex entries pointing at depth 0 leaf blocks. Records
+     * are sorted by logical block and never overlap.
+     */
+    constexpr uint32_t EXTENT_NODE_MAGIC = 0x31545845u;  // "EXT1"
+
+    struct ExtentNodeHeader {
+        uint32_t magic;             // EXTENT_NODE_MAGIC
+        uint16_t depth;             // 0 = leaf, 1 = index
+        uint16_t count;             // Records in this node
+        uint32_t mapped_blocks;     // Root only: file blocks mapped by the tree
+        uint32_t reserved;          // Padding
+    };  // Total: 16 bytes
+
+    struct ExtentRecord {
+        uint32_t logical;           // First file block (0-based)
+        uint32_t physical;          // First content block (1-based)
+        uint32_t count;             // Number of blocks
+        uint32_t reserved;          // Padding
+    };  // Total: 16 bytes
+
+    struct ExtentIndex {
+        uint32_t logical;           // First file block covered by the child
+        uint32_t child;             // Block holding the child leaf node
+    };  // Total: 8 bytes
+
+    static_assert(sizeof(ExtentNodeHeader) == 16 && sizeof(ExtentRecord) == 16 && sizeof(ExtentIndex) == 8,
+                  "extent node records must keep their on-disk sizes");
+
+    static_assert(sizeof(OmniLayoutInfo) <= sizeof(OMNIHeader::reserved),
+                  "OmniLayoutInfo must fit in OMNIHeader::reserved");
+
+    inline OmniLayoutInfo* layout_info(OMNIHeader* header)
+    {
+        return reinterpret_cast<OmniLayoutInfo*>(header->reserved);
+    }
+
+    inline const OmniLayoutInfo* layout_info(const OMNIHeader* header)
+    {
+        return reinterpret_cast<const OmniLayoutInfo*>(header->reserved);
+    }
+
+    inline uint64_t align_up(uint64_t v, uint64_t a)
+    {
+        return (v + a - 1) / a * a;
+    }
+}
+
+#endif // OMNI_LAYOUT_HPP
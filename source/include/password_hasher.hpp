@@ -0,0 +1,161 @@
+#ifndef PASSWORD_HASHER_HPP
+#define PASSWORD_HASHER_HPP
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "odf_types.hpp"
+
+namespace ofs::security
+{
+    constexpr size_t SHA256_DIGEST_SIZE = 32;
+
+    // Hex digest length; fills UserInfo::password_hash exactly (no NUL).
+    constexpr size_t PASSWORD_HASH_HEX_SIZE = 64;
+
+    constexpr size_t PASSWORD_SALT_SIZE = 16;
+    constexpr uint32_t DEFAULT_HASH_ITERATIONS = 10000;
+
+    /*
+     * Password record, kept in UserInfo::reserved next to password_hash:
+     *
+     *   reserved[0..15]   salt
+     *   reserved[16..19]  PBKDF2 iteration count (little endian)
+     *   reserved[20]      scheme
+     *
+     * Records written before the salt existed read as HashScheme::sha256.
+     */
+    enum class HashScheme : uint8_t {
+        sha256 = 0,          // password_hash = hex(SHA-256(password))
+        pbkdf2_sha256 = 1    // password_hash = hex(PBKDF2-HMAC-SHA256(password, salt, iterations))
+    };
+
+    // One-shot SHA-256 (FIPS 180-4).
+    void sha256(const uint8_t* data, size_t len, uint8_t out[SHA256_DIGEST_SIZE]);
+
+    // Lowercase hex SHA-256 of data.
+    std::string sha256_hex(std::string_view data);
+
+    // PBKDF2-HMAC-SHA256 with a single 32-byte output block.
+    struct Pbkdf2Job
+    {
+        std::string_view password;
+        const uint8_t* salt;
+        size_t salt_len;
+        uint32_t iterations;
+        uint8_t out[SHA256_DIGEST_SIZE];
+    };
+
+    void pbkdf2_sha256(Pbkdf2Job& job);
+
+    // Runs jobs side by side, sha256_lanes() at a time; jobs with equal
+    // iteration counts share the most work.
+    void pbkdf2_sha256_batch(Pbkdf2Job* jobs, size_t count);
+
+    // Cryptographically random bytes (getrandom, std::random_device fallback).
+    void random_bytes(uint8_t* out, size_t len);
+
+    // Multi-buffer width on this CPU: 8 with AVX2, otherwise 4 (SSE2).
+    size_t sha256_lanes();
+
+    // Writes a fresh salted record for password into u.
+    void make_password_record(std::string_view password, uint32_t iterations, UserInfo& u);
+
+    // Checks password against u's record, in the caller's thread.
+    bool verify_password(std::string_view password, const UserInfo& u);
+
+    // True when u's record is legacy or uses another iteration count.
+    bool needs_rehash(const UserInfo& u, uint32_t iterations);
+
+    /**
+     * Password hashing service.
+     *
+     * Verifications run on a dedicated pool of worker threads so a burst of
+     * logins never occupies the callers' threads; each worker takes up to
+     * sha256_lanes() queued requests and hashes them together.
+     *
+     * Successful verifications are remembered for cache_ttl seconds, keyed
+     * by username and bound to the stored record, so repeated logins of the
+     * same account skip PBKDF2. The cache holds a keyed SHA-256 of the
+     * password (per-process random key), never the password itself.
+     */
+    class PasswordHasher
+    {
+    public:
+        using Callback = std::function<void(bool ok)>;
+
+        PasswordHasher();
+        ~PasswordHasher();
+
+        PasswordHasher(const PasswordHasher&) = delete;
+        PasswordHasher& operator=(const PasswordHasher&) = delete;
+
+        // threads = 0 uses the hardware concurrency. Restarts the pool.
+        void start(uint32_t iterations, uint32_t threads, uint32_t cache_ttl);
+        void stop();
+
+        uint32_t iterations() const { return iterations_; }
+
+        // Fills the record for a new or changed password.
+        void hash(std::string_view password, UserInfo& u) const;
+
+        // Queues a verification; done runs on a worker thread (or inline on
+        // a cache hit). Falls back to inline hashing when the pool is stopped.
+        void verify_async(const std::string& username, const std::string& password,
+                          const UserInfo& record, Callback done);
+
+        // Blocking form of verify_async.
+        bool verify(const std::string& username, const std::string& password, const UserInfo& record);
+
+        // Drops cached verifications of a user (password change, delete).
+        void forget(const std::string& username);
+
+        uint64_t cache_hits() const;
+
+    private:
+        struct Request
+        {
+            std::string username;
+            std::string password;
+            UserInfo record;
+            Callback done;
+        };
+
+        struct CacheEntry
+        {
+            uint8_t tag[SHA256_DIGEST_SIZE];          // keyed hash of the password
+            char record[PASSWORD_HASH_HEX_SIZE];      // stored hash it was checked against
+            uint64_t expires;                         // unix seconds
+        };
+
+        uint32_t iterations_;
+        uint32_t cache_ttl_;
+        uint8_t cache_key_[32];
+
+        std::vector<std::thread> workers_;
+        std::deque<Request> queue_;
+        std::mutex queue_mtx_;
+        std::condition_variable queue_cv_;
+        bool stopping_;
+
+        std::unordered_map<std::string, CacheEntry> cache_;
+        mutable std::mutex cache_mtx_;
+        uint64_t cache_hits_;
+
+        void worker_loop();
+        void cache_tag(const std::string& password, const UserInfo& record, uint8_t out[SHA256_DIGEST_SIZE]) const;
+        bool cache_lookup(const std::string& username, const std::string& password, const UserInfo& record);
+        void cache_store(const std::string& username, const std::string& password, const UserInfo& record);
+    };
+}
+
+#endif // PASSWORD_HASHER_HPP
@@ -0,0 +1,124 @@
+#ifndef PATH_INDEX_HPP
+#define PATH_INDEX_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "omni_layout.hpp"
+
+namespace ofs::storage
+{
+    class OmniContainer;
+}
+
+namespace ofs::fs
+{
+    /**
+     * Path resolution for the metadata area.
+     *
+     * Three structures work together:
+     *   - the dentry table: an open-addressing hash of (parent index, name)
+     *     -> entry index. It lives in the container next to the metadata
+     *     area, so a clean start uses it as is;
+     *   - an LRU cache of full paths, including negative ("does not exist")
+     *     results, so repeated lookups skip the component walk;
+     *   - per-directory child lists for dir_list and dir_delete, kept as
+     *     three flat arrays (first child, next and previous sibling) indexed
+     *     by entry. They normally live in the index snapshot area, so after
+     *     a clean shutdown they are used as mapped instead of being rebuilt.
+     *
+     * Callers serialise mutations (insert/erase/forget*) against lookups;
+     * only the LRU cache has its own lock because readers update it.
+     */
+    class PathIndex
+    {
+    public:
+        static constexpr size_t DEFAULT_CACHE_CAPACITY = 4096;
+
+        explicit PathIndex(size_t cache_capacity = DEFAULT_CACHE_CAPACITY);
+
+        PathIndex(const PathIndex&) = delete;
+        PathIndex& operator=(const PathIndex&) = delete;
+
+        // Binds to the container's metadata. With rebuild the dentry table is
+        // rehashed from the metadata (e.g. after an unclean shutdown). links
+        // is storage for 3 * (max_files + 1) words of child lists, or nullptr
+        // for a private copy; links_valid says it already matches the metadata.
+        void attach(storage::OmniContainer& container, bool rebuild,
+                    uint32_t* links = nullptr, bool links_valid = false);
+        void detach();
+
+        // Child of parent called name, or 0.
+        uint32_t lookup(uint32_t parent, std::string_view name) const;
+
+        // Entry for a validated absolute path ("/" or "/a/b"), or 0.
+        uint32_t resolve(const std::string& path);
+
+        // Adds an entry under its current parent_index and name. erase()
+        // must run while those fields still hold their old values.
+        void insert(uint32_t entry);
+        void erase(uint32_t entry);
+
+        // Child list of a directory: first_child(dir), then next_sibling()
+        // until it returns 0.
+        uint32_t first_child(uint32_t dir) const { return first_child_[dir]; }
+        uint32_t next_sibling(uint32_t entry) const { return next_sibling_[entry]; }
+
+        // Path cache invalidation.
+        void forget(const std::string& path);
+        void forget_all();
+
+        uint64_t cache_hits() const;
+        uint64_t cache_misses() const;
+
+    private:
+        storage::OmniContainer* container_;
+        storage::MetadataEntry* entries_;
+        uint32_t max_files_;
+
+        uint32_t* slots_;
+        size_t mask_;
+        bool slots_mapped_;
+        std::vector<uint32_t> local_slots_;  // used when the container has no table
+
+        uint32_t* first_child_;
+        uint32_t* next_sibling_;
+        uint32_t* prev_sibling_;
+        std::vector<uint32_t> local_links_;  // used when no snapshot storage is given
+
+        size_t cache_capacity_;
+        mutable std::mutex cache_mtx_;
+        std::list<std::pair<std::string, uint32_t>> lru_;
+        std::unordered_map<std::string, std::list<std::pair<std::string, uint32_t>>::iterator> cache_;
+        uint64_t hits_;
+        uint64_t misses_;
+
+        const storage::MetadataEntry& meta(uint32_t entry) const { return entries_[entry - 1]; }
+        static uint64_t hash_key(uint32_t parent, std::string_view name);
+        size_t home_of(uint32_t entry) const;
+        void set_slot(size_t slot, uint32_t value);
+        void hash_insert(uint32_t entry);
+        void hash_erase(uint32_t entry);
+        void link_child(uint32_t entry);
+        void unlink_child(uint32_t entry);
+        void remember(const std::string& path, uint32_t entry);
+    };
+
+    // Name stored in a metadata entry (not necessarily NUL terminated).
+    inline std::string_view entry_name(const storage::MetadataEntry& e)
+    {
+        size_t len = 0;
+        while (len < sizeof(e.name) && e.name[len] != '\0') {
+            ++len;
+        }
+        return std::string_view(e.name, len);
+    }
+}
+
+#endif // PATH_INDEX_HPP
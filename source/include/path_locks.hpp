@@ -0,0 +1,73 @@
+#ifndef PATH_LOCKS_HPP
+#define PATH_LOCKS_HPP
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace ofs::server
+{
+    enum class LockMode : uint8_t {
+        intent_shared = 0,     // something below is read
+        intent_exclusive,      // something below is written
+        shared,                // this name and everything below is read
+        exclusive              // this name and everything below is written
+    };
+
+    /**
+     * The lock names one request needs, with their modes.
+     *
+     * Names are '/'-separated like paths: file system paths live under "/",
+     * and other state under roots of their own ("#users", "#sessions/<id>").
+     * Adding a name also adds the matching intent lock on each of its
+     * ancestors, so a shared lock on "/a" conflicts with a write to
+     * "/a/b/c" but not with a read of it. A name added twice keeps the
+     * stronger combination of its modes.
+     */
+    class LockSet
+    {
+    public:
+        struct Entry
+        {
+            std::string name;
+            LockMode mode;
+        };
+
+        void add(std::string_view name, LockMode mode);
+        void clear() { entries_.clear(); }
+        const std::vector<Entry>& entries() const { return entries_; }
+
+    private:
+        std::vector<Entry> entries_;
+
+        void put(std::string_view name, LockMode mode);
+    };
+
+    /**
+     * Counts of the locks held on each name, by mode. compatible() is the
+     * usual multi-granularity matrix: intent locks share with each other,
+     * shared locks share with intent-shared and shared, exclusive shares
+     * with nothing. Not thread-safe; the caller holds its own lock.
+     */
+    class PathLocks
+    {
+    public:
+        bool compatible(const LockSet& set) const;
+        void acquire(const LockSet& set);
+        void release(const LockSet& set);
+        void clear() { held_.clear(); }
+        bool empty() const { return held_.empty(); }
+
+    private:
+        struct Holders
+        {
+            uint32_t count[4] = {0, 0, 0, 0};
+        };
+
+        std::unordered_map<std::string, Holders> held_;
+    };
+}
+
+#endif // PATH_LOCKS_HPP
@@ -0,0 +1,176 @@
+#ifndef PROTOCOL_HPP
+#define PROTOCOL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "odf_types.hpp"
+
+namespace ofs::server
+{
+    /*
+     * Socket protocol (notes/README.md): a stream of JSON objects in each
+     * direction. Requests may be pretty-printed across lines; responses are
+     * one object per line.
+     *
+     *   request  := {"operation": ..., "session_id": ..., "parameters": {...}, "request_id": ...}
+     *   response := {"status": "success", "operation": ..., "request_id": ..., "data": {...}}
+     *             | {"status": "error", "operation": ..., "request_id": ..., "error_code": N, "error_message": ...}
+     *
+     * Parameter values may be strings, numbers or booleans; they are kept
+     * as text and converted by the operation that reads them. File content
+     * ("data" of file_create, file_edit, file_read and file_read_next) is
+     * base64.
+     *
+     * file_read with "stream": true answers with a series of response
+     * lines, one per chunk of the file, each carrying its "offset" and
+     * "more": true except the last. An error line ends the series early.
+     */
+    enum class Operation : uint8_t {
+        unknown = 0,
+        user_login,
+        user_logout,
+        user_create,
+        user_delete,
+        user_list,
+        get_session_info,
+        file_create,
+        file_read,
+        file_edit,
+        file_delete,
+        file_truncate,
+        file_exists,
+        file_rename,
+        dir_create,
+        dir_list,
+        dir_delete,
+        dir_exists,
+        get_metadata,
+        set_permissions,
+        get_stats,
+        file_open,
+        file_read_next,
+        file_close
+    };
+
+    // One perfect-hash probe and one compare.
+    Operation operation_from_name(std::string_view name);
+    const char* operation_name(Operation op);
+
+    /**
+     * Finds request boundaries in a connection's receive buffer.
+     *
+     * A request is one top-level JSON object, which may span lines and
+     * reads; braces inside strings are skipped. Whitespace between objects
+     * is ignored. Anything else at the top level runs to the end of its
+     * line and comes out as a frame of its own, so that the client gets an
+     * error for it. The scanner keeps its position between calls: bytes
+     * already looked at are not scanned again when more data arrives.
+     */
+    class FrameScanner
+    {
+    public:
+        // Next complete frame in [base, base + len) as [begin, end); false
+        // when the data ends inside a frame or between frames.
+        bool next(const char* base, size_t len, size_t& begin, size_t& end);
+
+        // Bytes in front of the frame in progress (all scanned bytes when
+        // there is none); the caller may discard them.
+        size_t consumed() const { return in_frame_ ? start_ : pos_; }
+
+        // The caller removed n bytes (n <= consumed()) from the front.
+        void shift(size_t n)
+        {
+            pos_ -= n;
+            start_ -= n;
+        }
+
+    private:
+        size_t pos_ = 0;          // next byte to look at
+        size_t start_ = 0;        // first byte of the frame in progress
+        uint32_t depth_ = 0;      // open braces and brackets
+        bool in_frame_ = false;
+        bool in_string_ = false;
+        bool escape_ = false;     // the last byte seen was a backslash in a string
+        bool garbage_ = false;    // frame does not start with '{'; ends at newline
+    };
+
+    /**
+     * A parsed request. Every view points into the frame it was parsed
+     * from, which must outlive the Request; strings are unescaped in place.
+     */
+    struct Request
+    {
+        static constexpr size_t MAX_PARAMS = 16;
+
+        struct Param
+        {
+            std::string_view key;
+            std::string_view value;
+        };
+
+        Operation op = Operation::unknown;
+        std::string_view operation;
+        std::string_view session_id;
+        std::string_view request_id;
+        Param params[MAX_PARAMS];
+        size_t param_count = 0;
+
+        // nullptr when the parameter is absent.
+        const std::string_view* param(std::string_view key) const;
+    };
+
+    // Parses one request frame in place. err names the first syntax error.
+    bool parse_request(char* frame, size_t len, Request& out, const char*& err);
+
+    // Message text for an error code.
+    const char* error_message(OFSErrorCodes code);
+
+    /**
+     * Appends JSON to a string. Commas are inserted automatically; nesting
+     * is limited to 64 levels.
+     */
+    class JsonWriter
+    {
+    public:
+        explicit JsonWriter(std::string& out);
+
+        void begin_object();
+        void end_object();
+        void begin_array();
+        void end_array();
+
+        void key(std::string_view k);
+        void value(std::string_view v);
+        void value(const char* v) { value(std::string_view(v)); }
+        void value(int64_t v);
+        void value(uint64_t v);
+        void value(uint32_t v) { value(static_cast<uint64_t>(v)); }
+        void value(int32_t v) { value(static_cast<int64_t>(v)); }
+        void value(double v);
+        void value(bool v);
+        // Binary data as a base64 string, encoded straight into the output.
+        void value_base64(const char* data, size_t len);
+
+        // Writes "status", "operation" and "request_id" of a response and
+        // leaves the top-level object open.
+        void begin_response(bool success, std::string_view operation, std::string_view request_id);
+
+    private:
+        std::string& out_;
+        uint64_t first_;    // bit d set while nesting level d has no member yet
+        uint32_t depth_;
+        bool after_key_;
+
+        void separate();
+        void escaped(std::string_view s);
+    };
+
+    // A complete error response line.
+    void write_error(std::string& out, std::string_view operation, std::string_view request_id,
+                     OFSErrorCodes code, std::string_view message = {});
+}
+
+#endif // PROTOCOL_HPP
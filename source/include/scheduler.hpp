@@ -0,0 +1,125 @@
+#ifndef SCHEDULER_HPP
+#define SCHEDULER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "work_stealing_deque.hpp"
+
+namespace ofs::server
+{
+    enum class Priority : uint8_t {
+        interactive = 0,    // metadata lookups and changes
+        bulk,               // file content transfers
+        maintenance,        // administration and background work
+    };
+
+    constexpr size_t PRIORITY_COUNT = 3;
+
+    const char* priority_name(Priority p);
+
+    // Something to run; the scheduler hands it back to the Runner, which
+    // owns it from then on.
+    struct ScheduledWork
+    {
+        Priority priority = Priority::interactive;
+        std::chrono::steady_clock::time_point queued;
+    };
+
+    /**
+     * Work-stealing thread pool with priority classes.
+     *
+     * Each worker has a Chase-Lev deque per class. Work submitted from a
+     * worker thread goes to that worker's deque; work from anywhere else
+     * goes to a shared injection queue per class, from which workers take
+     * a small batch at a time. A worker with nothing of its own steals the
+     * oldest item of another worker. Workers also take their own items
+     * oldest-first, so nothing sits behind a stream of newer work.
+     *
+     * Classes are served in priority order, with aging: a class that has
+     * work but has not been served for AGING_STEP times its rank goes
+     * first. Bulk transfers therefore never hold up metadata operations,
+     * and a flood of metadata operations delays bulk work by at most
+     * AGING_STEP. Work that waited longer than the timeout (measured from
+     * its queued time) is handed to the Runner with expired set, to be
+     * answered rather than run.
+     */
+    class Scheduler
+    {
+    public:
+        static constexpr std::chrono::milliseconds AGING_STEP{250};
+        static constexpr size_t INJECT_BATCH = 8;
+        // Sleep of a worker that sees work counted but cannot take it.
+        static constexpr std::chrono::microseconds MISS_BACKOFF{200};
+
+        using Runner = std::function<void(ScheduledWork* work, bool expired)>;
+
+        struct Stats
+        {
+            uint64_t run[PRIORITY_COUNT];
+            uint64_t expired;
+            uint64_t stolen;
+            uint64_t aged;       // picks made out of priority order
+        };
+
+        Scheduler();
+        ~Scheduler();
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        // timeout 0 disables expiry.
+        void start(uint32_t workers, std::chrono::milliseconds timeout, Runner run);
+
+        // Joins the workers and returns the work that never ran.
+        std::vector<ScheduledWork*> stop();
+
+        // Safe from any thread.
+        void submit(ScheduledWork* work);
+
+        uint32_t workers() const { return static_cast<uint32_t>(workers_.size()); }
+        Stats stats() const;
+
+    private:
+        struct Worker
+        {
+            WorkStealingDeque<ScheduledWork> local[PRIORITY_COUNT];
+            std::thread thread;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers_;
+        Runner run_;
+        std::chrono::steady_clock::duration timeout_;
+
+        std::mutex inject_mtx_;
+        std::deque<ScheduledWork*> inject_[PRIORITY_COUNT];
+
+        std::atomic<int64_t> queued_[PRIORITY_COUNT];
+        std::atomic<int64_t> last_served_[PRIORITY_COUNT];   // steady_clock ticks
+
+        std::mutex idle_mtx_;
+        std::condition_variable idle_cv_;
+        std::atomic<uint32_t> sleepers_;
+        std::atomic<bool> stop_;
+
+        std::atomic<uint64_t> run_count_[PRIORITY_COUNT];
+        std::atomic<uint64_t> expired_;
+        std::atomic<uint64_t> stolen_;
+        std::atomic<uint64_t> aged_;
+
+        void worker_loop(uint32_t self);
+        ScheduledWork* next(uint32_t self);
+        ScheduledWork* take(uint32_t self, size_t cls);
+        void wake_one();
+    };
+}
+
+#endif // SCHEDULER_HPP
@@ -0,0 +1,277 @@
+#ifndef SERVER_HPP
+#define SERVER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "config_types.hpp"
+#include "dispatcher.hpp"
+#include "file_system.hpp"
+#include "io_ring.hpp"
+#include "path_locks.hpp"
+#include "scheduler.hpp"
+#include "session_manager.hpp"
+
+namespace ofs::server
+{
+    /**
+     * Recycled connection buffers. Every buffer starts at chunk bytes; one
+     * that grew for a large frame is shrunk back when it is returned.
+     * Reactor-thread only.
+     */
+    class BufferPool
+    {
+    public:
+        BufferPool(size_t chunk, size_t keep);
+
+        std::vector<char> acquire();
+        void release(std::vector<char>&& buf);
+
+        size_t chunk() const { return chunk_; }
+
+    private:
+        size_t chunk_;
+        size_t keep_;
+        std::vector<std::vector<char>> free_;
+    };
+
+    /**
+     * TCP front end: a stream of JSON requests over non-blocking sockets,
+     * one response line each.
+     *
+     * One reactor thread runs an epoll loop over the listening socket, the
+     * connections and an eventfd for completions. A FrameScanner per
+     * connection cuts complete requests out of the receive buffer; they
+     * go to the FIFO queue; one executor thread runs them in arrival order
+     * through the Dispatcher.
+     *
+     * With [server] execution = concurrent, requests run on the workers
+     * of a Scheduler instead. Each request is parsed on arrival and given
+     * the locks of its Dispatcher::footprint; it is admitted once its
+     * locks conflict neither with a running request nor with an earlier
+     * one still waiting. Requests on unrelated paths run side by side;
+     * conflicting ones keep their arrival order, so every result matches
+     * the FIFO executor's. Admitted requests are scheduled by
+     * Dispatcher::priority, so a client's bulk uploads do not hold up
+     * other clients' metadata requests.
+     *
+     * A connection may pipeline requests; each
+     * gets a sequence number and responses are written back in that order
+     * even when they complete out of order (logins finish on the hashing
+     * pool).
+     *
+     * Frames and responses are SlabPool buffers: the reactor cuts frames
+     * into them and hands responses back once it has copied or sent them,
+     * the worker that ran a frame hands the frame back, so in the steady
+     * state neither side allocates for them.
+     *
+     * A streamed file_read keeps its place in that order until its last
+     * chunk. Each further chunk is queued like a request, without locks,
+     * once the stream is the connection's next response and less than
+     * [server] stream_window bytes of output wait to be sent; a transfer
+     * thus holds a few windows of memory whatever the file size.
+     *
+     * With [io] backend = io_uring the reactor drives one io_uring
+     * instead of epoll: accepts, receives, sends, the completion eventfd
+     * and the once-per-second tick are all ring operations, and every
+     * completion batch costs one io_uring_enter. Connection slot i is
+     * registered file i and receives into registered buffer i. Responses
+     * are copied into a per-slot send chunk so the connection's output
+     * buffer can keep growing while a send is queued. When the kernel
+     * refuses io_uring, the server falls back to epoll.
+     *
+     * Backpressure:
+     *   - at max_connections the listening socket leaves the epoll set and
+     *     new clients wait in the kernel backlog;
+     *   - a connection stops being read while it has MAX_IN_FLIGHT requests
+     *     queued or more than SEND_HIGH_WATER bytes unsent;
+     *   - a request that waited longer than queue_timeout is answered with
+     *     an error instead of being run.
+     */
+    class Server
+    {
+    public:
+        static constexpr size_t BUFFER_CHUNK = 16 * 1024;
+        static constexpr size_t MAX_FRAME = 32 * 1024 * 1024;
+        static constexpr uint32_t MAX_IN_FLIGHT = 64;
+        static constexpr size_t SEND_HIGH_WATER = 4 * 1024 * 1024;
+        // Waiting requests looked through for ones that may start.
+        static constexpr size_t ADMIT_WINDOW = 64;
+
+        Server(fs::FileSystem& filesystem, const config::Config& cfg);
+        ~Server();
+
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        // Binds cfg.port (0 picks a free port) and starts the executor.
+        OFSErrorCodes start();
+
+        // Event loop; returns after stop(). Closes every connection.
+        void run();
+
+        // Safe from any thread and from signal handlers.
+        void stop();
+
+        uint16_t port() const { return port_; }
+        security::SessionManager& sessions() { return sessions_; }
+        uint32_t connections() const { return active_; }
+
+    private:
+        struct Connection
+        {
+            int fd = -1;
+            uint32_t generation = 0;
+            std::vector<char> rx;
+            size_t rx_len = 0;
+            FrameScanner scanner;      // request boundaries in rx
+            std::vector<char> tx;
+            size_t tx_len = 0;
+            size_t tx_off = 0;
+            uint64_t next_seq = 0;     // assigned to the next request
+            uint64_t send_seq = 0;     // next response to write
+            std::map<uint64_t, std::string> ready;  // completed ahead of send_seq
+            // Streamed responses between two chunks, by sequence number.
+            std::map<uint64_t, std::unique_ptr<Dispatcher::Stream>> streams;
+            uint32_t in_flight = 0;
+            uint32_t events = 0;       // current epoll interest
+            bool peer_closed = false;
+            // io_uring reactor only.
+            bool reading = false;      // a receive is queued
+            bool sending = false;      // a send is queued
+            size_t staged = 0;         // bytes in the slot's send chunk
+            size_t staged_sent = 0;
+            bool parked = false;       // closed, slot held until its operations complete
+        };
+
+        struct Job
+        {
+            uint32_t conn;
+            uint32_t generation;
+            uint64_t seq;
+            std::string frame;
+            std::chrono::steady_clock::time_point queued;
+            std::unique_ptr<Dispatcher::Stream> stream;   // set for the next chunk of a stream
+        };
+
+        // Concurrent execution: a job parsed on arrival, with its locks.
+        // Heap-allocated so the Request's views into the frame stay put.
+        struct Task : ScheduledWork
+        {
+            Job job;
+            Request req;
+            const char* err = nullptr;
+            LockSet locks;
+        };
+
+        // Completions travel from any thread back to the reactor. Shared so
+        // that late replies (hashing pool) never outlive their target.
+        struct Outbox
+        {
+            struct Item
+            {
+                uint32_t conn;
+                uint32_t generation;
+                uint64_t seq;
+                std::string text;
+                std::unique_ptr<Dispatcher::Stream> rest;   // the response goes on
+            };
+
+            std::mutex mtx;
+            std::vector<Item> items;
+            int wake_fd = -1;
+            bool closed = false;
+
+            void post(Item&& item);
+        };
+
+        fs::FileSystem& fs_;
+        config::Config cfg_;
+        security::SessionManager sessions_;
+        Dispatcher dispatcher_;
+
+        int listen_fd_;
+        int epoll_fd_;
+        uint16_t port_;
+        std::atomic<bool> stopping_;
+        bool accepting_;
+
+        std::vector<Connection> conns_;
+        std::vector<uint32_t> free_conns_;
+        uint32_t active_;
+        BufferPool buffers_;
+        std::shared_ptr<Outbox> outbox_;
+        // Reactor scratch kept from one event to the next.
+        std::vector<Job> jobs_;
+        std::vector<Outbox::Item> taken_;
+        std::vector<std::unique_ptr<Task>> tasks_;
+
+        std::deque<Job> queue_;
+        std::mutex queue_mtx_;
+        std::condition_variable queue_cv_;
+        std::vector<std::thread> executors_;
+        bool executor_stop_;
+        // Concurrent execution; guarded by queue_mtx_.
+        bool concurrent_;
+        std::deque<std::unique_ptr<Task>> waiting_;   // arrival order
+        PathLocks held_;                              // locks of admitted tasks
+        PathLocks ahead_;                             // scratch for admit()
+        Scheduler scheduler_;
+        uint64_t last_tick_;
+
+        // io_uring reactor state; the ring is declared last so that it is
+        // torn down before the buffers its operations point into.
+        bool use_ring_;
+        bool accept_queued_;
+        uint64_t wake_buf_;
+        std::vector<char> ring_rx_;        // registered, BUFFER_CHUNK per slot
+        std::vector<char> ring_tx_;        // send chunk per slot
+        std::vector<uint32_t> ring_ops_;   // queued operations per slot
+        IoRing ring_;
+
+        void tick();
+        void open_connection(int fd);
+        void set_events(uint32_t idx, uint32_t events);
+        void set_accepting(bool on);
+        void accept_clients();
+        void on_readable(uint32_t idx);
+        void on_writable(uint32_t idx);
+        size_t split_frames(uint32_t idx, const char* base, size_t len, std::vector<Job>& jobs,
+                            std::chrono::steady_clock::time_point now);
+        bool take_frames(uint32_t idx, std::vector<Job>& jobs, std::chrono::steady_clock::time_point now);
+        void queue_jobs(std::vector<Job>& jobs);
+        void drain_outbox();
+        void take_outbox();
+        void deliver(uint32_t idx, uint64_t seq, std::string&& text, std::unique_ptr<Dispatcher::Stream> rest);
+        bool flush(uint32_t idx);
+        void update_interest(uint32_t idx);
+        void resume_stream(uint32_t idx, size_t unsent);
+        void close_connection(uint32_t idx);
+        void executor_loop();
+        void run_task(ScheduledWork* work, bool expired);
+        void admit(std::vector<Task*>& ready);
+        void execute(Job& job, const Request* req, const char* err, bool expired);
+
+        void run_epoll();
+        bool start_ring(uint32_t max_conns);
+        void run_ring();
+        void on_completion(const IoRing::Completion& cqe);
+        void queue_accept();
+        void queue_recv(uint32_t idx);
+        void queue_send(uint32_t idx);
+        void on_received(uint32_t idx, int32_t res);
+        void on_sent(uint32_t idx, int32_t res);
+    };
+}
+
+#endif // SERVER_HPP
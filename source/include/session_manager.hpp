@@ -0,0 +1,107 @@
+#ifndef SESSION_MANAGER_HPP
+#define SESSION_MANAGER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include "odf_types.hpp"
+#include "timing_wheel.hpp"
+
+namespace ofs::security
+{
+    /*
+     * 128-bit session token. handle is (generation << 32) | slab slot and
+     * locates the session; secret is random and proves the holder got the
+     * token from create(). Printed as 32 lowercase hex digits, secret first;
+     * that string is SessionInfo::session_id.
+     */
+    struct SessionToken
+    {
+        uint64_t secret;
+        uint64_t handle;
+    };
+
+    constexpr size_t SESSION_TOKEN_HEX_SIZE = 32;
+
+    /**
+     * Logged-in sessions in a fixed-capacity slab.
+     *
+     * Validation reads one slab slot and compares the secret and generation
+     * from the token: no hashing, no lock. It records activity with relaxed
+     * atomic stores; last_activity is only written when the second changes,
+     * so a busy session does not keep its cache line bouncing.
+     *
+     * Expiry is a timing wheel of idle deadlines. Validations never touch
+     * the wheel: when a deadline comes up, expire() re-arms the session
+     * from its last_activity if it was used in the meantime and frees it
+     * otherwise. The owner calls expire() about once per tick (second).
+     *
+     * The slab slot's generation advances whenever a session ends, so a
+     * stale token never matches a reused slot.
+     */
+    class SessionManager
+    {
+    public:
+        SessionManager();
+
+        SessionManager(const SessionManager&) = delete;
+        SessionManager& operator=(const SessionManager&) = delete;
+
+        // Drops every session. idle_timeout is in seconds; 0 never expires.
+        void init(uint32_t capacity, uint32_t idle_timeout);
+
+        // Opens a session for user; out.session_id holds the token.
+        OFSErrorCodes create(const UserInfo& user, SessionInfo& out);
+
+        // Checks a token and records one operation on the session.
+        OFSErrorCodes validate(const SessionToken& token, UserRole* role = nullptr);
+        OFSErrorCodes validate(std::string_view session_id, UserRole* role = nullptr);
+
+        OFSErrorCodes info(std::string_view session_id, SessionInfo& out) const;
+        OFSErrorCodes destroy(std::string_view session_id);
+
+        // Ends every session of a user (account deleted); returns how many.
+        uint32_t destroy_user(std::string_view username);
+
+        // Advances the wheel to now (unix seconds) and frees idle sessions.
+        size_t expire(uint64_t now);
+
+        uint32_t active() const;
+        uint32_t capacity() const { return capacity_; }
+
+        static bool parse_token(std::string_view session_id, SessionToken& out);
+        static void format_token(const SessionToken& token, char out[SESSION_TOKEN_HEX_SIZE]);
+
+    private:
+        // Hot part of a session, one cache line each.
+        struct alignas(64) SessionSlot
+        {
+            std::atomic<uint64_t> secret;           // 0 while the slot is free
+            std::atomic<uint32_t> generation;
+            std::atomic<uint32_t> operations;
+            std::atomic<uint64_t> last_activity;    // unix seconds
+            std::atomic<uint8_t> role;
+        };
+
+        uint32_t capacity_;
+        uint32_t idle_timeout_;
+        std::unique_ptr<SessionSlot[]> slots_;
+
+        // Guarded by mtx_: everything but the hot-path loads and stores.
+        std::vector<SessionInfo> infos_;
+        std::vector<uint32_t> free_;    // free slots, lowest on top
+        TimingWheel wheel_;
+        std::vector<uint32_t> due_;
+        mutable std::mutex mtx_;
+
+        bool matches(const SessionToken& token, uint32_t& slot) const;
+        void release(uint32_t slot);
+    };
+}
+
+#endif // SESSION_MANAGER_HPP
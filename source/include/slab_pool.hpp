@@ -0,0 +1,79 @@
+#ifndef SLAB_POOL_HPP
+#define SLAB_POOL_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ofs
+{
+    /**
+     * Byte buffers recycled in power-of-two size classes, 256 bytes to
+     * 4 MiB, shared by every thread.
+     *
+     * Request frames, response lines and file contents are std::strings
+     * that are filled on one thread and dropped on another: the reactor
+     * cuts frames that workers run, workers write responses the reactor
+     * sends. acquire() hands out a string from the class that fits the
+     * size asked for and release() files any string under the class its
+     * capacity fills, so that in the steady state these buffers go round
+     * between threads without reaching malloc. Each class has its own
+     * lock and keeps at most KEEP_BYTES of idle buffers (at least
+     * MIN_KEEP); the rest, and anything below or above the classes, is
+     * freed.
+     */
+    class SlabPool
+    {
+    public:
+        static constexpr unsigned MIN_SHIFT = 8;
+        static constexpr unsigned MAX_SHIFT = 22;
+        static constexpr size_t KEEP_BYTES = 4 * 1024 * 1024;
+        static constexpr size_t MIN_KEEP = 4;
+
+        struct Stats
+        {
+            uint64_t hits;       // acquires served from an idle buffer
+            uint64_t misses;     // acquires that allocated
+            uint64_t idle_bytes; // held in the classes now
+        };
+
+        static SlabPool& get_instance();
+
+        SlabPool(const SlabPool&) = delete;
+        SlabPool& operator=(const SlabPool&) = delete;
+
+        // An empty string with room for at least size bytes.
+        std::string acquire(size_t size);
+
+        // Gives s room for at least size bytes, keeping its content; a
+        // buffer that is too small is traded for a pooled one.
+        void reserve(std::string& s, size_t size);
+
+        // Takes s back; s is left empty.
+        void release(std::string&& s);
+
+        Stats stats() const;
+
+    private:
+        static constexpr unsigned CLASSES = MAX_SHIFT - MIN_SHIFT + 1;
+
+        struct Class
+        {
+            std::mutex mtx;
+            std::vector<std::string> free;
+            size_t keep = 0;
+        };
+
+        Class classes_[CLASSES];
+        std::atomic<uint64_t> hits_;
+        std::atomic<uint64_t> misses_;
+        std::atomic<uint64_t> idle_bytes_;
+
+        SlabPool();
+    };
+}
+
+#endif // SLAB_POOL_HPP
@@ -0,0 +1,123 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+#include "odf_types.hpp"
+#include "omni_layout.hpp"
+
+namespace ofs::storage
+{
+    class OmniContainer;
+
+    /*
+     * Index snapshot area
+     *
+     * Holds the in-memory indexes in a pointer-free form so fs_init can map
+     * them instead of rebuilding them:
+     *
+     *   [ SnapshotHeader            ]  section table, generation, checksum
+     *   [ allocator section         ]  free counts + summary bitmaps
+     *   [ directory section         ]  first_child / next / prev sibling links
+     *   [ entries section           ]  counters + free metadata slot stack
+     *   [ users section             ]  user hash index + free user slot stack
+     *
+     * Every section is addressed by its offset from the start of the area,
+     * so the area can be used in place through any mapping.
+     *
+     * Sections that are edited in place while mounted (directory, entries,
+     * users)
+     * are only trusted when the header generation equals the container's
+     * mount_generation and the checksum matches, i.e. after a clean
+     * shutdown. Anything else means a full rebuild from the metadata area.
+     */
+
+    constexpr char SNAPSHOT_MAGIC[8] = {'O', 'F', 'S', 'S', 'N', 'A', 'P', '1'};
+    constexpr uint32_t SNAPSHOT_VERSION = 1u;
+    constexpr uint32_t SNAPSHOT_MAX_SECTIONS = 8u;
+
+    enum class SnapshotSection : uint32_t {
+        none = 0,
+        allocator = 1,   // BlockAllocator summary levels
+        directory = 2,   // PathIndex child links
+        entries = 3,     // File/dir counters and the free slot stack
+        users = 4        // User index
+    };
+
+    struct SnapshotSectionInfo {
+        uint32_t id;                // SnapshotSection
+        uint32_t reserved;          // Padding
+        uint64_t offset;            // From the start of the snapshot area
+        uint64_t size;              // Capacity in bytes
+    };  // Total: 24 bytes
+
+    struct SnapshotHeader {
+        char magic[8];              // SNAPSHOT_MAGIC
+        uint32_t version;           // SNAPSHOT_VERSION
+        uint32_t section_count;     // Used entries in sections[]
+        uint64_t generation;        // mount_generation when sealed
+        uint64_t checksum;          // Over every section
+        SnapshotSectionInfo sections[SNAPSHOT_MAX_SECTIONS];
+    };  // Total: 224 bytes
+
+    // Leading fields of the entries section; the free slot stack follows.
+    struct EntriesSnapshot {
+        uint32_t free_count;        // Entries on the free slot stack
+        uint32_t total_files;
+        uint32_t total_directories;
+        uint32_t reserved;
+    };  // Total: 16 bytes
+
+    // Sections and total size for a container geometry.
+    struct SnapshotLayout {
+        SnapshotSectionInfo sections[SNAPSHOT_MAX_SECTIONS];
+        uint32_t section_count;
+        uint64_t total_size;
+    };
+
+    SnapshotLayout compute_snapshot_layout(uint32_t max_files, uint32_t max_users, uint64_t total_blocks);
+
+    // Checksum used for the snapshot payload (64-bit, word at a time).
+    uint64_t snapshot_checksum(const uint8_t* data, size_t len);
+
+    /**
+     * View over a container's snapshot area.
+     */
+    class Snapshot
+    {
+    private:
+        OmniContainer* container_;
+        SnapshotHeader* header_;
+        uint8_t* base_;
+        uint64_t size_;
+
+        uint64_t payload_checksum() const;
+
+    public:
+        Snapshot();
+
+        // Writes an empty header and section table (fs_format).
+        static void initialize(uint8_t* area, const SnapshotLayout& layout);
+
+        // Binds to the container's area; false if it has none or the
+        // section table is malformed.
+        bool attach(OmniContainer& container);
+        void detach();
+        bool present() const { return header_ != nullptr; }
+
+        // Section payload and its capacity, or nullptr when it is missing.
+        uint8_t* section(SnapshotSection id, uint64_t& size);
+
+        // True when the area was sealed at generation and is intact.
+        bool valid(uint64_t generation) const;
+
+        // Recomputes the checksum and records generation. The caller
+        // flushes the area (mark_all_dirty) before and after.
+        void seal(uint64_t generation);
+
+        void mark_all_dirty();
+    };
+}
+
+#endif // SNAPSHOT_HPP
@@ -0,0 +1,67 @@
+#ifndef TIMING_WHEEL_HPP
+#define TIMING_WHEEL_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace ofs
+{
+    /**
+     * Hierarchical timing wheel over a fixed set of timer ids.
+     *
+     * Three levels of 64 buckets cover 1, 64 and 4096 ticks per bucket
+     * (about 3 days at one tick per second). A timer sits in the bucket of
+     * the coarsest level that still tells its deadline apart from now, and
+     * moves down a level when that bucket comes round; advancing one tick
+     * only touches the buckets that are due. Deadlines beyond the wheel's
+     * span park in the top level and are placed again as time passes.
+     *
+     * Timers are intrusive doubly linked lists over per-id arrays, so
+     * schedule and cancel are O(1) and nothing is allocated after reset().
+     * Not thread-safe; the owner serializes calls.
+     */
+    class TimingWheel
+    {
+    public:
+        static constexpr uint32_t LEVELS = 3;
+        static constexpr uint32_t BUCKET_BITS = 6;
+        static constexpr uint32_t BUCKETS = 1u << BUCKET_BITS;
+        static constexpr uint64_t SPAN = 1ULL << (LEVELS * BUCKET_BITS);
+
+        TimingWheel();
+
+        // Timer ids 0..capacity-1, all idle; the wheel starts at tick now.
+        void reset(uint32_t capacity, uint64_t now);
+
+        // Arms id for deadline (re-arms it if already armed). Deadlines at
+        // or before the current tick fire on the next advance.
+        void schedule(uint32_t id, uint64_t deadline);
+        void cancel(uint32_t id);
+        bool armed(uint32_t id) const;
+
+        // Moves the wheel to tick now and appends the ids whose deadline
+        // passed to expired, disarmed. Returns how many were appended.
+        size_t advance(uint64_t now, std::vector<uint32_t>& expired);
+
+        uint64_t now() const { return current_; }
+        uint32_t pending() const { return pending_; }
+
+    private:
+        static constexpr uint32_t NONE = UINT32_MAX;
+
+        uint64_t current_;
+        uint32_t pending_;
+        std::vector<uint32_t> heads_;       // LEVELS * BUCKETS list heads
+        std::vector<uint32_t> next_;
+        std::vector<uint32_t> prev_;
+        std::vector<uint32_t> bucket_;      // NONE when idle
+        std::vector<uint64_t> deadline_;
+
+        void link(uint32_t id);
+        void unlink(uint32_t id);
+        uint32_t take(uint32_t bucket);
+    };
+}
+
+#endif // TIMING_WHEEL_HPP
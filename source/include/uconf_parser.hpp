@@ -9,6 +9,10 @@ namespace ofs::config
     bool load_uconf_or_create_default(const std::string& path, Config& out_cfg, std::string& err);
 
     bool write_uconf(const std::string& path, const Config& cfg, std::string& err);
+
+    // Pushes the [logging] section into the logger: rotation policy, file
+    // format and, with async set, the asynchronous backend.
+    void apply_logging_config(const Config& cfg);
 }
 
 #endif // UCONF_PARSER_HPP
\ No newline at end of file
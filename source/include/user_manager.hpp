@@ -0,0 +1,133 @@
+#ifndef USER_MANAGER_HPP
+#define USER_MANAGER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "odf_types.hpp"
+
+namespace ofs::storage
+{
+    class OmniContainer;
+}
+
+namespace ofs::security
+{
+    class PasswordHasher;
+
+    // Hot fields for one index position. The UserInfo record itself (cold,
+    // in the container's user table) is only read on a full hash match.
+    struct UserHot
+    {
+        uint64_t hash;      // Full 64-bit hash of the username
+        uint32_t slot;      // User table slot
+        uint8_t role;       // UserRole
+        uint8_t active;     // Mirrors UserInfo::is_active
+        uint16_t reserved;
+    };  // Total: 16 bytes
+
+    // Leading fields of the index storage; control bytes, hot array and free
+    // slot stack follow.
+    struct UserIndexHeader
+    {
+        uint32_t capacity;      // Index positions (power of two, >= 16)
+        uint32_t count;         // Live users
+        uint32_t tombstones;    // Deleted control bytes
+        uint32_t free_count;    // Entries on the free slot stack
+    };  // Total: 16 bytes
+
+    /**
+     * Users of one container, indexed by username.
+     *
+     * The index is a Swiss-table style open-addressing hash: one control
+     * byte per position (empty, deleted, or the low 7 bits of the hash),
+     * probed 16 at a time with SSE2 compares, then the hot array, then the
+     * cold UserInfo record. Index storage is pointer-free, so it can live in
+     * the container's snapshot area and be used as mapped after a clean
+     * shutdown.
+     *
+     * Capacity is at least twice max_users, so a lookup almost always ends
+     * in the first group regardless of how many users there are.
+     */
+    class UserManager
+    {
+    public:
+        static constexpr size_t GROUP_SIZE = 16;
+
+        using LoginCallback = std::function<void(OFSErrorCodes result, const UserInfo& user)>;
+
+        UserManager();
+
+        UserManager(const UserManager&) = delete;
+        UserManager& operator=(const UserManager&) = delete;
+
+        // Bytes of index storage needed for max_users.
+        static uint64_t snapshot_bytes(uint32_t max_users);
+
+        // Binds to the container's user table. storage is snapshot_bytes()
+        // of index storage (or nullptr for a private copy); valid says it
+        // already matches the user table, otherwise it is rebuilt.
+        void attach(storage::OmniContainer& container, uint8_t* storage = nullptr,
+                    size_t storage_len = 0, bool valid = false);
+        void detach();
+
+        // Routes password hashing through hasher (nullptr hashes inline with
+        // the default iteration count).
+        void set_hasher(PasswordHasher* hasher);
+
+        OFSErrorCodes user_create(const std::string& username, const std::string& password, UserRole role);
+        OFSErrorCodes user_delete(const std::string& username);
+
+        // Verifies the password and records last_login; out receives the
+        // user's record.
+        OFSErrorCodes user_login(const std::string& username, const std::string& password, UserInfo& out);
+
+        // Non-blocking login: done runs once the hasher has checked the
+        // password, usually on one of its worker threads.
+        void user_login_async(const std::string& username, const std::string& password, LoginCallback done);
+
+        // Every active user, in index order.
+        OFSErrorCodes user_list(std::vector<UserInfo>& out) const;
+
+        // User table slot and role of a user.
+        OFSErrorCodes find(const std::string& username, uint32_t& slot, UserRole* role = nullptr) const;
+
+        uint32_t count() const;
+        uint32_t capacity() const;
+
+        static bool valid_username(std::string_view username);
+
+    private:
+        storage::OmniContainer* container_;
+        PasswordHasher* hasher_;
+        UserInfo* table_;
+        uint32_t max_users_;
+
+        UserIndexHeader* header_;
+        uint8_t* ctrl_;         // capacity + GROUP_SIZE bytes, the first group mirrored at the end
+        UserHot* hot_;
+        uint32_t* free_stack_;  // free user table slots, lowest on top
+        size_t mask_;
+        std::vector<uint8_t> local_storage_;
+
+        mutable std::shared_mutex mtx_;
+
+        static uint64_t hash_name(std::string_view name);
+        static std::string_view record_name(const UserInfo& u);
+        void set_ctrl(size_t pos, uint8_t value);
+        size_t locate(std::string_view name, uint64_t hash) const;
+        void place(uint64_t hash, uint32_t slot, uint8_t role);
+        void rebuild();
+        void rehash();
+        OFSErrorCodes lookup(const std::string& username, uint32_t& slot, UserInfo& out) const;
+        OFSErrorCodes finish_login(const std::string& username, const std::string& password, uint32_t slot,
+                                   bool ok, UserInfo& out);
+    };
+}
+
+#endif // USER_MANAGER_HPP
@@ -0,0 +1,108 @@
+#ifndef WORK_STEALING_DEQUE_HPP
+#define WORK_STEALING_DEQUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace ofs
+{
+    /**
+     * Chase-Lev work-stealing deque of pointers (Chase and Lev, SPAA 2005),
+     * with the C11 memory orders of Lê, Pop, Cohen and Zappa Nardelli,
+     * PPoPP 2013.
+     *
+     * One owner thread push()es and pop()s at the bottom; any thread may
+     * steal() from the top. Capacity is fixed (a power of two) and push()
+     * returns false when the deque is full, so the caller can put the item
+     * somewhere else instead of growing the buffer under thieves. steal()
+     * may fail spuriously when it loses a race; callers treat that as
+     * empty and retry later.
+     */
+    template <typename T>
+    class WorkStealingDeque
+    {
+    public:
+        explicit WorkStealingDeque(size_t capacity = 1024)
+        {
+            size_t cap = 1;
+            while (cap < capacity) {
+                cap <<= 1;
+            }
+            mask_ = static_cast<int64_t>(cap) - 1;
+            buf_ = std::make_unique<std::atomic<T*>[]>(cap);
+        }
+
+        WorkStealingDeque(const WorkStealingDeque&) = delete;
+        WorkStealingDeque& operator=(const WorkStealingDeque&) = delete;
+
+        // Owner only.
+        bool push(T* item)
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed);
+            int64_t t = top_.load(std::memory_order_acquire);
+            if (b - t > mask_) {
+                return false;
+            }
+            buf_[b & mask_].store(item, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom_.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+
+        // Owner only: the newest item, or nullptr.
+        T* pop()
+        {
+            int64_t b = bottom_.load(std::memory_order_relaxed) - 1;
+            bottom_.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top_.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom_.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            T* item = buf_[b & mask_].load(std::memory_order_relaxed);
+            if (t == b) {
+                // Last item: race the thieves for it.
+                if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    item = nullptr;
+                }
+                bottom_.store(b + 1, std::memory_order_relaxed);
+            }
+            return item;
+        }
+
+        // Any thread: the oldest item, or nullptr.
+        T* steal()
+        {
+            int64_t t = top_.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom_.load(std::memory_order_acquire);
+            if (t >= b) {
+                return nullptr;
+            }
+            T* item = buf_[t & mask_].load(std::memory_order_relaxed);
+            if (!top_.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return item;
+        }
+
+        // Approximate when other threads are pushing or stealing.
+        size_t size() const
+        {
+            int64_t n = bottom_.load(std::memory_order_relaxed) - top_.load(std::memory_order_relaxed);
+            return n > 0 ? static_cast<size_t>(n) : 0;
+        }
+
+    private:
+        // Thieves hammer top_; keep it off the owner's line.
+        alignas(64) std::atomic<int64_t> top_{0};
+        alignas(64) std::atomic<int64_t> bottom_{0};
+        int64_t mask_;
+        std::unique_ptr<std::atomic<T*>[]> buf_;
+    };
+}
+
+#endif // WORK_STEALING_DEQUE_HPP
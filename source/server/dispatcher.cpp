@@ -0,0 +1,838 @@
+#include "../include/dispatcher.hpp"
+#include "../include/log_macros.hpp"
+
+#include "../include/base64.hpp"
+#include "../include/slab_pool.hpp"
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstring>
+#include <thread>
+#include <type_traits>
+
+#define MODULE_NAME "DISPATCHER"
+
+namespace ofs::server
+{
+    // Room made up front for a response, and per listed entry or user.
+    static constexpr size_t RESPONSE_BYTES = 1024;
+    static constexpr size_t ENTRY_JSON_BYTES = 384;
+    static constexpr size_t USER_JSON_BYTES = 160;
+
+    // Arena::reset() clears these without running anything per element.
+    static_assert(std::is_trivially_destructible<FileEntry>::value, "FileEntry must be trivially destructible");
+    static_assert(std::is_trivially_destructible<UserInfo>::value, "UserInfo must be trivially destructible");
+
+    Dispatcher::Dispatcher(fs::FileSystem& filesystem, security::SessionManager& sessions, const config::Config& cfg)
+        : fs_(filesystem),
+          sessions_(sessions),
+          require_auth_(cfg.require_auth),
+          window_(cfg.stream_window),
+          pending_logins_(0),
+          pending_commits_(0),
+          requests_(0),
+          allocations_(0)
+    {
+    }
+
+    Dispatcher::Stream::~Stream()
+    {
+        if (fs != nullptr) {
+            fs->file_close(handle, session);
+        }
+    }
+
+    Dispatcher::Arena& Dispatcher::arena()
+    {
+        static thread_local Arena a;
+        return a;
+    }
+
+    void Dispatcher::Arena::make_room(std::string& out, size_t extra)
+    {
+        SlabPool::get_instance().reserve(out, out.size() + extra);
+        response = out.capacity();
+    }
+
+    uint32_t Dispatcher::Arena::reset(const std::string& out)
+    {
+        uint32_t grown = (out.capacity() > response) + (entries.capacity() > entries_capacity) +
+                         (users.capacity() > users_capacity);
+        SlabPool& pool = SlabPool::get_instance();
+        for (std::string* s : {&path, &data, &name, &other}) {
+            if (s->capacity() > ARENA_KEEP) {
+                pool.release(std::move(*s));
+            } else {
+                s->clear();
+            }
+        }
+        if (entries.capacity() * sizeof(FileEntry) > ARENA_KEEP) {
+            std::vector<FileEntry>().swap(entries);
+        }
+        if (users.capacity() * sizeof(UserInfo) > ARENA_KEEP) {
+            std::vector<UserInfo>().swap(users);
+        }
+        entries.clear();
+        users.clear();
+        entries_capacity = entries.capacity();
+        users_capacity = users.capacity();
+        response = 0;
+        return grown;
+    }
+
+    // The response is complete: counts the request and empties the arena.
+    void Dispatcher::finish(const std::string& out)
+    {
+        requests_.fetch_add(1, std::memory_order_relaxed);
+        allocations_.fetch_add(arena().reset(out), std::memory_order_relaxed);
+    }
+
+    void Dispatcher::drain()
+    {
+        while (pending_logins_.load() != 0 || pending_commits_.load() != 0) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
+
+    static const char* role_name(UserRole role)
+    {
+        return role == UserRole::ADMIN ? "admin" : "normal";
+    }
+
+    static std::string_view fixed_string(const char* s, size_t max)
+    {
+        return std::string_view(s, strnlen(s, max));
+    }
+
+    static bool param_string(const Request& req, std::string_view key, std::string& out)
+    {
+        const std::string_view* v = req.param(key);
+        if (v == nullptr) {
+            return false;
+        }
+        out.assign(v->data(), v->size());
+        return true;
+    }
+
+    // Decimal, or octal with a leading 0 ("0644").
+    static bool param_number(const Request& req, std::string_view key, uint64_t& out)
+    {
+        const std::string_view* v = req.param(key);
+        if (v == nullptr || v->empty()) {
+            return false;
+        }
+        int base = v->size() > 1 && (*v)[0] == '0' ? 8 : 10;
+        const char* end = v->data() + v->size();
+        auto [ptr, ec] = std::from_chars(v->data(), end, out, base);
+        return ec == std::errc() && ptr == end;
+    }
+
+    // An absent parameter keeps out; false only for one that is present
+    // and not a number.
+    static bool param_optional(const Request& req, std::string_view key, uint64_t& out)
+    {
+        return req.param(key) == nullptr || param_number(req, key, out);
+    }
+
+    static bool param_flag(const Request& req, std::string_view key)
+    {
+        const std::string_view* v = req.param(key);
+        return v != nullptr && (*v == "true" || *v == "1");
+    }
+
+    // File content, decoded from base64 where it lies in the request
+    // frame. The views of a Request point into the mutable frame passed
+    // to parse_request, so writing through them is safe. Absent is an
+    // empty payload; false when the text is not valid base64.
+    static bool param_data(const Request& req, std::string_view key, std::string_view& out)
+    {
+        out = {};
+        const std::string_view* v = req.param(key);
+        if (v == nullptr) {
+            return true;
+        }
+        char* text = const_cast<char*>(v->data());
+        size_t len = 0;
+        if (!base64::decode(text, v->size(), reinterpret_cast<uint8_t*>(text), len)) {
+            return false;
+        }
+        out = std::string_view(text, len);
+        return true;
+    }
+
+    static void write_entry(JsonWriter& w, const FileEntry& e)
+    {
+        w.begin_object();
+        w.key("name");
+        w.value(fixed_string(e.name, sizeof(e.name)));
+        w.key("type");
+        w.value(e.getType() == EntryType::DIRECTORY ? "directory" : "file");
+        w.key("size");
+        w.value(e.size);
+        w.key("permissions");
+        w.value(e.permissions);
+        w.key("created_time");
+        w.value(e.created_time);
+        w.key("modified_time");
+        w.value(e.modified_time);
+        w.key("owner");
+        w.value(fixed_string(e.owner, sizeof(e.owner)));
+        w.key("inode");
+        w.value(e.inode);
+        w.end_object();
+    }
+
+    std::string Dispatcher::reject(std::string& frame, OFSErrorCodes code, std::string_view message)
+    {
+        Request req;
+        const char* err;
+        parse_request(frame.data(), frame.size(), req, err);
+        return reject(req, code, message);
+    }
+
+    std::string Dispatcher::reject(const Request& req, OFSErrorCodes code, std::string_view message)
+    {
+        std::string out;
+        write_error(out, req.operation, req.request_id, code, message);
+        return out;
+    }
+
+    void Dispatcher::footprint(const Request& req, LockSet& out)
+    {
+        out.clear();
+        if (req.op == Operation::unknown) {
+            return;
+        }
+
+        // Every request validates its session; the two that read or end
+        // the session's own state need it to themselves.
+        if (!req.session_id.empty()) {
+            std::string name = "#sessions/";
+            name.append(req.session_id.data(), req.session_id.size());
+            bool own = req.op == Operation::user_logout || req.op == Operation::get_session_info;
+            out.add(name, own ? LockMode::exclusive : LockMode::shared);
+        }
+
+        auto path = [&req, &out](std::string_view key, LockMode mode) {
+            if (const std::string_view* v = req.param(key)) {
+                out.add(*v, mode);
+            }
+        };
+
+        switch (req.op) {
+        case Operation::user_login:
+        case Operation::user_list:
+            out.add("#users", LockMode::shared);
+            break;
+        case Operation::user_create:
+            out.add("#users", LockMode::exclusive);
+            break;
+        case Operation::user_delete:
+            // Also ends the user's sessions.
+            out.add("#users", LockMode::exclusive);
+            out.add("#sessions", LockMode::exclusive);
+            break;
+        case Operation::user_logout:
+        case Operation::get_session_info:
+            break;
+        case Operation::file_create:
+        case Operation::dir_create:
+            // The owner comes from the user table.
+            out.add("#users", LockMode::shared);
+            path("path", LockMode::exclusive);
+            break;
+        case Operation::file_read:
+        case Operation::file_open:
+        case Operation::file_exists:
+        case Operation::dir_list:
+        case Operation::dir_exists:
+        case Operation::get_metadata:
+            path("path", LockMode::shared);
+            break;
+        case Operation::file_edit:
+        case Operation::file_delete:
+        case Operation::file_truncate:
+        case Operation::dir_delete:
+        case Operation::set_permissions:
+            path("path", LockMode::exclusive);
+            break;
+        case Operation::file_rename:
+            path("old_path", LockMode::exclusive);
+            path("new_path", LockMode::exclusive);
+            break;
+        case Operation::file_read_next:
+        case Operation::file_close:
+            // Reads through one handle keep their order, and the file's
+            // path orders them against changes to the file.
+            if (const std::string_view* v = req.param("handle")) {
+                std::string name = "#handles/";
+                name.append(v->data(), v->size());
+                out.add(name, LockMode::exclusive);
+                uint64_t handle;
+                std::string file;
+                if (param_number(req, "handle", handle) && fs_.handle_path(handle, req.session_id, file)) {
+                    out.add(file, LockMode::shared);
+                }
+            }
+            break;
+        case Operation::get_stats:
+            out.add("/", LockMode::shared);
+            out.add("#users", LockMode::shared);
+            out.add("#sessions", LockMode::shared);
+            break;
+        case Operation::unknown:
+            break;
+        }
+    }
+
+    Priority Dispatcher::priority(const Request& req)
+    {
+        switch (req.op) {
+        case Operation::file_create:
+        case Operation::file_read:
+        case Operation::file_read_next:
+        case Operation::file_edit:
+            return Priority::bulk;
+        case Operation::user_create:
+        case Operation::user_delete:
+        case Operation::user_list:
+            return Priority::maintenance;
+        default:
+            return Priority::interactive;
+        }
+    }
+
+    void Dispatcher::handle(std::string& frame, Reply reply)
+    {
+        Request req;
+        const char* err;
+        bool ok = parse_request(frame.data(), frame.size(), req, err);
+        handle(req, ok ? nullptr : err, std::move(reply));
+    }
+
+    void Dispatcher::handle(const Request& req, const char* err, Reply reply)
+    {
+        if (err != nullptr) {
+            LOG_WARN(MODULE_NAME, 101, "malformed request: {}", err);
+            std::string out;
+            write_error(out, req.operation, req.request_id, OFSErrorCodes::ERROR_INVALID_OPERATION,
+                        std::string("malformed request: ") + err);
+            reply(std::move(out), nullptr);
+            return;
+        }
+        if (req.op == Operation::unknown) {
+            std::string out;
+            write_error(out, req.operation, req.request_id, OFSErrorCodes::ERROR_NOT_IMPLEMENTED,
+                        "unknown operation");
+            reply(std::move(out), nullptr);
+            return;
+        }
+        if (req.op == Operation::user_login) {
+            login(req, std::move(reply));
+            return;
+        }
+
+        std::string out = SlabPool::get_instance().acquire(RESPONSE_BYTES);
+        arena().response = out.capacity();
+        UserRole role = UserRole::NORMAL;
+        OFSErrorCodes rc = OFSErrorCodes::SUCCESS;
+        if (!req.session_id.empty() || require_auth_) {
+            rc = sessions_.validate(req.session_id, &role);
+        }
+        // A change is answered once the journal has it on disk; the worker
+        // goes on to the next request meanwhile.
+        storage::DeferredCommits commits;
+        std::unique_ptr<Stream> rest;
+        if (rc == OFSErrorCodes::SUCCESS) {
+            rc = execute(req, role, out, rest);
+        }
+        if (rc != OFSErrorCodes::SUCCESS) {
+            out.clear();
+            write_error(out, req.operation, req.request_id, rc);
+        }
+        finish(out);
+        if (commits.last() == 0) {
+            reply(std::move(out), std::move(rest));
+            return;
+        }
+        ++pending_commits_;
+        fs_.journal().when_durable(commits.last(), [this, reply = std::move(reply), out = std::move(out)]() mutable {
+            reply(std::move(out), nullptr);
+            --pending_commits_;
+        });
+    }
+
+    void Dispatcher::resume(std::unique_ptr<Stream> stream, Reply reply)
+    {
+        std::string out = SlabPool::get_instance().acquire(RESPONSE_BYTES);
+        arena().response = out.capacity();
+        OFSErrorCodes rc = next_chunk(*stream, out);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            out.clear();
+            write_error(out, operation_name(Operation::file_read), stream->request_id, rc);
+            stream.reset();
+        } else if (stream->left == 0) {
+            stream.reset();
+        }
+        finish(out);
+        reply(std::move(out), std::move(stream));
+    }
+
+    // One chunk of a stream, at most window_ bytes of the file, as a
+    // complete response line.
+    OFSErrorCodes Dispatcher::next_chunk(Stream& stream, std::string& out)
+    {
+        Arena& a = arena();
+        std::string& data = a.data;
+        uint64_t offset = 0;
+        size_t len = static_cast<size_t>(std::min<uint64_t>(stream.left, window_));
+        OFSErrorCodes rc = fs_.file_read_next(stream.handle, stream.session, len, data, &offset);
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+        stream.left = data.empty() ? 0 : stream.left - data.size();
+
+        a.make_room(out, RESPONSE_BYTES + base64::encoded_size(data.size()));
+        JsonWriter w(out);
+        w.begin_response(true, operation_name(Operation::file_read), stream.request_id);
+        w.key("data");
+        w.begin_object();
+        w.key("path");
+        w.value(stream.path);
+        w.key("offset");
+        w.value(offset);
+        w.key("size");
+        w.value(static_cast<uint64_t>(data.size()));
+        w.key("data");
+        w.value_base64(data.data(), data.size());
+        w.key("more");
+        w.value(stream.left != 0);
+        w.end_object();
+        w.end_object();
+        out += '\n';
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    void Dispatcher::login(const Request& req, Reply reply)
+    {
+        std::string username, password;
+        if (!param_string(req, "username", username) || !param_string(req, "password", password)) {
+            std::string out;
+            write_error(out, req.operation, req.request_id, OFSErrorCodes::ERROR_INVALID_OPERATION,
+                        "username and password are required");
+            reply(std::move(out), nullptr);
+            return;
+        }
+
+        // The frame the request points into is gone when the hash is done.
+        std::string operation(req.operation);
+        std::string request_id(req.request_id);
+        ++pending_logins_;
+        fs_.users().user_login_async(
+            username, password,
+            [this, operation, request_id, reply = std::move(reply)](OFSErrorCodes rc, const UserInfo& user) {
+                std::string out;
+                SessionInfo session;
+                if (rc == OFSErrorCodes::SUCCESS) {
+                    rc = sessions_.create(user, session);
+                }
+                if (rc != OFSErrorCodes::SUCCESS) {
+                    write_error(out, operation, request_id, rc);
+                    reply(std::move(out), nullptr);
+                    --pending_logins_;
+                    return;
+                }
+                JsonWriter w(out);
+                w.begin_response(true, operation, request_id);
+                w.key("data");
+                w.begin_object();
+                w.key("session_id");
+                w.value(fixed_string(session.session_id, sizeof(session.session_id)));
+                w.key("username");
+                w.value(fixed_string(user.username, sizeof(user.username)));
+                w.key("role");
+                w.value(role_name(user.role));
+                w.end_object();
+                w.end_object();
+                out += '\n';
+                reply(std::move(out), nullptr);
+                --pending_logins_;
+            });
+    }
+
+    // User table slot of the session's user, recorded as the owner of new
+    // files and directories (0 without a session).
+    uint32_t Dispatcher::owner_slot(const Request& req)
+    {
+        SessionInfo info;
+        uint32_t slot = 0;
+        if (!req.session_id.empty() && sessions_.info(req.session_id, info) == OFSErrorCodes::SUCCESS) {
+            fs_.users().find(std::string(fixed_string(info.user.username, sizeof(info.user.username))), slot);
+        }
+        return slot;
+    }
+
+    // A full handle table may be holding handles of sessions that logged
+    // out or expired since; those are closed and the open tried again.
+    OFSErrorCodes Dispatcher::open_handle(const std::string& path, std::string_view session, uint64_t& handle,
+                                          uint64_t& size, uint64_t offset)
+    {
+        OFSErrorCodes rc = fs_.file_open(path, session, handle, size, offset);
+        if (rc != OFSErrorCodes::ERROR_NO_SPACE) {
+            return rc;
+        }
+        SessionInfo info;
+        size_t closed = fs_.close_handles([this, &info](std::string_view s) {
+            return !s.empty() && sessions_.info(s, info) != OFSErrorCodes::SUCCESS;
+        });
+        return closed != 0 ? fs_.file_open(path, session, handle, size, offset) : rc;
+    }
+
+    OFSErrorCodes Dispatcher::execute(const Request& req, UserRole role, std::string& out,
+                                      std::unique_ptr<Stream>& rest)
+    {
+        Arena& a = arena();
+        std::string& path = a.path;
+        std::string& data = a.data;
+        std::string& name = a.name;
+        std::string& other = a.other;
+        std::string_view content;
+        uint64_t number = 0;
+        OFSErrorCodes rc = OFSErrorCodes::SUCCESS;
+        JsonWriter w(out);
+
+        // Arena strings grow through the slab pool.
+        auto need = [&req](std::string_view key, std::string& v) {
+            const std::string_view* p = req.param(key);
+            if (p == nullptr) {
+                return false;
+            }
+            SlabPool::get_instance().reserve(v, p->size());
+            v.assign(p->data(), p->size());
+            return true;
+        };
+        auto admin_only = [role] { return role == UserRole::ADMIN; };
+
+        // Operations fill "data" (or leave it empty) and fall through to
+        // the common tail that closes the response.
+        w.begin_response(true, req.operation, req.request_id);
+        w.key("data");
+        w.begin_object();
+
+        switch (req.op) {
+        case Operation::user_logout:
+            rc = sessions_.destroy(req.session_id);
+            if (rc == OFSErrorCodes::SUCCESS) {
+                fs_.close_handles([&req](std::string_view s) { return s == req.session_id; });
+            }
+            break;
+
+        case Operation::user_create: {
+            if (!admin_only()) {
+                return OFSErrorCodes::ERROR_PERMISSION_DENIED;
+            }
+            if (!need("username", name) || !need("password", data)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            UserRole new_role = UserRole::NORMAL;
+            if (param_string(req, "role", other)) {
+                if (other == "admin" || other == "1") {
+                    new_role = UserRole::ADMIN;
+                } else if (other != "normal" && other != "0") {
+                    return OFSErrorCodes::ERROR_INVALID_OPERATION;
+                }
+            }
+            rc = fs_.users().user_create(name, data, new_role);
+            break;
+        }
+
+        case Operation::user_delete:
+            if (!admin_only()) {
+                return OFSErrorCodes::ERROR_PERMISSION_DENIED;
+            }
+            if (!need("username", name)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            rc = fs_.users().user_delete(name);
+            if (rc == OFSErrorCodes::SUCCESS) {
+                sessions_.destroy_user(name);
+            }
+            break;
+
+        case Operation::user_list: {
+            if (!admin_only()) {
+                return OFSErrorCodes::ERROR_PERMISSION_DENIED;
+            }
+            std::vector<UserInfo>& users = a.users;
+            rc = fs_.users().user_list(users);
+            a.make_room(out, users.size() * USER_JSON_BYTES);
+            w.key("users");
+            w.begin_array();
+            for (const UserInfo& u : users) {
+                w.begin_object();
+                w.key("username");
+                w.value(fixed_string(u.username, sizeof(u.username)));
+                w.key("role");
+                w.value(role_name(u.role));
+                w.key("created_time");
+                w.value(u.created_time);
+                w.key("last_login");
+                w.value(u.last_login);
+                w.end_object();
+            }
+            w.end_array();
+            break;
+        }
+
+        case Operation::get_session_info: {
+            SessionInfo info;
+            rc = sessions_.info(req.session_id, info);
+            w.key("session_id");
+            w.value(fixed_string(info.session_id, sizeof(info.session_id)));
+            w.key("username");
+            w.value(fixed_string(info.user.username, sizeof(info.user.username)));
+            w.key("role");
+            w.value(role_name(info.user.role));
+            w.key("login_time");
+            w.value(info.login_time);
+            w.key("last_activity");
+            w.value(info.last_activity);
+            w.key("operations_count");
+            w.value(info.operations_count);
+            break;
+        }
+
+        case Operation::file_create:
+            if (!need("path", path)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            if (!param_data(req, "data", content)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            rc = fs_.file_create(path, content.data(), content.size(), owner_slot(req));
+            break;
+
+        case Operation::file_read: {
+            // "offset" and "length" ask for a range; "stream" for the
+            // file (or range) in chunks of at most window_ bytes.
+            uint64_t offset = 0;
+            uint64_t length = UINT64_MAX;
+            if (!need("path", path) || !param_optional(req, "offset", offset) ||
+                !param_optional(req, "length", length)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            if (param_flag(req, "stream")) {
+                std::unique_ptr<Stream> stream = std::make_unique<Stream>();
+                uint64_t size;
+                rc = open_handle(path, req.session_id, stream->handle, size, offset);
+                if (rc != OFSErrorCodes::SUCCESS) {
+                    return rc;
+                }
+                stream->fs = &fs_;
+                stream->session.assign(req.session_id.data(), req.session_id.size());
+                stream->left = std::min(length, size - offset);
+                stream->path = path;
+                stream->request_id.assign(req.request_id.data(), req.request_id.size());
+                out.clear();
+                rc = next_chunk(*stream, out);
+                if (rc == OFSErrorCodes::SUCCESS && stream->left != 0) {
+                    rest = std::move(stream);
+                }
+                return rc;
+            }
+            bool range = req.param("offset") != nullptr || req.param("length") != nullptr;
+            rc = range ? fs_.file_read_range(path, offset, static_cast<size_t>(length), data) : fs_.file_read(path, data);
+            w.key("path");
+            w.value(path);
+            if (range) {
+                w.key("offset");
+                w.value(offset);
+            }
+            w.key("size");
+            w.value(static_cast<uint64_t>(data.size()));
+            a.make_room(out, RESPONSE_BYTES + base64::encoded_size(data.size()));
+            w.key("data");
+            w.value_base64(data.data(), data.size());
+            break;
+        }
+
+        case Operation::file_open: {
+            uint64_t offset = 0;
+            uint64_t handle = 0;
+            uint64_t size = 0;
+            if (!need("path", path) || !param_optional(req, "offset", offset)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            rc = open_handle(path, req.session_id, handle, size, offset);
+            w.key("handle");
+            w.value(handle);
+            w.key("size");
+            w.value(size);
+            break;
+        }
+
+        case Operation::file_read_next: {
+            // At most window_ bytes whatever "length" asks for.
+            uint64_t length = window_;
+            uint64_t offset = 0;
+            if (!param_number(req, "handle", number) || !param_optional(req, "length", length)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            rc = fs_.file_read_next(number, req.session_id, static_cast<size_t>(std::min<uint64_t>(length, window_)), data, &offset);
+            w.key("handle");
+            w.value(number);
+            w.key("offset");
+            w.value(offset);
+            w.key("size");
+            w.value(static_cast<uint64_t>(data.size()));
+            a.make_room(out, RESPONSE_BYTES + base64::encoded_size(data.size()));
+            w.key("data");
+            w.value_base64(data.data(), data.size());
+            break;
+        }
+
+        case Operation::file_close:
+            if (!param_number(req, "handle", number)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            rc = fs_.file_close(number, req.session_id);
+            break;
+
+        case Operation::file_edit:
+            if (!need("path", path) || req.param("data") == nullptr || !param_data(req, "data", content) ||
+                !param_number(req, "index", number)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            rc = fs_.file_edit(path, content.data(), content.size(), number);
+            break;
+
+        case Operation::file_delete:
+        case Operation::file_truncate:
+        case Operation::file_exists:
+        case Operation::dir_delete:
+        case Operation::dir_exists:
+            if (!need("path", path)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            rc = req.op == Operation::file_delete     ? fs_.file_delete(path)
+                 : req.op == Operation::file_truncate ? fs_.file_truncate(path)
+                 : req.op == Operation::file_exists   ? fs_.file_exists(path)
+                 : req.op == Operation::dir_delete    ? fs_.dir_delete(path)
+                                                      : fs_.dir_exists(path);
+            break;
+
+        case Operation::file_rename:
+            if (!need("old_path", path) || !need("new_path", other)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            rc = fs_.file_rename(path, other);
+            break;
+
+        case Operation::dir_create:
+            if (!need("path", path)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            rc = fs_.dir_create(path, owner_slot(req));
+            break;
+
+        case Operation::dir_list: {
+            if (!need("path", path)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            std::vector<FileEntry>& entries = a.entries;
+            rc = fs_.dir_list(path, entries);
+            a.make_room(out, entries.size() * ENTRY_JSON_BYTES);
+            w.key("entries");
+            w.begin_array();
+            for (const FileEntry& e : entries) {
+                write_entry(w, e);
+            }
+            w.end_array();
+            break;
+        }
+
+        case Operation::get_metadata: {
+            if (!need("path", path)) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            FileMetadata meta;
+            rc = fs_.get_metadata(path, meta);
+            w.key("path");
+            w.value(fixed_string(meta.path, sizeof(meta.path)));
+            w.key("entry");
+            write_entry(w, meta.entry);
+            w.key("blocks_used");
+            w.value(meta.blocks_used);
+            w.key("actual_size");
+            w.value(meta.actual_size);
+            break;
+        }
+
+        case Operation::set_permissions:
+            if (!need("path", path) || !param_number(req, "permissions", number) || number > 07777) {
+                return OFSErrorCodes::ERROR_INVALID_OPERATION;
+            }
+            rc = fs_.set_permissions(path, static_cast<uint32_t>(number));
+            break;
+
+        case Operation::get_stats: {
+            FSStats stats;
+            rc = fs_.get_stats(stats);
+            stats.active_sessions = sessions_.active();
+            w.key("total_size");
+            w.value(stats.total_size);
+            w.key("used_space");
+            w.value(stats.used_space);
+            w.key("free_space");
+            w.value(stats.free_space);
+            w.key("total_files");
+            w.value(stats.total_files);
+            w.key("total_directories");
+            w.value(stats.total_directories);
+            w.key("total_users");
+            w.value(stats.total_users);
+            w.key("active_sessions");
+            w.value(stats.active_sessions);
+            w.key("fragmentation");
+            w.value(stats.fragmentation);
+            w.key("cache_hits");
+            w.value(stats.cache_hits);
+            w.key("cache_misses");
+            w.value(stats.cache_misses);
+            w.key("cache_evictions");
+            w.value(stats.cache_evictions);
+            w.key("cache_read_ahead");
+            w.value(stats.cache_read_ahead);
+            w.key("cache_read_ahead_hits");
+            w.value(stats.cache_read_ahead_hits);
+            // Requests and stream chunks run so far, and the allocations
+            // their buffers still made: pool misses and arena growth.
+            SlabPool::Stats pool = SlabPool::get_instance().stats();
+            w.key("requests");
+            w.value(requests_.load());
+            w.key("request_allocations");
+            w.value(allocations_.load() + pool.misses);
+            w.key("buffer_pool_hits");
+            w.value(pool.hits);
+            w.key("buffer_pool_misses");
+            w.value(pool.misses);
+            w.key("buffer_pool_idle_bytes");
+            w.value(pool.idle_bytes);
+            break;
+        }
+
+        case Operation::user_login:
+        case Operation::unknown:
+            return OFSErrorCodes::ERROR_INVALID_OPERATION;
+        }
+
+        if (rc != OFSErrorCodes::SUCCESS) {
+            return rc;
+        }
+        w.end_object();
+        w.end_object();
+        out += '\n';
+        return OFSErrorCodes::SUCCESS;
+    }
+}
@@ -0,0 +1,77 @@
+// ofs_server: serves a .omni container over the JSON socket protocol.
+//
+//   ofs_server OMNI_FILE [CONFIG]
+//
+// CONFIG defaults to compiled/default.uconf. The container is formatted
+// from it first if OMNI_FILE does not exist. SIGINT / SIGTERM shut down
+// cleanly (the index snapshot is sealed on the way out).
+
+#include "../include/file_system.hpp"
+#include "../include/logger.hpp"
+#include "../include/server.hpp"
+#include "../include/uconf_parser.hpp"
+
+#include <csignal>
+#include <filesystem>
+#include <iostream>
+#include <string>
+
+using namespace ofs;
+
+static server::Server* g_server = nullptr;
+
+static void on_signal(int)
+{
+    if (g_server != nullptr) {
+        g_server->stop();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2 || argc > 3) {
+        std::cerr << "usage: ofs_server OMNI_FILE [CONFIG]\n";
+        return 2;
+    }
+    const std::string omni_path = argv[1];
+    const std::string config_path = argc == 3 ? argv[2] : "compiled/default.uconf";
+
+    Logger::get_instance().set_log_file("logs/ofs_server.log");
+
+    config::Config cfg;
+    std::string err;
+    if (!config::load_uconf_or_create_default(config_path, cfg, err)) {
+        std::cerr << "cannot load " << config_path << ": " << err << "\n";
+        return 1;
+    }
+    config::apply_logging_config(cfg);
+
+    if (!std::filesystem::exists(omni_path) &&
+        fs::FileSystem::format(omni_path, config_path) != OFSErrorCodes::SUCCESS) {
+        std::cerr << "cannot format " << omni_path << "\n";
+        return 1;
+    }
+
+    fs::FileSystem filesystem;
+    if (filesystem.init(omni_path, cfg) != OFSErrorCodes::SUCCESS) {
+        std::cerr << "cannot mount " << omni_path << "\n";
+        return 1;
+    }
+
+    int rc = 0;
+    {
+        server::Server srv(filesystem, cfg);
+        if (srv.start() != OFSErrorCodes::SUCCESS) {
+            rc = 1;
+        } else {
+            g_server = &srv;
+            std::signal(SIGINT, on_signal);
+            std::signal(SIGTERM, on_signal);
+            std::cout << "ofs_server listening on port " << srv.port() << "\n";
+            srv.run();
+            g_server = nullptr;
+        }
+    }
+    filesystem.shutdown();
+    return rc;
+}
@@ -0,0 +1,102 @@
+#include "../include/path_locks.hpp"
+
+namespace ofs::server
+{
+    // COMPATIBLE[a][b]: a lock in mode a can be granted while b is held.
+    static constexpr bool COMPATIBLE[4][4] = {
+        //  IS     IX     S      X
+        {true, true, true, false},    // IS
+        {true, true, false, false},   // IX
+        {true, false, true, false},   // S
+        {false, false, false, false}  // X
+    };
+
+    static bool compatible_modes(LockMode a, LockMode b)
+    {
+        return COMPATIBLE[static_cast<int>(a)][static_cast<int>(b)];
+    }
+
+    // One mode that covers both: IS + IX is IX, IS + S is S, and IX + S
+    // (shared with intent to write below) is treated as exclusive.
+    static LockMode combine(LockMode a, LockMode b)
+    {
+        if (a == b) {
+            return a;
+        }
+        if (a == LockMode::exclusive || b == LockMode::exclusive) {
+            return LockMode::exclusive;
+        }
+        if (a == LockMode::intent_shared) {
+            return b;
+        }
+        if (b == LockMode::intent_shared) {
+            return a;
+        }
+        return LockMode::exclusive;
+    }
+
+    void LockSet::put(std::string_view name, LockMode mode)
+    {
+        for (Entry& e : entries_) {
+            if (e.name == name) {
+                e.mode = combine(e.mode, mode);
+                return;
+            }
+        }
+        entries_.push_back(Entry{std::string(name), mode});
+    }
+
+    void LockSet::add(std::string_view name, LockMode mode)
+    {
+        if (name.empty()) {
+            return;
+        }
+        bool reads = mode == LockMode::shared || mode == LockMode::intent_shared;
+        LockMode intent = reads ? LockMode::intent_shared : LockMode::intent_exclusive;
+        if (name[0] == '/' && name.size() > 1) {
+            put("/", intent);
+        }
+        for (size_t at = name.find('/', 1); at != std::string_view::npos; at = name.find('/', at + 1)) {
+            put(name.substr(0, at), intent);
+        }
+        put(name, mode);
+    }
+
+    bool PathLocks::compatible(const LockSet& set) const
+    {
+        for (const LockSet::Entry& e : set.entries()) {
+            auto it = held_.find(e.name);
+            if (it == held_.end()) {
+                continue;
+            }
+            for (int m = 0; m < 4; ++m) {
+                if (it->second.count[m] != 0 && !compatible_modes(e.mode, static_cast<LockMode>(m))) {
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+
+    void PathLocks::acquire(const LockSet& set)
+    {
+        for (const LockSet::Entry& e : set.entries()) {
+            ++held_[e.name].count[static_cast<int>(e.mode)];
+        }
+    }
+
+    void PathLocks::release(const LockSet& set)
+    {
+        for (const LockSet::Entry& e : set.entries()) {
+            auto it = held_.find(e.name);
+            if (it == held_.end()) {
+                continue;
+            }
+            Holders& h = it->second;
+            --h.count[static_cast<int>(e.mode)];
+            if ((h.count[0] | h.count[1] | h.count[2] | h.count[3]) == 0) {
+                held_.erase(it);
+            }
+        }
+    }
+}
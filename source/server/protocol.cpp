@@ -0,0 +1,626 @@
+#include "../include/protocol.hpp"
+#include "../include/base64.hpp"
+
+#include <charconv>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace ofs::server
+{
+    static constexpr const char* OPERATION_NAMES[] = {
+        "unknown",     "user_login",   "user_logout",   "user_create",   "user_delete",
+        "user_list",   "get_session_info", "file_create", "file_read",   "file_edit",
+        "file_delete", "file_truncate", "file_exists",  "file_rename",   "dir_create",
+        "dir_list",    "dir_delete",   "dir_exists",    "get_metadata",  "set_permissions",
+        "get_stats",   "file_open",    "file_read_next", "file_close"};
+
+    static constexpr size_t OPERATION_COUNT = sizeof(OPERATION_NAMES) / sizeof(OPERATION_NAMES[0]);
+
+    // Operation names are told apart by their length and their first and
+    // sixth characters; the multipliers were searched for a hash with no
+    // collisions in 64 slots, which the static_assert keeps true.
+    static constexpr uint32_t operation_hash(const char* name, size_t len)
+    {
+        return static_cast<uint32_t>(len + static_cast<uint8_t>(name[0]) * 2u + static_cast<uint8_t>(name[5]) * 3u) & 63u;
+    }
+
+    namespace
+    {
+        struct OperationTable
+        {
+            uint8_t slot[64];
+            bool perfect;
+
+            constexpr OperationTable() : slot(), perfect(true)
+            {
+                for (size_t i = 1; i < OPERATION_COUNT; ++i) {
+                    size_t len = 0;
+                    while (OPERATION_NAMES[i][len] != '\0') {
+                        ++len;
+                    }
+                    uint32_t h = operation_hash(OPERATION_NAMES[i], len);
+                    perfect = perfect && slot[h] == 0;
+                    slot[h] = static_cast<uint8_t>(i);
+                }
+            }
+        };
+
+        constexpr OperationTable OPERATION_TABLE{};
+        static_assert(OPERATION_TABLE.perfect, "operation names collide in the perfect hash");
+    }
+
+    Operation operation_from_name(std::string_view name)
+    {
+        if (name.size() < 6) {
+            return Operation::unknown;
+        }
+        uint8_t i = OPERATION_TABLE.slot[operation_hash(name.data(), name.size())];
+        return i != 0 && name == OPERATION_NAMES[i] ? static_cast<Operation>(i) : Operation::unknown;
+    }
+
+    const char* operation_name(Operation op)
+    {
+        size_t i = static_cast<size_t>(op);
+        return i < OPERATION_COUNT ? OPERATION_NAMES[i] : OPERATION_NAMES[0];
+    }
+
+    const std::string_view* Request::param(std::string_view key) const
+    {
+        for (size_t i = 0; i < param_count; ++i) {
+            if (params[i].key == key) {
+                return &params[i].value;
+            }
+        }
+        return nullptr;
+    }
+
+    const char* error_message(OFSErrorCodes code)
+    {
+        switch (code) {
+        case OFSErrorCodes::SUCCESS: return "Success";
+        case OFSErrorCodes::ERROR_NOT_FOUND: return "Not found";
+        case OFSErrorCodes::ERROR_PERMISSION_DENIED: return "Permission denied";
+        case OFSErrorCodes::ERROR_IO_ERROR: return "I/O error";
+        case OFSErrorCodes::ERROR_INVALID_PATH: return "Invalid path";
+        case OFSErrorCodes::ERROR_FILE_EXISTS: return "Already exists";
+        case OFSErrorCodes::ERROR_NO_SPACE: return "No space left";
+        case OFSErrorCodes::ERROR_INVALID_CONFIG: return "Invalid configuration";
+        case OFSErrorCodes::ERROR_NOT_IMPLEMENTED: return "Not implemented";
+        case OFSErrorCodes::ERROR_INVALID_SESSION: return "Invalid or expired session";
+        case OFSErrorCodes::ERROR_DIRECTORY_NOT_EMPTY: return "Directory not empty";
+        case OFSErrorCodes::ERROR_INVALID_OPERATION: return "Invalid operation";
+        }
+        return "Unknown error";
+    }
+
+    // First byte in [p, end) that ends a plain run of string content: a
+    // quote, a backslash or a control character.
+    static const char* scan_plain(const char* p, const char* end)
+    {
+#if defined(__SSE2__)
+        const __m128i quote = _mm_set1_epi8('"');
+        const __m128i backslash = _mm_set1_epi8('\\');
+        const __m128i ctrl = _mm_set1_epi8(0x1F);
+        while (end - p >= 16) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+            __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, quote), _mm_cmpeq_epi8(v, backslash)),
+                                       _mm_cmpeq_epi8(_mm_max_epu8(v, ctrl), ctrl));
+            int mask = _mm_movemask_epi8(hit);
+            if (mask != 0) {
+                return p + __builtin_ctz(static_cast<unsigned>(mask));
+            }
+            p += 16;
+        }
+#endif
+        while (p < end && *p != '"' && *p != '\\' && static_cast<unsigned char>(*p) >= 0x20) {
+            ++p;
+        }
+        return p;
+    }
+
+    // ------------------------------------------------------------------
+    // Framing
+    // ------------------------------------------------------------------
+
+    bool FrameScanner::next(const char* base, size_t len, size_t& begin, size_t& end)
+    {
+        const char* p = base + pos_;
+        const char* stop = base + len;
+        while (p < stop) {
+            if (!in_frame_) {
+                char c = *p;
+                if (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+                    ++p;
+                    continue;
+                }
+                in_frame_ = true;
+                start_ = static_cast<size_t>(p - base);
+                garbage_ = c != '{';
+                depth_ = 0;
+            }
+            if (garbage_) {
+                const void* nl = std::memchr(p, '\n', static_cast<size_t>(stop - p));
+                if (nl == nullptr) {
+                    p = stop;
+                    break;
+                }
+                size_t at = static_cast<size_t>(static_cast<const char*>(nl) - base);
+                begin = start_;
+                end = at > start_ && base[at - 1] == '\r' ? at - 1 : at;
+                pos_ = at + 1;
+                in_frame_ = false;
+                return true;
+            }
+            if (in_string_) {
+                if (escape_) {
+                    escape_ = false;
+                    ++p;
+                    continue;
+                }
+                p = scan_plain(p, stop);
+                if (p == stop) {
+                    break;
+                }
+                if (*p == '"') {
+                    in_string_ = false;
+                } else if (*p == '\\') {
+                    escape_ = true;
+                }
+                ++p;
+                continue;
+            }
+            char c = *p++;
+            if (c == '"') {
+                in_string_ = true;
+            } else if (c == '{' || c == '[') {
+                ++depth_;
+            } else if ((c == '}' || c == ']') && --depth_ == 0) {
+                begin = start_;
+                end = static_cast<size_t>(p - base);
+                pos_ = end;
+                in_frame_ = false;
+                return true;
+            }
+        }
+        pos_ = static_cast<size_t>(p - base);
+        return false;
+    }
+
+    // ------------------------------------------------------------------
+    // Parser
+    // ------------------------------------------------------------------
+
+    namespace
+    {
+        // Works in place: unescaped strings are written back over their
+        // source, which is never shorter, and returned as views of it.
+        struct Cursor
+        {
+            char* p;
+            char* end;
+            const char*& err;
+
+            bool fail(const char* what)
+            {
+                if (err == nullptr) {
+                    err = what;
+                }
+                return false;
+            }
+
+            void skip_ws()
+            {
+                while (p < end && (*p == ' ' || *p == '\t' || *p == '\r' || *p == '\n')) {
+                    ++p;
+                }
+            }
+
+            bool expect(char c)
+            {
+                skip_ws();
+                if (p == end || *p != c) {
+                    return false;
+                }
+                ++p;
+                return true;
+            }
+
+            static void put_utf8(char*& w, uint32_t cp)
+            {
+                if (cp < 0x80) {
+                    *w++ = static_cast<char>(cp);
+                } else if (cp < 0x800) {
+                    *w++ = static_cast<char>(0xC0 | (cp >> 6));
+                    *w++ = static_cast<char>(0x80 | (cp & 0x3F));
+                } else if (cp < 0x10000) {
+                    *w++ = static_cast<char>(0xE0 | (cp >> 12));
+                    *w++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                    *w++ = static_cast<char>(0x80 | (cp & 0x3F));
+                } else {
+                    *w++ = static_cast<char>(0xF0 | (cp >> 18));
+                    *w++ = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                    *w++ = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                    *w++ = static_cast<char>(0x80 | (cp & 0x3F));
+                }
+            }
+
+            bool hex4(uint32_t& cp)
+            {
+                if (end - p < 4) {
+                    return false;
+                }
+                cp = 0;
+                for (int i = 0; i < 4; ++i, ++p) {
+                    char c = *p;
+                    cp <<= 4;
+                    if (c >= '0' && c <= '9') cp |= static_cast<uint32_t>(c - '0');
+                    else if (c >= 'a' && c <= 'f') cp |= static_cast<uint32_t>(c - 'a' + 10);
+                    else if (c >= 'A' && c <= 'F') cp |= static_cast<uint32_t>(c - 'A' + 10);
+                    else return false;
+                }
+                return true;
+            }
+
+            bool string(std::string_view& out)
+            {
+                if (!expect('"')) {
+                    return fail("expected a string");
+                }
+                char* start = p;
+                char* w = p;
+                while (p < end) {
+                    char* run = const_cast<char*>(scan_plain(p, end));
+                    if (w != p) {
+                        std::memmove(w, p, static_cast<size_t>(run - p));
+                    }
+                    w += run - p;
+                    p = run;
+                    if (p == end) {
+                        break;
+                    }
+                    char c = *p++;
+                    if (c == '"') {
+                        out = std::string_view(start, static_cast<size_t>(w - start));
+                        return true;
+                    }
+                    if (c != '\\') {
+                        return fail("control character in string");
+                    }
+                    if (p == end) {
+                        break;
+                    }
+                    switch (*p++) {
+                    case '"': *w++ = '"'; break;
+                    case '\\': *w++ = '\\'; break;
+                    case '/': *w++ = '/'; break;
+                    case 'b': *w++ = '\b'; break;
+                    case 'f': *w++ = '\f'; break;
+                    case 'n': *w++ = '\n'; break;
+                    case 'r': *w++ = '\r'; break;
+                    case 't': *w++ = '\t'; break;
+                    case 'u': {
+                        uint32_t cp;
+                        if (!hex4(cp)) {
+                            return fail("bad \\u escape");
+                        }
+                        if (cp >= 0xD800 && cp < 0xDC00) {
+                            uint32_t low;
+                            if (end - p < 6 || p[0] != '\\' || p[1] != 'u') {
+                                return fail("unpaired surrogate");
+                            }
+                            p += 2;
+                            if (!hex4(low) || low < 0xDC00 || low >= 0xE000) {
+                                return fail("unpaired surrogate");
+                            }
+                            cp = 0x10000 + ((cp - 0xD800) << 10) + (low - 0xDC00);
+                        }
+                        put_utf8(w, cp);
+                        break;
+                    }
+                    default:
+                        return fail("bad escape");
+                    }
+                }
+                return fail("unterminated string");
+            }
+
+            // A string, number or literal, as text.
+            bool scalar(std::string_view& out)
+            {
+                skip_ws();
+                if (p == end) {
+                    return fail("expected a value");
+                }
+                if (*p == '"') {
+                    return string(out);
+                }
+                char* start = p;
+                if (*p == '-' || (*p >= '0' && *p <= '9')) {
+                    ++p;
+                    while (p < end && ((*p >= '0' && *p <= '9') || *p == '.' || *p == 'e' || *p == 'E' ||
+                                       *p == '+' || *p == '-')) {
+                        ++p;
+                    }
+                } else {
+                    for (const char* lit : {"true", "false", "null"}) {
+                        size_t n = std::strlen(lit);
+                        if (static_cast<size_t>(end - p) >= n && std::memcmp(p, lit, n) == 0) {
+                            p += n;
+                            break;
+                        }
+                    }
+                    if (p == start) {
+                        return fail("expected a value");
+                    }
+                }
+                out = std::string_view(start, static_cast<size_t>(p - start));
+                return true;
+            }
+
+            // Skips any value, including nested objects and arrays.
+            bool skip_value(int depth)
+            {
+                skip_ws();
+                if (depth > 32) {
+                    return fail("nesting too deep");
+                }
+                std::string_view scratch;
+                if (p < end && (*p == '{' || *p == '[')) {
+                    char close = *p == '{' ? '}' : ']';
+                    bool object = *p == '{';
+                    ++p;
+                    if (expect(close)) {
+                        return true;
+                    }
+                    do {
+                        if (object && (!string(scratch) || !expect(':'))) {
+                            return fail("bad object member");
+                        }
+                        if (!skip_value(depth + 1)) {
+                            return false;
+                        }
+                    } while (expect(','));
+                    return expect(close) || fail("unterminated object or array");
+                }
+                return scalar(scratch);
+            }
+        };
+    }
+
+    bool parse_request(char* frame, size_t len, Request& out, const char*& err)
+    {
+        err = nullptr;
+        out.op = Operation::unknown;
+        out.operation = {};
+        out.session_id = {};
+        out.request_id = {};
+        out.param_count = 0;
+        Cursor c{frame, frame + len, err};
+
+        if (!c.expect('{')) {
+            return c.fail("request is not a JSON object");
+        }
+        std::string_view key;
+        if (!c.expect('}')) {
+            do {
+                if (!c.string(key) || !c.expect(':')) {
+                    return c.fail("bad member");
+                }
+                if (key == "operation") {
+                    if (!c.string(out.operation)) {
+                        return false;
+                    }
+                } else if (key == "session_id") {
+                    if (!c.scalar(out.session_id)) {
+                        return false;
+                    }
+                    if (out.session_id == "null") {
+                        out.session_id = {};
+                    }
+                } else if (key == "request_id") {
+                    if (!c.scalar(out.request_id)) {
+                        return false;
+                    }
+                } else if (key == "parameters") {
+                    if (!c.expect('{')) {
+                        return c.fail("parameters must be an object");
+                    }
+                    if (!c.expect('}')) {
+                        do {
+                            if (out.param_count == Request::MAX_PARAMS) {
+                                return c.fail("too many parameters");
+                            }
+                            Request::Param& p = out.params[out.param_count];
+                            if (!c.string(p.key) || !c.expect(':') || !c.scalar(p.value)) {
+                                return c.fail("bad parameter");
+                            }
+                            ++out.param_count;
+                        } while (c.expect(','));
+                        if (!c.expect('}')) {
+                            return c.fail("unterminated parameters");
+                        }
+                    }
+                } else if (!c.skip_value(0)) {
+                    return false;
+                }
+            } while (c.expect(','));
+            if (!c.expect('}')) {
+                return c.fail("unterminated request");
+            }
+        }
+        c.skip_ws();
+        if (c.p != c.end) {
+            return c.fail("trailing data after request");
+        }
+
+        out.op = operation_from_name(out.operation);
+        return true;
+    }
+
+    // ------------------------------------------------------------------
+    // Writer
+    // ------------------------------------------------------------------
+
+    JsonWriter::JsonWriter(std::string& out) : out_(out), first_(1), depth_(0), after_key_(false)
+    {
+        // Enough for most responses without a regrowth.
+        if (out_.capacity() < 256) {
+            out_.reserve(256);
+        }
+    }
+
+    void JsonWriter::separate()
+    {
+        if (after_key_) {
+            after_key_ = false;
+            return;
+        }
+        if (depth_ == 0) {
+            return;
+        }
+        uint64_t bit = 1ULL << depth_;
+        if (first_ & bit) {
+            first_ &= ~bit;
+        } else {
+            out_ += ',';
+        }
+    }
+
+    void JsonWriter::begin_object()
+    {
+        separate();
+        out_ += '{';
+        ++depth_;
+        first_ |= 1ULL << depth_;
+    }
+
+    void JsonWriter::end_object()
+    {
+        out_ += '}';
+        --depth_;
+    }
+
+    void JsonWriter::begin_array()
+    {
+        separate();
+        out_ += '[';
+        ++depth_;
+        first_ |= 1ULL << depth_;
+    }
+
+    void JsonWriter::end_array()
+    {
+        out_ += ']';
+        --depth_;
+    }
+
+    void JsonWriter::key(std::string_view k)
+    {
+        separate();
+        escaped(k);
+        out_ += ':';
+        after_key_ = true;
+    }
+
+    void JsonWriter::escaped(std::string_view s)
+    {
+        static constexpr char HEX[] = "0123456789abcdef";
+        out_ += '"';
+        const char* p = s.data();
+        const char* end = p + s.size();
+        while (true) {
+            const char* run = scan_plain(p, end);
+            out_.append(p, static_cast<size_t>(run - p));
+            if (run == end) {
+                break;
+            }
+            unsigned char c = static_cast<unsigned char>(*run);
+            switch (c) {
+            case '"': out_ += "\\\""; break;
+            case '\\': out_ += "\\\\"; break;
+            case '\n': out_ += "\\n"; break;
+            case '\r': out_ += "\\r"; break;
+            case '\t': out_ += "\\t"; break;
+            default:
+                out_ += "\\u00";
+                out_ += HEX[c >> 4];
+                out_ += HEX[c & 0x0F];
+            }
+            p = run + 1;
+        }
+        out_ += '"';
+    }
+
+    void JsonWriter::value(std::string_view v)
+    {
+        separate();
+        escaped(v);
+    }
+
+    void JsonWriter::value(int64_t v)
+    {
+        separate();
+        char buf[24];
+        char* end = std::to_chars(buf, buf + sizeof(buf), v).ptr;
+        out_.append(buf, static_cast<size_t>(end - buf));
+    }
+
+    void JsonWriter::value(uint64_t v)
+    {
+        separate();
+        char buf[24];
+        char* end = std::to_chars(buf, buf + sizeof(buf), v).ptr;
+        out_.append(buf, static_cast<size_t>(end - buf));
+    }
+
+    void JsonWriter::value(double v)
+    {
+        separate();
+        char buf[32];
+        char* end = std::to_chars(buf, buf + sizeof(buf), v, std::chars_format::general, 6).ptr;
+        out_.append(buf, static_cast<size_t>(end - buf));
+    }
+
+    void JsonWriter::value(bool v)
+    {
+        separate();
+        out_ += v ? "true" : "false";
+    }
+
+    void JsonWriter::value_base64(const char* data, size_t len)
+    {
+        separate();
+        size_t at = out_.size();
+        out_.resize(at + base64::encoded_size(len) + 2);
+        out_[at] = '"';
+        base64::encode(reinterpret_cast<const uint8_t*>(data), len, &out_[at + 1]);
+        out_.back() = '"';
+    }
+
+    void JsonWriter::begin_response(bool success, std::string_view operation, std::string_view request_id)
+    {
+        begin_object();
+        key("status");
+        value(success ? "success" : "error");
+        key("operation");
+        value(operation);
+        key("request_id");
+        value(request_id);
+    }
+
+    void write_error(std::string& out, std::string_view operation, std::string_view request_id,
+                     OFSErrorCodes code, std::string_view message)
+    {
+        JsonWriter w(out);
+        w.begin_response(false, operation, request_id);
+        w.key("error_code");
+        w.value(static_cast<int32_t>(code));
+        w.key("error_message");
+        w.value(message.empty() ? std::string_view(error_message(code)) : message);
+        w.end_object();
+        out += '\n';
+    }
+}
@@ -0,0 +1,227 @@
+#include "../include/scheduler.hpp"
+
+namespace ofs::server
+{
+    // The worker the current thread is, if any; submit() from a worker
+    // goes to its own deques.
+    static thread_local const Scheduler* tls_scheduler = nullptr;
+    static thread_local uint32_t tls_worker = 0;
+
+    static int64_t now_ticks()
+    {
+        return std::chrono::steady_clock::now().time_since_epoch().count();
+    }
+
+    const char* priority_name(Priority p)
+    {
+        switch (p) {
+        case Priority::interactive: return "interactive";
+        case Priority::bulk: return "bulk";
+        case Priority::maintenance: return "maintenance";
+        }
+        return "unknown";
+    }
+
+    Scheduler::Scheduler() : timeout_(0), sleepers_(0), stop_(false), expired_(0), stolen_(0), aged_(0)
+    {
+        for (size_t c = 0; c < PRIORITY_COUNT; ++c) {
+            queued_[c] = 0;
+            last_served_[c] = 0;
+            run_count_[c] = 0;
+        }
+    }
+
+    Scheduler::~Scheduler()
+    {
+        stop();
+    }
+
+    void Scheduler::start(uint32_t workers, std::chrono::milliseconds timeout, Runner run)
+    {
+        run_ = std::move(run);
+        timeout_ = timeout;
+        stop_ = false;
+        int64_t now = now_ticks();
+        for (size_t c = 0; c < PRIORITY_COUNT; ++c) {
+            last_served_[c] = now;
+        }
+        workers = std::max<uint32_t>(workers, 1);
+        for (uint32_t i = 0; i < workers; ++i) {
+            workers_.push_back(std::make_unique<Worker>());
+        }
+        // Started only once every deque exists: thieves walk them all.
+        for (uint32_t i = 0; i < workers; ++i) {
+            workers_[i]->thread = std::thread(&Scheduler::worker_loop, this, i);
+        }
+    }
+
+    std::vector<ScheduledWork*> Scheduler::stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(idle_mtx_);
+            stop_ = true;
+        }
+        idle_cv_.notify_all();
+        for (auto& w : workers_) {
+            if (w->thread.joinable()) {
+                w->thread.join();
+            }
+        }
+
+        std::vector<ScheduledWork*> left;
+        for (auto& w : workers_) {
+            for (size_t c = 0; c < PRIORITY_COUNT; ++c) {
+                while (ScheduledWork* item = w->local[c].steal()) {
+                    left.push_back(item);
+                }
+            }
+        }
+        std::lock_guard<std::mutex> lock(inject_mtx_);
+        for (size_t c = 0; c < PRIORITY_COUNT; ++c) {
+            left.insert(left.end(), inject_[c].begin(), inject_[c].end());
+            inject_[c].clear();
+            queued_[c] = 0;
+        }
+        workers_.clear();
+        return left;
+    }
+
+    void Scheduler::submit(ScheduledWork* work)
+    {
+        size_t c = static_cast<size_t>(work->priority);
+        bool local = tls_scheduler == this && workers_[tls_worker]->local[c].push(work);
+        if (!local) {
+            std::lock_guard<std::mutex> lock(inject_mtx_);
+            inject_[c].push_back(work);
+        }
+        // Aging counts from the moment a class has work again, not from
+        // the last time it was served before it went idle.
+        if (queued_[c].fetch_add(1) <= 0) {
+            last_served_[c] = now_ticks();
+        }
+        wake_one();
+    }
+
+    void Scheduler::wake_one()
+    {
+        if (sleepers_.load() > 0) {
+            std::lock_guard<std::mutex> lock(idle_mtx_);
+            idle_cv_.notify_one();
+        }
+    }
+
+    Scheduler::Stats Scheduler::stats() const
+    {
+        Stats s;
+        for (size_t c = 0; c < PRIORITY_COUNT; ++c) {
+            s.run[c] = run_count_[c].load();
+        }
+        s.expired = expired_.load();
+        s.stolen = stolen_.load();
+        s.aged = aged_.load();
+        return s;
+    }
+
+    // Own deque first, then a batch from the injection queue, then the
+    // other workers.
+    ScheduledWork* Scheduler::take(uint32_t self, size_t cls)
+    {
+        Worker& me = *workers_[self];
+        ScheduledWork* item = me.local[cls].steal();
+        if (item == nullptr) {
+            std::lock_guard<std::mutex> lock(inject_mtx_);
+            std::deque<ScheduledWork*>& q = inject_[cls];
+            if (!q.empty()) {
+                item = q.front();
+                q.pop_front();
+                for (size_t i = 1; i < INJECT_BATCH && !q.empty() && me.local[cls].push(q.front()); ++i) {
+                    q.pop_front();
+                }
+            }
+        }
+        if (item == nullptr) {
+            size_t n = workers_.size();
+            for (size_t k = 1; k < n && item == nullptr; ++k) {
+                item = workers_[(self + k) % n]->local[cls].steal();
+            }
+            if (item != nullptr) {
+                ++stolen_;
+            }
+        }
+        if (item != nullptr) {
+            --queued_[cls];
+            last_served_[cls] = now_ticks();
+        }
+        return item;
+    }
+
+    ScheduledWork* Scheduler::next(uint32_t self)
+    {
+        int64_t now = now_ticks();
+        for (size_t c = 1; c < PRIORITY_COUNT; ++c) {
+            auto step = std::chrono::duration_cast<std::chrono::steady_clock::duration>(AGING_STEP).count();
+            if (queued_[c].load() > 0 && now - last_served_[c].load() > step * static_cast<int64_t>(c)) {
+                if (ScheduledWork* item = take(self, c)) {
+                    ++aged_;
+                    return item;
+                }
+            }
+        }
+        for (size_t c = 0; c < PRIORITY_COUNT; ++c) {
+            if (queued_[c].load() > 0) {
+                if (ScheduledWork* item = take(self, c)) {
+                    return item;
+                }
+            }
+        }
+        return nullptr;
+    }
+
+    void Scheduler::worker_loop(uint32_t self)
+    {
+        tls_scheduler = this;
+        tls_worker = self;
+        auto has_work = [this] {
+            for (size_t c = 0; c < PRIORITY_COUNT; ++c) {
+                if (queued_[c].load() > 0) {
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        uint32_t misses = 0;
+        while (!stop_.load()) {
+            ScheduledWork* work = next(self);
+            if (work == nullptr && has_work()) {
+                // Counted but not taken: its owner is popping it, or a
+                // steal lost a race. Yield once, then sleep briefly (a
+                // submit still wakes us) rather than spin on the counters.
+                if (misses++ == 0) {
+                    std::this_thread::yield();
+                } else {
+                    std::unique_lock<std::mutex> lock(idle_mtx_);
+                    ++sleepers_;
+                    idle_cv_.wait_for(lock, MISS_BACKOFF);
+                    --sleepers_;
+                }
+                continue;
+            }
+            misses = 0;
+            if (work == nullptr) {
+                std::unique_lock<std::mutex> lock(idle_mtx_);
+                ++sleepers_;
+                idle_cv_.wait(lock, [&] { return stop_.load() || has_work(); });
+                --sleepers_;
+                continue;
+            }
+            bool expired = timeout_.count() > 0 && std::chrono::steady_clock::now() - work->queued > timeout_;
+            ++run_count_[static_cast<size_t>(work->priority)];
+            if (expired) {
+                ++expired_;
+            }
+            run_(work, expired);
+        }
+        tls_scheduler = nullptr;
+    }
+}
@@ -0,0 +1,1014 @@
+#include "../include/server.hpp"
+#include "../include/coarse_clock.hpp"
+#include "../include/log_macros.hpp"
+#include "../include/slab_pool.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#define MODULE_NAME "SERVER"
+
+namespace ofs::server
+{
+    static constexpr uint64_t TAG_LISTEN = UINT64_MAX;
+    static constexpr uint64_t TAG_WAKE = UINT64_MAX - 1;
+
+    static uint64_t conn_tag(uint32_t idx, uint32_t generation)
+    {
+        return (static_cast<uint64_t>(generation) << 32) | idx;
+    }
+
+    // io_uring user_data: the operation in the top byte; connection
+    // operations carry the slot and the low 24 bits of its generation.
+    enum RingOp : uint64_t
+    {
+        OP_ACCEPT = 1,
+        OP_WAKE,
+        OP_TICK,
+        OP_RECV,
+        OP_SEND
+    };
+
+    static constexpr uint32_t GENERATION_MASK = 0xFFFFFF;
+
+    static uint64_t ring_tag(RingOp op, uint32_t idx = 0, uint32_t generation = 0)
+    {
+        return (static_cast<uint64_t>(op) << 56) | (static_cast<uint64_t>(generation & GENERATION_MASK) << 32) | idx;
+    }
+
+    // ------------------------------------------------------------------
+    // BufferPool
+    // ------------------------------------------------------------------
+
+    BufferPool::BufferPool(size_t chunk, size_t keep) : chunk_(chunk), keep_(keep)
+    {
+    }
+
+    std::vector<char> BufferPool::acquire()
+    {
+        if (free_.empty()) {
+            return std::vector<char>(chunk_);
+        }
+        std::vector<char> buf = std::move(free_.back());
+        free_.pop_back();
+        return buf;
+    }
+
+    void BufferPool::release(std::vector<char>&& buf)
+    {
+        if (free_.size() >= keep_) {
+            return;
+        }
+        if (buf.size() != chunk_) {
+            buf = std::vector<char>(chunk_);
+        }
+        free_.push_back(std::move(buf));
+    }
+
+    // ------------------------------------------------------------------
+    // Outbox
+    // ------------------------------------------------------------------
+
+    void Server::Outbox::post(Item&& item)
+    {
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            if (closed) {
+                return;
+            }
+            wake = items.empty();
+            items.push_back(std::move(item));
+        }
+        // One wakeup per batch: the reactor takes every queued item.
+        if (wake) {
+            uint64_t one = 1;
+            ssize_t n = ::write(wake_fd, &one, sizeof(one));
+            (void)n;
+        }
+    }
+
+    // ------------------------------------------------------------------
+    // Server
+    // ------------------------------------------------------------------
+
+    Server::Server(fs::FileSystem& filesystem, const config::Config& cfg)
+        : fs_(filesystem),
+          cfg_(cfg),
+          dispatcher_(filesystem, sessions_, cfg),
+          listen_fd_(-1),
+          epoll_fd_(-1),
+          port_(0),
+          stopping_(false),
+          accepting_(false),
+          active_(0),
+          buffers_(BUFFER_CHUNK, 2 * std::max<size_t>(cfg.max_connections, 1)),
+          outbox_(std::make_shared<Outbox>()),
+          executor_stop_(false),
+          concurrent_(cfg.execution == "concurrent"),
+          last_tick_(0),
+          use_ring_(false),
+          accept_queued_(false),
+          wake_buf_(0)
+    {
+    }
+
+    Server::~Server()
+    {
+        stop();
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            executor_stop_ = true;
+        }
+        queue_cv_.notify_all();
+        for (std::thread& t : executors_) {
+            t.join();
+        }
+        for (ScheduledWork* work : scheduler_.stop()) {
+            delete static_cast<Task*>(work);
+        }
+        dispatcher_.drain();
+        {
+            std::lock_guard<std::mutex> lock(outbox_->mtx);
+            outbox_->closed = true;
+        }
+        for (uint32_t i = 0; i < conns_.size(); ++i) {
+            if (conns_[i].fd >= 0) {
+                ::close(conns_[i].fd);
+            }
+        }
+        if (listen_fd_ >= 0) {
+            ::close(listen_fd_);
+        }
+        if (epoll_fd_ >= 0) {
+            ::close(epoll_fd_);
+        }
+        if (outbox_->wake_fd >= 0) {
+            ::close(outbox_->wake_fd);
+        }
+    }
+
+    OFSErrorCodes Server::start()
+    {
+        uint32_t max_conns = std::max<uint32_t>(cfg_.max_connections, 1);
+        if (cfg_.io_backend == "io_uring") {
+            use_ring_ = start_ring(max_conns);
+            if (!use_ring_) {
+                LOG_WARN(MODULE_NAME, 105, "io_uring unavailable, serving with epoll");
+            }
+        }
+
+        // Ring operations wait in the kernel; epoll wants non-blocking fds.
+        int nonblock = use_ring_ ? 0 : SOCK_NONBLOCK;
+        listen_fd_ = ::socket(AF_INET, SOCK_STREAM | nonblock | SOCK_CLOEXEC, 0);
+        if (listen_fd_ < 0) {
+            LOG_ERROR(MODULE_NAME, 301, "socket failed: {}", std::strerror(errno));
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        int one = 1;
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_ANY);
+        addr.sin_port = htons(cfg_.port);
+        if (::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0 ||
+            ::listen(listen_fd_, SOMAXCONN) != 0) {
+            LOG_ERROR(MODULE_NAME, 302, "cannot listen on port {}: {}", cfg_.port, std::strerror(errno));
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        socklen_t len = sizeof(addr);
+        ::getsockname(listen_fd_, reinterpret_cast<sockaddr*>(&addr), &len);
+        port_ = ntohs(addr.sin_port);
+
+        outbox_->wake_fd = ::eventfd(0, (use_ring_ ? 0 : EFD_NONBLOCK) | EFD_CLOEXEC);
+        if (outbox_->wake_fd < 0) {
+            LOG_ERROR(MODULE_NAME, 301, "eventfd failed: {}", std::strerror(errno));
+            return OFSErrorCodes::ERROR_IO_ERROR;
+        }
+        if (!use_ring_) {
+            epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+            if (epoll_fd_ < 0) {
+                LOG_ERROR(MODULE_NAME, 301, "epoll_create1 failed: {}", std::strerror(errno));
+                return OFSErrorCodes::ERROR_IO_ERROR;
+            }
+            epoll_event ev{};
+            ev.events = EPOLLIN;
+            ev.data.u64 = TAG_WAKE;
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, outbox_->wake_fd, &ev);
+            ev.data.u64 = TAG_LISTEN;
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, listen_fd_, &ev);
+        }
+        accepting_ = true;
+
+        conns_ = std::vector<Connection>(max_conns);
+        free_conns_.clear();
+        for (uint32_t i = max_conns; i-- > 0;) {
+            free_conns_.push_back(i);
+        }
+        sessions_.init(cfg_.max_sessions, cfg_.session_timeout);
+        uint32_t executors = 1;
+        if (concurrent_) {
+            executors = cfg_.workers != 0 ? cfg_.workers : std::thread::hardware_concurrency();
+            scheduler_.start(executors, std::chrono::seconds(cfg_.queue_timeout),
+                             [this](ScheduledWork* work, bool expired) { run_task(work, expired); });
+            executors = scheduler_.workers();
+        } else {
+            executors_.emplace_back(&Server::executor_loop, this);
+        }
+
+        LOG_INFO(MODULE_NAME, 10, "listening on port {} ({} connections, queue timeout {}s, {}, {} executor{})", port_,
+                 max_conns, cfg_.queue_timeout, use_ring_ ? "io_uring" : "epoll",
+                 concurrent_ ? "concurrent" : "fifo", executors, executors == 1 ? "" : "s");
+        return OFSErrorCodes::SUCCESS;
+    }
+
+    void Server::stop()
+    {
+        stopping_.store(true);
+        if (outbox_->wake_fd >= 0) {
+            uint64_t one = 1;
+            ssize_t n = ::write(outbox_->wake_fd, &one, sizeof(one));
+            (void)n;
+        }
+    }
+
+    void Server::run()
+    {
+        last_tick_ = clock::unix_seconds();
+        if (use_ring_) {
+            run_ring();
+        } else {
+            run_epoll();
+        }
+
+        for (uint32_t i = 0; i < conns_.size(); ++i) {
+            if (conns_[i].fd >= 0) {
+                close_connection(i);
+            }
+        }
+        LOG_INFO(MODULE_NAME, 11, "stopped");
+    }
+
+    // Sessions expire on a one-second tick.
+    void Server::tick()
+    {
+        uint64_t now = clock::unix_seconds();
+        if (now != last_tick_) {
+            last_tick_ = now;
+            sessions_.expire(now);
+        }
+    }
+
+    void Server::run_epoll()
+    {
+        epoll_event events[256];
+        while (!stopping_.load()) {
+            int n = ::epoll_wait(epoll_fd_, events, 256, 1000);
+            if (n < 0 && errno != EINTR) {
+                LOG_ERROR(MODULE_NAME, 303, "epoll_wait failed: {}", std::strerror(errno));
+                break;
+            }
+            for (int i = 0; i < n; ++i) {
+                uint64_t tag = events[i].data.u64;
+                if (tag == TAG_LISTEN) {
+                    accept_clients();
+                    continue;
+                }
+                if (tag == TAG_WAKE) {
+                    drain_outbox();
+                    continue;
+                }
+                uint32_t idx = static_cast<uint32_t>(tag);
+                if (idx >= conns_.size() || conns_[idx].fd < 0 ||
+                    conns_[idx].generation != static_cast<uint32_t>(tag >> 32)) {
+                    continue;
+                }
+                uint32_t ev = events[i].events;
+                if (ev & EPOLLERR) {
+                    close_connection(idx);
+                    continue;
+                }
+                if (ev & (EPOLLIN | EPOLLHUP)) {
+                    on_readable(idx);
+                }
+                if (conns_[idx].fd >= 0 && (ev & EPOLLOUT)) {
+                    on_writable(idx);
+                }
+            }
+            tick();
+        }
+    }
+
+    void Server::set_accepting(bool on)
+    {
+        if (use_ring_) {
+            accepting_ = on;
+            queue_accept();
+            return;
+        }
+        if (accepting_ == on) {
+            return;
+        }
+        accepting_ = on;
+        epoll_event ev{};
+        ev.events = on ? static_cast<uint32_t>(EPOLLIN) : 0u;
+        ev.data.u64 = TAG_LISTEN;
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, listen_fd_, &ev);
+    }
+
+    void Server::accept_clients()
+    {
+        while (!free_conns_.empty()) {
+            int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                if (errno == EINTR || errno == ECONNABORTED) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    LOG_WARN(MODULE_NAME, 104, "accept failed: {}", std::strerror(errno));
+                }
+                return;
+            }
+            open_connection(fd);
+        }
+        // Full: leave new clients in the kernel backlog until a slot frees.
+        LOG_WARN(MODULE_NAME, 101, "{} connections open, not accepting more", active_);
+        set_accepting(false);
+    }
+
+    void Server::open_connection(int fd)
+    {
+        int one = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        uint32_t idx = free_conns_.back();
+        free_conns_.pop_back();
+        Connection& c = conns_[idx];
+        c.fd = fd;
+        c.rx = buffers_.acquire();
+        c.tx = buffers_.acquire();
+        ++active_;
+        if (use_ring_) {
+            ring_.update_file(idx, fd);
+            queue_recv(idx);
+            return;
+        }
+        c.events = EPOLLIN;
+        epoll_event ev{};
+        ev.events = EPOLLIN;
+        ev.data.u64 = conn_tag(idx, c.generation);
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    void Server::set_events(uint32_t idx, uint32_t events)
+    {
+        Connection& c = conns_[idx];
+        if (c.events == events) {
+            return;
+        }
+        c.events = events;
+        epoll_event ev{};
+        ev.events = events;
+        ev.data.u64 = conn_tag(idx, c.generation);
+        ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, c.fd, &ev);
+    }
+
+    void Server::on_readable(uint32_t idx)
+    {
+        Connection& c = conns_[idx];
+        std::vector<Job>& jobs = jobs_;
+        jobs.clear();
+        auto now = std::chrono::steady_clock::now();
+
+        // A few reads per wakeup keep one busy client from starving others.
+        for (int round = 0; round < 4; ++round) {
+            if (c.rx.size() - c.rx_len < BUFFER_CHUNK / 4) {
+                c.rx.resize(std::max(c.rx.size() * 2, c.rx_len + BUFFER_CHUNK));
+            }
+            size_t space = c.rx.size() - c.rx_len;
+            ssize_t n = ::recv(c.fd, c.rx.data() + c.rx_len, space, 0);
+            if (n == 0) {
+                c.peer_closed = true;
+                break;
+            }
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                    close_connection(idx);
+                    return;
+                }
+                break;
+            }
+            c.rx_len += static_cast<size_t>(n);
+            bool drained = static_cast<size_t>(n) < space;
+            if (!take_frames(idx, jobs, now) || drained || c.in_flight >= MAX_IN_FLIGHT) {
+                break;
+            }
+        }
+
+        queue_jobs(jobs);
+        update_interest(idx);
+    }
+
+    // Turns the complete requests in [base, base + len) into jobs, resuming
+    // where the connection's scanner stopped. Returns the bytes consumed.
+    size_t Server::split_frames(uint32_t idx, const char* base, size_t len, std::vector<Job>& jobs,
+                                std::chrono::steady_clock::time_point now)
+    {
+        Connection& c = conns_[idx];
+        SlabPool& pool = SlabPool::get_instance();
+        size_t begin, end;
+        while (c.scanner.next(base, len, begin, end)) {
+            // Pooled: the worker that runs the frame hands it back.
+            std::string frame = pool.acquire(end - begin);
+            frame.assign(base + begin, end - begin);
+            jobs.push_back(Job{idx, c.generation, c.next_seq++, std::move(frame), now, nullptr});
+            ++c.in_flight;
+        }
+        return c.scanner.consumed();
+    }
+
+    // Splits complete requests off the front of rx. False when the pending
+    // request outgrew MAX_FRAME and the connection is being closed.
+    bool Server::take_frames(uint32_t idx, std::vector<Job>& jobs, std::chrono::steady_clock::time_point now)
+    {
+        Connection& c = conns_[idx];
+        size_t start = split_frames(idx, c.rx.data(), c.rx_len, jobs, now);
+        if (start > 0) {
+            std::memmove(c.rx.data(), c.rx.data() + start, c.rx_len - start);
+            c.rx_len -= start;
+            c.scanner.shift(start);
+        }
+
+        if (c.rx_len > MAX_FRAME) {
+            // Answered through the outbox so it queues behind the
+            // requests already split off this read.
+            LOG_WARN(MODULE_NAME, 103, "request larger than {} bytes, closing connection", MAX_FRAME);
+            std::string err;
+            write_error(err, "", "", OFSErrorCodes::ERROR_INVALID_OPERATION, "request too large");
+            ++c.in_flight;
+            outbox_->post(Outbox::Item{idx, c.generation, c.next_seq++, std::move(err), nullptr});
+            c.rx_len = 0;
+            c.scanner = FrameScanner{};
+            c.peer_closed = true;
+            return false;
+        }
+        return true;
+    }
+
+    void Server::queue_jobs(std::vector<Job>& jobs)
+    {
+        if (jobs.empty()) {
+            return;
+        }
+        if (concurrent_) {
+            // Parsed here, outside the queue lock, so that workers can
+            // compare footprints.
+            std::vector<std::unique_ptr<Task>>& tasks = tasks_;
+            tasks.clear();
+            for (Job& job : jobs) {
+                std::unique_ptr<Task> task = std::make_unique<Task>();
+                task->job = std::move(job);
+                std::string& frame = task->job.frame;
+                if (parse_request(frame.data(), frame.size(), task->req, task->err)) {
+                    dispatcher_.footprint(task->req, task->locks);
+                    task->priority = Dispatcher::priority(task->req);
+                }
+                task->queued = task->job.queued;
+                tasks.push_back(std::move(task));
+            }
+            std::vector<Task*> ready;
+            {
+                std::lock_guard<std::mutex> lock(queue_mtx_);
+                for (std::unique_ptr<Task>& task : tasks) {
+                    waiting_.push_back(std::move(task));
+                }
+                admit(ready);
+            }
+            for (Task* t : ready) {
+                scheduler_.submit(t);
+            }
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            for (Job& job : jobs) {
+                queue_.push_back(std::move(job));
+            }
+        }
+        queue_cv_.notify_one();
+    }
+
+    void Server::on_writable(uint32_t idx)
+    {
+        if (flush(idx)) {
+            update_interest(idx);
+        }
+    }
+
+    void Server::drain_outbox()
+    {
+        uint64_t count;
+        ssize_t n = ::read(outbox_->wake_fd, &count, sizeof(count));
+        (void)n;
+        take_outbox();
+    }
+
+    void Server::take_outbox()
+    {
+        // The emptied vector goes back to the outbox, so neither side
+        // allocates once both have grown to the usual batch.
+        std::vector<Outbox::Item>& items = taken_;
+        items.clear();
+        {
+            std::lock_guard<std::mutex> lock(outbox_->mtx);
+            items.swap(outbox_->items);
+        }
+        for (Outbox::Item& item : items) {
+            if (item.conn < conns_.size() && conns_[item.conn].fd >= 0 &&
+                conns_[item.conn].generation == item.generation) {
+                deliver(item.conn, item.seq, std::move(item.text), std::move(item.rest));
+            }
+        }
+    }
+
+    // Queues a response and writes whatever is now in order. With rest
+    // the response is one chunk of a stream, which stays in flight and
+    // holds send_seq until its last chunk.
+    void Server::deliver(uint32_t idx, uint64_t seq, std::string&& text, std::unique_ptr<Dispatcher::Stream> rest)
+    {
+        Connection& c = conns_[idx];
+        if (rest != nullptr) {
+            c.streams.emplace(seq, std::move(rest));
+        } else {
+            --c.in_flight;
+        }
+        if (seq != c.send_seq) {
+            c.ready.emplace(seq, std::move(text));
+            return;
+        }
+
+        auto append = [&c](std::string_view s) {
+            if (c.tx_off > 0) {
+                std::memmove(c.tx.data(), c.tx.data() + c.tx_off, c.tx_len - c.tx_off);
+                c.tx_len -= c.tx_off;
+                c.tx_off = 0;
+            }
+            if (c.tx_len + s.size() > c.tx.size()) {
+                c.tx.resize(std::max(c.tx.size() * 2, c.tx_len + s.size()));
+            }
+            std::memcpy(c.tx.data() + c.tx_len, s.data(), s.size());
+            c.tx_len += s.size();
+        };
+        // Nothing waiting to go out under epoll: send straight from the
+        // response and buffer only what the socket did not take.
+        size_t sent = 0;
+        if (!use_ring_ && c.tx_off == c.tx_len) {
+            while (sent < text.size()) {
+                ssize_t n = ::send(c.fd, text.data() + sent, text.size() - sent, MSG_NOSIGNAL);
+                if (n < 0) {
+                    if (errno == EINTR) {
+                        continue;
+                    }
+                    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                        break;
+                    }
+                    close_connection(idx);
+                    return;
+                }
+                sent += static_cast<size_t>(n);
+            }
+        }
+        append(std::string_view(text).substr(sent));
+        SlabPool& pool = SlabPool::get_instance();
+        pool.release(std::move(text));
+        // A stream keeps send_seq; its later chunks come by resume_stream().
+        while (c.streams.count(c.send_seq) == 0) {
+            ++c.send_seq;
+            auto it = c.ready.begin();
+            if (it == c.ready.end() || it->first != c.send_seq) {
+                break;
+            }
+            append(it->second);
+            pool.release(std::move(it->second));
+            c.ready.erase(it);
+        }
+
+        if (flush(idx)) {
+            update_interest(idx);
+        }
+    }
+
+    // Sends pending output; false if the connection was closed. The ring
+    // reactor only stages the next chunk here and sends it asynchronously.
+    bool Server::flush(uint32_t idx)
+    {
+        Connection& c = conns_[idx];
+        if (use_ring_) {
+            if (c.sending || c.tx_off == c.tx_len) {
+                return true;
+            }
+            size_t n = std::min(c.tx_len - c.tx_off, BUFFER_CHUNK);
+            std::memcpy(ring_tx_.data() + static_cast<size_t>(idx) * BUFFER_CHUNK, c.tx.data() + c.tx_off, n);
+            c.tx_off += n;
+            if (c.tx_off == c.tx_len) {
+                c.tx_off = 0;
+                c.tx_len = 0;
+            }
+            c.staged = n;
+            c.staged_sent = 0;
+            queue_send(idx);
+            return true;
+        }
+        while (c.tx_off < c.tx_len) {
+            ssize_t n = ::send(c.fd, c.tx.data() + c.tx_off, c.tx_len - c.tx_off, MSG_NOSIGNAL);
+            if (n < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    return true;
+                }
+                close_connection(idx);
+                return false;
+            }
+            c.tx_off += static_cast<size_t>(n);
+        }
+        c.tx_off = 0;
+        c.tx_len = 0;
+        return true;
+    }
+
+    void Server::update_interest(uint32_t idx)
+    {
+        Connection& c = conns_[idx];
+        size_t unsent = c.tx_len - c.tx_off + (c.staged - c.staged_sent);
+        if (c.peer_closed && c.in_flight == 0 && unsent == 0) {
+            close_connection(idx);
+            return;
+        }
+        resume_stream(idx, unsent);
+        bool want_read = !c.peer_closed && c.in_flight < MAX_IN_FLIGHT && unsent < SEND_HIGH_WATER;
+        if (use_ring_) {
+            // Sends are queued by flush(); a receive is queued again only
+            // once the previous one has completed.
+            if (want_read && !c.reading) {
+                queue_recv(idx);
+            }
+            return;
+        }
+        uint32_t events = 0;
+        if (want_read) {
+            events |= EPOLLIN;
+        }
+        if (unsent != 0) {
+            events |= EPOLLOUT;
+        }
+        set_events(idx, events);
+    }
+
+    // Queues the next chunk of the stream that is the connection's next
+    // response, once less than a window of output waits to be sent.
+    void Server::resume_stream(uint32_t idx, size_t unsent)
+    {
+        Connection& c = conns_[idx];
+        auto it = c.streams.find(c.send_seq);
+        if (it == c.streams.end() || unsent >= cfg_.stream_window) {
+            return;
+        }
+        Job job{idx, c.generation, c.send_seq, std::string(), std::chrono::steady_clock::now(), std::move(it->second)};
+        c.streams.erase(it);
+        if (concurrent_) {
+            // No locks: a chunk fails if the file changed since the open.
+            std::unique_ptr<Task> task = std::make_unique<Task>();
+            task->job = std::move(job);
+            task->priority = Priority::bulk;
+            task->queued = task->job.queued;
+            scheduler_.submit(task.release());
+            return;
+        }
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            queue_.push_back(std::move(job));
+        }
+        queue_cv_.notify_one();
+    }
+
+    void Server::close_connection(uint32_t idx)
+    {
+        Connection& c = conns_[idx];
+        if (use_ring_) {
+            // Completes the queued receive and send; the slot (its file
+            // index and buffers) is reused only after both have come back.
+            ::shutdown(c.fd, SHUT_RDWR);
+            ring_.update_file(idx, -1);
+        } else {
+            ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, c.fd, nullptr);
+        }
+        ::close(c.fd);
+        buffers_.release(std::move(c.rx));
+        buffers_.release(std::move(c.tx));
+
+        uint32_t generation = c.generation + 1;
+        c = Connection{};
+        c.generation = generation;
+        if (use_ring_ && ring_ops_[idx] != 0) {
+            c.parked = true;
+        } else {
+            free_conns_.push_back(idx);
+        }
+        --active_;
+        if (!stopping_.load()) {
+            set_accepting(true);
+        }
+    }
+
+    void Server::executor_loop()
+    {
+        for (;;) {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(queue_mtx_);
+                queue_cv_.wait(lock, [this] { return executor_stop_ || !queue_.empty(); });
+                if (executor_stop_) {
+                    return;
+                }
+                job = std::move(queue_.front());
+                queue_.pop_front();
+            }
+            const auto timeout = std::chrono::seconds(cfg_.queue_timeout);
+            bool expired = cfg_.queue_timeout != 0 && std::chrono::steady_clock::now() - job.queued > timeout;
+            execute(job, nullptr, nullptr, expired);
+            SlabPool::get_instance().release(std::move(job.frame));
+        }
+    }
+
+    void Server::run_task(ScheduledWork* work, bool expired)
+    {
+        std::unique_ptr<Task> task(static_cast<Task*>(work));
+        execute(task->job, &task->req, task->err, expired);
+        SlabPool::get_instance().release(std::move(task->job.frame));
+        std::vector<Task*> ready;
+        {
+            std::lock_guard<std::mutex> lock(queue_mtx_);
+            held_.release(task->locks);
+            // Released locks may unblock several waiting tasks.
+            admit(ready);
+        }
+        for (Task* t : ready) {
+            scheduler_.submit(t);
+        }
+    }
+
+    // Moves every task in the window that conflicts neither with an
+    // admitted task nor with any task ahead of it to ready, taking its
+    // locks. Called with queue_mtx_ held.
+    void Server::admit(std::vector<Task*>& ready)
+    {
+        ahead_.clear();
+        size_t window = std::min(waiting_.size(), ADMIT_WINDOW);
+        for (size_t i = 0; i < window;) {
+            Task& t = *waiting_[i];
+            if (held_.compatible(t.locks) && ahead_.compatible(t.locks)) {
+                held_.acquire(t.locks);
+                ready.push_back(waiting_[i].release());
+                waiting_.erase(waiting_.begin() + static_cast<std::ptrdiff_t>(i));
+                --window;
+                continue;
+            }
+            ahead_.acquire(t.locks);
+            ++i;
+        }
+    }
+
+    // Runs one job, or answers it with a timeout error when it expired;
+    // req is its parsed request under concurrent execution, nullptr when
+    // the dispatcher should parse the frame itself.
+    void Server::execute(Job& job, const Request* req, const char* err, bool expired)
+    {
+        std::shared_ptr<Outbox> outbox = outbox_;
+        uint32_t conn = job.conn;
+        uint32_t generation = job.generation;
+        uint64_t seq = job.seq;
+        auto reply = [outbox, conn, generation, seq](std::string&& text, std::unique_ptr<Dispatcher::Stream> rest) {
+            outbox->post(Outbox::Item{conn, generation, seq, std::move(text), std::move(rest)});
+        };
+
+        if (job.stream != nullptr) {
+            dispatcher_.resume(std::move(job.stream), reply);
+            return;
+        }
+
+        if (expired) {
+            LOG_WARN(MODULE_NAME, 102, "request waited longer than {}s in the queue", cfg_.queue_timeout);
+            const OFSErrorCodes rc = OFSErrorCodes::ERROR_INVALID_OPERATION;
+            reply(req != nullptr ? Dispatcher::reject(*req, rc, "queue timeout")
+                                 : Dispatcher::reject(job.frame, rc, "queue timeout"),
+                  nullptr);
+            return;
+        }
+        if (req != nullptr) {
+            dispatcher_.handle(*req, err, reply);
+        } else {
+            dispatcher_.handle(job.frame, reply);
+        }
+    }
+
+    // ------------------------------------------------------------------
+    // io_uring reactor
+    // ------------------------------------------------------------------
+
+    bool Server::start_ring(uint32_t max_conns)
+    {
+        // Room for a receive and a send per connection plus accept, wake
+        // and tick, so the ring never has to submit early.
+        if (!ring_.init(std::max<uint32_t>(cfg_.io_queue_depth, 2 * max_conns + 4))) {
+            return false;
+        }
+        std::vector<int> files(max_conns, -1);
+        ring_rx_.assign(static_cast<size_t>(max_conns) * BUFFER_CHUNK, 0);
+        ring_tx_.assign(static_cast<size_t>(max_conns) * BUFFER_CHUNK, 0);
+        std::vector<iovec> iov(max_conns);
+        for (uint32_t i = 0; i < max_conns; ++i) {
+            iov[i].iov_base = ring_rx_.data() + static_cast<size_t>(i) * BUFFER_CHUNK;
+            iov[i].iov_len = BUFFER_CHUNK;
+        }
+        if (!ring_.register_files(files.data(), max_conns) || !ring_.register_buffers(iov.data(), max_conns)) {
+            ring_.close();
+            ring_rx_.clear();
+            ring_tx_.clear();
+            return false;
+        }
+        ring_ops_.assign(max_conns, 0);
+        return true;
+    }
+
+    void Server::run_ring()
+    {
+        ring_.prep_read(outbox_->wake_fd, false, &wake_buf_, sizeof(wake_buf_), 0, ring_tag(OP_WAKE));
+        ring_.prep_timeout(1000, ring_tag(OP_TICK));
+        queue_accept();
+
+        while (!stopping_.load()) {
+            int rc = ring_.submit(1);
+            if (rc < 0 && rc != -EAGAIN && rc != -EBUSY) {
+                LOG_ERROR(MODULE_NAME, 303, "io_uring_enter failed: {}", std::strerror(-rc));
+                break;
+            }
+            IoRing::Completion cqe;
+            while (ring_.pop(cqe)) {
+                on_completion(cqe);
+            }
+            tick();
+        }
+    }
+
+    void Server::on_completion(const IoRing::Completion& cqe)
+    {
+        RingOp op = static_cast<RingOp>(cqe.user_data >> 56);
+        switch (op) {
+        case OP_WAKE:
+            take_outbox();
+            ring_.prep_read(outbox_->wake_fd, false, &wake_buf_, sizeof(wake_buf_), 0, ring_tag(OP_WAKE));
+            return;
+        case OP_TICK:
+            ring_.prep_timeout(1000, ring_tag(OP_TICK));
+            return;
+        case OP_ACCEPT:
+            accept_queued_ = false;
+            if (cqe.res >= 0) {
+                open_connection(cqe.res);
+                if (free_conns_.empty()) {
+                    LOG_WARN(MODULE_NAME, 101, "{} connections open, not accepting more", active_);
+                }
+            } else if (cqe.res != -EINTR && cqe.res != -EAGAIN && cqe.res != -ECONNABORTED) {
+                LOG_WARN(MODULE_NAME, 104, "accept failed: {}", std::strerror(-cqe.res));
+            }
+            queue_accept();
+            return;
+        default:
+            break;
+        }
+
+        uint32_t idx = static_cast<uint32_t>(cqe.user_data);
+        uint32_t generation = static_cast<uint32_t>(cqe.user_data >> 32) & GENERATION_MASK;
+        Connection& c = conns_[idx];
+        --ring_ops_[idx];
+        if (c.fd < 0 || (c.generation & GENERATION_MASK) != generation) {
+            if (c.parked && ring_ops_[idx] == 0) {
+                c.parked = false;
+                free_conns_.push_back(idx);
+                queue_accept();
+            }
+            return;
+        }
+        if (op == OP_RECV) {
+            on_received(idx, cqe.res);
+        } else {
+            on_sent(idx, cqe.res);
+        }
+    }
+
+    void Server::queue_accept()
+    {
+        if (!accepting_ || accept_queued_ || free_conns_.empty() || stopping_.load()) {
+            return;
+        }
+        ring_.prep_accept(listen_fd_, SOCK_CLOEXEC, ring_tag(OP_ACCEPT));
+        accept_queued_ = true;
+    }
+
+    void Server::queue_recv(uint32_t idx)
+    {
+        Connection& c = conns_[idx];
+        ring_.prep_read_fixed(static_cast<int>(idx), true, ring_rx_.data() + static_cast<size_t>(idx) * BUFFER_CHUNK,
+                              static_cast<uint32_t>(BUFFER_CHUNK), static_cast<uint16_t>(idx), 0,
+                              ring_tag(OP_RECV, idx, c.generation));
+        c.reading = true;
+        ++ring_ops_[idx];
+    }
+
+    void Server::queue_send(uint32_t idx)
+    {
+        Connection& c = conns_[idx];
+        const char* chunk = ring_tx_.data() + static_cast<size_t>(idx) * BUFFER_CHUNK;
+        ring_.prep_send(static_cast<int>(idx), true, chunk + c.staged_sent,
+                        static_cast<uint32_t>(c.staged - c.staged_sent), MSG_NOSIGNAL,
+                        ring_tag(OP_SEND, idx, c.generation));
+        c.sending = true;
+        ++ring_ops_[idx];
+    }
+
+    void Server::on_received(uint32_t idx, int32_t res)
+    {
+        Connection& c = conns_[idx];
+        c.reading = false;
+        if (res == 0) {
+            c.peer_closed = true;
+        } else if (res < 0) {
+            if (res != -EINTR && res != -EAGAIN) {
+                close_connection(idx);
+                return;
+            }
+        } else {
+            std::vector<Job>& jobs = jobs_;
+            jobs.clear();
+            auto now = std::chrono::steady_clock::now();
+            const char* data = ring_rx_.data() + static_cast<size_t>(idx) * BUFFER_CHUNK;
+            size_t n = static_cast<size_t>(res);
+            // Nothing buffered: whole requests are taken straight from the
+            // registered chunk and only a trailing partial one is copied.
+            if (c.rx_len == 0) {
+                size_t used = split_frames(idx, data, n, jobs, now);
+                c.scanner.shift(used);
+                data += used;
+                n -= used;
+            }
+            if (n > 0) {
+                if (c.rx.size() - c.rx_len < n) {
+                    c.rx.resize(std::max(c.rx.size() * 2, c.rx_len + n));
+                }
+                std::memcpy(c.rx.data() + c.rx_len, data, n);
+                c.rx_len += n;
+                take_frames(idx, jobs, now);
+            }
+            queue_jobs(jobs);
+        }
+        update_interest(idx);
+    }
+
+    void Server::on_sent(uint32_t idx, int32_t res)
+    {
+        Connection& c = conns_[idx];
+        c.sending = false;
+        if (res < 0 && res != -EINTR && res != -EAGAIN) {
+            close_connection(idx);
+            return;
+        }
+        if (res > 0) {
+            c.staged_sent += static_cast<size_t>(res);
+        }
+        if (c.staged_sent < c.staged) {
+            queue_send(idx);
+            return;
+        }
+        c.staged = 0;
+        c.staged_sent = 0;
+        flush(idx);
+        update_interest(idx);
+    }
+}
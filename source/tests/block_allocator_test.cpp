@@ -0,0 +1,164 @@
+#include "../include/block_allocator.hpp"
+#include "../include/omni_container.hpp"
+#include "../include/logger.hpp"
+#include "test_util.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+using namespace ofs;
+using namespace ofs::storage;
+
+void test_contiguous_and_release(const std::string& path)
+{
+    check(OmniContainer::format(path, make_config(8ULL * 1024 * 1024, 100)) == OFSErrorCodes::SUCCESS, "format");
+    OmniContainer c;
+    check(c.open(path, SyncPolicy::on_shutdown) == OFSErrorCodes::SUCCESS, "open");
+
+    BlockAllocator alloc;
+    check(alloc.attach(c) == OFSErrorCodes::SUCCESS, "attach");
+    uint64_t total = alloc.total_blocks();
+    check(alloc.free_blocks() == total, "fresh container is all free");
+    check(alloc.free_extents() == 1, "fresh container is one free run");
+    check(alloc.fragmentation() == 0.0, "no fragmentation on a fresh container");
+
+    std::vector<Extent> a, b, d;
+    check(alloc.allocate(10, a) == OFSErrorCodes::SUCCESS && a.size() == 1, "10 blocks in one extent");
+    check(a[0].start == 1 && a[0].count == 10, "first fit starts at block 1");
+    check(alloc.allocate(5, b) == OFSErrorCodes::SUCCESS && b.size() == 1 && b[0].start == 11, "next extent follows");
+    check(alloc.allocate(3, d) == OFSErrorCodes::SUCCESS && d[0].start == 16, "third extent follows");
+    check(!alloc.is_free(1) && !alloc.is_free(18) && alloc.is_free(19), "bits set for allocated blocks");
+
+    // Free the middle extent: free space becomes two runs.
+    check(alloc.release(b) == OFSErrorCodes::SUCCESS, "release middle");
+    check(alloc.free_extents() == 2, "hole plus tail are two runs");
+    check(alloc.fragmentation() > 0.0, "fragmentation reported");
+    check(alloc.release(b) == OFSErrorCodes::ERROR_INVALID_OPERATION, "double release rejected");
+
+    // A request that fits the hole reuses it.
+    std::vector<Extent> e;
+    check(alloc.allocate(5, e) == OFSErrorCodes::SUCCESS && e[0].start == 11, "hole reused first fit");
+    check(alloc.free_extents() == 1, "hole filled");
+
+    check(alloc.release(a) == OFSErrorCodes::SUCCESS, "release a");
+    check(alloc.release(e) == OFSErrorCodes::SUCCESS, "release e");
+    check(alloc.release(d) == OFSErrorCodes::SUCCESS, "release d");
+    check(alloc.free_blocks() == total && alloc.free_extents() == 1, "everything coalesces back");
+
+    FSStats stats {};
+    alloc.fill_stats(stats);
+    check(stats.free_space == total * 4096, "stats free space from allocator");
+    check(stats.fragmentation == 0.0, "stats fragmentation from allocator");
+}
+
+void test_fragmented_fallback(const std::string& path)
+{
+    check(OmniContainer::format(path, make_config(4ULL * 1024 * 1024, 100)) == OFSErrorCodes::SUCCESS, "format");
+    OmniContainer c;
+    check(c.open(path, SyncPolicy::on_shutdown) == OFSErrorCodes::SUCCESS, "open");
+    BlockAllocator alloc;
+    alloc.attach(c);
+    uint64_t total = alloc.total_blocks();
+
+    // Fill everything with 1-block extents and free every other one.
+    std::vector<Extent> singles;
+    for (uint64_t i = 0; i < total; ++i)
+    {
+        alloc.allocate(1, singles);
+    }
+    check(alloc.free_blocks() == 0, "container full");
+    std::vector<Extent> none;
+    check(alloc.allocate(1, none) == OFSErrorCodes::ERROR_NO_SPACE && none.empty(), "no space when full");
+
+    for (size_t i = 0; i < singles.size(); i += 2)
+    {
+        alloc.release(singles[i]);
+    }
+    // Also free a run of 4 so the fallback has a largest run to prefer.
+    alloc.release(Extent{singles[101].start, 1});
+    alloc.release(Extent{singles[103].start, 1});
+    uint64_t free_now = alloc.free_blocks();
+    check(alloc.largest_free_extent() == 5, "largest free run is blocks 101..105");
+
+    std::vector<Extent> out;
+    Extent big;
+    check(alloc.allocate_contiguous(8, big) == OFSErrorCodes::ERROR_NO_SPACE, "no contiguous run of 8");
+    check(alloc.allocate(8, out) == OFSErrorCodes::SUCCESS, "fragmented allocation succeeds");
+    uint32_t got = 0;
+    bool has_run = false;
+    for (const Extent& x : out)
+    {
+        got += x.count;
+        has_run = has_run || x.count == 5;
+    }
+    check(got == 8 && has_run, "largest run used first");
+    check(out.size() == 4, "8 blocks from a 5-run and three singles");
+    check(alloc.free_blocks() == free_now - 8, "free count updated");
+}
+
+void test_persistence(const std::string& path)
+{
+    check(OmniContainer::format(path, make_config(4ULL * 1024 * 1024, 100)) == OFSErrorCodes::SUCCESS, "format");
+    uint64_t free_before = 0;
+    {
+        OmniContainer c;
+        c.open(path, SyncPolicy::on_shutdown);
+        BlockAllocator alloc;
+        alloc.attach(c);
+        std::vector<Extent> out;
+        alloc.allocate(20, out);
+        alloc.release(Extent{5, 3});
+        free_before = alloc.free_blocks();
+    }
+
+    OmniContainer c;
+    c.open(path, SyncPolicy::on_shutdown);
+    BlockAllocator alloc;
+    alloc.attach(c);
+    check(alloc.free_blocks() == free_before, "free count rebuilt from the on-disk map");
+    check(alloc.free_extents() == 2, "hole and tail survive a reopen");
+    check(alloc.is_free(5) && !alloc.is_free(4) && !alloc.is_free(20), "bits survive a reopen");
+}
+
+void test_large_scan(const std::string& path)
+{
+    // 16 GiB sparse container: ~4M blocks, three summary levels.
+    check(OmniContainer::format(path, make_config(16ULL * 1024 * 1024 * 1024, 100)) == OFSErrorCodes::SUCCESS, "format large");
+    OmniContainer c;
+    check(c.open(path, SyncPolicy::on_shutdown) == OFSErrorCodes::SUCCESS, "open large");
+    BlockAllocator alloc;
+    alloc.attach(c);
+    uint64_t total = alloc.total_blocks();
+
+    // Use everything but the last block, then find it.
+    std::vector<Extent> out;
+    check(alloc.allocate(static_cast<uint32_t>(total - 1), out) == OFSErrorCodes::SUCCESS, "allocate all but one");
+
+    auto t0 = std::chrono::steady_clock::now();
+    std::vector<Extent> last;
+    for (int i = 0; i < 1000; ++i)
+    {
+        last.clear();
+        alloc.allocate(1, last, 1);
+        alloc.release(last);
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    check(!last.empty() && last[0].start == total, "last block found from the start hint");
+    std::cout << "find last free of " << total << " blocks: " << ns / 1000 << " ns per alloc+free\n";
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/block_allocator_test.log");
+
+    const std::string path = "block_allocator_test.omni";
+    test_contiguous_and_release(path);
+    test_fragmented_fallback(path);
+    test_persistence(path);
+    test_large_scan(path);
+    std::filesystem::remove(path);
+
+    return report("block allocator");
+}
@@ -0,0 +1,377 @@
+#include "../include/block_cache.hpp"
+#include "../include/file_system.hpp"
+#include "../include/logger.hpp"
+#include "test_util.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <filesystem>
+#include <iostream>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ofs;
+using namespace ofs::storage;
+
+static std::string random_bytes(std::mt19937& rng, size_t len)
+{
+    std::string s(len, '\0');
+    for (char& c : s) {
+        c = static_cast<char>(rng() & 0xFF);
+    }
+    return s;
+}
+
+// A cache over a byte vector standing in for the container.
+struct Disk
+{
+    static constexpr uint32_t BLOCK = 512;
+    std::vector<uint8_t> bytes;
+    std::atomic<size_t> reads{0};
+    std::atomic<size_t> writes{0};
+
+    explicit Disk(size_t blocks) : bytes((blocks + 1) * BLOCK)
+    {
+        for (size_t i = 0; i < bytes.size(); ++i) {
+            bytes[i] = static_cast<uint8_t>(i * 7 + (i >> 9));
+        }
+    }
+
+    BlockCache::Transfer reader()
+    {
+        return [this](const IoSegment* segs, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                std::memcpy(segs[i].data, bytes.data() + segs[i].offset, segs[i].len);
+            }
+            ++reads;
+            return OFSErrorCodes::SUCCESS;
+        };
+    }
+
+    BlockCache::Transfer writer()
+    {
+        return [this](const IoSegment* segs, size_t count) {
+            for (size_t i = 0; i < count; ++i) {
+                std::memcpy(bytes.data() + segs[i].offset, segs[i].data, segs[i].len);
+            }
+            ++writes;
+            return OFSErrorCodes::SUCCESS;
+        };
+    }
+};
+
+static bool read_block(BlockCache& cache, uint32_t block, std::vector<uint8_t>& out)
+{
+    out.resize(Disk::BLOCK);
+    IoSegment seg{static_cast<uint64_t>(block) * Disk::BLOCK, out.data(), Disk::BLOCK};
+    return cache.read(&seg, 1) == OFSErrorCodes::SUCCESS;
+}
+
+void test_scan_resistance()
+{
+    // 32 frames are one shard: A1in keeps 8 of them, the ghost list 16.
+    Disk disk(2000);
+    BlockCache cache(Disk::BLOCK, Disk::BLOCK, 32 * Disk::BLOCK, disk.reader(), disk.writer(), 60000);
+    std::vector<uint8_t> out;
+
+    auto read_range = [&](uint32_t first, uint32_t count) {
+        for (uint32_t b = first; b < first + count; ++b) {
+            read_block(cache, b, out);
+        }
+    };
+
+    // Eight hot blocks, read again after falling out of A1in, move to Am.
+    read_range(1, 8);
+    read_range(100, 32);
+    read_range(1, 8);
+    BlockCache::Stats before = cache.stats();
+
+    // A scan ten times the size of the cache.
+    read_range(1000, 320);
+    read_range(1, 8);
+    BlockCache::Stats after = cache.stats();
+    check(after.hits - before.hits == 8, "hot blocks survive a long scan");
+    check(after.evictions - before.evictions >= 320, "the scan went through A1in");
+
+    bool same = true;
+    for (uint32_t b = 1; b <= 8; ++b) {
+        read_block(cache, b, out);
+        same &= std::memcmp(out.data(), disk.bytes.data() + b * Disk::BLOCK, Disk::BLOCK) == 0;
+    }
+    check(same, "cached blocks hold the container bytes");
+}
+
+void test_write_back()
+{
+    Disk disk(256);
+    BlockCache cache(Disk::BLOCK, Disk::BLOCK, 64 * Disk::BLOCK, disk.reader(), disk.writer(), 60000);
+    std::vector<uint8_t> model = disk.bytes;
+
+    // 16 neighbouring blocks in one call, and a partial write elsewhere.
+    std::vector<uint8_t> data(16 * Disk::BLOCK, 0xAB);
+    IoSegment seg{10 * Disk::BLOCK, data.data(), data.size()};
+    cache.write(&seg, 1);
+    std::memcpy(model.data() + seg.offset, data.data(), data.size());
+    uint8_t small[7] = {1, 2, 3, 4, 5, 6, 7};
+    IoSegment part{50 * Disk::BLOCK + 100, small, sizeof(small)};
+    cache.write(&part, 1);
+    std::memcpy(model.data() + part.offset, small, sizeof(small));
+
+    check(disk.bytes != model && disk.writes == 0, "writes stay in the cache");
+    check(cache.stats().dirty == 17, "17 blocks are dirty");
+
+    // Reading a partially written block fills the rest from the container.
+    std::vector<uint8_t> out;
+    read_block(cache, 50, out);
+    check(std::memcmp(out.data(), model.data() + 50 * Disk::BLOCK, Disk::BLOCK) == 0,
+          "a partial write reads back over the container bytes");
+
+    // A ranged flush only writes what it covers.
+    cache.flush(50 * Disk::BLOCK, Disk::BLOCK);
+    check(disk.writes == 1 && cache.stats().dirty == 16, "ranged flush writes one block");
+
+    cache.flush();
+    check(disk.bytes == model, "flush writes everything back");
+    BlockCache::Stats st = cache.stats();
+    check(st.write_backs == 17 && st.flushes == 2, "neighbouring dirty blocks go out in one writer call");
+
+    // A discarded block is not written back.
+    cache.write(&part, 1);
+    small[0] = 99;
+    cache.write(&part, 1);
+    cache.discard(50, 1);
+    cache.flush();
+    check(disk.bytes[part.offset] == 1, "discarded blocks are dropped");
+
+    // Evicting a dirty frame writes it back first.
+    std::vector<uint8_t> fill(Disk::BLOCK);
+    for (uint32_t b = 100; b < 250; ++b) {
+        std::memset(fill.data(), static_cast<int>(b), fill.size());
+        IoSegment s{static_cast<uint64_t>(b) * Disk::BLOCK, fill.data(), fill.size()};
+        cache.write(&s, 1);
+    }
+    check(disk.bytes[100 * Disk::BLOCK] == 100, "evicted dirty blocks are written back");
+    cache.flush();
+    check(disk.bytes[249 * Disk::BLOCK] == 249 && cache.stats().dirty == 0, "nothing is left dirty");
+}
+
+void test_read_ahead()
+{
+    Disk disk(2000);
+    BlockCache cache(Disk::BLOCK, Disk::BLOCK, 256 * Disk::BLOCK, disk.reader(), disk.writer(), 60000, 32, 2000);
+    std::vector<uint8_t> out;
+
+    // A reader going through 400 blocks one at a time, slowly enough for
+    // the worker to stay ahead.
+    bool same = true;
+    for (uint32_t b = 1; b <= 400; ++b) {
+        read_block(cache, b, out);
+        same &= std::memcmp(out.data(), disk.bytes.data() + b * Disk::BLOCK, Disk::BLOCK) == 0;
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    BlockCache::Stats st = cache.stats();
+    check(same, "read-ahead blocks hold the container bytes");
+    check(st.read_ahead >= 350 && st.read_ahead_hits >= 350, "a sequential reader is read ahead of");
+    check(disk.reads < 80, "read-ahead reads blocks in batches");
+
+    // Reads 97 blocks apart never continue one another.
+    Disk other(2000);
+    BlockCache scattered(Disk::BLOCK, Disk::BLOCK, 256 * Disk::BLOCK, other.reader(), other.writer(), 60000, 32,
+                         2000);
+    for (uint32_t i = 0; i < 400; ++i) {
+        read_block(scattered, 1 + (i * 97) % 1990, out);
+        std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+    check(scattered.stats().read_ahead == 0, "scattered reads are not read ahead of");
+}
+
+void test_read_ahead_race()
+{
+    // The worker's read of blocks 3-6 is held until a large write has
+    // gone around the cache over them; the old bytes it read must not be
+    // installed.
+    Disk disk(256);
+    std::thread::id main = std::this_thread::get_id();
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool reading = false;
+    bool written = false;
+    BlockCache::Transfer plain = disk.reader();
+    BlockCache::Transfer held = [&](const IoSegment* segs, size_t count) {
+        OFSErrorCodes rc = plain(segs, count);
+        if (std::this_thread::get_id() != main) {
+            std::unique_lock<std::mutex> lock(mtx);
+            reading = true;
+            cv.notify_all();
+            cv.wait(lock, [&] { return written; });
+        }
+        return rc;
+    };
+    BlockCache cache(Disk::BLOCK, Disk::BLOCK, 64 * Disk::BLOCK, held, disk.writer(), 60000, 32, 250);
+
+    std::vector<uint8_t> out;
+    read_block(cache, 1, out);
+    read_block(cache, 2, out);
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        check(cv.wait_for(lock, std::chrono::seconds(5), [&] { return reading; }), "the stream is read ahead of");
+    }
+
+    std::vector<uint8_t> big(40 * Disk::BLOCK, 0x3C);
+    IoSegment seg{3 * Disk::BLOCK, big.data(), big.size()};
+    cache.write(&seg, 1);
+    check(cache.stats().bypassed == 1, "the write goes around the cache");
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        written = true;
+    }
+    cv.notify_all();
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    bool fresh = true;
+    for (uint32_t b = 3; b <= 6; ++b) {
+        read_block(cache, b, out);
+        fresh &= out == std::vector<uint8_t>(Disk::BLOCK, 0x3C);
+    }
+    check(fresh, "a read-ahead that raced a write-around leaves no stale blocks");
+}
+
+void test_large_transfers()
+{
+    // 64 frames: A1in holds 16 blocks, so 40 go around the cache.
+    Disk disk(256);
+    BlockCache cache(Disk::BLOCK, Disk::BLOCK, 64 * Disk::BLOCK, disk.reader(), disk.writer(), 60000);
+    std::vector<uint8_t> model = disk.bytes;
+
+    // A dirty block the large write only partly covers.
+    uint8_t small[5] = {9, 9, 9, 9, 9};
+    IoSegment part{20 * Disk::BLOCK + 10, small, sizeof(small)};
+    cache.write(&part, 1);
+    std::memcpy(model.data() + part.offset, small, sizeof(small));
+
+    std::vector<uint8_t> big(40 * Disk::BLOCK, 0x5A);
+    IoSegment seg{20 * Disk::BLOCK + 100, big.data(), big.size()};
+    cache.write(&seg, 1);
+    std::memcpy(model.data() + seg.offset, big.data(), big.size());
+    check(disk.writes == 2 && disk.bytes == model, "a large write goes out in one call after the dirty block");
+    check(cache.stats().dirty == 0 && cache.stats().bypassed == 1, "a large write leaves no frames dirty");
+
+    // A large read sees a dirty block inside it.
+    small[0] = 1;
+    IoSegment inside{30 * Disk::BLOCK, small, sizeof(small)};
+    cache.write(&inside, 1);
+    std::memcpy(model.data() + inside.offset, small, sizeof(small));
+    std::vector<uint8_t> out(big.size());
+    IoSegment whole{20 * Disk::BLOCK + 100, out.data(), out.size()};
+    size_t reads = disk.reads;
+    check(cache.read(&whole, 1) == OFSErrorCodes::SUCCESS && disk.reads == reads + 1 &&
+              std::memcmp(out.data(), model.data() + whole.offset, out.size()) == 0,
+          "a large read is one call and sees dirty blocks");
+}
+
+void test_file_system(const std::string& path, const std::string& crashed, const std::string& backend,
+                      const std::string& mapping)
+{
+    std::string label = " (" + backend + ", " + mapping + ")";
+    config::Config cfg = make_config();
+    cfg.io_cache_size = 64 * 4096;
+    cfg.io_backend = backend;
+    cfg.block_mapping = mapping;
+    OmniContainer::format(path, cfg);
+
+    std::mt19937 rng(21);
+    std::vector<std::string> names, contents, flushed;
+    {
+        fs::FileSystem fs;
+        fs.init(path, cfg);
+        check(fs.container().cache() != nullptr, "cache_size sets up a cache" + label);
+
+        // More data than the cache holds, then edits and deletes that free
+        // blocks for reuse.
+        for (int i = 0; i < 12; ++i) {
+            names.push_back("/f" + std::to_string(i));
+            contents.push_back(random_bytes(rng, 10000 + 9000 * i));
+            fs.file_create(names.back(), contents.back().data(), contents.back().size());
+        }
+        for (int i = 0; i < 40; ++i) {
+            size_t f = rng() % names.size();
+            std::string patch = random_bytes(rng, 1 + rng() % 6000);
+            size_t at = rng() % (contents[f].size() + 1);
+            fs.file_edit(names[f], patch.data(), patch.size(), at);
+            if (at + patch.size() > contents[f].size()) {
+                contents[f].resize(at + patch.size());
+            }
+            contents[f].replace(at, patch.size(), patch);
+        }
+
+        // A journal flush writes back the content it covers, so a crash
+        // after it keeps the data.
+        fs.journal().flush();
+        std::filesystem::copy_file(path, crashed, std::filesystem::copy_options::overwrite_existing);
+        flushed = contents;
+
+        for (int i = 0; i < 3; ++i) {
+            fs.file_delete(names[i]);
+            contents[i] = random_bytes(rng, 30000);
+            fs.file_create(names[i], contents[i].data(), contents[i].size());
+        }
+
+        bool same = true;
+        for (size_t i = 0; i < names.size(); ++i) {
+            std::string out;
+            same &= fs.file_read(names[i], out) == OFSErrorCodes::SUCCESS && out == contents[i];
+        }
+        check(same, "content reads back through the cache" + label);
+
+        std::string out;
+        fs.file_read(names[3], out);
+        fs.file_read(names[3], out);
+        FSStats stats;
+        fs.get_stats(stats);
+        check(stats.cache_hits > 0 && stats.cache_misses > 0 && stats.cache_evictions > 0,
+              "get_stats reports hits, misses and evictions" + label);
+
+        fs.shutdown();
+    }
+
+    for (const std::string& p : {path, crashed}) {
+        config::Config plain = cfg;
+        plain.io_cache_size = 0;
+        fs::FileSystem fs;
+        fs.init(p, plain);
+        bool same = fs.container().cache() == nullptr;
+        for (size_t i = 0; i < names.size(); ++i) {
+            std::string out;
+            same &= fs.file_read(names[i], out) == OFSErrorCodes::SUCCESS && out == (p == path ? contents : flushed)[i];
+        }
+        check(same, (p == path ? "content is on disk after shutdown" : "content is on disk after a crash") + label);
+        fs.shutdown();
+    }
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/block_cache_test.log");
+
+    const std::string path = "block_cache_test.omni";
+    const std::string crashed = "block_cache_test_crashed.omni";
+
+    test_scan_resistance();
+    test_write_back();
+    test_read_ahead();
+    test_read_ahead_race();
+    test_large_transfers();
+    test_file_system(path, crashed, "mmap", "extent");
+    test_file_system(path, crashed, "pread", "extent");
+    test_file_system(path, crashed, "pread", "chain");
+    test_file_system(path, crashed, "io_uring", "chain");
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(crashed);
+
+    return report("block cache");
+}
@@ -0,0 +1,169 @@
+#include "../include/block_mapper.hpp"
+#include "../include/omni_container.hpp"
+#include "../include/logger.hpp"
+#include "test_util.hpp"
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+using namespace ofs;
+using namespace ofs::storage;
+
+static config::Config mapper_config(const std::string& mapping, uint32_t block_size)
+{
+    config::Config cfg = make_config(8ULL * 1024 * 1024, 100);
+    cfg.block_size = block_size;
+    cfg.block_mapping = mapping;
+    return cfg;
+}
+
+static std::vector<uint8_t> pattern(size_t len, uint8_t seed)
+{
+    std::vector<uint8_t> v(len);
+    for (size_t i = 0; i < len; ++i)
+    {
+        v[i] = static_cast<uint8_t>(i * 31 + seed);
+    }
+    return v;
+}
+
+void test_round_trip(const std::string& path, const std::string& mapping)
+{
+    const std::string tag = "[" + mapping + "] ";
+    check(OmniContainer::format(path, mapper_config(mapping, 4096)) == OFSErrorCodes::SUCCESS, tag + "format");
+
+    const size_t size = 300000;
+    std::vector<uint8_t> data = pattern(size, 7);
+    uint64_t free_before = 0;
+    MetadataEntry saved {};
+    {
+        OmniContainer c;
+        c.open(path, SyncPolicy::on_shutdown);
+        BlockAllocator alloc;
+        alloc.attach(c);
+        std::unique_ptr<BlockMapper> mapper = BlockMapper::create(c, alloc);
+        check(mapper->kind() == (mapping == "chain" ? BlockMapping::chain : BlockMapping::extent), tag + "mapper matches format");
+        free_before = alloc.free_blocks();
+
+        MetadataEntry e {};
+        uint64_t blocks = mapper->blocks_for_size(size);
+        check(mapper->resize(e, blocks) == OFSErrorCodes::SUCCESS, tag + "resize");
+        check(mapper->block_count(e) == blocks, tag + "block count");
+        check(mapper->write(e, 0, data.data(), size) == OFSErrorCodes::SUCCESS, tag + "write");
+        saved = e;
+    }
+
+    // Reopen: the mapping is read back from the container.
+    OmniContainer c;
+    c.open(path, SyncPolicy::on_shutdown);
+    BlockAllocator alloc;
+    alloc.attach(c);
+    std::unique_ptr<BlockMapper> mapper = BlockMapper::create(c, alloc);
+    MetadataEntry e = saved;
+
+    std::vector<uint8_t> back(size);
+    check(mapper->read(e, 0, back.data(), size) == OFSErrorCodes::SUCCESS && back == data, tag + "read after reopen");
+
+    std::vector<uint8_t> mid(5000);
+    check(mapper->read(e, 123457, mid.data(), mid.size()) == OFSErrorCodes::SUCCESS &&
+          std::equal(mid.begin(), mid.end(), data.begin() + 123457), tag + "random offset read");
+    check(mapper->read(e, size, mid.data(), mapper->payload_size() * 100) != OFSErrorCodes::SUCCESS, tag + "read past mapping fails");
+
+    if (mapping == "extent")
+    {
+        std::vector<Extent> runs;
+        mapper->map_range(e, 0, mapper->block_count(e), runs);
+        check(runs.size() == 1, tag + "fresh file is a single run");
+        check(mapper->payload_size() == 4096, tag + "blocks carry no header");
+    }
+    else
+    {
+        check(mapper->payload_size() == 4092, tag + "chain blocks lose 4 bytes");
+    }
+
+    // Shrink, grow, then release everything.
+    check(mapper->resize(e, 3) == OFSErrorCodes::SUCCESS && mapper->block_count(e) == 3, tag + "shrink");
+    check(mapper->read(e, 0, back.data(), 3 * mapper->payload_size()) == OFSErrorCodes::SUCCESS &&
+          std::equal(back.begin(), back.begin() + 3 * mapper->payload_size(), data.begin()), tag + "prefix kept after shrink");
+    check(mapper->resize(e, 40) == OFSErrorCodes::SUCCESS && mapper->block_count(e) == 40, tag + "grow");
+    check(mapper->release(e) == OFSErrorCodes::SUCCESS && e.start_block == 0, tag + "release");
+    check(alloc.free_blocks() == free_before, tag + "all blocks returned");
+}
+
+void test_two_level_tree(const std::string& path)
+{
+    // 512-byte blocks hold 31 extents per leaf, so a badly fragmented file
+    // needs an index root.
+    check(OmniContainer::format(path, mapper_config("extent", 512)) == OFSErrorCodes::SUCCESS, "format 512");
+    OmniContainer c;
+    c.open(path, SyncPolicy::on_shutdown);
+    BlockAllocator alloc;
+    alloc.attach(c);
+    ExtentMapper mapper(c, alloc);
+
+    std::vector<Extent> fill;
+    alloc.allocate(static_cast<uint32_t>(alloc.free_blocks()), fill);
+    for (uint32_t b = 1; b <= 400; b += 2)
+    {
+        alloc.release(Extent{b, 1});
+    }
+
+    MetadataEntry e {};
+    check(mapper.resize(e, 150) == OFSErrorCodes::SUCCESS, "fragmented resize");
+    std::vector<Extent> runs;
+    check(mapper.map_range(e, 0, 150, runs) == OFSErrorCodes::SUCCESS && runs.size() == 150, "150 single-block extents");
+
+    std::vector<uint8_t> data = pattern(150 * 512, 3);
+    std::vector<uint8_t> back(data.size());
+    mapper.write(e, 0, data.data(), data.size());
+    check(mapper.read(e, 0, back.data(), back.size()) == OFSErrorCodes::SUCCESS && back == data, "two-level read");
+
+    Extent one;
+    check(mapper.map_range(e, 97, 1, runs) == OFSErrorCodes::SUCCESS, "lookup in a later leaf");
+    one = runs.back();
+    check(one.count == 1 && one.start % 2 == 1, "lookup lands on a freed odd block");
+
+    uint64_t free_before = alloc.free_blocks();
+    check(mapper.resize(e, 10) == OFSErrorCodes::SUCCESS, "shrink to one leaf");
+    check(alloc.free_blocks() == free_before + 140 + 5, "data and leaf blocks returned");
+    check(mapper.release(e) == OFSErrorCodes::SUCCESS, "release");
+}
+
+void bench_random_lookup(const std::string& path, const std::string& mapping)
+{
+    OmniContainer::format(path, mapper_config(mapping, 4096));
+    OmniContainer c;
+    c.open(path, SyncPolicy::on_shutdown);
+    BlockAllocator alloc;
+    alloc.attach(c);
+    std::unique_ptr<BlockMapper> mapper = BlockMapper::create(c, alloc);
+
+    MetadataEntry e {};
+    mapper->resize(e, 1500);
+    std::vector<Extent> runs;
+    auto t0 = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < 1500; ++i)
+    {
+        runs.clear();
+        mapper->map_range(e, (i * 7919) % 1500, 1, runs);
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << mapping << ": random block lookup in a 1500-block file: " << ns / 1500 << " ns\n";
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/block_mapper_test.log");
+
+    const std::string path = "block_mapper_test.omni";
+    test_round_trip(path, "chain");
+    test_round_trip(path, "extent");
+    test_two_level_tree(path);
+    bench_random_lookup(path, "chain");
+    bench_random_lookup(path, "extent");
+    std::filesystem::remove(path);
+
+    return report("block mapper");
+}
@@ -0,0 +1,327 @@
+#include "../include/file_system.hpp"
+#include "../include/delta_vault.hpp"
+#include "../include/snapshot.hpp"
+#include "../include/logger.hpp"
+#include "test_util.hpp"
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace ofs;
+using namespace ofs::storage;
+
+static std::string random_bytes(std::mt19937& rng, size_t len)
+{
+    std::string s(len, '\0');
+    for (char& c : s) {
+        c = static_cast<char>(rng() & 0xFF);
+    }
+    return s;
+}
+
+// Hashes of the chunks data is cut into.
+static std::vector<uint64_t> chunk_hashes(const std::string& data)
+{
+    std::vector<uint64_t> out;
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data());
+    for (size_t pos = 0; pos < data.size();) {
+        size_t n = cdc_cut(p + pos, data.size() - pos);
+        out.push_back(snapshot_checksum(p + pos, n));
+        pos += n;
+    }
+    return out;
+}
+
+void test_cdc()
+{
+    std::mt19937 rng(7);
+    std::string data = random_bytes(rng, 1 << 20);
+    const uint8_t* p = reinterpret_cast<const uint8_t*>(data.data());
+
+    bool bounded = true;
+    size_t chunks = 0;
+    for (size_t pos = 0; pos < data.size(); ++chunks) {
+        size_t n = cdc_cut(p + pos, data.size() - pos);
+        bool last = pos + n == data.size();
+        bounded &= n <= CDC_MAX_CHUNK && (last || n >= CDC_MIN_CHUNK);
+        pos += n;
+    }
+    check(bounded, "chunks stay between the minimum and maximum size");
+    size_t avg = data.size() / chunks;
+    check(avg >= CDC_AVG_CHUNK / 2 && avg <= CDC_AVG_CHUNK * 2, "chunks average near CDC_AVG_CHUNK");
+    check(cdc_cut(p, 100) == 100, "short input is one chunk");
+
+    // An insert only changes the chunks around it.
+    std::string edited = data;
+    edited.insert(300000, random_bytes(rng, 100));
+    std::vector<uint64_t> before = chunk_hashes(data);
+    std::vector<uint64_t> after = chunk_hashes(edited);
+    std::set<uint64_t> known(before.begin(), before.end());
+    size_t shared = 0;
+    for (uint64_t h : after) {
+        shared += known.count(h);
+    }
+    check(shared + 3 >= after.size(), "cut points resynchronise after an insert");
+
+    auto t0 = std::chrono::steady_clock::now();
+    size_t total = 0;
+    for (int round = 0; round < 20; ++round) {
+        for (size_t pos = 0; pos < data.size();) {
+            pos += cdc_cut(p + pos, data.size() - pos);
+        }
+        total += data.size();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "cdc: " << chunks << " chunks of 1 MiB, " << static_cast<int>(total / secs / 1e6) << " MB/s\n";
+}
+
+void test_versions(const std::string& path)
+{
+    config::Config cfg = make_config();
+    OmniContainer::format(path, cfg);
+    fs::FileSystem fs;
+    check(fs.init(path, cfg) == OFSErrorCodes::SUCCESS, "init");
+    check(fs.vault().active(), "history is on by default");
+
+    std::mt19937 rng(11);
+    std::vector<std::string> expected;
+    expected.push_back(random_bytes(rng, 200000));
+    fs.file_create("/a", expected.back().data(), expected.back().size());
+    for (int i = 0; i < 20; ++i) {
+        std::string cur = expected.back();
+        // Every fifth edit appends past the end.
+        size_t at = i % 5 == 4 ? cur.size() : rng() % (cur.size() - 100);
+        std::string patch = random_bytes(rng, 1 + rng() % 1000);
+        if (at + patch.size() > cur.size()) {
+            cur.resize(at + patch.size());
+        }
+        cur.replace(at, patch.size(), patch);
+        fs.file_edit("/a", patch.data(), patch.size(), at);
+        expected.push_back(cur);
+    }
+
+    std::vector<FileVersion> versions;
+    check(fs.file_versions("/a", versions) == OFSErrorCodes::SUCCESS && versions.size() == expected.size(),
+          "one version per change");
+    size_t fulls = 0;
+    for (const FileVersion& v : versions) {
+        fulls += v.delta ? 0 : 1;
+    }
+    check(fulls == (expected.size() + cfg.history_full_every - 1) / cfg.history_full_every,
+          "a full version every history_full_every versions");
+
+    bool all = true;
+    for (size_t i = 0; i < expected.size(); ++i) {
+        std::string out;
+        all &= fs.file_read_version("/a", static_cast<uint32_t>(i + 1), out) == OFSErrorCodes::SUCCESS &&
+               out == expected[i];
+    }
+    check(all, "every version reads back as it was");
+
+    std::string out;
+    check(fs.file_read_version("/a", 99, out) == OFSErrorCodes::ERROR_NOT_FOUND, "unknown version");
+    check(fs.file_restore("/a", 3) == OFSErrorCodes::SUCCESS, "restore");
+    fs.file_read("/a", out);
+    check(out == expected[2], "restore writes the old content back");
+    fs.file_versions("/a", versions);
+    check(versions.back().version == expected.size() + 1, "restore is a new version");
+
+    // Truncate records the fill pattern; delete drops the history.
+    fs.file_truncate("/a");
+    fs.file_versions("/a", versions);
+    check(versions.size() == expected.size() + 2, "truncate is a new version");
+    fs.file_delete("/a");
+    check(fs.vault().stats().versions == 0 && fs.vault().stats().chunks == 0, "delete drops the history");
+    fs.shutdown();
+}
+
+void test_dedup(const std::string& path)
+{
+    config::Config cfg = make_config();
+    OmniContainer::format(path, cfg);
+    fs::FileSystem fs;
+    fs.init(path, cfg);
+
+    std::mt19937 rng(3);
+    std::string content = random_bytes(rng, 256 * 1024);
+    FSStats before;
+    fs.get_stats(before);
+    for (int i = 0; i < 10; ++i) {
+        std::string copy = content;
+        copy.replace(rng() % copy.size() / 2, 16, random_bytes(rng, 16));
+        fs.file_create("/copy" + std::to_string(i), copy.data(), copy.size());
+    }
+    DeltaVault::Stats s = fs.vault().stats();
+    check(s.version_bytes == 10 * content.size(), "every copy is a version");
+    check(s.chunk_bytes < 2 * content.size(), "identical chunks are stored once");
+    check(s.dedup_hits > 0, "chunks are shared between files");
+    std::cout << "dedup: " << s.version_bytes << " bytes of versions in " << s.chunk_bytes << " bytes of chunks\n";
+
+    // Deleting every copy returns the history's blocks.
+    for (int i = 0; i < 10; ++i) {
+        fs.file_delete("/copy" + std::to_string(i));
+    }
+    FSStats after;
+    fs.get_stats(after);
+    check(after.free_space + 4 * CDC_MAX_CHUNK >= before.free_space, "freed chunks go back to the allocator");
+    fs.shutdown();
+}
+
+void test_bounded(const std::string& path)
+{
+    // A log of the minimum size keeps only the newest versions.
+    config::Config cfg = make_config();
+    cfg.history_size = CHANGE_LOG_MIN_SIZE;
+    cfg.history_chunks = 64;
+    OmniContainer::format(path, cfg);
+    fs::FileSystem fs;
+    fs.init(path, cfg);
+
+    std::mt19937 rng(5);
+    std::string cur = random_bytes(rng, 100000);
+    fs.file_create("/b", cur.data(), cur.size());
+    for (int i = 0; i < 300; ++i) {
+        std::string patch = random_bytes(rng, 2000);
+        size_t at = rng() % (cur.size() - patch.size());
+        cur.replace(at, patch.size(), patch);
+        fs.file_edit("/b", patch.data(), patch.size(), at);
+    }
+
+    DeltaVault::Stats s = fs.vault().stats();
+    std::vector<FileVersion> versions;
+    fs.file_versions("/b", versions);
+    check(s.dropped > 0 && versions.size() < 301, "old versions are dropped");
+    check(s.log_used <= CHANGE_LOG_MIN_SIZE, "the log stays within history_size");
+    check(s.chunks <= 64, "the chunk table stays within history_chunks");
+    check(!versions.empty() && !versions.front().delta, "the oldest kept version is full");
+    std::string out;
+    check(fs.file_read_version("/b", versions.back().version, out) == OFSErrorCodes::SUCCESS && out == cur,
+          "the newest version matches the file");
+    check(fs.file_read_version("/b", versions.front().version, out) == OFSErrorCodes::SUCCESS,
+          "the oldest kept version reads");
+    fs.shutdown();
+}
+
+void test_space_pressure(const std::string& path)
+{
+    // History gives way when live data needs the space.
+    config::Config cfg = make_config();
+    cfg.total_size = 4ULL * 1024 * 1024;
+    OmniContainer::format(path, cfg);
+    fs::FileSystem fs;
+    fs.init(path, cfg);
+
+    std::mt19937 rng(9);
+    bool ok = true;
+    for (int i = 0; i < 2; ++i) {
+        std::string data = random_bytes(rng, 400 * 1024);
+        ok &= fs.file_create("/f" + std::to_string(i), data.data(), data.size()) == OFSErrorCodes::SUCCESS;
+        fs.file_truncate("/f" + std::to_string(i));
+    }
+    check(ok, "files fit next to their history");
+    check(fs.vault().stats().chunk_bytes != 0, "some history is kept");
+    FSStats stats;
+    fs.get_stats(stats);
+    std::string big = random_bytes(rng, static_cast<size_t>(stats.free_space) + 64 * cfg.block_size);
+    check(fs.file_create("/big", big.data(), big.size()) == OFSErrorCodes::SUCCESS,
+          "history is reclaimed for live data");
+    std::string out;
+    check(fs.file_read("/big", out) == OFSErrorCodes::SUCCESS && out == big, "reclaimed space holds the file");
+    fs.shutdown();
+}
+
+void test_persistence(const std::string& path, const std::string& crashed)
+{
+    config::Config cfg = make_config();
+    OmniContainer::format(path, cfg);
+
+    std::mt19937 rng(13);
+    std::vector<std::string> expected;
+    {
+        fs::FileSystem fs;
+        fs.init(path, cfg);
+        expected.push_back(random_bytes(rng, 50000));
+        fs.file_create("/p", expected.back().data(), expected.back().size());
+        for (int i = 0; i < 10; ++i) {
+            std::string patch = random_bytes(rng, 500);
+            std::string cur = expected.back();
+            cur.replace(1000 * i, patch.size(), patch);
+            fs.file_edit("/p", patch.data(), patch.size(), 1000 * i);
+            expected.push_back(cur);
+        }
+        fs.shutdown();
+    }
+
+    auto all_versions = [&expected](fs::FileSystem& fs) {
+        bool all = true;
+        for (size_t i = 0; i < expected.size(); ++i) {
+            std::string out;
+            all &= fs.file_read_version("/p", static_cast<uint32_t>(i + 1), out) == OFSErrorCodes::SUCCESS &&
+                   out == expected[i];
+        }
+        return all;
+    };
+
+    {
+        fs::FileSystem fs;
+        fs.init(path, cfg);
+        check(all_versions(fs), "history survives a remount");
+
+        // More versions, then a copy taken as a crash would leave the file.
+        std::string patch = random_bytes(rng, 300);
+        std::string cur = expected.back();
+        cur.replace(0, patch.size(), patch);
+        fs.file_edit("/p", patch.data(), patch.size(), 0);
+        expected.push_back(cur);
+        fs.journal().flush();
+        std::filesystem::copy_file(path, crashed, std::filesystem::copy_options::overwrite_existing);
+        fs.shutdown();
+    }
+
+    fs::FileSystem fs;
+    check(fs.init(crashed, cfg) == OFSErrorCodes::SUCCESS, "mount the crashed copy");
+    check(all_versions(fs), "history survives a crash");
+    fs.shutdown();
+}
+
+void test_disabled(const std::string& path)
+{
+    config::Config cfg = make_config();
+    cfg.history_size = 0;
+    OmniContainer::format(path, cfg);
+    fs::FileSystem fs;
+    fs.init(path, cfg);
+    check(!fs.vault().active(), "history_size 0 formats without history");
+    fs.file_create("/x", "abc", 3);
+    fs.file_edit("/x", "d", 1, 3);
+    std::vector<FileVersion> versions;
+    check(fs.file_versions("/x", versions) == OFSErrorCodes::SUCCESS && versions.empty(), "no versions kept");
+    std::string out;
+    check(fs.file_read("/x", out) == OFSErrorCodes::SUCCESS && out == "abcd", "files work without history");
+    fs.shutdown();
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/delta_vault_test.log");
+
+    const std::string path = "delta_vault_test.omni";
+    const std::string crashed = "delta_vault_test_crashed.omni";
+
+    test_cdc();
+    test_versions(path);
+    test_dedup(path);
+    test_bounded(path);
+    test_space_pressure(path);
+    test_persistence(path, crashed);
+    test_disabled(path);
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(crashed);
+
+    return report("delta vault");
+}
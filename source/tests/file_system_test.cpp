@@ -0,0 +1,369 @@
+#include "../include/file_system.hpp"
+#include "../include/logger.hpp"
+#include "test_util.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+using namespace ofs;
+using namespace ofs::fs;
+
+static bool has_child(FileSystem& fs, const std::string& dir, const std::string& name)
+{
+    std::vector<FileEntry> entries;
+    fs.dir_list(dir, entries);
+    for (const FileEntry& e : entries)
+    {
+        if (name == e.name) return true;
+    }
+    return false;
+}
+
+void test_operations(const std::string& path)
+{
+    config::Config cfg = make_config(16ULL * 1024 * 1024, 200);
+    check(storage::OmniContainer::format(path, cfg) == OFSErrorCodes::SUCCESS, "format");
+
+    FileSystem fs;
+    check(fs.init(path, cfg) == OFSErrorCodes::SUCCESS, "init");
+
+    check(fs.dir_create("/reports") == OFSErrorCodes::SUCCESS, "mkdir /reports");
+    check(fs.dir_create("/reports") == OFSErrorCodes::ERROR_FILE_EXISTS, "mkdir twice");
+    check(fs.dir_create("/missing/x") == OFSErrorCodes::ERROR_NOT_FOUND, "mkdir under missing parent");
+    check(fs.dir_create("/waytoolongname") == OFSErrorCodes::ERROR_INVALID_PATH, "name over the limit");
+    check(fs.dir_create("relative") == OFSErrorCodes::ERROR_INVALID_PATH, "relative path rejected");
+
+    // A negative lookup is cached, then invalidated by the create.
+    check(fs.file_exists("/reports/daily.txt") == OFSErrorCodes::ERROR_NOT_FOUND, "missing before create");
+    const std::string body = "balance=100\n";
+    check(fs.file_create("/reports/daily.txt", body.data(), body.size()) == OFSErrorCodes::SUCCESS, "create file");
+    check(fs.file_exists("/reports/daily.txt") == OFSErrorCodes::SUCCESS, "negative cache entry invalidated");
+    check(fs.dir_exists("/reports/daily.txt") == OFSErrorCodes::ERROR_NOT_FOUND, "a file is not a directory");
+
+    std::string out;
+    check(fs.file_read("/reports/daily.txt", out) == OFSErrorCodes::SUCCESS && out == body, "read back");
+
+    const std::string more = "=200\nextra line\n";
+    check(fs.file_edit("/reports/daily.txt", more.data(), more.size(), 7) == OFSErrorCodes::SUCCESS, "edit extends");
+    fs.file_read("/reports/daily.txt", out);
+    check(out == "balance=200\nextra line\n", "edit result");
+    check(fs.file_edit("/reports/daily.txt", "x", 1, 1000) == OFSErrorCodes::ERROR_INVALID_OPERATION, "edit past end rejected");
+
+    std::string big(50000, 'q');
+    check(fs.file_create("/reports/big", big.data(), big.size()) == OFSErrorCodes::SUCCESS, "multi-block file");
+    fs.file_read("/reports/big", out);
+    check(out == big, "multi-block read");
+
+    check(fs.file_truncate("/reports/big") == OFSErrorCodes::SUCCESS, "truncate");
+    fs.file_read("/reports/big", out);
+    check(out.size() == big.size() && out.compare(0, 14, "siruamrsiruamr") == 0 &&
+          out[big.size() - 1] == "siruamr"[(big.size() - 1) % 7], "truncate fills the whole file");
+
+    check(has_child(fs, "/reports", "daily.txt") && has_child(fs, "/reports", "big"), "dir_list children");
+    check(has_child(fs, "/", "reports"), "root lists /reports");
+
+    // Renames update the index and the path cache.
+    check(fs.file_rename("/reports/daily.txt", "/reports/d1") == OFSErrorCodes::SUCCESS, "rename file");
+    check(fs.file_exists("/reports/daily.txt") == OFSErrorCodes::ERROR_NOT_FOUND, "old name gone");
+    check(fs.file_exists("/reports/d1") == OFSErrorCodes::SUCCESS, "new name present");
+
+    check(fs.dir_create("/archive") == OFSErrorCodes::SUCCESS, "mkdir /archive");
+    check(fs.file_exists("/archive/r/d1") == OFSErrorCodes::ERROR_NOT_FOUND, "cache a negative below /archive");
+    check(fs.file_exists("/reports/big") == OFSErrorCodes::SUCCESS, "cache a positive below /reports");
+    check(fs.file_rename("/reports", "/archive/r") == OFSErrorCodes::SUCCESS, "move directory");
+    check(fs.file_exists("/archive/r/d1") == OFSErrorCodes::SUCCESS, "negative entry dropped after dir move");
+    check(fs.file_exists("/reports/big") == OFSErrorCodes::ERROR_NOT_FOUND, "positive entry dropped after dir move");
+    check(!has_child(fs, "/", "reports") && has_child(fs, "/archive", "r"), "child vectors follow the move");
+    check(fs.file_rename("/archive", "/archive/r/loop") == OFSErrorCodes::ERROR_INVALID_OPERATION, "no move into itself");
+
+    check(fs.dir_delete("/archive/r") == OFSErrorCodes::ERROR_DIRECTORY_NOT_EMPTY, "non-empty dir kept");
+    check(fs.file_delete("/archive/r/d1") == OFSErrorCodes::SUCCESS, "delete file");
+    check(fs.file_delete("/archive/r/big") == OFSErrorCodes::SUCCESS, "delete big");
+    check(fs.dir_delete("/archive/r") == OFSErrorCodes::SUCCESS, "delete empty dir");
+    check(fs.dir_exists("/archive/r") == OFSErrorCodes::ERROR_NOT_FOUND, "dir gone");
+    check(fs.dir_delete("/") == OFSErrorCodes::ERROR_INVALID_OPERATION, "root cannot be deleted");
+
+    FSStats stats;
+    check(fs.get_stats(stats) == OFSErrorCodes::SUCCESS, "stats");
+    check(stats.total_files == 0 && stats.total_directories == 1, "counters follow operations");
+
+    fs.shutdown();
+}
+
+// Content written through pread / io_uring is seen through the mapping
+// and survives a remount, for both block mapping formats.
+void test_io_backends(const std::string& path)
+{
+    for (const char* mapping : {"chain", "extent"}) {
+        for (const char* backend : {"pread", "io_uring"}) {
+            std::string tag = std::string(backend) + "/" + mapping + ": ";
+            config::Config cfg = make_config(16ULL * 1024 * 1024, 50);
+            cfg.block_mapping = mapping;
+            cfg.io_backend = backend;
+            storage::OmniContainer::format(path, cfg);
+
+            std::string body(70000, '\0');
+            for (size_t i = 0; i < body.size(); ++i) {
+                body[i] = static_cast<char>('a' + (i * 7) % 26);
+            }
+            std::string out;
+            {
+                FileSystem fs;
+                check(fs.init(path, cfg) == OFSErrorCodes::SUCCESS, tag + "init");
+                storage::IoBackend expect = std::string(backend) == "pread" ? storage::IoBackend::pread
+                                                                            : storage::IoBackend::io_uring;
+                check(fs.container().io_backend() == expect, tag + "backend selected");
+                check(fs.file_create("/f", body.data(), body.size()) == OFSErrorCodes::SUCCESS, tag + "create");
+                // Straddles block boundaries and extends the file.
+                fs.file_edit("/f", "EDITED", 6, 4093);
+                fs.file_edit("/f", "tail", 4, body.size());
+                body.replace(4093, 6, "EDITED");
+                body += "tail";
+                check(fs.file_read("/f", out) == OFSErrorCodes::SUCCESS && out == body, tag + "read back");
+                fs.shutdown();
+            }
+            cfg.io_backend = "mmap";
+            FileSystem fs;
+            fs.init(path, cfg);
+            check(fs.file_read("/f", out) == OFSErrorCodes::SUCCESS && out == body, tag + "persisted");
+            fs.shutdown();
+        }
+    }
+}
+
+// Range reads and handles, over both block mapping formats.
+void test_partial_reads(const std::string& path)
+{
+    for (const char* mapping : {"chain", "extent"}) {
+        std::string tag = std::string(mapping) + ": ";
+        config::Config cfg = make_config(16ULL * 1024 * 1024, 50);
+        cfg.block_mapping = mapping;
+        storage::OmniContainer::format(path, cfg);
+        FileSystem fs;
+        fs.init(path, cfg);
+
+        std::string body(50000, '\0');
+        for (size_t i = 0; i < body.size(); ++i) {
+            body[i] = static_cast<char>('a' + (i * 11) % 26);
+        }
+        fs.file_create("/f", body.data(), body.size());
+
+        std::string out;
+        check(fs.file_read_range("/f", 4090, 10000, out) == OFSErrorCodes::SUCCESS && out == body.substr(4090, 10000),
+              tag + "range across blocks");
+        check(fs.file_read_range("/f", 45000, 10000, out) == OFSErrorCodes::SUCCESS && out == body.substr(45000),
+              tag + "range clipped at the end");
+        check(fs.file_read_range("/f", body.size(), 10, out) == OFSErrorCodes::SUCCESS && out.empty(),
+              tag + "range at the end is empty");
+        check(fs.file_read_range("/f", body.size() + 1, 10, out) == OFSErrorCodes::ERROR_INVALID_OPERATION,
+              tag + "range past the end");
+        check(fs.file_read_range("/nope", 0, 10, out) == OFSErrorCodes::ERROR_NOT_FOUND, tag + "range of a missing file");
+
+        // A buffer handed back through free_buffer serves the next read.
+        std::string whole;
+        fs.file_read("/f", whole);
+        const char* buffer = whole.data();
+        FileSystem::free_buffer(std::move(whole));
+        check(whole.empty(), tag + "free_buffer empties the buffer");
+        std::string again;
+        check(fs.file_read("/f", again) == OFSErrorCodes::SUCCESS && again == body && again.data() == buffer,
+              tag + "read reuses the freed buffer");
+
+        // A handle reads on where it stopped, through a rename.
+        uint64_t handle = 0, size = 0, offset = 0;
+        check(fs.file_open("/f", "s1", handle, size, 100) == OFSErrorCodes::SUCCESS && size == body.size(),
+              tag + "open");
+        fs.file_rename("/f", "/g");
+        std::string at;
+        check(fs.handle_path(handle, "s1", at) && at == "/g" && !fs.handle_path(handle, "s2", at),
+              tag + "a handle's path follows a rename");
+        uint64_t inner = 0;
+        fs.dir_create("/hd");
+        fs.file_create("/hd/x", "x", 1);
+        fs.file_open("/hd/x", "s1", inner, size);
+        fs.file_rename("/hd", "/he");
+        check(fs.handle_path(inner, "s1", at) && at == "/he/x", tag + "and the rename of its directory");
+        fs.file_close(inner, "s1");
+        std::string all;
+        bool ordered = true;
+        while (fs.file_read_next(handle, "s1", 4096, out, &offset) == OFSErrorCodes::SUCCESS && !out.empty()) {
+            ordered &= offset == 100 + all.size();
+            all += out;
+        }
+        check(ordered && all == body.substr(100), tag + "read_next covers the rest in order");
+        check(fs.file_close(handle, "s1") == OFSErrorCodes::SUCCESS, tag + "close");
+        check(fs.file_read_next(handle, "s1", 10, out) == OFSErrorCodes::ERROR_NOT_FOUND, tag + "closed handle");
+        check(fs.file_open("/g", "s1", handle, size, body.size() + 1) == OFSErrorCodes::ERROR_INVALID_OPERATION,
+              tag + "open past the end");
+
+        // Only the session that opened a handle can use or close it.
+        fs.file_open("/g", "s1", handle, size);
+        check(fs.file_read_next(handle, "s2", 10, out) == OFSErrorCodes::ERROR_NOT_FOUND &&
+                  fs.file_read_next(handle, "", 10, out) == OFSErrorCodes::ERROR_NOT_FOUND,
+              tag + "other sessions cannot read a handle");
+        check(fs.file_close(handle, "s2") == OFSErrorCodes::ERROR_NOT_FOUND, tag + "other sessions cannot close it");
+        check(fs.file_read_next(handle, "s1", 3, out) == OFSErrorCodes::SUCCESS && out == body.substr(0, 3),
+              tag + "the owner still reads it");
+
+        // An edit, even one that leaves the bytes as they were, ends the
+        // reads through handles opened before it.
+        fs.file_edit("/g", body.data(), 3, 0);
+        check(fs.file_read_next(handle, "s1", 3, out) == OFSErrorCodes::ERROR_INVALID_OPERATION,
+              tag + "handle of a changed file");
+
+        // Deleting the file ends its handles, even when the slot is reused.
+        fs.file_delete("/g");
+        fs.file_create("/h", "new", 3);
+        check(fs.file_read_next(handle, "s1", 10, out) == OFSErrorCodes::ERROR_NOT_FOUND,
+              tag + "handle of a deleted file");
+        fs.file_close(handle, "s1");
+
+        // A session gets MAX_OPEN_PER_SESSION handles; the table is full
+        // at MAX_OPEN_FILES. Opens past either fail, and none is closed.
+        uint64_t first = 0;
+        fs.file_open("/h", "s1", first, size);
+        for (size_t i = 1; i < FileSystem::MAX_OPEN_PER_SESSION; ++i) {
+            fs.file_open("/h", "s1", handle, size);
+        }
+        check(fs.file_open("/h", "s1", handle, size) == OFSErrorCodes::ERROR_NO_SPACE, tag + "per-session limit");
+        check(fs.file_open("/h", "s2", handle, size) == OFSErrorCodes::SUCCESS, tag + "other sessions still open");
+        fs.file_close(handle, "s2");
+        size_t opened = FileSystem::MAX_OPEN_PER_SESSION;
+        while (opened < FileSystem::MAX_OPEN_FILES && fs.file_open("/h", "", handle, size) == OFSErrorCodes::SUCCESS) {
+            ++opened;
+        }
+        check(opened == FileSystem::MAX_OPEN_FILES, tag + "no per-session limit without a session");
+        check(fs.file_open("/h", "s2", handle, size) == OFSErrorCodes::ERROR_NO_SPACE, tag + "table full");
+        check(fs.file_read_next(first, "s1", 1, out) == OFSErrorCodes::SUCCESS && out == "n", tag + "no handle evicted");
+
+        // Closing a session's handles makes room again.
+        check(fs.close_handles([](std::string_view s) { return s == "s1"; }) == FileSystem::MAX_OPEN_PER_SESSION,
+              tag + "close_handles closes the session's handles");
+        check(fs.file_read_next(first, "s1", 1, out) == OFSErrorCodes::ERROR_NOT_FOUND, tag + "closed with its session");
+        check(fs.file_open("/h", "s2", handle, size) == OFSErrorCodes::SUCCESS, tag + "room after close_handles");
+        fs.shutdown();
+    }
+}
+
+void test_persistence(const std::string& path)
+{
+    config::Config cfg = make_config(16ULL * 1024 * 1024, 200);
+    storage::OmniContainer::format(path, cfg);
+    {
+        FileSystem fs;
+        fs.init(path, cfg);
+        fs.dir_create("/a");
+        fs.dir_create("/a/b");
+        fs.file_create("/a/b/c", "hello", 5);
+    }
+
+    // Clean restart: the dentry table and the index snapshot are used as is.
+    uint64_t generation = 0;
+    {
+        storage::OmniContainer c;
+        c.open(path, storage::SyncPolicy::on_shutdown);
+        storage::Snapshot snap;
+        generation = c.layout().mount_generation;
+        check(snap.attach(c) && snap.valid(generation), "snapshot sealed at shutdown");
+    }
+    {
+        FileSystem fs;
+        fs.init(path, cfg);
+        check(fs.container().layout().mount_generation == generation + 1, "generation advances on init");
+        std::string out;
+        check(fs.file_read("/a/b/c", out) == OFSErrorCodes::SUCCESS && out == "hello", "file found after clean restart");
+        FileMetadata meta;
+        check(fs.get_metadata("/a/b/c", meta) == OFSErrorCodes::SUCCESS && meta.entry.size == 5, "metadata after restart");
+        check(has_child(fs, "/a", "b") && has_child(fs, "/a/b", "c"), "child lists from the snapshot");
+        FSStats stats;
+        fs.get_stats(stats);
+        check(stats.total_files == 1 && stats.total_directories == 2, "counters from the snapshot");
+
+        // Slots freed and reused across the restart come from the saved stack.
+        check(fs.file_create("/a/d", "x", 1) == OFSErrorCodes::SUCCESS, "create after warm start");
+        check(fs.file_delete("/a/d") == OFSErrorCodes::SUCCESS, "delete after warm start");
+    }
+
+    // A corrupted snapshot fails its checksum and everything is rebuilt.
+    {
+        storage::OmniContainer c;
+        c.open(path, storage::SyncPolicy::on_shutdown);
+        storage::Snapshot snap;
+        snap.attach(c);
+        uint64_t len = 0;
+        uint8_t* links = snap.section(storage::SnapshotSection::directory, len);
+        std::memset(links, 0xFF, static_cast<size_t>(len));
+        snap.mark_all_dirty();
+    }
+    {
+        FileSystem fs;
+        fs.init(path, cfg);
+        check(has_child(fs, "/a", "b") && !has_child(fs, "/a", "d"), "child lists rebuilt after checksum mismatch");
+        check(fs.dir_delete("/a") == OFSErrorCodes::ERROR_DIRECTORY_NOT_EMPTY, "rebuilt lists see children");
+    }
+
+    // Unclean restart: wipe the table and clear the flag, as a crash would.
+    {
+        storage::OmniContainer c;
+        c.open(path, storage::SyncPolicy::on_shutdown);
+        storage::View<uint32_t> table = c.dentry_table();
+        std::memset(table.data, 0, table.size * sizeof(uint32_t));
+        c.mutable_layout().dentry_clean = 0;
+        c.mutable_layout().mount_generation += 7;
+        c.mark_dirty(c.base(), c.mapped_size());
+    }
+    {
+        FileSystem fs;
+        fs.init(path, cfg);
+        std::string out;
+        check(fs.file_read("/a/b/c", out) == OFSErrorCodes::SUCCESS && out == "hello", "index rebuilt after unclean shutdown");
+        FSStats stats;
+        fs.get_stats(stats);
+        check(stats.total_files == 1 && stats.total_directories == 2, "counters rebuilt after unclean shutdown");
+    }
+}
+
+void bench_lookup(const std::string& path)
+{
+    config::Config cfg = make_config(16ULL * 1024 * 1024, 5000);
+    cfg.total_size = 64ULL * 1024 * 1024;
+    storage::OmniContainer::format(path, cfg);
+    FileSystem fs;
+    fs.init(path, cfg);
+
+    fs.dir_create("/d");
+    for (int i = 0; i < 4000; ++i)
+    {
+        fs.file_create("/d/f" + std::to_string(i), "x", 1);
+    }
+    std::vector<FileEntry> entries;
+    fs.dir_list("/d", entries);
+    check(entries.size() == 4000, "4000 children listed");
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < 100000; ++i)
+    {
+        fs.file_exists("/d/f" + std::to_string(i % 4000));
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    std::cout << "file_exists in a 4000-entry directory: " << ns / 100000 << " ns (cache hits "
+              << fs.path_index().cache_hits() << ", misses " << fs.path_index().cache_misses() << ")\n";
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/file_system_test.log");
+
+    const std::string path = "file_system_test.omni";
+    test_operations(path);
+    test_persistence(path);
+    test_io_backends(path);
+    test_partial_reads(path);
+    bench_lookup(path);
+    std::filesystem::remove(path);
+
+    return report("file system");
+}
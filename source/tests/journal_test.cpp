@@ -0,0 +1,363 @@
+#include "../include/file_system.hpp"
+#include "../include/journal.hpp"
+#include "../include/logger.hpp"
+#include "test_util.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ofs;
+using namespace ofs::storage;
+
+// Renames entry index in a transaction of its own.
+static void set_name(Journal& journal, OmniContainer& c, uint32_t index, const char* name)
+{
+    Transaction tx(&journal);
+    MetadataEntry* e = c.entry(index);
+    std::memset(e->name, 0, sizeof(e->name));
+    std::strncpy(e->name, name, sizeof(e->name) - 1);
+    e->validity = ENTRY_IN_USE;
+    c.mark_dirty(e, sizeof(*e));
+}
+
+static bool name_is(OmniContainer& c, uint32_t index, const char* name)
+{
+    const MetadataEntry* e = c.entry(index);
+    return e->in_use() && std::strncmp(e->name, name, sizeof(e->name)) == 0;
+}
+
+// Offset of the record with sequence seq, or 0.
+static uint64_t record_offset(OmniContainer& c, uint64_t seq)
+{
+    const OmniLayoutInfo& l = c.layout();
+    uint64_t pos = JOURNAL_RECORDS_OFFSET;
+    while (pos + sizeof(JournalRecord) <= l.journal_size) {
+        JournalRecord rec;
+        std::memcpy(&rec, c.base() + l.journal_offset + pos, sizeof(rec));
+        if (rec.magic != JOURNAL_RECORD_MAGIC || rec.length == 0) {
+            return 0;
+        }
+        if (rec.seq == seq) {
+            return l.journal_offset + pos;
+        }
+        pos += rec.length;
+    }
+    return 0;
+}
+
+void test_layout()
+{
+    config::Config cfg = make_config();
+    OmniLayoutInfo l;
+    check(OmniContainer::compute_layout(cfg, l) == OFSErrorCodes::SUCCESS, "layout computes");
+    check(l.journal_size == cfg.journal_size, "journal sized from the config");
+    check(l.journal_offset % JOURNAL_ALIGN == 0, "journal is aligned");
+    check(l.journal_offset >= l.free_map_offset + l.free_map_size, "journal follows the free map");
+    check(l.content_offset >= l.journal_offset + l.journal_size, "content follows the journal");
+
+    cfg.journal_size = 0;
+    check(OmniContainer::compute_layout(cfg, l) == OFSErrorCodes::SUCCESS && l.journal_size == 0,
+          "journal_size 0 formats without a journal");
+}
+
+void test_replay(const std::string& path, const std::string& crashed)
+{
+    config::Config cfg = make_config();
+    check(OmniContainer::format(path, cfg) == OFSErrorCodes::SUCCESS, "format");
+
+    {
+        OmniContainer c;
+        Journal journal;
+        check(c.open(path, SyncPolicy::on_shutdown) == OFSErrorCodes::SUCCESS, "open");
+        check(journal.attach(c, Durability::async, 1000) == OFSErrorCodes::SUCCESS && journal.active(),
+              "journal attaches");
+
+        set_name(journal, c, 2, "first");
+        set_name(journal, c, 3, "second");
+        set_name(journal, c, 4, "third");
+        journal.flush();
+        check(journal.stats().records == 3, "one record per transaction");
+
+        // Take the file as a crash would leave it: records durable, the
+        // entries themselves not yet written in place.
+        std::filesystem::copy_file(path, crashed, std::filesystem::copy_options::overwrite_existing);
+    }
+
+    {
+        OmniContainer c;
+        Journal journal;
+        c.open(crashed, SyncPolicy::on_shutdown);
+        check(journal.attach(c, Durability::async, 1000) == OFSErrorCodes::SUCCESS, "attach after a crash");
+        check(journal.stats().replayed == 3, "every record is replayed");
+        check(name_is(c, 2, "first") && name_is(c, 4, "third"),
+              "replay restores the committed entries");
+
+        // Replay checkpointed: a second mount has nothing to apply.
+        journal.detach();
+        check(journal.attach(c, Durability::async, 1000) == OFSErrorCodes::SUCCESS &&
+              journal.stats().replayed == 0, "a checkpointed journal is empty");
+    }
+}
+
+void test_torn_record(const std::string& path, const std::string& crashed)
+{
+    config::Config cfg = make_config();
+    OmniContainer::format(path, cfg);
+
+    {
+        OmniContainer c;
+        Journal journal;
+        c.open(path, SyncPolicy::on_shutdown);
+        journal.attach(c, Durability::async, 1000);
+        set_name(journal, c, 2, "kept");
+        set_name(journal, c, 3, "torn");
+        set_name(journal, c, 4, "after");
+        journal.flush();
+        std::filesystem::copy_file(path, crashed, std::filesystem::copy_options::overwrite_existing);
+
+        // The second record was only half written.
+        uint64_t first_seq = reinterpret_cast<JournalHeader*>(c.base() + c.layout().journal_offset)->first_seq;
+        uint64_t second = record_offset(c, first_seq + 1);
+        check(second != 0, "second record found");
+        if (second != 0) {
+            std::fstream f(crashed, std::ios::in | std::ios::out | std::ios::binary);
+            uint64_t at = second + sizeof(JournalRecord) + sizeof(JournalRange) + 1;
+            char byte;
+            f.seekg(static_cast<std::streamoff>(at));
+            f.get(byte);
+            f.seekp(static_cast<std::streamoff>(at));
+            f.put(static_cast<char>(byte ^ 0xFF));
+        }
+    }
+
+    OmniContainer c;
+    Journal journal;
+    c.open(crashed, SyncPolicy::on_shutdown);
+    journal.attach(c, Durability::async, 1000);
+    check(journal.stats().replayed == 1, "replay stops at the torn record");
+    check(name_is(c, 2, "kept"), "records before the tear are applied");
+    check(!c.entry(3)->in_use() && !c.entry(4)->in_use(), "nothing from the tear on is applied");
+}
+
+void test_killed_mid_transaction(const std::string& path, const std::string& crashed)
+{
+    config::Config cfg = make_config();
+    OmniContainer::format(path, cfg);
+
+    OmniContainer c;
+    Journal journal;
+    c.open(path, SyncPolicy::on_shutdown);
+    journal.attach(c, Durability::fsync, 1000);
+    set_name(journal, c, 2, "committed");
+    {
+        // Killed half way: the change is made and marked, but never
+        // committed. The file, as the page cache holds it, must not show it.
+        Transaction tx(&journal);
+        MetadataEntry* e = c.entry(3);
+        std::strncpy(e->name, "half", sizeof(e->name) - 1);
+        e->validity = ENTRY_IN_USE;
+        c.mark_dirty(e, sizeof(*e));
+        std::filesystem::copy_file(path, crashed, std::filesystem::copy_options::overwrite_existing);
+    }
+
+    OmniContainer copy;
+    Journal replayed;
+    copy.open(crashed, SyncPolicy::on_shutdown);
+    replayed.attach(copy, Durability::async, 1000);
+    check(name_is(copy, 2, "committed"), "a committed change survives the kill");
+    check(!copy.entry(3)->in_use(), "a change killed mid-transaction never reaches the file");
+}
+
+void test_durability_modes(const std::string& path)
+{
+    for (const char* mode : {"fsync", "group", "async"}) {
+        config::Config cfg = make_config();
+        cfg.io_durability = mode;
+        cfg.io_group_commit_ms = 20;
+        OmniContainer::format(path, cfg);
+
+        fs::FileSystem fs;
+        check(fs.init(path, cfg) == OFSErrorCodes::SUCCESS, std::string("init with ") + mode);
+        Journal& journal = fs.journal();
+        check(journal.active() && journal.durability() == durability_from_string(mode),
+              std::string("journal runs ") + mode);
+
+        Journal::Stats before = journal.stats();
+        auto t0 = std::chrono::steady_clock::now();
+        check(fs.dir_create("/d") == OFSErrorCodes::SUCCESS, std::string("mkdir under ") + mode);
+        auto took = std::chrono::steady_clock::now() - t0;
+        Journal::Stats after = journal.stats();
+
+        check(after.records == before.records + 1, std::string("one record under ") + mode);
+        if (std::string(mode) == "fsync") {
+            check(after.flushes > before.flushes, "fsync flushes before returning");
+        } else if (std::string(mode) == "group") {
+            check(after.flushes > before.flushes && took >= std::chrono::milliseconds(1),
+                  "group waits for the next flush");
+        } else {
+            check(took < std::chrono::milliseconds(20), "async returns before the flush");
+        }
+
+        // A deferred commit returns at once and reports the record to wait for.
+        uint64_t seq;
+        {
+            DeferredCommits deferred;
+            fs.dir_create("/e");
+            seq = deferred.last();
+        }
+        check(seq != 0, std::string("deferred commit reports its record under ") + mode);
+        std::atomic<bool> done{false};
+        journal.when_durable(seq, [&done] { done = true; });
+        auto t1 = std::chrono::steady_clock::now();
+        while (!done.load() && std::chrono::steady_clock::now() - t1 < std::chrono::seconds(2)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        check(done.load(), std::string("when_durable runs under ") + mode);
+        fs.shutdown();
+    }
+}
+
+void test_group_commit(const std::string& path)
+{
+    config::Config cfg = make_config();
+    cfg.io_durability = "group";
+    cfg.io_group_commit_ms = 10;
+    OmniContainer::format(path, cfg);
+
+    fs::FileSystem fs;
+    fs.init(path, cfg);
+    Journal::Stats before = fs.journal().stats();
+
+    const int threads = 8;
+    const int per_thread = 20;
+    std::atomic<int> ok{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&fs, &ok, t] {
+            for (int i = 0; i < per_thread; ++i) {
+                if (fs.dir_create("/t" + std::to_string(t) + "_" + std::to_string(i)) == OFSErrorCodes::SUCCESS) {
+                    ++ok;
+                }
+            }
+        });
+    }
+    for (std::thread& w : workers) {
+        w.join();
+    }
+    Journal::Stats after = fs.journal().stats();
+    uint64_t records = after.records - before.records;
+    uint64_t flushes = after.flushes - before.flushes;
+    check(ok.load() == threads * per_thread, "every concurrent mkdir succeeds");
+    check(records == static_cast<uint64_t>(threads * per_thread), "one record per mkdir");
+    check(flushes * 2 <= records, "concurrent commits share flushes");
+    std::cout << "group commit: " << records << " records, " << flushes << " flushes\n";
+    fs.shutdown();
+}
+
+void test_checkpoint_on_full(const std::string& path, const std::string& crashed)
+{
+    // A journal much smaller than the work done checkpoints on its own and
+    // keeps every change.
+    config::Config cfg = make_config();
+    cfg.journal_size = JOURNAL_ALIGN;
+    cfg.io_durability = "async";
+    OmniContainer::format(path, cfg);
+
+    {
+        fs::FileSystem fs;
+        fs.init(path, cfg);
+        for (int i = 0; i < 400; ++i) {
+            fs.file_create("/f" + std::to_string(i), "x", 1);
+        }
+        check(fs.journal().stats().checkpoints > 1, "a full journal checkpoints");
+        fs.journal().flush();
+        std::filesystem::copy_file(path, crashed, std::filesystem::copy_options::overwrite_existing);
+        fs.shutdown();
+    }
+
+    // The copy was never shut down: its indexes are rebuilt from the
+    // metadata the journal left.
+    fs::FileSystem fs;
+    check(fs.init(crashed, cfg) == OFSErrorCodes::SUCCESS, "mount the crashed copy");
+    bool all = true;
+    for (int i = 0; i < 400; ++i) {
+        all &= fs.file_exists("/f" + std::to_string(i)) == OFSErrorCodes::SUCCESS;
+    }
+    check(all, "every file survives the crash");
+    fs.shutdown();
+}
+
+void test_change_larger_than_journal(const std::string& path, const std::string& crashed)
+{
+    // One transaction touching more metadata than the journal holds: it is
+    // written in place, and durable once the transaction ends.
+    config::Config cfg = make_config();
+    cfg.journal_size = JOURNAL_ALIGN;
+    cfg.max_files = 2000;
+    OmniContainer::format(path, cfg);
+
+    const uint32_t count = 1500;
+    OmniContainer c;
+    Journal journal;
+    c.open(path, SyncPolicy::on_shutdown);
+    journal.attach(c, Durability::fsync, 1000);
+    check(count * sizeof(MetadataEntry) > c.layout().journal_size, "the change exceeds the journal");
+    Journal::Stats before = journal.stats();
+    uint64_t seq;
+    {
+        DeferredCommits deferred;
+        {
+            Transaction tx(&journal);
+            for (uint32_t i = 2; i < 2 + count; ++i) {
+                MetadataEntry* e = c.entry(i);
+                std::snprintf(e->name, sizeof(e->name), "big%u", i);
+                e->validity = ENTRY_IN_USE;
+                c.mark_dirty(e, sizeof(*e));
+            }
+        }
+        seq = deferred.last();
+    }
+    check(seq != 0, "an oversized commit reports a record to wait for");
+    check(journal.stats().checkpoints > before.checkpoints, "an oversized commit checkpoints");
+    journal.flush();
+    std::filesystem::copy_file(path, crashed, std::filesystem::copy_options::overwrite_existing);
+
+    OmniContainer copy;
+    Journal replayed;
+    copy.open(crashed, SyncPolicy::on_shutdown);
+    check(replayed.attach(copy, Durability::async, 1000) == OFSErrorCodes::SUCCESS, "attach after an oversized commit");
+    bool all = true;
+    for (uint32_t i = 2; i < 2 + count; ++i) {
+        all &= name_is(copy, i, ("big" + std::to_string(i)).c_str());
+    }
+    check(all, "an oversized change survives a reopen");
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/journal_test.log");
+
+    const std::string path = "journal_test.omni";
+    const std::string crashed = "journal_test_crashed.omni";
+
+    test_layout();
+    test_replay(path, crashed);
+    test_torn_record(path, crashed);
+    test_killed_mid_transaction(path, crashed);
+    test_durability_modes(path);
+    test_group_commit(path);
+    test_checkpoint_on_full(path, crashed);
+    test_change_larger_than_journal(path, crashed);
+
+    std::filesystem::remove(path);
+    std::filesystem::remove(crashed);
+
+    return report("journal");
+}
@@ -0,0 +1,114 @@
+#include "../include/logger.hpp"
+#include "../include/log_macros.hpp"
+#include "../include/log_encoding.hpp"
+#include "test_util.hpp"
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <filesystem>
+
+using namespace ofs;
+
+#define TEST_MODULE "LOG_ENCODING_TEST"
+
+static std::string read_file(const std::string& path)
+{
+    std::ifstream is(path, std::ios::binary);
+    return std::string((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+}
+
+void test_round_trip()
+{
+    BinaryLogEncoder enc;
+    std::string out;
+    enc.begin_segment(out, 1700000000LL * 1000000000LL, 5000, "unit", 42);
+    enc.append_record(out, 5000 + 1500, LogLevel::warn, "MOD_A", 201, "first", "/src/a.cpp", 10);
+    enc.append_record(out, 5000 + 2500, LogLevel::error, "MOD_B", -7, "second", "/src/a.cpp", 20);
+
+    // A second segment appended to the same file (e.g. after a restart).
+    enc.reset();
+    enc.begin_segment(out, 1700000100LL * 1000000000LL, 0, "unit2", 43);
+    enc.append_record(out, 10, LogLevel::info, "MOD_A", 11, "third", "/src/b.cpp", 30);
+
+    std::vector<DecodedLogRecord> recs;
+    std::vector<std::string> msgs;
+    std::string err;
+    bool ok = decode_binary_log(out, [&](const DecodedLogRecord& r) {
+        recs.push_back(r);
+        msgs.emplace_back(r.msg);
+    }, err);
+
+    check(ok, "decode succeeds: " + err);
+    check(recs.size() == 3, "three records decoded");
+    if (recs.size() == 3)
+    {
+        check(recs[0].wall_ns == 1700000000LL * 1000000000LL + 1500, "timestamp delta restored");
+        check(recs[1].code == -7, "negative code restored");
+        check(recs[1].module == "MOD_B" && recs[1].line == 20, "module and line restored");
+        check(recs[2].app == "unit2" && recs[2].pid == 43, "second segment header applied");
+        check(msgs[2] == "third", "message restored");
+    }
+
+    std::string line;
+    format_text_log_line(line, recs[0].wall_ns, recs[0].app, recs[0].pid,
+                         recs[0].level, recs[0].module, recs[0].code, recs[0].msg,
+                         recs[0].src_file, recs[0].line);
+    check(line == "2023-11-14T22:13:20Z app=\"unit\" pid=42 level=WARN module=MOD_A code=201 "
+                  "msg=\"first\" file=\"/src/a.cpp\" line=10\n", "text rendering matches logger format");
+
+    std::string truncated = out.substr(0, out.size() - 3);
+    size_t delivered = 0;
+    ok = decode_binary_log(truncated, [&](const DecodedLogRecord&) { ++delivered; }, err);
+    check(!ok && delivered == 2, "truncated tail is reported after delivering intact records");
+}
+
+void test_logger_binary_file()
+{
+    const std::string text_path = "./logs/encoding_test.txt.log";
+    const std::string bin_path = "./logs/encoding_test.bin.log";
+    std::filesystem::remove(text_path);
+    std::filesystem::remove(bin_path);
+
+    Logger& logger = Logger::get_instance();
+
+    logger.set_log_file(text_path);
+    logger.set_log_format(LogFormat::text);
+    for (int i = 0; i < 200; ++i)
+    {
+        LOG_INFO(TEST_MODULE, 20, "operation {} complete", i);
+    }
+
+    logger.set_log_file(bin_path);
+    logger.set_log_format(LogFormat::binary);
+    logger.enable_async();
+    for (int i = 0; i < 200; ++i)
+    {
+        LOG_INFO(TEST_MODULE, 20, "operation {} complete", i);
+    }
+    logger.disable_async();
+    logger.set_log_format(LogFormat::text);
+
+    std::string bin = read_file(bin_path);
+    std::string text = read_file(text_path);
+
+    size_t count = 0;
+    std::string err;
+    bool ok = decode_binary_log(bin, [&](const DecodedLogRecord& r) {
+        if (r.code == 20 && r.module == TEST_MODULE) ++count;
+    }, err);
+
+    check(ok, "logger output decodes: " + err);
+    check(count == 200, "all logger records decoded");
+    std::cout << "text bytes: " << text.size() << ", binary bytes: " << bin.size() << "\n";
+    check(bin.size() * 3 < text.size(), "binary log is much smaller than text");
+}
+
+int main()
+{
+    test_round_trip();
+    test_logger_binary_file();
+
+    return report("log encoding");
+}
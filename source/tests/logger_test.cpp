@@ -7,6 +7,7 @@
 #include <vector>
 #include <limits>
 #include <stdexcept>
+#include <filesystem>
 
 using namespace ofs;
 using namespace std::literals;
@@ -32,6 +33,15 @@ void test_multithreaded_logging(int thread_id)
     }
 }
 
+void test_multithreaded_format_logging(int thread_id)
+{
+    for (int i = 0; i < 5; ++i)
+    {
+        LOG_INFO(TEST_MODULE, 160 + thread_id, "Thread {} writing formatted log entry {}", thread_id, i);
+        std::this_thread::sleep_for(10ms);
+    }
+}
+
 void run_multithread_test()
 {
     LOG_INFO(TEST_MODULE, 110, "Starting multithreaded logging test.");
@@ -49,6 +59,112 @@ void run_multithread_test()
     LOG_INFO(TEST_MODULE, 111, "Multithreaded logging test complete.");
 }
 
+void run_multithread_format_test()
+{
+    LOG_INFO(TEST_MODULE, 112, "Starting multithreaded format logging test.");
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 5; ++i)
+    {
+        threads.emplace_back(test_multithreaded_format_logging, i);
+    }
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+    LOG_INFO(TEST_MODULE, 113, "Multithreaded format logging test complete.");
+}
+
+void test_level_filtering()
+{
+    Logger& logger = Logger::get_instance();
+    int evaluated = 0;
+    auto expensive = [&evaluated]() { ++evaluated; return std::string("built"); };
+
+    logger.set_min_level(LogLevel::info);
+    LOG_DEBUG(TEST_MODULE, 103, "Filtered debug message: {}", expensive());
+    LOG_INFO(TEST_MODULE, 104, "Unfiltered info message: {}", expensive());
+    logger.set_min_level(LogLevel::debug);
+
+    int expected = (OFS_MIN_LOG_LEVEL <= OFS_LOG_LEVEL_INFO) ? 1 : 0;
+    if (evaluated != expected)
+    {
+        LOG_ERROR(TEST_MODULE, 320, "Filtered log arguments were evaluated ({} times).", evaluated);
+    }
+
+    std::string rendered = format_log_message("a={} b={} {{literal}} c={}", 1, "two", 3.5);
+    if (rendered != "a=1 b=two {literal} c=3.5")
+    {
+        LOG_ERROR(TEST_MODULE, 321, "Unexpected format output: " + rendered);
+    }
+}
+
+void run_async_test()
+{
+    Logger& logger = Logger::get_instance();
+    logger.enable_async(1024, LogOverflowPolicy::block);
+    LOG_INFO(TEST_MODULE, 130, "Starting async logging test.");
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 5; ++i)
+    {
+        threads.emplace_back(test_multithreaded_logging, i);
+    }
+
+    for (auto& t : threads)
+    {
+        t.join();
+    }
+
+    LOG_INFO(TEST_MODULE, 131, "Async logging test complete.");
+    logger.disable_async();
+
+    if (logger.dropped_records() != 0)
+    {
+        LOG_ERROR(TEST_MODULE, 330, "Async logger dropped records under the block policy.");
+    }
+}
+
+void test_rotation_policy()
+{
+    Logger& logger = Logger::get_instance();
+    const std::string dir = "./logs/rotation_test";
+    std::filesystem::remove_all(dir);
+    logger.set_log_file(dir + "/rotation.log");
+
+    LogRotationPolicy policy;
+    policy.max_size_bytes = 16 * 1024;
+    policy.max_archives = 2;
+    policy.compress = true;
+    logger.set_rotation_policy(policy);
+
+    for (int i = 0; i < 1000; ++i)
+    {
+        LOG_DEBUG(TEST_MODULE, 140, "Rotation filler line {}", i);
+    }
+
+    // Compression and retention run on the archiver thread.
+    std::this_thread::sleep_for(500ms);
+
+    size_t archives = 0;
+    for (const auto& entry : std::filesystem::directory_iterator(dir))
+    {
+        if (entry.path().extension() == ".lz")
+        {
+            ++archives;
+        }
+    }
+
+    logger.set_rotation_policy(LogRotationPolicy{});
+    logger.set_log_file("./logs/test_logger.log");
+
+    if (archives != policy.max_archives)
+    {
+        LOG_ERROR(TEST_MODULE, 340, "Expected {} compressed archives, found {}.", policy.max_archives, archives);
+    }
+}
+
 void demonstrate_error_handling()
 {
     LOG_INFO(TEST_MODULE, 120, "Interactive error demonstration started.");
@@ -107,7 +223,11 @@ int main()
 
     // Run automated tests
     test_basic_logging();
+    test_level_filtering();
     run_multithread_test();
+    run_multithread_format_test();
+    run_async_test();
+    test_rotation_policy();
     
     std::cout << "\n--- Interactive Test Menu ---\n";
     std::cout << "1. Run Interactive Error Demo (Division)\n";
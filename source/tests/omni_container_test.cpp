@@ -0,0 +1,193 @@
+#include "../include/omni_container.hpp"
+#include "../include/byte_map.hpp"
+#include "../include/logger.hpp"
+#include "test_util.hpp"
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <cstring>
+#include <algorithm>
+#include <filesystem>
+#include <random>
+#include <vector>
+
+using namespace ofs;
+using namespace ofs::storage;
+
+void test_layout()
+{
+    config::Config cfg = make_config(4ULL * 1024 * 1024, 100);
+    OmniLayoutInfo l;
+    check(OmniContainer::compute_layout(cfg, l) == OFSErrorCodes::SUCCESS, "layout computes");
+    check(l.metadata_offset == 512 + 8 * sizeof(UserInfo), "metadata follows the user table");
+    check(l.content_offset % cfg.block_size == 0, "content is block aligned");
+    check(l.free_map_size * 8 >= l.total_blocks, "free map covers every block");
+    check(l.content_offset + l.total_blocks * cfg.block_size <= cfg.total_size, "content fits in the file");
+
+    cfg.block_size = 3000;
+    check(OmniContainer::compute_layout(cfg, l) == OFSErrorCodes::ERROR_INVALID_CONFIG, "odd block size rejected");
+}
+
+void test_format_and_open(const std::string& path)
+{
+    config::Config cfg = make_config(4ULL * 1024 * 1024, 100);
+    check(OmniContainer::format(path, cfg) == OFSErrorCodes::SUCCESS, "format succeeds");
+    check(std::filesystem::file_size(path) == cfg.total_size, "file has total_size bytes");
+
+    OmniContainer c;
+    check(c.open(path, SyncPolicy::on_shutdown) == OFSErrorCodes::SUCCESS, "open succeeds");
+    if (!c.is_open())
+    {
+        return;
+    }
+
+    check(std::memcmp(c.header()->magic, OMNI_MAGIC, 8) == 0, "magic present");
+    check(c.max_files() == cfg.max_files, "max_files recorded");
+    check(c.max_users() == cfg.max_users, "max_users recorded");
+
+    MetadataEntry* root = c.entry(ROOT_ENTRY_INDEX);
+    check(root != nullptr && root->in_use() && root->is_directory(), "root entry is a directory");
+    check(c.entry(2) != nullptr && !c.entry(2)->in_use(), "other entries start free");
+    check(c.entry(0) == nullptr && c.entry(cfg.max_files + 1) == nullptr, "entry bounds checked");
+
+    ByteView b = c.block(1);
+    check(b.size == cfg.block_size, "block view has block_size bytes");
+    check(c.block(static_cast<uint32_t>(c.total_blocks()) + 1).empty(), "block bounds checked");
+
+    // Writes go straight into the mapping and survive a reopen.
+    std::memcpy(b.data, "hello omni", 10);
+    c.mark_dirty(b.data, 10);
+    std::strncpy(c.entry(2)->name, "notes", sizeof(c.entry(2)->name) - 1);
+    c.entry(2)->validity = ENTRY_IN_USE;
+    c.mark_dirty(c.entry(2), sizeof(MetadataEntry));
+    check(c.sync() == OFSErrorCodes::SUCCESS, "sync succeeds");
+    c.close();
+
+    OmniContainer again;
+    check(again.open(path, SyncPolicy::immediate) == OFSErrorCodes::SUCCESS, "reopen succeeds");
+    if (again.is_open())
+    {
+        check(std::memcmp(again.block(1).data, "hello omni", 10) == 0, "block contents persisted");
+        check(again.entry(2)->in_use() && std::strcmp(again.entry(2)->name, "notes") == 0, "entry persisted");
+    }
+}
+
+void test_rejects_corruption(const std::string& path)
+{
+    {
+        std::fstream f(path, std::ios::in | std::ios::out | std::ios::binary);
+        f.seekp(0);
+        f.write("BROKEN!!", 8);
+    }
+    OmniContainer c;
+    check(c.open(path) == OFSErrorCodes::ERROR_IO_ERROR, "bad magic rejected");
+    check(!c.is_open(), "container stays closed after a failed open");
+
+    OmniContainer missing;
+    check(missing.open(path + ".missing") == OFSErrorCodes::ERROR_NOT_FOUND, "missing file reported");
+}
+
+void test_byte_map()
+{
+    uint8_t table[bytemap::TABLE_SIZE];
+    uint8_t inverse[bytemap::TABLE_SIZE];
+    bytemap::make_permutation(42, table);
+    bytemap::invert(table, inverse);
+    check(bytemap::is_permutation(table), "map is one-to-one");
+    table[1] = table[0];
+    check(!bytemap::is_permutation(table), "a repeated value is not one-to-one");
+    bytemap::make_permutation(42, table);
+    bytemap::Table forward, backward;
+    bytemap::prepare(table, forward);
+    bytemap::prepare(inverse, backward);
+
+    // Every path against the table itself, around every vector edge and
+    // in place.
+    std::mt19937 rng(1);
+    std::vector<uint8_t> src(300);
+    for (uint8_t& b : src) {
+        b = static_cast<uint8_t>(rng());
+    }
+    for (size_t i = 0; i < 256; ++i) {
+        src[i] = static_cast<uint8_t>(i);
+    }
+    for (bytemap::Path path : {bytemap::Path::scalar, bytemap::Path::ssse3, bytemap::Path::avx2,
+                                bytemap::Path::avx512vbmi}) {
+        if (!bytemap::supported(path)) {
+            continue;
+        }
+        bool same = true;
+        for (size_t len = 0; len <= src.size(); ++len) {
+            std::vector<uint8_t> enc(len), back(len);
+            bytemap::translate(path, forward, src.data(), enc.data(), len);
+            for (size_t i = 0; i < len; ++i) {
+                same &= enc[i] == table[src[i]];
+            }
+            back = enc;
+            bytemap::translate(path, backward, back.data(), back.data(), len);
+            same &= std::equal(back.begin(), back.end(), src.begin());
+        }
+        check(same, std::string("byte map path ") + bytemap::path_name(path) + " matches the table");
+    }
+}
+
+void test_content_map(const std::string& path)
+{
+    config::Config cfg = make_config(4ULL * 1024 * 1024, 100);
+    OmniLayoutInfo l;
+    OmniContainer::compute_layout(cfg, l);
+    check(l.content_map_offset != 0 && l.content_map_offset + 256 <= l.free_map_offset,
+          "content map sits before the free map");
+    OmniContainer::format(path, cfg);
+
+    std::string text = "content through the substitution map";
+    for (IoBackend backend : {IoBackend::mmap, IoBackend::pread, IoBackend::io_uring}) {
+        OmniContainer c;
+        c.open(path, SyncPolicy::on_shutdown);
+        check(c.content_encoded(), "format stores a content map");
+        c.set_io_backend(backend);
+        std::string data = text + io_backend_name(backend);
+        uint64_t offset = c.block_offset(2) + 100;
+        IoSegment w{offset, reinterpret_cast<uint8_t*>(data.data()), data.size()};
+        c.write_segments(&w, 1);
+
+        const uint8_t* map = c.base() + c.layout().content_map_offset;
+        bool encoded = true;
+        for (size_t i = 0; i < data.size(); ++i) {
+            encoded &= c.base()[offset + i] == map[static_cast<uint8_t>(data[i])];
+        }
+        check(encoded, std::string("the container holds encoded bytes (") + io_backend_name(backend) + ")");
+        check(data == text + io_backend_name(backend), "the caller's buffer is left as it was");
+
+        std::string back(data.size(), '\0');
+        IoSegment r{offset, reinterpret_cast<uint8_t*>(back.data()), back.size()};
+        c.read_segments(&r, 1);
+        check(back == data, std::string("reads decode (") + io_backend_name(backend) + ")");
+    }
+
+    cfg.encode_content = false;
+    OmniContainer::compute_layout(cfg, l);
+    check(l.content_map_offset == 0, "encode_content = false formats without a map");
+    OmniContainer::format(path, cfg);
+    OmniContainer plain;
+    plain.open(path, SyncPolicy::on_shutdown);
+    IoSegment w{plain.block_offset(1), reinterpret_cast<uint8_t*>(text.data()), text.size()};
+    plain.write_segments(&w, 1);
+    check(!plain.content_encoded() && std::memcmp(plain.base() + plain.block_offset(1), text.data(), text.size()) == 0,
+          "without a map content is stored as is");
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/omni_container_test.log");
+
+    const std::string path = "omni_container_test.omni";
+    test_layout();
+    test_format_and_open(path);
+    test_rejects_corruption(path);
+    test_byte_map();
+    test_content_map(path);
+    std::filesystem::remove(path);
+
+    return report("omni container");
+}
@@ -0,0 +1,192 @@
+#include "../include/base64.hpp"
+#include "../include/logger.hpp"
+#include "../include/protocol.hpp"
+#include "test_util.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace ofs;
+using namespace ofs::server;
+
+void test_base64()
+{
+    // RFC 4648 test vectors.
+    const char* plain[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+    const char* coded[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+    for (int i = 0; i < 7; ++i) {
+        std::string p = plain[i];
+        std::string out(base64::encoded_size(p.size()), '\0');
+        base64::encode(reinterpret_cast<const uint8_t*>(p.data()), p.size(), out.data());
+        check(out == coded[i], std::string("encode ") + plain[i]);
+    }
+
+    // The SIMD blocks against the scalar code, around every block edge,
+    // and in-place decoding.
+    std::mt19937 rng(7);
+    bool same = true, round_trip = true;
+    for (size_t len = 0; len < 300; ++len) {
+        std::vector<uint8_t> data(len);
+        for (uint8_t& b : data) {
+            b = static_cast<uint8_t>(rng());
+        }
+        std::string fast(base64::encoded_size(len), '\0');
+        std::string slow(base64::encoded_size(len), '\0');
+        base64::encode(data.data(), len, fast.data());
+        base64::encode_scalar(data.data(), len, slow.data());
+        same &= fast == slow;
+
+        size_t n = 0;
+        bool ok = base64::decode(fast.data(), fast.size(), reinterpret_cast<uint8_t*>(fast.data()), n);
+        round_trip &= ok && n == len && std::memcmp(data.data(), fast.data(), len) == 0;
+    }
+    check(same, "SIMD and scalar encoders agree");
+    check(round_trip, "decode in place round-trips");
+
+    // Invalid input is refused wherever it sits, inside a SIMD block or in
+    // the scalar tail.
+    std::vector<uint8_t> data(120, 0x5A);
+    std::string text(base64::encoded_size(data.size()), '\0');
+    base64::encode(data.data(), data.size(), text.data());
+    bool refused = true;
+    for (size_t at = 0; at < text.size(); at += 7) {
+        for (char bad : {'!', '=', '\n', '\x80'}) {
+            std::string t = text;
+            t[at] = bad;
+            std::vector<uint8_t> out(base64::decoded_max(t.size()));
+            size_t n = 0;
+            refused &= !base64::decode(t.data(), t.size(), out.data(), n);
+        }
+    }
+    check(refused, "invalid characters are refused");
+    std::vector<uint8_t> out(8);
+    size_t n = 0;
+    check(!base64::decode("Zm9", 3, out.data(), n), "length not a multiple of 4");
+    check(!base64::decode("Zg==Zg==", 8, out.data(), n), "padding before the end");
+    check(!base64::decode("Z===", 4, out.data(), n), "three padding characters");
+}
+
+void test_operations()
+{
+    const char* names[] = {"user_login",    "user_logout", "user_create",   "user_delete",      "user_list",
+                           "get_session_info", "file_create", "file_read",  "file_edit",        "file_delete",
+                           "file_truncate", "file_exists", "file_rename",   "dir_create",       "dir_list",
+                           "dir_delete",    "dir_exists",  "get_metadata",  "set_permissions",  "get_stats",
+                           "file_open",     "file_read_next", "file_close"};
+    bool all = true;
+    for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); ++i) {
+        Operation op = operation_from_name(names[i]);
+        all &= op == static_cast<Operation>(i + 1) && std::string(operation_name(op)) == names[i];
+    }
+    check(all, "every operation name maps to its operation");
+    check(operation_from_name("format_disk") == Operation::unknown, "unknown name");
+    check(operation_from_name("file_reads") == Operation::unknown, "near miss");
+    check(operation_from_name("file_read_nex") == Operation::unknown, "prefix of a name");
+    check(operation_from_name("") == Operation::unknown, "empty name");
+}
+
+void test_parser()
+{
+    std::string frame = "{ \"operation\" : \"file_create\", \"session_id\": null, \"extra\": {\"a\": [1, {}]},\n"
+                        "  \"parameters\": {\"path\": \"/a\\\"b\\u00e9\", \"index\": 12, \"flag\": true},"
+                        " \"request_id\": 7 }";
+    Request req;
+    const char* err = nullptr;
+    check(parse_request(frame.data(), frame.size(), req, err), "request parses");
+    check(req.op == Operation::file_create && req.operation == "file_create", "operation");
+    check(req.session_id.empty() && req.request_id == "7", "null session and numeric request_id");
+    const std::string_view* path = req.param("path");
+    check(path != nullptr && *path == "/a\"b\xc3\xa9", "escapes are decoded in place");
+    check(req.param("index") != nullptr && *req.param("index") == "12", "number parameter");
+    check(req.param("flag") != nullptr && *req.param("flag") == "true", "literal parameter");
+    check(req.param("missing") == nullptr, "absent parameter");
+    // The views point into the frame.
+    check(path != nullptr && path->data() > frame.data() && path->data() < frame.data() + frame.size(),
+          "no copies");
+
+    std::string bad = "{\"operation\": \"get_stats\", \"parameters\": {\"a\": \"x\"}";
+    check(!parse_request(bad.data(), bad.size(), req, err) && err != nullptr, "unterminated request");
+    std::string many = "{\"parameters\": {";
+    for (size_t i = 0; i <= Request::MAX_PARAMS; ++i) {
+        many += (i ? ",\"p" : "\"p") + std::to_string(i) + "\": 1";
+    }
+    many += "}}";
+    check(!parse_request(many.data(), many.size(), req, err), "too many parameters");
+}
+
+void test_scanner()
+{
+    // Two requests, braces and an escaped quote inside strings, garbage
+    // and blank lines, fed one byte at a time.
+    std::string stream = "{\"a\": \"}{\\\"\", \"b\": {\"c\": [1]}}\r\n\n  junk line\r\n"
+                         "{\n  \"operation\": \"get_stats\"\n}";
+    std::vector<std::string> frames;
+    FrameScanner scanner;
+    std::string buf;
+    for (char c : stream) {
+        buf += c;
+        size_t begin, end;
+        while (scanner.next(buf.data(), buf.size(), begin, end)) {
+            frames.push_back(buf.substr(begin, end - begin));
+        }
+        size_t used = scanner.consumed();
+        buf.erase(0, used);
+        scanner.shift(used);
+    }
+    check(frames.size() == 3, "three frames");
+    if (frames.size() == 3) {
+        check(frames[0] == "{\"a\": \"}{\\\"\", \"b\": {\"c\": [1]}}", "braces in strings");
+        check(frames[1] == "junk line", "text outside an object is a line");
+        check(frames[2] == "{\n  \"operation\": \"get_stats\"\n}", "object over several lines");
+    }
+    check(buf.empty(), "nothing left over");
+}
+
+void bench_codec()
+{
+    std::vector<uint8_t> data(1 << 20);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<uint8_t>(i * 131);
+    }
+    std::string text(base64::encoded_size(data.size()), '\0');
+    std::vector<uint8_t> out(data.size());
+    const int rounds = 50;
+    size_t n = 0;
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        base64::encode(data.data(), data.size(), text.data());
+    }
+    auto t1 = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        base64::decode(text.data(), text.size(), out.data(), n);
+    }
+    auto t2 = std::chrono::steady_clock::now();
+    for (int i = 0; i < rounds; ++i) {
+        base64::decode_scalar(text.data(), text.size(), out.data(), n);
+    }
+    auto t3 = std::chrono::steady_clock::now();
+    check(out == data, "benchmark round trip");
+
+    auto mbs = [&](std::chrono::steady_clock::duration d) {
+        return static_cast<uint64_t>(rounds * data.size() / std::chrono::duration<double>(d).count() / 1e6);
+    };
+    std::cout << "base64 encode: " << mbs(t1 - t0) << " MB/s, decode: " << mbs(t2 - t1)
+              << " MB/s (scalar " << mbs(t3 - t2) << " MB/s)\n";
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/protocol_test.log");
+
+    test_base64();
+    test_operations();
+    test_parser();
+    test_scanner();
+    bench_codec();
+
+    return report("protocol");
+}
@@ -0,0 +1,285 @@
+#include "../include/logger.hpp"
+#include "../include/scheduler.hpp"
+#include "../include/work_stealing_deque.hpp"
+#include "test_util.hpp"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ofs;
+using namespace ofs::server;
+
+struct Item : ScheduledWork
+{
+    int id = 0;
+};
+
+static Item* make_item(int id, Priority p)
+{
+    Item* it = new Item();
+    it->id = id;
+    it->priority = p;
+    it->queued = std::chrono::steady_clock::now();
+    return it;
+}
+
+// Holds the single worker of a scheduler until released.
+struct Gate
+{
+    std::mutex mtx;
+    std::condition_variable cv;
+    bool open = false;
+    bool entered = false;
+
+    void hold()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        entered = true;
+        cv.notify_all();
+        cv.wait(lock, [this] { return open; });
+    }
+
+    void wait_entered()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv.wait(lock, [this] { return entered; });
+    }
+
+    void release()
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        open = true;
+        cv.notify_all();
+    }
+};
+
+void test_deque()
+{
+    WorkStealingDeque<Item> dq(4);
+    Item items[5];
+    for (int i = 0; i < 4; ++i) {
+        check(dq.push(&items[i]), "push into free space");
+    }
+    check(!dq.push(&items[4]), "push into a full deque fails");
+    check(dq.pop() == &items[3], "pop takes the newest");
+    check(dq.steal() == &items[0], "steal takes the oldest");
+    check(dq.size() == 2, "size after pop and steal");
+    dq.pop();
+    dq.pop();
+    check(dq.pop() == nullptr && dq.steal() == nullptr, "empty deque");
+
+    // The owner pushes and pops while thieves steal: every item comes out
+    // exactly once.
+    const int total = 200000;
+    std::vector<Item> pool(total);
+    std::vector<std::atomic<int>> seen(total);
+    for (auto& s : seen) {
+        s = 0;
+    }
+    WorkStealingDeque<Item> shared(256);
+    std::atomic<bool> done{false};
+    std::atomic<int> taken{0};
+    auto thief = [&] {
+        while (!done.load() || shared.size() != 0) {
+            if (Item* it = shared.steal()) {
+                ++seen[it - pool.data()];
+                ++taken;
+            }
+        }
+    };
+    std::thread t1(thief), t2(thief);
+    for (int i = 0; i < total; ++i) {
+        while (!shared.push(&pool[i])) {
+            if (Item* it = shared.pop()) {
+                ++seen[it - pool.data()];
+                ++taken;
+            }
+        }
+        if (i % 3 == 0) {
+            if (Item* it = shared.pop()) {
+                ++seen[it - pool.data()];
+                ++taken;
+            }
+        }
+    }
+    while (Item* it = shared.pop()) {
+        ++seen[it - pool.data()];
+        ++taken;
+    }
+    done = true;
+    t1.join();
+    t2.join();
+    bool once = true;
+    for (auto& s : seen) {
+        once &= s.load() == 1;
+    }
+    check(taken.load() == total && once, "concurrent pop and steal hand out every item once");
+}
+
+void test_priority()
+{
+    // One worker, held while a bulk flood and a few interactive items
+    // queue up behind it: the interactive ones run first.
+    Scheduler sched;
+    Gate gate;
+    std::mutex mtx;
+    std::vector<Item*> order;
+    sched.start(1, std::chrono::milliseconds(0), [&](ScheduledWork* w, bool) {
+        Item* it = static_cast<Item*>(w);
+        if (it->id < 0) {
+            gate.hold();
+        } else {
+            std::lock_guard<std::mutex> lock(mtx);
+            order.push_back(it);
+            return;
+        }
+        delete it;
+    });
+    sched.submit(make_item(-1, Priority::interactive));
+    gate.wait_entered();
+    for (int i = 0; i < 20; ++i) {
+        sched.submit(make_item(i, Priority::bulk));
+    }
+    for (int i = 0; i < 5; ++i) {
+        sched.submit(make_item(100 + i, Priority::interactive));
+    }
+    sched.submit(make_item(200, Priority::maintenance));
+    gate.release();
+    while (true) {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (order.size() == 26) {
+            break;
+        }
+    }
+    check(sched.stop().empty(), "nothing left after the queue drained");
+
+    bool interactive_first = true;
+    for (int i = 0; i < 5; ++i) {
+        interactive_first &= order[i]->priority == Priority::interactive && order[i]->id == 100 + i;
+    }
+    check(interactive_first, "interactive work runs ahead of bulk, in order");
+    bool bulk_in_order = true;
+    for (int i = 0; i < 20; ++i) {
+        bulk_in_order &= order[5 + i]->id == i;
+    }
+    check(bulk_in_order, "bulk work runs oldest first");
+    check(order[25]->priority == Priority::maintenance, "maintenance runs last");
+    Scheduler::Stats s = sched.stats();
+    check(s.run[0] == 6 && s.run[1] == 20 && s.run[2] == 1, "run counts per class");
+    for (Item* it : order) {
+        delete it;
+    }
+}
+
+void test_aging()
+{
+    // A worker kept busy by an endless stream of interactive work still
+    // gets to the bulk item within a few aging steps.
+    Scheduler sched;
+    std::atomic<bool> bulk_ran{false};
+    std::atomic<int> flood{0};
+    sched.start(1, std::chrono::milliseconds(0), [&](ScheduledWork* w, bool) {
+        Item* it = static_cast<Item*>(w);
+        if (it->priority == Priority::bulk) {
+            bulk_ran = true;
+        } else if (!bulk_ran.load() && flood.load() < 100000) {
+            ++flood;
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            sched.submit(make_item(0, Priority::interactive));
+            sched.submit(make_item(0, Priority::interactive));
+        }
+        delete it;
+    });
+    auto t0 = std::chrono::steady_clock::now();
+    sched.submit(make_item(0, Priority::interactive));
+    sched.submit(make_item(1, Priority::bulk));
+    while (!bulk_ran.load() && std::chrono::steady_clock::now() - t0 < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    auto waited = std::chrono::steady_clock::now() - t0;
+    for (ScheduledWork* w : sched.stop()) {
+        delete static_cast<Item*>(w);
+    }
+    check(bulk_ran.load(), "bulk work runs under an interactive flood");
+    check(waited < 4 * Scheduler::AGING_STEP, "bulk work waits about one aging step");
+    check(sched.stats().aged >= 1, "the bulk item was picked by aging");
+}
+
+void test_expiry()
+{
+    // Work that waited past the timeout reaches the runner marked expired.
+    Scheduler sched;
+    Gate gate;
+    std::atomic<int> expired{0}, fresh{0};
+    sched.start(1, std::chrono::milliseconds(50), [&](ScheduledWork* w, bool is_expired) {
+        Item* it = static_cast<Item*>(w);
+        if (it->id < 0) {
+            gate.hold();
+        } else if (is_expired) {
+            ++expired;
+        } else {
+            ++fresh;
+        }
+        delete it;
+    });
+    sched.submit(make_item(-1, Priority::interactive));
+    gate.wait_entered();
+    sched.submit(make_item(1, Priority::bulk));
+    std::this_thread::sleep_for(std::chrono::milliseconds(120));
+    gate.release();
+    while (expired.load() + fresh.load() < 1) {
+        std::this_thread::yield();
+    }
+    sched.submit(make_item(2, Priority::interactive));
+    while (expired.load() + fresh.load() < 2) {
+        std::this_thread::yield();
+    }
+    sched.stop();
+    check(expired.load() == 1 && fresh.load() == 1, "only the late item expires");
+    check(sched.stats().expired == 1, "expiry is counted");
+}
+
+void test_stealing()
+{
+    // Work one worker submits lands in its own deque; idle workers steal it.
+    Scheduler sched;
+    std::atomic<int> ran{0};
+    sched.start(4, std::chrono::milliseconds(0), [&](ScheduledWork* w, bool) {
+        Item* it = static_cast<Item*>(w);
+        if (it->id < 0) {
+            for (int i = 0; i < 64; ++i) {
+                sched.submit(make_item(i, Priority::bulk));
+            }
+        } else {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            ++ran;
+        }
+        delete it;
+    });
+    sched.submit(make_item(-1, Priority::interactive));
+    auto t0 = std::chrono::steady_clock::now();
+    while (ran.load() < 64 && std::chrono::steady_clock::now() - t0 < std::chrono::seconds(5)) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    sched.stop();
+    check(ran.load() == 64, "all spawned work runs");
+    check(sched.stats().stolen > 0, "idle workers steal");
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/scheduler_test.log");
+
+    test_deque();
+    test_priority();
+    test_aging();
+    test_expiry();
+    test_stealing();
+
+    return report("scheduler");
+}
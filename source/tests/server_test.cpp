@@ -0,0 +1,658 @@
+#include "../include/base64.hpp"
+#include "../include/file_system.hpp"
+#include "../include/logger.hpp"
+#include "../include/server.hpp"
+#include "test_util.hpp"
+#include <arpa/inet.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <iostream>
+#include <netinet/in.h>
+#include <poll.h>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace ofs;
+
+// Blocking test client: sends JSON requests, reads response lines.
+class Client
+{
+public:
+    explicit Client(uint16_t port)
+    {
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr{};
+        addr.sin_family = AF_INET;
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        addr.sin_port = htons(port);
+        connected_ = ::connect(fd_, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0;
+    }
+
+    ~Client() { ::close(fd_); }
+
+    bool connected() const { return connected_; }
+
+    void send(const std::string& data)
+    {
+        size_t off = 0;
+        while (off < data.size()) {
+            ssize_t n = ::send(fd_, data.data() + off, data.size() - off, MSG_NOSIGNAL);
+            if (n <= 0) {
+                return;
+            }
+            off += static_cast<size_t>(n);
+        }
+    }
+
+    // Next response line, or "" after timeout_ms without one.
+    std::string line(int timeout_ms = 5000)
+    {
+        while (true) {
+            size_t nl = buf_.find('\n');
+            if (nl != std::string::npos) {
+                std::string out = buf_.substr(0, nl);
+                buf_.erase(0, nl + 1);
+                return out;
+            }
+            pollfd p{fd_, POLLIN, 0};
+            if (::poll(&p, 1, timeout_ms) <= 0) {
+                return "";
+            }
+            char tmp[65536];
+            ssize_t n = ::recv(fd_, tmp, sizeof(tmp), 0);
+            if (n <= 0) {
+                return "";
+            }
+            buf_.append(tmp, static_cast<size_t>(n));
+        }
+    }
+
+private:
+    int fd_;
+    bool connected_;
+    std::string buf_;
+};
+
+static std::string request(const std::string& op, const std::string& session, const std::string& params,
+                           const std::string& id)
+{
+    return "{\"operation\":\"" + op + "\",\"session_id\":\"" + session + "\",\"parameters\":{" + params +
+           "},\"request_id\":\"" + id + "\"}\n";
+}
+
+static std::string b64(const std::string& s)
+{
+    std::string out(base64::encoded_size(s.size()), '\0');
+    base64::encode(reinterpret_cast<const uint8_t*>(s.data()), s.size(), out.data());
+    return out;
+}
+
+// Value of a string or number field in a response line.
+static std::string field(const std::string& line, const std::string& key)
+{
+    std::string pat = "\"" + key + "\":";
+    size_t at = line.find(pat);
+    if (at == std::string::npos) {
+        return "";
+    }
+    at += pat.size();
+    if (line[at] == '"') {
+        size_t end = line.find('"', at + 1);
+        return line.substr(at + 1, end - at - 1);
+    }
+    size_t end = line.find_first_of(",}", at);
+    return line.substr(at, end - at);
+}
+
+static std::string login(Client& c, const std::string& user, const std::string& pw)
+{
+    c.send(request("user_login", "", "\"username\":\"" + user + "\",\"password\":\"" + pw + "\"", "login"));
+    return field(c.line(), "session_id");
+}
+
+void test_server(const std::string& path, const std::string& backend, const std::string& execution)
+{
+    config::Config cfg = make_config();
+    cfg.io_backend = backend;
+    cfg.execution = execution;
+    cfg.max_files = 2000;
+    cfg.port = 0;
+    cfg.max_connections = 4;
+    storage::OmniContainer::format(path, cfg);
+
+    fs::FileSystem filesystem;
+    filesystem.init(path, cfg);
+    server::Server srv(filesystem, cfg);
+    check(srv.start() == OFSErrorCodes::SUCCESS, "server starts");
+    std::thread loop([&srv] { srv.run(); });
+
+    Client admin(srv.port());
+    check(admin.connected(), "client connects");
+    std::string session = login(admin, "admin", "admin123");
+    check(session.size() == 32, "login returns a session");
+
+    // Pipelining: many requests in one write, answered in order.
+    std::string batch = request("dir_create", session, "\"path\":\"/docs\"", "0");
+    for (int i = 1; i <= 50; ++i) {
+        batch += request("file_create", session,
+                         "\"path\":\"/docs/f" + std::to_string(i) + "\",\"data\":\"" +
+                             b64("line " + std::to_string(i) + "\n") + "\"",
+                         std::to_string(i));
+    }
+    batch += request("dir_list", session, "\"path\":\"/docs\"", "51");
+    admin.send(batch);
+    bool in_order = true;
+    std::string last;
+    for (int i = 0; i <= 51; ++i) {
+        last = admin.line();
+        in_order &= field(last, "request_id") == std::to_string(i) && field(last, "status") == "success";
+    }
+    check(in_order, "pipelined responses in order");
+    check(last.find("\"name\":\"f50\"") != std::string::npos, "dir_list sees every file");
+
+    admin.send(request("file_read", session, "\"path\":\"/docs/f7\"", "r"));
+    std::string read = admin.line();
+    check(read.find("\"data\":\"" + b64("line 7\n") + "\"") != std::string::npos && field(read, "size") == "7",
+          "file_read returns the data");
+
+    // A request pretty-printed over several lines, as in notes/README.md,
+    // and arriving in pieces.
+    std::string pretty = "{\n  \"operation\": \"file_edit\",\n  \"session_id\": \"" + session +
+                         "\",\n  \"parameters\": {\n    \"path\": \"/docs/f7\",\n    \"data\": \"" + b64("LINE") +
+                         "\",\n    \"index\": 0\n  },\n  \"request_id\": \"pretty}\"\n}\n";
+    admin.send(pretty.substr(0, 40));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    admin.send(pretty.substr(40));
+    check(field(admin.line(), "request_id") == "pretty}", "multi-line request");
+    admin.send(request("file_read", session, "\"path\":\"/docs/f7\"", "r2"));
+    check(admin.line().find("\"data\":\"" + b64("LINE 7\n") + "\"") != std::string::npos,
+          "file_edit decodes base64");
+
+    // A request split across several writes.
+    std::string split = request("get_stats", session, "", "split");
+    admin.send(split.substr(0, 10));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    admin.send(split.substr(10, 25));
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    admin.send(split.substr(35));
+    std::string stats = admin.line();
+    check(field(stats, "request_id") == "split" && field(stats, "total_files") == "50", "split request");
+    check(field(stats, "active_sessions") == "1", "stats count sessions");
+
+    // Errors.
+    admin.send("{\"operation\": \"file_read\", \"parameters\": [1, 2]}\n");
+    check(field(admin.line(), "error_code") == "-11", "malformed request");
+    admin.send("hello\r\n");
+    check(field(admin.line(), "error_code") == "-11", "text outside an object");
+    admin.send(request("file_create", session, "\"path\":\"/bad\",\"data\":\"not base64!\"", "x"));
+    check(field(admin.line(), "error_code") == "-11", "invalid base64");
+    admin.send(request("format_disk", session, "", "x"));
+    check(field(admin.line(), "error_code") == "-8", "unknown operation");
+    admin.send(request("dir_list", "", "\"path\":\"/\"", "x"));
+    check(field(admin.line(), "error_code") == "-9", "missing session");
+    admin.send(request("file_read", session, "\"path\":\"/nope\"", "x"));
+    check(field(admin.line(), "error_code") == "-1", "not found");
+
+    admin.send(request("user_create", session, "\"username\":\"bob\",\"password\":\"pw\"", "u"));
+    check(field(admin.line(), "status") == "success", "admin creates a user");
+    Client bob(srv.port());
+    std::string bob_session = login(bob, "bob", "pw");
+    bob.send(request("user_list", bob_session, "", "x"));
+    check(field(bob.line(), "error_code") == "-2", "user_list is admin only");
+    bob.send(request("get_session_info", bob_session, "", "x"));
+    check(field(bob.line(), "username") == "bob", "session info");
+
+    // Login completes on the hashing pool; the request behind it still
+    // answers second.
+    bob.send(request("user_login", "", "\"username\":\"bob\",\"password\":\"pw\"", "a") +
+             request("get_stats", bob_session, "", "b"));
+    std::string first = bob.line(), second = bob.line();
+    check(field(first, "request_id") == "a" && field(second, "request_id") == "b", "login keeps its place");
+
+    // max_connections: the fifth client waits in the backlog.
+    {
+        Client c3(srv.port());
+        Client c4(srv.port());
+        c3.send(request("get_stats", session, "", "c3"));
+        check(!c3.line().empty(), "third connection served");
+        Client waiting(srv.port());
+        waiting.send(request("get_stats", session, "", "w"));
+        check(waiting.line(300).empty(), "over the limit waits");
+        c4.send(request("get_stats", session, "", "c4"));
+        c4.line();
+    }
+    for (int i = 0; i < 100 && srv.connections() > 2; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    check(srv.connections() == 2, "closed connections free their slots");
+
+    admin.send(request("user_logout", session, "", "bye"));
+    check(field(admin.line(), "status") == "success", "logout");
+    admin.send(request("get_stats", session, "", "x"));
+    check(field(admin.line(), "error_code") == "-9", "session gone after logout");
+
+    srv.stop();
+    loop.join();
+    filesystem.shutdown();
+}
+
+// File content of a response line, decoded.
+static std::string content(const std::string& line)
+{
+    size_t at = line.find("\"data\":\"");
+    if (at == std::string::npos) {
+        return "";
+    }
+    at += 8;
+    size_t end = line.find('"', at);
+    std::string out(base64::decoded_max(end - at), '\0');
+    size_t n = 0;
+    base64::decode(line.data() + at, end - at, reinterpret_cast<uint8_t*>(out.data()), n);
+    out.resize(n);
+    return out;
+}
+
+// Range reads, streamed reads and handles over the socket, with a small
+// window so that a file takes many chunks.
+void test_streaming(const std::string& path, const std::string& backend, const std::string& execution)
+{
+    config::Config cfg = make_config();
+    cfg.io_backend = backend;
+    cfg.execution = execution;
+    cfg.max_files = 100;
+    cfg.port = 0;
+    cfg.stream_window = 64 * 1024;
+    storage::OmniContainer::format(path, cfg);
+
+    fs::FileSystem filesystem;
+    filesystem.init(path, cfg);
+    server::Server srv(filesystem, cfg);
+    srv.start();
+    std::thread loop([&srv] { srv.run(); });
+    std::string tag = " (" + backend + ", " + execution + ")";
+
+    Client c(srv.port());
+    std::string session = login(c, "admin", "admin123");
+    std::string body(2 * 1024 * 1024 + 1000, '\0');
+    for (size_t i = 0; i < body.size(); ++i) {
+        body[i] = static_cast<char>((i * 131) >> 7);
+    }
+    c.send(request("file_create", session, "\"path\":\"/big\",\"data\":\"" + b64(body) + "\"", "c"));
+    check(field(c.line(), "status") == "success", "large file created" + tag);
+
+    c.send(request("file_read", session, "\"path\":\"/big\",\"offset\":70000,\"length\":100", "r"));
+    std::string range = c.line();
+    check(field(range, "offset") == "70000" && content(range) == body.substr(70000, 100),
+          "range read" + tag);
+
+    // The stream answers in window-sized chunks and keeps its place ahead
+    // of the request behind it.
+    c.send(request("file_read", session, "\"path\":\"/big\",\"stream\":true", "s") +
+           request("get_stats", session, "", "after"));
+    std::string streamed, line;
+    size_t chunks = 0;
+    bool framed = true;
+    do {
+        line = c.line();
+        framed &= field(line, "request_id") == "s" && field(line, "offset") == std::to_string(streamed.size()) &&
+                  std::stoul("0" + field(line, "size")) <= cfg.stream_window;
+        streamed += content(line);
+        ++chunks;
+    } while (framed && field(line, "more") == "true");
+    check(framed && streamed == body, "streamed chunks carry the file in order" + tag);
+    check(chunks == (body.size() + cfg.stream_window - 1) / cfg.stream_window, "one chunk per window" + tag);
+    check(field(c.line(), "request_id") == "after", "the next response follows the last chunk" + tag);
+
+    c.send(request("file_read", session, "\"path\":\"/big\",\"stream\":true,\"offset\":1000,\"length\":100000", "p"));
+    streamed.clear();
+    do {
+        line = c.line();
+        streamed += content(line);
+    } while (field(line, "more") == "true");
+    check(streamed == body.substr(1000, 100000), "streamed range" + tag);
+
+    // A reader that stops reading holds the stream back; other clients are
+    // still served.
+    {
+        Client slow(srv.port());
+        slow.send(request("file_read", session, "\"path\":\"/big\",\"stream\":true", "slow"));
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        c.send(request("get_stats", session, "", "meanwhile"));
+        check(field(c.line(), "request_id") == "meanwhile", "a stalled stream does not hold up others" + tag);
+        line = slow.line();
+        check(field(line, "more") == "true", "stalled stream resumes" + tag);
+    }
+
+    // An edit that runs between two chunks ends the stream with an error
+    // rather than mixing two versions of the file.
+    c.send(request("file_read", session, "\"path\":\"/big\",\"stream\":true", "s") +
+           request("file_edit", session, "\"path\":\"/big\",\"data\":\"" + b64(body.substr(0, 3)) + "\",\"index\":0",
+                   "e"));
+    do {
+        line = c.line();
+    } while (field(line, "more") == "true");
+    check(field(line, "request_id") == "s" && field(line, "error_code") == "-11",
+          "a stream over a changed file fails" + tag);
+    check(field(c.line(), "request_id") == "e", "the edit answers after the stream" + tag);
+
+    c.send(request("file_open", session, "\"path\":\"/big\",\"offset\":5", "o"));
+    line = c.line();
+    std::string handle = field(line, "handle");
+    check(field(line, "size") == std::to_string(body.size()), "file_open reports the size" + tag);
+    std::string next;
+    c.send(request("file_read_next", session, "\"handle\":" + handle + ",\"length\":10", "n1") +
+           request("file_read_next", session, "\"handle\":" + handle + ",\"length\":100000000", "n2"));
+    next = c.line();
+    check(field(next, "offset") == "5" && content(next) == body.substr(5, 10), "file_read_next" + tag);
+    next = c.line();
+    check(field(next, "offset") == "15" && field(next, "size") == std::to_string(cfg.stream_window),
+          "file_read_next is held to the window" + tag);
+    {
+        // A handle is only good for the session that opened it.
+        Client other(srv.port());
+        std::string other_session = login(other, "admin", "admin123");
+        other.send(request("file_read_next", other_session, "\"handle\":" + handle, "m") +
+                   request("file_close", other_session, "\"handle\":" + handle, "k"));
+        check(field(other.line(), "error_code") == "-1", "another session cannot read a handle" + tag);
+        check(field(other.line(), "error_code") == "-1", "another session cannot close a handle" + tag);
+    }
+    c.send(request("file_close", session, "\"handle\":" + handle, "x") +
+           request("file_read_next", session, "\"handle\":" + handle, "y"));
+    check(field(c.line(), "status") == "success", "file_close" + tag);
+    check(field(c.line(), "error_code") == "-1", "closed handle" + tag);
+
+    // Once their buffers have gone round the slab pool and the worker
+    // arenas, the same requests run again without allocating for them.
+    auto allocations = [&c, &session] {
+        c.send(request("get_stats", session, "", "a"));
+        return std::stoull("0" + field(c.line(), "request_allocations"));
+    };
+    auto round = [&c, &session] {
+        for (int i = 0; i < 10; ++i) {
+            c.send(request("file_read", session, "\"path\":\"/big\",\"offset\":0,\"length\":65536", "r"));
+            c.line();
+            c.send(request("dir_list", session, "\"path\":\"/\"", "l"));
+            c.line();
+            c.send(request("get_metadata", session, "\"path\":\"/big\"", "m"));
+            c.line();
+            c.send(request("file_read", session, "\"path\":\"/big\",\"stream\":true,\"length\":200000", "s"));
+            while (field(c.line(), "more") == "true") {
+            }
+        }
+    };
+    round();
+    round();
+    uint64_t before = allocations();
+    round();
+    check(allocations() == before, "steady state requests do not allocate their buffers" + tag);
+
+    srv.stop();
+    loop.join();
+    filesystem.shutdown();
+}
+
+void test_path_locks()
+{
+    auto set = [](std::initializer_list<std::pair<const char*, server::LockMode>> locks) {
+        server::LockSet s;
+        for (const auto& l : locks) {
+            s.add(l.first, l.second);
+        }
+        return s;
+    };
+    using server::LockMode;
+    server::PathLocks held;
+    server::LockSet write_abc = set({{"/a/b/c", LockMode::exclusive}});
+    held.acquire(write_abc);
+    check(held.compatible(set({{"/a/b/d", LockMode::shared}})), "sibling read runs beside a write");
+    check(held.compatible(set({{"/a/b/d", LockMode::exclusive}})), "sibling write runs beside a write");
+    check(!held.compatible(set({{"/a/b/c", LockMode::shared}})), "read of the written file waits");
+    check(!held.compatible(set({{"/a", LockMode::shared}})), "listing an ancestor waits");
+    check(!held.compatible(set({{"/", LockMode::shared}})), "stats wait for writes");
+    check(!held.compatible(set({{"/a/b/c/d", LockMode::shared}})), "a path below a written one waits");
+    held.release(write_abc);
+    check(held.empty(), "release drops every name");
+
+    server::LockSet reads = set({{"/a", LockMode::shared}, {"/a/b", LockMode::shared}});
+    held.acquire(reads);
+    held.acquire(reads);
+    check(held.compatible(set({{"/a/b", LockMode::shared}})), "readers share");
+    check(!held.compatible(set({{"/a/x", LockMode::exclusive}})), "write under a read directory waits");
+    check(held.compatible(set({{"/b/x", LockMode::exclusive}})), "write elsewhere runs");
+    held.release(reads);
+    held.release(reads);
+
+    // The same name twice keeps the stronger mode.
+    server::LockSet both = set({{"/a/b", LockMode::shared}, {"/a/b/c", LockMode::exclusive}});
+    held.acquire(both);
+    check(!held.compatible(set({{"/a/b", LockMode::intent_shared}})), "shared plus intent-exclusive is exclusive");
+    held.release(both);
+}
+
+// Under concurrent execution, pipelined requests that touch the same paths
+// must see each other in order while unrelated readers run beside them.
+void test_concurrent_order(const std::string& path)
+{
+    config::Config cfg = make_config();
+    cfg.execution = "concurrent";
+    cfg.workers = 4;
+    cfg.port = 0;
+    storage::OmniContainer::format(path, cfg);
+
+    fs::FileSystem filesystem;
+    filesystem.init(path, cfg);
+    server::Server srv(filesystem, cfg);
+    srv.start();
+    std::thread loop([&srv] { srv.run(); });
+
+    Client writer(srv.port());
+    std::string session = login(writer, "admin", "admin123");
+    writer.send(request("dir_create", session, "\"path\":\"/r\"", "d") +
+                request("file_create", session, "\"path\":\"/r/k\",\"data\":\"" + b64("k") + "\"", "k"));
+    writer.line();
+    writer.line();
+
+    std::atomic<bool> done{false};
+    std::atomic<int> bad_reads{0};
+    std::thread reader([&] {
+        Client c(srv.port());
+        std::string s = login(c, "admin", "admin123");
+        while (!done.load()) {
+            c.send(request("file_read", s, "\"path\":\"/r/k\"", "rk"));
+            if (c.line().find("\"data\":\"" + b64("k") + "\"") == std::string::npos) {
+                ++bad_reads;
+            }
+        }
+    });
+
+    bool ordered = true;
+    for (int round = 0; round < 50; ++round) {
+        std::string f = "/w" + std::to_string(round);
+        std::string batch;
+        batch += request("file_create", session, "\"path\":\"" + f + "\",\"data\":\"" + b64("one") + "\"", "c");
+        batch += request("file_read", session, "\"path\":\"" + f + "\"", "r1");
+        batch += request("file_edit", session,
+                         "\"path\":\"" + f + "\",\"data\":\"" + b64("TWO") + "\",\"index\":0", "e");
+        batch += request("file_read", session, "\"path\":\"" + f + "\"", "r2");
+        batch += request("file_rename", session, "\"old_path\":\"" + f + "\",\"new_path\":\"" + f + "x\"", "m");
+        batch += request("file_exists", session, "\"path\":\"" + f + "\"", "x1");
+        batch += request("file_read", session, "\"path\":\"" + f + "x\"", "r3");
+        batch += request("file_delete", session, "\"path\":\"" + f + "x\"", "del");
+        batch += request("file_exists", session, "\"path\":\"" + f + "x\"", "x2");
+        writer.send(batch);
+        std::vector<std::string> r;
+        for (int i = 0; i < 9; ++i) {
+            r.push_back(writer.line());
+        }
+        ordered &= field(r[0], "status") == "success";
+        ordered &= r[1].find("\"data\":\"" + b64("one") + "\"") != std::string::npos;
+        ordered &= r[3].find("\"data\":\"" + b64("TWO") + "\"") != std::string::npos;
+        ordered &= field(r[4], "status") == "success" && field(r[5], "error_code") == "-1";
+        ordered &= r[6].find("\"data\":\"" + b64("TWO") + "\"") != std::string::npos;
+        ordered &= field(r[7], "status") == "success" && field(r[8], "error_code") == "-1";
+    }
+    check(ordered, "conflicting requests keep their order");
+    writer.send(request("get_stats", session, "", "s"));
+    check(field(writer.line(), "total_files") == "1", "stats after the writes");
+
+    done = true;
+    reader.join();
+    check(bad_reads == 0, "unrelated reads run beside the writes");
+
+    srv.stop();
+    loop.join();
+    filesystem.shutdown();
+}
+
+void test_priority_classes(const std::string& path)
+{
+    // One worker; a client pipelines large uploads while another lists an
+    // unrelated directory. The listing overtakes the uploads still queued.
+    config::Config cfg = make_config();
+    cfg.execution = "concurrent";
+    cfg.workers = 1;
+    cfg.total_size = 64ULL * 1024 * 1024;
+    cfg.port = 0;
+    storage::OmniContainer::format(path, cfg);
+
+    fs::FileSystem filesystem;
+    filesystem.init(path, cfg);
+    server::Server srv(filesystem, cfg);
+    srv.start();
+    std::thread loop([&srv] { srv.run(); });
+
+    Client lister(srv.port());
+    std::string ls = login(lister, "admin", "admin123");
+    lister.send(request("dir_create", ls, "\"path\":\"/docs\"", "d1") +
+                request("dir_create", ls, "\"path\":\"/up\"", "d2"));
+    lister.line();
+    lister.line();
+
+    const int uploads = 60;
+    std::atomic<bool> first{false};
+    std::atomic<int> replies{0};
+    std::atomic<int> before_listing{-1};
+    std::thread uploader([&] {
+        Client c(srv.port());
+        std::string s = login(c, "admin", "admin123");
+        std::string data = b64(std::string(256 * 1024, 'u'));
+        std::string batch;
+        for (int i = 0; i < uploads; ++i) {
+            batch += request("file_create", s, "\"path\":\"/up/f" + std::to_string(i) + "\",\"data\":\"" + data + "\"",
+                             "u" + std::to_string(i));
+        }
+        c.send(batch);
+        for (int i = 0; i < uploads; ++i) {
+            if (field(c.line(), "status") == "success") {
+                ++replies;
+            }
+            first = true;
+        }
+    });
+
+    while (!first.load()) {
+        std::this_thread::yield();
+    }
+    lister.send(request("dir_list", ls, "\"path\":\"/docs\"", "ls"));
+    std::string listing = lister.line();
+    before_listing = replies.load();
+    uploader.join();
+
+    check(field(listing, "status") == "success", "listing during uploads");
+    check(before_listing.load() < uploads, "listing is not queued behind every upload");
+    check(replies.load() == uploads, "every upload completes");
+
+    srv.stop();
+    loop.join();
+    filesystem.shutdown();
+}
+
+void bench_pipeline(const std::string& path, const std::string& backend, const std::string& execution)
+{
+    config::Config cfg = make_config();
+    cfg.io_backend = backend;
+    cfg.execution = execution;
+    cfg.port = 0;
+    cfg.max_connections = 64;
+    storage::OmniContainer::format(path, cfg);
+
+    fs::FileSystem filesystem;
+    filesystem.init(path, cfg);
+    Logger::get_instance().set_min_level(LogLevel::warn);
+    server::Server srv(filesystem, cfg);
+    srv.start();
+    std::thread loop([&srv] { srv.run(); });
+
+    const int clients = 8;
+    const int per_client = 10000;
+    std::vector<std::thread> threads;
+    std::vector<int> ok(clients, 0);
+    auto t0 = std::chrono::steady_clock::now();
+    for (int c = 0; c < clients; ++c) {
+        threads.emplace_back([&, c] {
+            Client client(srv.port());
+            std::string session = login(client, "admin", "admin123");
+            std::string req = request("file_exists", session, "\"path\":\"/\"", "q");
+            // Keep at most 32 requests outstanding, like a pipelining client.
+            int sent = 0, received = 0;
+            while (received < per_client) {
+                std::string burst;
+                while (sent < per_client && sent - received < 32) {
+                    burst += req;
+                    ++sent;
+                }
+                client.send(burst);
+                std::string line = client.line();
+                if (line.empty()) {
+                    break;
+                }
+                ++received;
+                ok[c] += field(line, "request_id") == "q";
+            }
+        });
+    }
+    for (std::thread& t : threads) {
+        t.join();
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    int total = 0;
+    for (int n : ok) {
+        total += n;
+    }
+    check(total == clients * per_client, "every pipelined request answered");
+    std::cout << "server (" << (backend == "io_uring" ? "io_uring" : "epoll") << ", " << execution
+              << "): " << clients << " clients, "
+              << static_cast<uint64_t>(total / secs) << " requests/s\n";
+
+    srv.stop();
+    loop.join();
+    Logger::get_instance().set_min_level(LogLevel::info);
+    filesystem.shutdown();
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/server_test.log");
+
+    const std::string path = "server_test.omni";
+    test_path_locks();
+    for (const char* backend : {"mmap", "io_uring"}) {
+        for (const char* execution : {"fifo", "concurrent"}) {
+            test_server(path, backend, execution);
+            test_streaming(path, backend, execution);
+        }
+    }
+    test_concurrent_order(path);
+    test_priority_classes(path);
+    for (const char* execution : {"fifo", "concurrent"}) {
+        bench_pipeline(path, "mmap", execution);
+        bench_pipeline(path, "io_uring", execution);
+    }
+    std::filesystem::remove(path);
+
+    return report("server");
+}
@@ -0,0 +1,198 @@
+#include "../include/session_manager.hpp"
+#include "../include/timing_wheel.hpp"
+#include "../include/coarse_clock.hpp"
+#include "../include/logger.hpp"
+#include "test_util.hpp"
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ofs;
+using namespace ofs::security;
+
+static UserInfo make_user(const std::string& name, UserRole role)
+{
+    UserInfo u{};
+    std::strncpy(u.username, name.c_str(), sizeof(u.username) - 1);
+    std::memset(u.password_hash, 'f', sizeof(u.password_hash));
+    u.role = role;
+    u.is_active = 1;
+    return u;
+}
+
+// Random schedules against a brute-force model: every timer must fire on
+// the first advance that reaches its deadline, never before.
+void test_wheel()
+{
+    const uint32_t n = 2000;
+    const uint64_t start = 1000000;
+    TimingWheel wheel;
+    wheel.reset(n, start);
+    std::vector<uint64_t> deadline(n, 0);
+    std::vector<bool> armed(n, false);
+    std::mt19937_64 rng(42);
+
+    std::vector<uint32_t> expired;
+    uint64_t now = start;
+    bool ok = true;
+    for (int round = 0; round < 20000 && ok; ++round) {
+        for (int k = 0; k < 4; ++k) {
+            uint32_t id = static_cast<uint32_t>(rng() % n);
+            uint64_t r = rng() % 100;
+            if (r < 10) {
+                wheel.cancel(id);
+                armed[id] = false;
+            } else {
+                uint64_t delta = r < 60 ? rng() % 64 : r < 90 ? rng() % 5000 : r < 98 ? rng() % 300000 : rng() % 1000000;
+                wheel.schedule(id, now + delta);
+                deadline[id] = delta == 0 ? now + 1 : now + delta;
+                armed[id] = true;
+            }
+        }
+
+        uint64_t step = round % 500 == 499 ? 3000 : 1 + rng() % 3;
+        now += step;
+        expired.clear();
+        wheel.advance(now, expired);
+        std::vector<bool> fired(n, false);
+        for (uint32_t id : expired) {
+            fired[id] = true;
+            if (!armed[id] || deadline[id] > now) {
+                ok = false;
+            }
+            armed[id] = false;
+        }
+        uint32_t pending = 0;
+        for (uint32_t id = 0; id < n; ++id) {
+            if (armed[id]) {
+                ++pending;
+                if (deadline[id] <= now || !wheel.armed(id)) {
+                    ok = false;
+                }
+            }
+        }
+        if (pending != wheel.pending()) {
+            ok = false;
+        }
+    }
+    check(ok, "timing wheel matches the model");
+
+    // A jump past the whole span still fires what is due.
+    wheel.schedule(7, now + 10);
+    wheel.schedule(8, now + 2 * TimingWheel::SPAN);
+    expired.clear();
+    wheel.advance(now + TimingWheel::SPAN + 5, expired);
+    bool has7 = false, has8 = false;
+    for (uint32_t id : expired) {
+        has7 |= id == 7;
+        has8 |= id == 8;
+    }
+    check(has7 && !has8 && wheel.armed(8), "long jump");
+}
+
+void test_sessions()
+{
+    SessionManager sessions;
+    sessions.init(4, 10);
+
+    SessionInfo a, b;
+    check(sessions.create(make_user("alice", UserRole::ADMIN), a) == OFSErrorCodes::SUCCESS, "create session");
+    check(std::strlen(a.session_id) == SESSION_TOKEN_HEX_SIZE, "token printed as 32 hex digits");
+    check(a.user.password_hash[0] == '\0', "session copy carries no password hash");
+    check(sessions.create(make_user("bob", UserRole::NORMAL), b) == OFSErrorCodes::SUCCESS, "second session");
+
+    SessionToken token;
+    check(SessionManager::parse_token(a.session_id, token), "token parses");
+    char printed[SESSION_TOKEN_HEX_SIZE];
+    SessionManager::format_token(token, printed);
+    check(std::string(printed, SESSION_TOKEN_HEX_SIZE) == a.session_id, "token round trip");
+
+    UserRole role = UserRole::NORMAL;
+    check(sessions.validate(a.session_id, &role) == OFSErrorCodes::SUCCESS && role == UserRole::ADMIN, "validate");
+    check(sessions.validate(token) == OFSErrorCodes::SUCCESS, "validate parsed token");
+    SessionInfo info;
+    check(sessions.info(a.session_id, info) == OFSErrorCodes::SUCCESS && info.operations_count == 2 &&
+          std::string(info.user.username) == "alice", "operations counted");
+
+    SessionToken forged = token;
+    forged.secret ^= 1;
+    check(sessions.validate(forged) == OFSErrorCodes::ERROR_INVALID_SESSION, "wrong secret");
+    forged = token;
+    forged.handle = (forged.handle & ~0xFFFFFFFFULL) | 99;
+    check(sessions.validate(forged) == OFSErrorCodes::ERROR_INVALID_SESSION, "slot out of range");
+    check(sessions.validate("not-a-token") == OFSErrorCodes::ERROR_INVALID_SESSION, "malformed token");
+
+    // A reused slot gets a new generation; the old token stays dead.
+    check(sessions.destroy(a.session_id) == OFSErrorCodes::SUCCESS, "logout");
+    check(sessions.destroy(a.session_id) == OFSErrorCodes::ERROR_INVALID_SESSION, "double logout");
+    SessionInfo c;
+    sessions.create(make_user("carol", UserRole::NORMAL), c);
+    SessionToken reused;
+    SessionManager::parse_token(c.session_id, reused);
+    check(static_cast<uint32_t>(reused.handle) == static_cast<uint32_t>(token.handle) &&
+          (reused.handle >> 32) == (token.handle >> 32) + 1, "slot reused with the next generation");
+    check(sessions.validate(token) == OFSErrorCodes::ERROR_INVALID_SESSION, "stale token rejected");
+
+    SessionInfo d, e, f;
+    sessions.create(make_user("bob", UserRole::NORMAL), d);
+    sessions.create(make_user("dave", UserRole::NORMAL), e);
+    check(sessions.create(make_user("erin", UserRole::NORMAL), f) == OFSErrorCodes::ERROR_NO_SPACE, "slab full");
+    check(sessions.destroy_user("bob") == 2 && sessions.active() == 2, "sessions of a deleted user end");
+
+    // Idle expiry: a session used after its creation second is re-armed
+    // from its last activity instead of expiring with the others.
+    sessions.init(4, 10);
+    uint64_t t0 = clock::unix_seconds();
+    SessionInfo idle, busy;
+    sessions.create(make_user("idle", UserRole::NORMAL), idle);
+    sessions.create(make_user("busy", UserRole::NORMAL), busy);
+    while (clock::unix_seconds() == t0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    uint64_t t1 = clock::unix_seconds();
+    sessions.validate(busy.session_id);
+    check(sessions.expire(t0 + 9) == 0, "nothing expires early");
+    check(sessions.expire(t0 + 10) == 1 && sessions.validate(idle.session_id) == OFSErrorCodes::ERROR_INVALID_SESSION,
+          "idle session expired");
+    check(sessions.info(busy.session_id, info) == OFSErrorCodes::SUCCESS, "busy session kept");
+    check(sessions.expire(t1 + 10) == 1 && sessions.active() == 0, "busy session expires once idle");
+}
+
+void bench_validate()
+{
+    SessionManager sessions;
+    const uint32_t n = 4096;
+    sessions.init(n, 1800);
+    std::vector<SessionToken> tokens(n);
+    Logger::get_instance().set_min_level(LogLevel::warn);
+    for (uint32_t i = 0; i < n; ++i) {
+        SessionInfo s;
+        sessions.create(make_user("user" + std::to_string(i), UserRole::NORMAL), s);
+        SessionManager::parse_token(s.session_id, tokens[i]);
+    }
+    Logger::get_instance().set_min_level(LogLevel::info);
+
+    size_t ok = 0;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < 4000000; ++i) {
+        ok += sessions.validate(tokens[(i * 2654435761u) % n]) == OFSErrorCodes::SUCCESS;
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+    check(ok == 4000000, "every token validates");
+    std::cout << "session validate among " << n << " sessions: " << ns / 4000000 << " ns\n";
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/session_manager_test.log");
+
+    test_wheel();
+    test_sessions();
+    bench_validate();
+
+    return report("session manager");
+}
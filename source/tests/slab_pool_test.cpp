@@ -0,0 +1,129 @@
+#include "../include/logger.hpp"
+#include "../include/slab_pool.hpp"
+#include "test_util.hpp"
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace ofs;
+
+static void test_classes()
+{
+    SlabPool& pool = SlabPool::get_instance();
+
+    std::string a = pool.acquire(0);
+    check(a.empty() && a.capacity() >= 255, "smallest class holds 255 bytes");
+    std::string b = pool.acquire(1000);
+    check(b.capacity() >= 1000 && b.capacity() < 2048, "1000 bytes come from the 1 KiB class");
+    std::string c = pool.acquire(1024);
+    check(c.capacity() >= 1024 && c.capacity() < 4096, "1024 bytes need the 2 KiB class");
+
+    // A released buffer comes back for any size its class serves.
+    b.assign(700, 'x');
+    const char* where = b.data();
+    pool.release(std::move(b));
+    check(b.empty() && b.capacity() < 256, "release leaves the string empty");
+    SlabPool::Stats before = pool.stats();
+    std::string again = pool.acquire(600);
+    SlabPool::Stats after = pool.stats();
+    check(again.data() == where && again.empty(), "released buffer is handed out again, empty");
+    check(after.hits == before.hits + 1 && after.misses == before.misses, "reuse counts as a hit");
+
+    // Too large for the classes: allocated and freed as usual.
+    size_t huge = static_cast<size_t>(1) << (SlabPool::MAX_SHIFT + 1);
+    std::string big = pool.acquire(huge);
+    check(big.capacity() >= huge, "oversized acquire still fits");
+    before = pool.stats();
+    pool.release(std::move(big));
+    check(pool.stats().idle_bytes == before.idle_bytes, "oversized buffers are not kept");
+
+    pool.release(std::move(a));
+    pool.release(std::move(c));
+    pool.release(std::move(again));
+}
+
+static void test_reserve()
+{
+    SlabPool& pool = SlabPool::get_instance();
+
+    std::string s = "keep me";
+    pool.reserve(s, 5000);
+    check(s == "keep me" && s.capacity() >= 5000, "reserve keeps the content");
+    size_t cap = s.capacity();
+    pool.reserve(s, 100);
+    check(s.capacity() == cap, "reserve does not shrink");
+
+    // The buffer reserve traded away is in the pool for the next one.
+    std::string t = pool.acquire(300);
+    const char* small = t.data();
+    pool.release(std::move(t));
+    std::string u(20, 'y');
+    pool.reserve(u, 400);
+    check(u == std::string(20, 'y'), "reserve from a heap string copies it over");
+    check(u.data() == small, "reserve takes the pooled buffer");
+    pool.release(std::move(s));
+    pool.release(std::move(u));
+}
+
+static void test_keep_limit()
+{
+    SlabPool& pool = SlabPool::get_instance();
+
+    // The 4 MiB class keeps MIN_KEEP buffers; the rest go to the heap.
+    size_t size = static_cast<size_t>(1) << (SlabPool::MAX_SHIFT - 1);
+    std::vector<std::string> held;
+    for (size_t i = 0; i < SlabPool::MIN_KEEP + 2; ++i) {
+        held.push_back(pool.acquire(size));
+    }
+    uint64_t idle = pool.stats().idle_bytes;
+    for (std::string& s : held) {
+        pool.release(std::move(s));
+    }
+    uint64_t kept = pool.stats().idle_bytes - idle;
+    check(kept == SlabPool::MIN_KEEP * (static_cast<uint64_t>(1) << SlabPool::MAX_SHIFT),
+          "a class keeps at most its quota of idle buffers");
+}
+
+static void test_threads()
+{
+    // Buffers filled on one thread and handed back on another, as the
+    // reactor and the workers do.
+    SlabPool& pool = SlabPool::get_instance();
+    const int rounds = 2000;
+    std::vector<std::thread> threads;
+    std::vector<int> bad(4, 0);
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&pool, &bad, t] {
+            std::string carried;
+            for (int i = 0; i < rounds; ++i) {
+                std::string s = pool.acquire(static_cast<size_t>(100 + (i * 37 + t * 11) % 9000));
+                s.assign(static_cast<size_t>(50 + i % 90), static_cast<char>('a' + t));
+                if (s[0] != 'a' + t) {
+                    ++bad[t];
+                }
+                pool.release(std::move(carried));
+                carried = std::move(s);
+            }
+            pool.release(std::move(carried));
+        });
+    }
+    for (std::thread& th : threads) {
+        th.join();
+    }
+    check(bad[0] + bad[1] + bad[2] + bad[3] == 0, "buffers are not shared between threads");
+    SlabPool::Stats st = pool.stats();
+    check(st.hits > st.misses, "steady state is served from the pool");
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/slab_pool_test.log");
+
+    test_classes();
+    test_reserve();
+    test_keep_limit();
+    test_threads();
+
+    return report("slab pool");
+}
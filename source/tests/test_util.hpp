@@ -0,0 +1,53 @@
+#ifndef TEST_UTIL_HPP
+#define TEST_UTIL_HPP
+
+#include "../include/config_types.hpp"
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+/**
+ * Shared by the test programs in this directory. Each program is a
+ * single translation unit, so failures counts the checks of one program.
+ */
+
+inline int failures = 0;
+
+inline void check(bool cond, const std::string& what)
+{
+    if (!cond)
+    {
+        std::cerr << "FAILED: " << what << "\n";
+        ++failures;
+    }
+}
+
+// Ends main(): prints the outcome and returns the exit status.
+inline int report(const std::string& name)
+{
+    if (failures != 0)
+    {
+        std::cerr << failures << " check(s) failed\n";
+        return 1;
+    }
+    std::cout << name << " tests passed\n";
+    return 0;
+}
+
+// A small container that is quick to format and to mount: 4 KiB blocks,
+// 8 users, cheap password hashing, synced only on shutdown and committed
+// asynchronously. Tests set what they exercise on the copy they get.
+inline ofs::config::Config make_config(uint64_t total_size = 16ULL * 1024 * 1024, uint32_t max_files = 500)
+{
+    ofs::config::Config cfg;
+    cfg.total_size = total_size;
+    cfg.block_size = 4096;
+    cfg.max_files = max_files;
+    cfg.max_users = 8;
+    cfg.hash_iterations = 10;
+    cfg.io_sync_policy = "on_shutdown";
+    cfg.io_durability = "async";
+    return cfg;
+}
+
+#endif // TEST_UTIL_HPP
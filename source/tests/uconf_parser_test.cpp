@@ -30,9 +30,37 @@ int main(int argc, char** argv)
     std::cout << " block_size: " << cfg.block_size << "\n";
     std::cout << " max_files: " << cfg.max_files << "\n";
     std::cout << " max_filename_length: " << cfg.max_filename_length << "\n";
+    std::cout << " block_mapping: " << cfg.block_mapping << "\n";
+    std::cout << " journal_size: " << cfg.journal_size << "\n";
+    std::cout << " history_size: " << cfg.history_size << "\n";
+    std::cout << " history_chunks: " << cfg.history_chunks << "\n";
+    std::cout << " history_full_every: " << cfg.history_full_every << "\n";
     std::cout << " max_users: " << cfg.max_users << "\n";
     std::cout << " admin_username: " << cfg.admin_username << "\n";
     std::cout << " require_auth: " << (cfg.require_auth ? "true" : "false") << "\n";
+    std::cout << " hash_iterations: " << cfg.hash_iterations << "\n";
+    std::cout << " hash_threads: " << cfg.hash_threads << "\n";
+    std::cout << " verify_cache_ttl: " << cfg.verify_cache_ttl << "\n";
+    std::cout << " max_sessions: " << cfg.max_sessions << "\n";
+    std::cout << " session_timeout: " << cfg.session_timeout << "\n";
+    std::cout << " encode_content: " << (cfg.encode_content ? "true" : "false") << "\n";
     std::cout << " server.port: " << cfg.port << "\n";
+    std::cout << " server.execution: " << cfg.execution << "\n";
+    std::cout << " server.workers: " << cfg.workers << "\n";
+    std::cout << " server.stream_window: " << cfg.stream_window << "\n";
+    std::cout << " io.backend: " << cfg.io_backend << "\n";
+    std::cout << " io.queue_depth: " << cfg.io_queue_depth << "\n";
+    std::cout << " io.durability: " << cfg.io_durability << "\n";
+    std::cout << " io.group_commit_ms: " << cfg.io_group_commit_ms << "\n";
+    std::cout << " io.cache_size: " << cfg.io_cache_size << "\n";
+    std::cout << " io.read_ahead: " << cfg.io_read_ahead << "\n";
+    std::cout << " logging.max_size: " << cfg.log_max_size << "\n";
+    std::cout << " logging.max_age: " << cfg.log_max_age << "\n";
+    std::cout << " logging.max_archives: " << cfg.log_max_archives << "\n";
+    std::cout << " logging.compress: " << (cfg.log_compress ? "true" : "false") << "\n";
+    std::cout << " logging.async: " << (cfg.log_async ? "true" : "false") << "\n";
+    std::cout << " logging.queue_size: " << cfg.log_queue_size << "\n";
+    std::cout << " logging.overflow: " << cfg.log_overflow << "\n";
+    std::cout << " logging.format: " << cfg.log_format << "\n";
     return 0;
 }
\ No newline at end of file
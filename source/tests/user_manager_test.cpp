@@ -0,0 +1,273 @@
+#include "../include/file_system.hpp"
+#include "../include/password_hasher.hpp"
+#include "../include/logger.hpp"
+#include "test_util.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <future>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace ofs;
+using namespace ofs::security;
+
+static config::Config users_config(uint32_t max_users)
+{
+    config::Config cfg = make_config(16ULL * 1024 * 1024, 100);
+    cfg.max_users = max_users;
+    cfg.hash_iterations = 100;
+    cfg.hash_threads = 2;
+    return cfg;
+}
+
+void test_sha256()
+{
+    check(sha256_hex("") == "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855", "sha256 of empty input");
+    check(sha256_hex("abc") == "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad", "sha256 of abc");
+    check(sha256_hex("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq") ==
+          "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1", "sha256 two-block message");
+    check(sha256_hex(std::string(1000, 'a')) ==
+          "41edece42d63e8d9bf515a9ba6932e1c20cbc9f5a5d134645adb5db1b9737ea3", "sha256 of 1000 bytes");
+}
+
+static std::string hex(const uint8_t* p, size_t n)
+{
+    static const char* digits = "0123456789abcdef";
+    std::string out;
+    for (size_t i = 0; i < n; ++i) {
+        out += digits[p[i] >> 4];
+        out += digits[p[i] & 0x0F];
+    }
+    return out;
+}
+
+void test_pbkdf2()
+{
+    const uint8_t salt[] = {'s', 'a', 'l', 't'};
+    Pbkdf2Job one{"password", salt, sizeof(salt), 1, {}};
+    pbkdf2_sha256(one);
+    check(hex(one.out, 32) == "120fb6cffcf8b32c43e7225256c4f837a86548c92ccc35480805987cb70be17b", "pbkdf2 1 iteration");
+    Pbkdf2Job two{"password", salt, sizeof(salt), 2, {}};
+    pbkdf2_sha256(two);
+    check(hex(two.out, 32) == "ae4d0c95af6b46d32d0adff928f06dd02a303f8ef3c251dfd6e2d85a95474c43", "pbkdf2 2 iterations");
+
+    // Batches of every width, mixed iteration counts and long keys must
+    // match the one-at-a-time result.
+    std::vector<std::string> passwords;
+    for (int i = 0; i < 11; ++i) {
+        passwords.push_back(i == 7 ? std::string(100, 'k') : "pw" + std::to_string(i));
+    }
+    for (size_t n = 1; n <= passwords.size(); ++n) {
+        std::vector<Pbkdf2Job> batch;
+        for (size_t i = 0; i < n; ++i) {
+            batch.push_back(Pbkdf2Job{passwords[i], salt, sizeof(salt), static_cast<uint32_t>(50 + (i % 3)), {}});
+        }
+        pbkdf2_sha256_batch(batch.data(), batch.size());
+        for (size_t i = 0; i < n; ++i) {
+            Pbkdf2Job single{passwords[i], salt, sizeof(salt), batch[i].iterations, {}};
+            pbkdf2_sha256(single);
+            check(std::memcmp(single.out, batch[i].out, 32) == 0, "batch of " + std::to_string(n) + " matches lane " + std::to_string(i));
+        }
+    }
+
+    UserInfo record{};
+    make_password_record("secret", 20, record);
+    check(verify_password("secret", record) && !verify_password("Secret", record), "salted record");
+    UserInfo again{};
+    make_password_record("secret", 20, again);
+    check(std::memcmp(record.password_hash, again.password_hash, PASSWORD_HASH_HEX_SIZE) != 0, "salt differs per record");
+    check(!needs_rehash(record, 20) && needs_rehash(record, 30), "needs_rehash follows iterations");
+
+    // Records from before salting are plain SHA-256 with zeroed reserved bytes.
+    UserInfo legacy{};
+    std::string digest = sha256_hex("old");
+    std::memcpy(legacy.password_hash, digest.data(), PASSWORD_HASH_HEX_SIZE);
+    check(verify_password("old", legacy) && !verify_password("new", legacy) && needs_rehash(legacy, 20), "legacy record");
+
+    PasswordHasher hasher;
+    hasher.start(20, 2, 60);
+    check(hasher.verify("u", "secret", record) && hasher.cache_hits() == 0, "pool verify");
+    check(hasher.verify("u", "secret", record) && hasher.cache_hits() == 1, "second verify hits the cache");
+    check(!hasher.verify("u", "wrong", record) && hasher.cache_hits() == 1, "wrong password never hits the cache");
+    check(!hasher.verify("u", "secret", again) || hasher.cache_hits() == 1, "cache bound to the stored record");
+    hasher.forget("u");
+    check(hasher.verify("u", "secret", record) && hasher.cache_hits() == 1, "forget drops the entry");
+
+    std::atomic<int> done{0}, accepted{0};
+    for (int i = 0; i < 20; ++i) {
+        hasher.verify_async("user" + std::to_string(i), i % 2 == 0 ? "secret" : "nope", record, [&](bool ok) {
+            accepted += ok ? 1 : 0;
+            ++done;
+        });
+    }
+    hasher.stop();
+    check(done == 20 && accepted == 10, "stop drains queued verifications");
+}
+
+void test_users(const std::string& path)
+{
+    config::Config cfg = users_config(64);
+    storage::OmniContainer::format(path, cfg);
+
+    fs::FileSystem filesystem;
+    filesystem.init(path, cfg);
+    UserManager& users = filesystem.users();
+
+    UserInfo info;
+    check(users.count() == 1, "admin created on first mount");
+    check(users.user_login("admin", "admin123", info) == OFSErrorCodes::SUCCESS && info.role == UserRole::ADMIN, "admin login");
+    check(info.last_login != 0, "last_login recorded");
+    check(users.user_login("admin", "wrong", info) == OFSErrorCodes::ERROR_PERMISSION_DENIED, "wrong password");
+    check(users.user_login("nobody", "x", info) == OFSErrorCodes::ERROR_NOT_FOUND, "unknown user");
+
+    check(users.user_create("alice", "pw1", UserRole::NORMAL) == OFSErrorCodes::SUCCESS, "create alice");
+    check(users.user_create("alice", "pw2", UserRole::NORMAL) == OFSErrorCodes::ERROR_FILE_EXISTS, "duplicate rejected");
+    check(users.user_create("has space", "pw", UserRole::NORMAL) == OFSErrorCodes::ERROR_INVALID_OPERATION, "bad name rejected");
+    check(users.user_create(std::string(32, 'x'), "pw", UserRole::NORMAL) == OFSErrorCodes::ERROR_INVALID_OPERATION, "name too long");
+
+    for (int i = 0; i < 62; ++i) {
+        users.user_create("svc" + std::to_string(i), "secret" + std::to_string(i), UserRole::NORMAL);
+    }
+    check(users.count() == 64, "table filled");
+    check(users.user_create("extra", "pw", UserRole::NORMAL) == OFSErrorCodes::ERROR_NO_SPACE, "full table");
+
+    // Churn leaves tombstones behind; the index must keep finding everyone.
+    for (int round = 0; round < 20; ++round) {
+        for (int i = 0; i < 62; i += 2) {
+            check(users.user_delete("svc" + std::to_string(i)) == OFSErrorCodes::SUCCESS, "delete svc");
+        }
+        for (int i = 0; i < 62; i += 2) {
+            check(users.user_create("svc" + std::to_string(i), "new" + std::to_string(i), UserRole::NORMAL) ==
+                  OFSErrorCodes::SUCCESS, "recreate svc");
+        }
+    }
+    check(users.user_login("svc3", "secret3", info) == OFSErrorCodes::SUCCESS, "untouched user after churn");
+    check(users.user_login("svc4", "new4", info) == OFSErrorCodes::SUCCESS, "recreated user has the new password");
+    check(users.user_delete("ghost") == OFSErrorCodes::ERROR_NOT_FOUND, "delete unknown");
+
+    std::promise<OFSErrorCodes> async_result;
+    users.user_login_async("svc9", "secret9", [&](OFSErrorCodes rc, const UserInfo& u) {
+        async_result.set_value(rc == OFSErrorCodes::SUCCESS && std::string(u.username) == "svc9" ? rc : OFSErrorCodes::ERROR_INVALID_OPERATION);
+    });
+    check(async_result.get_future().get() == OFSErrorCodes::SUCCESS, "async login");
+
+    std::vector<UserInfo> list;
+    users.user_list(list);
+    check(list.size() == 64, "user_list returns every user");
+
+    FSStats stats;
+    filesystem.get_stats(stats);
+    check(stats.total_users == 64, "stats count users");
+    filesystem.shutdown();
+
+    // Clean restart maps the index; an unclean one rebuilds it.
+    filesystem.init(path, cfg);
+    uint32_t slot;
+    UserRole role;
+    check(filesystem.users().find("alice", slot, &role) == OFSErrorCodes::SUCCESS && role == UserRole::NORMAL,
+          "user found after clean restart");
+    check(filesystem.users().user_login("svc5", "secret5", info) == OFSErrorCodes::SUCCESS, "login after clean restart");
+    filesystem.container().mutable_layout().dentry_clean = 0;
+    filesystem.container().sync();
+    std::filesystem::copy_file(path, path + ".crashed", std::filesystem::copy_options::overwrite_existing);
+    filesystem.shutdown();
+
+    fs::FileSystem recovered;
+    recovered.init(path + ".crashed", cfg);
+    check(recovered.users().count() == 64, "index rebuilt after crash");
+    check(recovered.users().user_login("svc6", "new6", info) == OFSErrorCodes::SUCCESS, "login after rebuild");
+    recovered.shutdown();
+    std::filesystem::remove(path + ".crashed");
+
+    // A record hashed with other parameters is rehashed on the next login.
+    cfg.hash_iterations = 200;
+    filesystem.init(path, cfg);
+    UserInfo before;
+    filesystem.users().user_login("alice", "pw1", before);
+    check(!needs_rehash(before, 200), "record upgraded on login");
+    check(filesystem.users().user_login("alice", "pw1", info) == OFSErrorCodes::SUCCESS, "login with upgraded record");
+    filesystem.shutdown();
+}
+
+void bench_lookup(const std::string& path)
+{
+    const uint32_t n = 20000;
+    config::Config cfg = users_config(n);
+    cfg.hash_iterations = 1;
+    storage::OmniContainer::format(path, cfg);
+    fs::FileSystem filesystem;
+    filesystem.init(path, cfg);
+    UserManager& users = filesystem.users();
+    Logger::get_instance().set_min_level(LogLevel::warn);
+    for (uint32_t i = 1; i < n; ++i) {
+        users.user_create("user" + std::to_string(i), "pw", UserRole::NORMAL);
+    }
+    Logger::get_instance().set_min_level(LogLevel::info);
+    check(users.count() == n, "20000 users created");
+
+    std::vector<std::string> names;
+    for (uint32_t i = 1; i < n; ++i) {
+        names.push_back("user" + std::to_string(i));
+    }
+    uint32_t slot;
+    auto t0 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < 1000000; ++i) {
+        users.find(names[(i * 7919) % names.size()], slot);
+    }
+    auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - t0).count();
+
+    UserInfo info;
+    auto t1 = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < 100000; ++i) {
+        users.user_login(names[(i * 7919) % names.size()], "pw", info);
+    }
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+
+    std::cout << "user lookup among " << n << " users: " << ns / 1000000 << " ns, "
+              << static_cast<uint64_t>(100000 / secs) << " cached logins/s\n";
+}
+
+void bench_pbkdf2()
+{
+    const uint8_t salt[PASSWORD_SALT_SIZE] = {};
+    const size_t jobs = 32;
+    std::vector<std::string> passwords;
+    for (size_t i = 0; i < jobs; ++i) {
+        passwords.push_back("password" + std::to_string(i));
+    }
+    std::vector<Pbkdf2Job> batch;
+    for (size_t i = 0; i < jobs; ++i) {
+        batch.push_back(Pbkdf2Job{passwords[i], salt, sizeof(salt), DEFAULT_HASH_ITERATIONS, {}});
+    }
+
+    auto t0 = std::chrono::steady_clock::now();
+    for (Pbkdf2Job& job : batch) {
+        pbkdf2_sha256(job);
+    }
+    double single = std::chrono::duration<double>(std::chrono::steady_clock::now() - t0).count();
+    auto t1 = std::chrono::steady_clock::now();
+    pbkdf2_sha256_batch(batch.data(), batch.size());
+    double lanes = std::chrono::duration<double>(std::chrono::steady_clock::now() - t1).count();
+
+    std::cout << "pbkdf2 (" << DEFAULT_HASH_ITERATIONS << " iterations): " << static_cast<uint64_t>(jobs / single)
+              << " hashes/s one at a time, " << static_cast<uint64_t>(jobs / lanes) << " hashes/s in "
+              << sha256_lanes() << " lanes\n";
+}
+
+int main()
+{
+    Logger::get_instance().set_log_file("logs/user_manager_test.log");
+
+    const std::string path = "user_manager_test.omni";
+    test_sha256();
+    test_pbkdf2();
+    test_users(path);
+    bench_lookup(path);
+    bench_pbkdf2();
+    std::filesystem::remove(path);
+
+    return report("user manager");
+}
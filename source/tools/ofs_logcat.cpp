@@ -0,0 +1,203 @@
+// ofs_logcat: decodes binary OFS logs back into the standard text format.
+//
+//   ofs_logcat [options] FILE...
+//     --level=LEVEL     minimum level (debug, info, warn, error, fatal)
+//     --module=NAME     only this module (may be repeated)
+//     --code=MIN-MAX    only codes in [MIN, MAX] (a single number also works)
+//     --since=TIME      only records at or after TIME
+//     --until=TIME      only records before TIME
+//
+// TIME is either "YYYY-MM-DDTHH:MM:SSZ" or seconds since the Unix epoch.
+// Compressed archives (*.lz) produced by log rotation are read directly.
+
+#include "../include/log_encoding.hpp"
+#include "../include/lz_codec.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <ctime>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ofs;
+
+struct LogFilter
+{
+    int min_level = static_cast<int>(LogLevel::debug);
+    std::set<std::string, std::less<>> modules;
+    int64_t code_min = std::numeric_limits<int64_t>::min();
+    int64_t code_max = std::numeric_limits<int64_t>::max();
+    int64_t since_ns = std::numeric_limits<int64_t>::min();
+    int64_t until_ns = std::numeric_limits<int64_t>::max();
+
+    bool accepts(const DecodedLogRecord& rec) const
+    {
+        if (static_cast<int>(rec.level) < min_level) return false;
+        if (!modules.empty() && modules.find(rec.module) == modules.end()) return false;
+        if (rec.code < code_min || rec.code > code_max) return false;
+        if (rec.wall_ns < since_ns || rec.wall_ns >= until_ns) return false;
+        return true;
+    }
+};
+
+static bool parse_level(std::string v, int& out)
+{
+    std::transform(v.begin(), v.end(), v.begin(), ::tolower);
+    const char* names[] = {"debug", "info", "warn", "error", "fatal"};
+    for (int i = 0; i < 5; ++i) {
+        if (v == names[i]) {
+            out = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_int(const std::string& v, int64_t& out)
+{
+    try {
+        size_t idx = 0;
+        out = std::stoll(v, &idx, 10);
+        return idx == v.size();
+    } catch (...) {
+        return false;
+    }
+}
+
+static bool parse_time_ns(const std::string& v, int64_t& out)
+{
+    int64_t secs;
+    if (parse_int(v, secs)) {
+        out = secs * 1000000000LL;
+        return true;
+    }
+
+    std::tm tm {};
+    std::istringstream iss(v);
+    iss >> std::get_time(&tm, "%Y-%m-%dT%H:%M:%S");
+    if (iss.fail()) {
+        return false;
+    }
+#if defined(_WIN32)
+    std::time_t t = _mkgmtime(&tm);
+#else
+    std::time_t t = timegm(&tm);
+#endif
+    out = static_cast<int64_t>(t) * 1000000000LL;
+    return true;
+}
+
+static bool parse_code_range(const std::string& v, LogFilter& f)
+{
+    size_t dash = v.find('-', 1);
+    if (dash == std::string::npos) {
+        int64_t c;
+        if (!parse_int(v, c)) return false;
+        f.code_min = f.code_max = c;
+        return true;
+    }
+    return parse_int(v.substr(0, dash), f.code_min) && parse_int(v.substr(dash + 1), f.code_max);
+}
+
+static void usage()
+{
+    std::cerr << "usage: ofs_logcat [--level=LEVEL] [--module=NAME]... [--code=MIN-MAX]\n"
+                 "                  [--since=TIME] [--until=TIME] FILE...\n";
+}
+
+int main(int argc, char** argv)
+{
+    LogFilter filter;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value_of = [&arg](const char* prefix) { return arg.substr(std::string(prefix).size()); };
+        bool ok = true;
+
+        if (arg.rfind("--level=", 0) == 0) {
+            ok = parse_level(value_of("--level="), filter.min_level);
+        } else if (arg.rfind("--module=", 0) == 0) {
+            filter.modules.insert(value_of("--module="));
+        } else if (arg.rfind("--code=", 0) == 0) {
+            ok = parse_code_range(value_of("--code="), filter);
+        } else if (arg.rfind("--since=", 0) == 0) {
+            ok = parse_time_ns(value_of("--since="), filter.since_ns);
+        } else if (arg.rfind("--until=", 0) == 0) {
+            ok = parse_time_ns(value_of("--until="), filter.until_ns);
+        } else if (arg == "-h" || arg == "--help") {
+            usage();
+            return 0;
+        } else if (arg.rfind("--", 0) == 0) {
+            ok = false;
+        } else {
+            files.push_back(arg);
+        }
+
+        if (!ok) {
+            std::cerr << "ofs_logcat: bad argument: " << arg << "\n";
+            usage();
+            return 2;
+        }
+    }
+
+    if (files.empty()) {
+        usage();
+        return 2;
+    }
+
+    int rc = 0;
+    std::string line;
+    for (const std::string& path : files) {
+        std::ifstream is(path, std::ios::binary);
+        if (!is) {
+            std::cerr << "ofs_logcat: cannot open " << path << "\n";
+            rc = 1;
+            continue;
+        }
+        std::string data((std::istreambuf_iterator<char>(is)), std::istreambuf_iterator<char>());
+
+        // Rotated archives are compressed by the logger's archiver.
+        if (lz::is_frame(data)) {
+            std::string raw;
+            std::string err;
+            if (!lz::decompress(data, raw, err)) {
+                std::cerr << "ofs_logcat: " << path << ": " << err << "\n";
+                rc = 1;
+                continue;
+            }
+            data.swap(raw);
+        }
+
+        if (!is_binary_log(data)) {
+            std::cerr << "ofs_logcat: " << path << " is not a binary OFS log\n";
+            rc = 1;
+            continue;
+        }
+
+        std::string err;
+        bool ok = decode_binary_log(data, [&](const DecodedLogRecord& rec) {
+            if (!filter.accepts(rec)) {
+                return;
+            }
+            line.clear();
+            format_text_log_line(line, rec.wall_ns, rec.app, rec.pid,
+                                 rec.level, rec.module, rec.code, rec.msg, rec.src_file, rec.line);
+            std::cout << line;
+        }, err);
+
+        if (!ok) {
+            std::cerr << "ofs_logcat: " << path << ": " << err << "\n";
+            rc = 1;
+        }
+    }
+    return rc;
+}